@@ -0,0 +1,124 @@
+/**
+ * cardindex.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for CardIndex.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "cardindex.h"
+#include "textnorm.h"
+#include <algorithm>
+using namespace std;
+
+CardIndex::CardIndex() : distinctTerms(0), duplicateCards(0) {}
+
+// Linear probing; returns the slot holding this normalized text, or the empty slot where it belongs
+size_t CardIndex::findSlot(const vector<Slot>& table, const CardStore& cards, bool definitions,
+                           string_view normalized, uint64_t hash, string& scratch) {
+    size_t mask = table.size() - 1;
+    size_t slot = static_cast<size_t>(hash) & mask;
+    uint32_t tag = static_cast<uint32_t>(hash >> 32);
+
+    while (table[slot].card != NO_CARD) {
+        if (table[slot].tag == tag) {
+            CardId other = table[slot].card;
+            normalizeText(definitions ? cards.def(other) : cards.term(other), scratch);
+            if (scratch == normalized) {
+                return slot;
+            }
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Indexes every card's term and definition
+ * Inputs:
+ *   - const CardStore& cards: Cards to index.
+ */
+void CardIndex::build(const CardStore& cards) {
+    size_t capacity = 16;
+    while (capacity < cards.size() * 2) {
+        capacity <<= 1;
+    }
+
+    slots.assign(capacity, Slot{NO_CARD, 0});
+    nextSameTerm.resize(cards.size());
+    distinctTerms = 0;
+    duplicateCards = 0;
+
+    string normalized;
+    string scratch;
+
+    for (CardId card = 0; card < cards.size(); ++card) {
+        normalizeText(cards.term(card), normalized);
+        uint64_t hash = hashText(normalized);
+        size_t slot = findSlot(slots, cards, false, normalized, hash, scratch);
+
+        if (slots[slot].card == NO_CARD) {
+            slots[slot] = Slot{card, static_cast<uint32_t>(hash >> 32)};
+            nextSameTerm[card] = card;
+            ++distinctTerms;
+        } else {
+            CardId first = slots[slot].card;
+            nextSameTerm[card] = nextSameTerm[first];
+            nextSameTerm[first] = card;
+            ++duplicateCards;
+        }
+    }
+
+    // Definitions only need numbering, so their table is dropped once every card has a group
+    vector<Slot> defSlots(capacity, Slot{NO_CARD, 0});
+    defGroups.resize(cards.size());
+    groupCards.clear();
+
+    for (CardId card = 0; card < cards.size(); ++card) {
+        normalizeText(cards.def(card), normalized);
+        uint64_t hash = hashText(normalized);
+        size_t slot = findSlot(defSlots, cards, true, normalized, hash, scratch);
+
+        if (defSlots[slot].card == NO_CARD) {
+            defSlots[slot] = Slot{card, static_cast<uint32_t>(hash >> 32)};
+            defGroups[card] = static_cast<uint32_t>(groupCards.size());
+            groupCards.push_back(card);
+        } else {
+            defGroups[card] = defGroups[defSlots[slot].card];
+        }
+    }
+}
+
+/**
+ * Looks up a term
+ * Inputs:
+ *   - const CardStore& cards: The store the index was built over.
+ *   - string_view term: Term to find.
+ * Returns:
+ *   - CardId: A card with that term, or NO_CARD.
+ */
+CardId CardIndex::findTerm(const CardStore& cards, string_view term) const {
+    if (slots.empty()) {
+        return NO_CARD;
+    }
+    string normalized;
+    string scratch;
+    normalizeText(term, normalized);
+    return slots[findSlot(slots, cards, false, normalized, hashText(normalized), scratch)].card;
+}
+
+/**
+ * Lists duplicated terms
+ * Inputs:
+ *   - vector<CardId>& firstCards: Receives the first card of every term that appears on more than one card.
+ */
+void CardIndex::duplicateTerms(vector<CardId>& firstCards) const {
+    firstCards.clear();
+    for (const Slot& slot : slots) {
+        if (slot.card != NO_CARD && nextSameTerm[slot.card] != slot.card) {
+            firstCards.push_back(slot.card);
+        }
+    }
+    sort(firstCards.begin(), firstCards.end());
+}
@@ -0,0 +1,99 @@
+/**
+ * cardindex.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for CardIndex, a hash index from normalized term to card ids.
+ * Game modes use it to find every card that shares a term (so a duplicated term accepts each of its
+ * definitions) and the loader uses it to report duplicate terms. It also numbers the distinct
+ * definitions, which is what multiple-choice distractors are drawn from.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_CARDINDEX_H
+#define M2AP_CARDINDEX_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "cardstore.h"
+using namespace std;
+
+const CardId NO_CARD = 0xFFFFFFFFu;
+
+class CardIndex {
+private:
+    struct Slot {
+        CardId card;    // First card of a distinct normalized term, or NO_CARD
+        uint32_t tag;   // High bits of the term's hash, checked before comparing text
+    };
+
+    vector<Slot> slots;            // Open addressing, linear probing
+    vector<CardId> nextSameTerm;   // Circular list of the cards sharing a normalized term
+    vector<uint32_t> defGroups;    // Distinct-definition id of each card
+    vector<CardId> groupCards;     // First card carrying each distinct definition
+    size_t distinctTerms;
+    size_t duplicateCards;
+
+    static size_t findSlot(const vector<Slot>& table, const CardStore& cards, bool definitions,
+                           string_view normalized, uint64_t hash, string& scratch);
+
+public:
+    CardIndex();
+
+    /**
+     * Indexes every card's term and definition
+     * Inputs:
+     *   - const CardStore& cards: Cards to index. One pass; no allocation per card.
+     */
+    void build(const CardStore& cards);
+
+    /**
+     * Looks up a term
+     * Inputs:
+     *   - const CardStore& cards: The store the index was built over.
+     *   - string_view term: Term to find; normalized the same way as the index.
+     * Returns:
+     *   - CardId: A card with that term, or NO_CARD.
+     */
+    CardId findTerm(const CardStore& cards, string_view term) const;
+
+    /**
+     * Returns:
+     *   - CardId: The next card with the same normalized term. Wraps around, so it returns the card
+     *     itself when its term is unique; iterate until coming back to the starting card.
+     */
+    CardId nextWithSameTerm(CardId card) const { return nextSameTerm[card]; }
+
+    bool hasDuplicateTerm(CardId card) const { return nextSameTerm[card] != card; }
+
+    /**
+     * Lists duplicated terms
+     * Inputs:
+     *   - vector<CardId>& firstCards: Receives the first card of every term that appears on more than one card.
+     */
+    void duplicateTerms(vector<CardId>& firstCards) const;
+
+    /**
+     * Distinct definitions are numbered 0 .. distinctDefinitionCount() - 1 in order of first appearance.
+     * Definitions that normalize to the same text share an id.
+     */
+    uint32_t definitionGroup(CardId card) const { return defGroups[card]; }
+    CardId definitionGroupCard(uint32_t group) const { return groupCards[group]; }
+    size_t distinctDefinitionCount() const { return groupCards.size(); }
+
+    size_t distinctTermCount() const { return distinctTerms; }
+    size_t duplicateCardCount() const { return duplicateCards; }
+    bool isBuilt() const { return !slots.empty(); }
+
+    /**
+     * Returns:
+     *   - size_t: Heap bytes held by the index.
+     */
+    size_t heapBytes() const {
+        return slots.capacity() * sizeof(Slot) + (nextSameTerm.capacity() + groupCards.capacity()) * sizeof(CardId) +
+               defGroups.capacity() * sizeof(uint32_t);
+    }
+};
+
+#endif // M2AP_CARDINDEX_H
@@ -0,0 +1,246 @@
+/**
+ * cardstore.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for CardStore.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "cardstore.h"
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+using namespace std;
+
+namespace {
+const uint32_t EMPTY_OFFSETS[1] = {0};
+const size_t TRAINING_SAMPLE_BYTES = 256 << 10;
+
+atomic<uint64_t> nextSerial(1);
+
+// Definitions recently decoded on this thread, from any compressed store. A definition can only be cached in
+// the set of DECODE_CACHE_WAYS entries its key hashes to, so a lookup compares a handful of keys, and within
+// the set the least recently read entry makes room for a new one
+const size_t DECODE_CACHE_SETS = CardStore::DECODE_CACHE_ENTRIES / CardStore::DECODE_CACHE_WAYS;
+
+struct DecodeCache {
+    uint64_t keys[CardStore::DECODE_CACHE_ENTRIES] = {};       // Store serial << 32 | card id; 0 if unused
+    uint64_t lastRead[CardStore::DECODE_CACHE_ENTRIES] = {};
+    size_t lengths[CardStore::DECODE_CACHE_ENTRIES] = {};
+    vector<char> text[CardStore::DECODE_CACHE_ENTRIES];        // Decoded text and the decoder's slack
+    uint64_t clock = 0;
+};
+
+thread_local DecodeCache decodeCache;
+}
+
+CardStore::CardStore() : text(""), offsets(EMPTY_OFFSETS), count(0), serial(0) {}
+
+CardStore::CardStore(CardStore&& other) noexcept
+        : mapping(std::move(other.mapping)), arena(std::move(other.arena)), ownedOffsets(std::move(other.ownedOffsets)),
+          text(other.text), offsets(other.offsets), count(other.count), symbols(std::move(other.symbols)),
+          serial(other.serial) {
+    refreshPointers();
+    other.arena.clear();
+    other.ownedOffsets.clear();
+    other.text = "";
+    other.offsets = EMPTY_OFFSETS;
+    other.count = 0;
+    other.serial = 0;
+}
+
+CardStore& CardStore::operator=(CardStore&& other) noexcept {
+    if (this != &other) {
+        mapping = std::move(other.mapping);
+        arena = std::move(other.arena);
+        ownedOffsets = std::move(other.ownedOffsets);
+        text = other.text;
+        offsets = other.offsets;
+        count = other.count;
+        symbols = std::move(other.symbols);
+        serial = other.serial;
+        refreshPointers();
+        other.arena.clear();
+        other.ownedOffsets.clear();
+        other.text = "";
+        other.offsets = EMPTY_OFFSETS;
+        other.count = 0;
+        other.serial = 0;
+    }
+    return *this;
+}
+
+// Owned stores point into their own arena; a short arena may sit in the string's inline buffer,
+// so the pointers are recomputed whenever the arena could have moved
+void CardStore::refreshPointers() {
+    if (!mapping.isOpen() && !ownedOffsets.empty()) {
+        text = arena.data();
+        offsets = ownedOffsets.data();
+    }
+}
+
+/**
+ * Reserves space for cards about to be added
+ * Inputs:
+ *   - size_t cards: Expected number of cards.
+ *   - size_t textBytes: Expected total length of all terms and definitions.
+ */
+void CardStore::reserve(size_t cards, size_t textBytes) {
+    arena.reserve(textBytes);
+    ownedOffsets.reserve(2 * cards + 1);
+    refreshPointers();
+}
+
+/**
+ * Appends a card, copying its text into the arena
+ * Inputs:
+ *   - string_view term: Study term.
+ *   - string_view def: Definition for the term.
+ * Returns:
+ *   - CardId: Id of the new card.
+ */
+CardId CardStore::addCard(string_view term, string_view def) {
+    if (mapping.isOpen()) {
+        throw logic_error("cards cannot be added to a compiled deck");
+    }
+    // An escaped byte takes two bytes of codes
+    size_t defBytes = symbols != nullptr ? 2 * def.size() : def.size();
+    if (arena.size() + term.size() + defBytes > numeric_limits<uint32_t>::max()
+        || count >= numeric_limits<CardId>::max()) {
+        throw length_error("card store is limited to 4 GiB of text");
+    }
+
+    if (ownedOffsets.empty()) {
+        ownedOffsets.push_back(0);
+    }
+    arena.append(term.data(), term.size());
+    ownedOffsets.push_back(static_cast<uint32_t>(arena.size()));
+    if (symbols != nullptr) {
+        symbols->encode(def, arena);
+    } else {
+        arena.append(def.data(), def.size());
+    }
+    ownedOffsets.push_back(static_cast<uint32_t>(arena.size()));
+
+    refreshPointers();
+    return static_cast<CardId>(count++);
+}
+
+/**
+ * Serves cards straight from a compiled deck mapping
+ * Inputs:
+ *   - MappedFile&& file: Mapping that holds the text and offsets.
+ *   - const char* textBase: Start of the text blob inside the mapping.
+ *   - const uint32_t* offsetTable: 2 * cardCount + 1 offsets inside the mapping.
+ *   - size_t cardCount: Number of cards.
+ */
+void CardStore::adoptMapping(MappedFile&& file, const char* textBase, const uint32_t* offsetTable, size_t cardCount) {
+    arena.clear();
+    arena.shrink_to_fit();
+    ownedOffsets.clear();
+    ownedOffsets.shrink_to_fit();
+    symbols.reset();
+    serial = 0;
+    mapping = std::move(file);
+    text = textBase;
+    offsets = offsetTable;
+    count = cardCount;
+}
+
+/**
+ * Takes over text and offsets that were laid out elsewhere
+ * Inputs:
+ *   - string&& textArena: All terms and definitions, back to back.
+ *   - vector<uint32_t>&& offsetTable: 2 * cardCount + 1 offsets into textArena, starting at 0.
+ */
+void CardStore::adoptArena(string&& textArena, vector<uint32_t>&& offsetTable) {
+    if (textArena.size() > numeric_limits<uint32_t>::max() || offsetTable.empty()
+        || offsetTable.size() % 2 == 0 || offsetTable.back() != textArena.size()) {
+        throw invalid_argument("card store arena does not match its offsets");
+    }
+    mapping = MappedFile();
+    symbols.reset();
+    serial = 0;
+    arena = std::move(textArena);
+    ownedOffsets = std::move(offsetTable);
+    count = ownedOffsets.size() / 2;
+    refreshPointers();
+}
+
+/**
+ * Stores the definitions compressed
+ * Description:
+ *   - The table is trained on evenly spaced definitions adding up to about TRAINING_SAMPLE_BYTES, which is
+ *     plenty for a dictionary of 255 short symbols and keeps training time flat however large the deck is.
+ */
+void CardStore::compressDefinitions() {
+    if (symbols != nullptr || count == 0) {
+        return;
+    }
+
+    size_t definitionBytes = 0;
+    for (size_t card = 0; card < count; ++card) {
+        definitionBytes += offsets[2 * card + 2] - offsets[2 * card + 1];
+    }
+    size_t stride = max<size_t>(1, definitionBytes / TRAINING_SAMPLE_BYTES);
+    vector<string_view> sample;
+    for (size_t card = 0; card < count; card += stride) {
+        sample.push_back(def(static_cast<CardId>(card)));
+    }
+    unique_ptr<SymbolTable> table(new SymbolTable());
+    table->train(sample);
+
+    string packed;
+    packed.reserve(textBytes());
+    vector<uint32_t> packedOffsets;
+    packedOffsets.reserve(2 * count + 1);
+    packedOffsets.push_back(0);
+    for (size_t card = 0; card < count; ++card) {
+        string_view cardTerm = term(static_cast<CardId>(card));
+        packed.append(cardTerm.data(), cardTerm.size());
+        packedOffsets.push_back(static_cast<uint32_t>(packed.size()));
+        table->encode(def(static_cast<CardId>(card)), packed);
+        if (packed.size() > numeric_limits<uint32_t>::max()) {
+            throw length_error("card store is limited to 4 GiB of text");
+        }
+        packedOffsets.push_back(static_cast<uint32_t>(packed.size()));
+    }
+    packed.shrink_to_fit();
+
+    mapping = MappedFile();
+    arena = std::move(packed);
+    ownedOffsets = std::move(packedOffsets);
+    symbols = std::move(table);
+    serial = nextSerial.fetch_add(1);
+    refreshPointers();
+}
+
+// Returns a compressed definition from this thread's cache, decoding it on a miss
+string_view CardStore::decodeDef(CardId id) const {
+    DecodeCache& cache = decodeCache;
+    uint64_t key = serial << 32 | id;
+    size_t first = static_cast<size_t>((key * 0x9E3779B97F4A7C15ULL) >> 32) % DECODE_CACHE_SETS * DECODE_CACHE_WAYS;
+    for (size_t entry = first; entry < first + DECODE_CACHE_WAYS; ++entry) {
+        if (cache.keys[entry] == key) {
+            cache.lastRead[entry] = ++cache.clock;
+            return string_view(cache.text[entry].data(), cache.lengths[entry]);
+        }
+    }
+    size_t slot = first;
+    for (size_t entry = first + 1; entry < first + DECODE_CACHE_WAYS; ++entry) {
+        slot = cache.lastRead[entry] < cache.lastRead[slot] ? entry : slot;
+    }
+
+    uint32_t start = offsets[2 * id + 1];
+    uint32_t length = offsets[2 * id + 2] - start;
+    vector<char>& buffer = cache.text[slot];
+    if (buffer.size() < SymbolTable::decodedBound(length)) {
+        buffer.resize(SymbolTable::decodedBound(length));
+    }
+    cache.keys[slot] = key;
+    cache.lastRead[slot] = ++cache.clock;
+    cache.lengths[slot] = symbols->decode(text + start, length, buffer.data());
+    return string_view(buffer.data(), cache.lengths[slot]);
+}
@@ -0,0 +1,146 @@
+/**
+ * cardstore.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for CardStore, the single owner of a deck's text. Cards are addressed by compact 32-bit ids.
+ * All text lives back to back in one arena and a struct-of-arrays offset table marks where each term and
+ * definition starts, so a card costs 8 bytes on top of its text and no per-card allocation.
+ * A compiled deck is served straight out of its mapping using the same layout.
+ * A store can also keep its definitions compressed with a symbol table trained on the deck (see
+ * symboltable.h); the arena then holds each definition's codes in place of its text, and def() decodes on
+ * demand through a small per-thread cache of recently decoded definitions.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_CARDSTORE_H
+#define M2AP_CARDSTORE_H
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mappedfile.h"
+#include "symboltable.h"
+using namespace std;
+
+typedef uint32_t CardId;
+
+class CardStore {
+private:
+    MappedFile mapping;             // Compiled decks: text and offsets live in the mapping
+    string arena;                   // Otherwise: all text, back to back
+    vector<uint32_t> ownedOffsets;  // Otherwise: 2 * size() + 1 offsets into the arena
+    const char* text;
+    const uint32_t* offsets;        // Term i is [offsets[2i], offsets[2i+1]), definition i is [offsets[2i+1], offsets[2i+2])
+    size_t count;
+    unique_ptr<SymbolTable> symbols;    // Compressed stores: definitions are held as codes of this table
+    uint64_t serial;                    // Compressed stores: tells this store's definitions apart when cached
+
+    void refreshPointers();
+    string_view decodeDef(CardId id) const;
+
+public:
+    CardStore();
+
+    CardStore(const CardStore&) = delete;
+    CardStore& operator=(const CardStore&) = delete;
+    CardStore(CardStore&& other) noexcept;
+    CardStore& operator=(CardStore&& other) noexcept;
+
+    /**
+     * Reserves space for cards about to be added
+     * Inputs:
+     *   - size_t cards: Expected number of cards.
+     *   - size_t textBytes: Expected total length of all terms and definitions.
+     */
+    void reserve(size_t cards, size_t textBytes);
+
+    /**
+     * Appends a card, copying its text into the arena
+     * Inputs:
+     *   - string_view term: Study term.
+     *   - string_view def: Definition for the term.
+     * Returns:
+     *   - CardId: Id of the new card.
+     * Description:
+     *   - Not available for stores adopted from a compiled deck.
+     *   - Adding cards may move the arena, so views returned earlier must not be kept across an add.
+     *   - A compressed store encodes the definition with the symbols it already has.
+     */
+    CardId addCard(string_view term, string_view def);
+
+    /**
+     * Stores the definitions compressed
+     * Description:
+     *   - Trains a symbol table on a sample of the definitions and replaces each definition's text with its
+     *     codes. Terms are left as they are, and a compiled deck is copied out of its mapping.
+     *   - Afterwards a view returned by def() points into a per-thread cache instead of the arena: it stays
+     *     valid until DECODE_CACHE_WAYS - 1 other compressed definitions have been read on the same thread.
+     */
+    void compressDefinitions();
+
+    /**
+     * Serves cards straight from a compiled deck mapping
+     * Inputs:
+     *   - MappedFile&& file: Mapping that holds the text and offsets; ownership moves into the store.
+     *   - const char* textBase: Start of the text blob inside the mapping.
+     *   - const uint32_t* offsetTable: 2 * cardCount + 1 offsets inside the mapping.
+     *   - size_t cardCount: Number of cards.
+     */
+    void adoptMapping(MappedFile&& file, const char* textBase, const uint32_t* offsetTable, size_t cardCount);
+
+    /**
+     * Takes over text and offsets that were laid out elsewhere
+     * Inputs:
+     *   - string&& textArena: All terms and definitions, back to back.
+     *   - vector<uint32_t>&& offsetTable: 2 * cardCount + 1 offsets into textArena, starting at 0.
+     * Description:
+     *   - Lets a builder that fills the arena in parallel hand it over without a copy per card.
+     */
+    void adoptArena(string&& textArena, vector<uint32_t>&& offsetTable);
+
+    static const size_t DECODE_CACHE_ENTRIES = 64;   // Decoded definitions each thread keeps
+    static const size_t DECODE_CACHE_WAYS = 8;       // Of which any one definition competes for this many
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool compressed() const { return symbols != nullptr; }
+
+    string_view term(CardId id) const {
+        return string_view(text + offsets[2 * id], offsets[2 * id + 1] - offsets[2 * id]);
+    }
+
+    string_view def(CardId id) const {
+        if (symbols != nullptr) {
+            return decodeDef(id);
+        }
+        return string_view(text + offsets[2 * id + 1], offsets[2 * id + 2] - offsets[2 * id + 1]);
+    }
+
+    /**
+     * Raw layout, for writers of the compiled format. In a compressed store the definition ranges hold codes
+     * of symbolTable().
+     */
+    const char* textData() const { return text; }
+    const uint32_t* offsetTable() const { return offsets; }
+    const SymbolTable* symbolTable() const { return symbols.get(); }
+
+    /**
+     * Returns:
+     *   - size_t: Total bytes of term and definition text (definition codes in a compressed store).
+     */
+    size_t textBytes() const { return count == 0 ? 0 : offsets[2 * count]; }
+
+    /**
+     * Returns:
+     *   - size_t: Heap bytes held by the store (zero for a mapped compiled deck).
+     */
+    size_t heapBytes() const {
+        return arena.capacity() + ownedOffsets.capacity() * sizeof(uint32_t)
+               + (symbols != nullptr ? sizeof(SymbolTable) + symbols->heapBytes() : 0);
+    }
+};
+
+#endif // M2AP_CARDSTORE_H
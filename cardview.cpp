@@ -0,0 +1,249 @@
+/**
+ * cardview.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the screen of the graphical front end.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "cardview.h"
+#include <algorithm>
+using namespace std;
+
+namespace {
+
+const float MARGIN = 24.0f;
+const float PADDING = 16.0f;
+const float CHOICE_GAP = 8.0f;
+const size_t HEADING_LINES = 3;
+const size_t CHOICE_LINES = 3;      // An option's definition is cut off after this many lines
+
+const uint32_t CARD = packColor(0xF4, 0xF1, 0xE8);
+const uint32_t TERM_TEXT = packColor(0x1B, 0x1F, 0x27);
+const uint32_t DEFINITION_TEXT = packColor(0x3A, 0x3F, 0x4A);
+const uint32_t CHOICE_BOX = packColor(0x2E, 0x34, 0x40);
+const uint32_t LIGHT_TEXT = packColor(0xE8, 0xEA, 0xEE);
+const uint32_t DIM_TEXT = packColor(0x9A, 0xA3, 0xB0);
+const uint32_t RIGHT = packColor(0x66, 0xBB, 0x6A);
+const uint32_t WRONG = packColor(0xEF, 0x53, 0x50);
+
+} // namespace
+
+CardView::CardView(GlyphAtlas& glyphAtlas)
+        : atlas(glyphAtlas), choiceCount(0), lastCorrect(false), current(CardPrompt::NONE), scrollLine(0),
+          definitionRows(0), lastWidth(0), budget(0), pending(false) {}
+
+void CardView::setText(Block& block, string_view text) {
+    if (block.text != text) {
+        block.text.assign(text);
+        block.stale = true;
+    }
+}
+
+/**
+ * Brings a block's layout up to a number of lines, within what is left of the frame's budget
+ */
+void CardView::layout(Block& block, int width, size_t linesWanted) {
+    if (block.stale || block.layout.wrap() != max(width, 1)) {
+        block.layout.reset(atlas, block.text, width);
+        block.stale = false;
+    }
+    if (block.layout.lineCount() < linesWanted && !block.layout.complete()) {
+        budget -= block.layout.layoutLines(min(budget, linesWanted - block.layout.lineCount()));
+        pending = pending || (block.layout.lineCount() < linesWanted && !block.layout.complete());
+    }
+}
+
+void CardView::clear() {
+    setText(heading, "");
+    setText(result, "");
+    choiceCount = 0;
+}
+
+// Only the last few messages are kept
+void CardView::message(string_view text) {
+    string joined = heading.text.empty() ? string(text) : heading.text + "\n" + string(text);
+    size_t lines = static_cast<size_t>(count(joined.begin(), joined.end(), '\n')) + 1;
+    size_t from = 0;
+    for (; lines > HEADING_LINES; --lines) {
+        from = joined.find('\n', from) + 1;
+    }
+    setText(heading, string_view(joined).substr(from));
+}
+
+void CardView::showTerm(string_view termText, bool) {
+    setText(term, termText);
+    setText(definition, "");
+    choiceCount = 0;
+    scrollLine = 0;
+}
+
+void CardView::showDefinition(string_view definitionText) {
+    setText(definition, definitionText);
+    scrollLine = 0;
+}
+
+void CardView::showChoices(const CardStore& cards, const vector<CardId>& options) {
+    if (choices.size() < options.size()) {
+        choices.resize(options.size());
+    }
+    string label;
+    for (size_t i = 0; i < options.size(); ++i) {
+        label = to_string(i + 1) + ".  ";
+        label += cards.def(options[i]);
+        setText(choices[i], label);
+    }
+    choiceCount = options.size();
+}
+
+void CardView::askFlip() {
+    current = CardPrompt::FLIP;
+    setText(hint, "Space: flip the card");
+}
+
+void CardView::askStar() {
+    current = CardPrompt::STAR;
+    setText(hint, "S: star this card     Space: next card");
+}
+
+void CardView::askStudyStarred() {
+    current = CardPrompt::STUDY_STARRED;
+    setText(hint, "Study the starred cards?     Y: yes     N: no");
+}
+
+void CardView::askRating() {
+    current = CardPrompt::RATING;
+    setText(hint, "1: again     2: hard     3: good     4: easy     Q: stop");
+}
+
+void CardView::askChoice(size_t count, bool) {
+    current = CardPrompt::CHOICE;
+    setText(hint, "1-" + to_string(count) + " or click: choose the definition");
+}
+
+void CardView::showChoiceResult(bool correct, size_t correctChoice) {
+    lastCorrect = correct;
+    setText(result, correct ? "Correct!" : "Incorrect. The answer was " + to_string(correctChoice) + ".");
+}
+
+void CardView::showGrade(string_view definitionText, const GradeResult& grade) {
+    lastCorrect = grade.accepted;
+    setText(result, grade.accepted ? "Correct!" : "Incorrect. The definition is: " + string(definitionText));
+}
+
+void CardView::showScore(string_view gameName, int score, size_t total) {
+    message(string(gameName) + " Score: " + to_string(score) + " / " + to_string(total));
+    showMenu();
+}
+
+void CardView::showMenu() {
+    current = CardPrompt::NONE;
+    setText(hint, "F: flashcards     M: multiple choice     Esc: quit");
+}
+
+/**
+ * Adds the screen to a batch
+ * Description:
+ *   - From the top: the game's messages, the card (term, and the definition once flipped, scrolled to
+ *     scrollLine), the options of a multiple-choice question, the last result and the keys to press.
+ */
+void CardView::draw(TextBatch& batch, int width, int height) {
+    budget = LINES_PER_FRAME;
+    pending = false;
+    lastWidth = width;
+    const float lineHeight = static_cast<float>(atlas.lineHeight());
+    const int contentWidth = max(width - 2 * static_cast<int>(MARGIN), 1);
+    const int innerWidth = max(contentWidth - 2 * static_cast<int>(PADDING), 1);
+
+    float y = MARGIN;
+    layout(heading, contentWidth, HEADING_LINES);
+    if (!heading.text.empty()) {
+        batch.addText(heading.layout, MARGIN, y, LIGHT_TEXT, 0, HEADING_LINES);
+        y += lineHeight * static_cast<float>(min(heading.layout.lineCount(), HEADING_LINES)) + PADDING;
+    }
+
+    // Bottom up: the keys to press, and the last result above them
+    float bottom = static_cast<float>(height) - MARGIN;
+    layout(hint, contentWidth, 1);
+    bottom -= lineHeight;
+    batch.addText(hint.layout, MARGIN, bottom, DIM_TEXT, 0, 1);
+    layout(result, contentWidth, 2);
+    if (!result.text.empty()) {
+        bottom -= lineHeight * 2.0f;
+        batch.addText(result.layout, MARGIN, bottom, lastCorrect ? RIGHT : WRONG, 0, 2);
+    }
+    bottom -= PADDING;
+
+    choiceTops.clear();
+    choiceBottoms.clear();
+    if (term.text.empty() && definition.text.empty()) {
+        return;
+    }
+
+    // The card: the term centered, then the definition, as much as fits
+    layout(term, innerWidth, SIZE_MAX);
+    float termHeight = lineHeight * static_cast<float>(term.layout.lineCount());
+    float cardTop = y;
+    float cardBottom;
+    if (choiceCount > 0) {
+        cardBottom = cardTop + termHeight + 2.0f * PADDING;
+    } else {
+        cardBottom = max(bottom, cardTop + termHeight + 2.0f * PADDING);
+    }
+    batch.addRect(MARGIN, cardTop, static_cast<float>(contentWidth), cardBottom - cardTop, CARD);
+    batch.addText(term.layout, MARGIN + PADDING, cardTop + PADDING, TERM_TEXT, 0, SIZE_MAX,
+                  static_cast<float>(innerWidth));
+
+    if (choiceCount == 0 && !definition.text.empty()) {
+        float definitionTop = cardTop + PADDING + termHeight + PADDING;
+        float room = cardBottom - PADDING - definitionTop;
+        definitionRows = room > 0.0f ? static_cast<size_t>(room / lineHeight) : 0;
+        layout(definition, innerWidth, scrollLine + definitionRows);
+        batch.addRect(MARGIN + PADDING, definitionTop - PADDING / 2.0f, static_cast<float>(innerWidth), 1.0f,
+                      DIM_TEXT);
+        batch.addText(definition.layout, MARGIN + PADDING, definitionTop - lineHeight * static_cast<float>(scrollLine),
+                      DEFINITION_TEXT, scrollLine, scrollLine + definitionRows);
+    }
+
+    // The options, each in its own box
+    y = cardBottom + PADDING;
+    for (size_t i = 0; i < choiceCount; ++i) {
+        layout(choices[i], innerWidth, CHOICE_LINES);
+        float boxHeight = lineHeight * static_cast<float>(min(max<size_t>(choices[i].layout.lineCount(), 1),
+                                                              CHOICE_LINES)) + PADDING;
+        if (y + boxHeight > bottom) {
+            break;
+        }
+        batch.addRect(MARGIN, y, static_cast<float>(contentWidth), boxHeight, CHOICE_BOX);
+        batch.addText(choices[i].layout, MARGIN + PADDING, y + PADDING / 2.0f, LIGHT_TEXT, 0, CHOICE_LINES);
+        choiceTops.push_back(y);
+        choiceBottoms.push_back(y + boxHeight);
+        y += boxHeight + CHOICE_GAP;
+    }
+}
+
+void CardView::scroll(int lines) {
+    size_t last = definition.layout.lineCount();
+    if (definition.layout.complete()) {
+        last = last > definitionRows ? last - definitionRows : 0;
+    }
+    if (lines < 0) {
+        size_t back = static_cast<size_t>(-lines);
+        scrollLine = scrollLine > back ? scrollLine - back : 0;
+    } else {
+        scrollLine = min(scrollLine + static_cast<size_t>(lines), last);
+    }
+}
+
+size_t CardView::choiceAt(float x, float y) const {
+    if (x < MARGIN || x > static_cast<float>(lastWidth) - MARGIN) {
+        return 0;
+    }
+    for (size_t i = 0; i < choiceTops.size(); ++i) {
+        if (y >= choiceTops[i] && y < choiceBottoms[i]) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
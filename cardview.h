@@ -0,0 +1,129 @@
+/**
+ * cardview.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the screen of the graphical front end. CardView is a GameRenderer: it keeps what the
+ * flashcard and multiple-choice games ask to show (the term, the definition, the options, the result of
+ * the last answer and what the learner should do next) and draws it as one batch. Text is only laid out
+ * again when it or the window width changes, and a long definition is laid out a few dozen lines per
+ * frame, as far as it is scrolled, so no frame pays for text that is not on screen.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_CARDVIEW_H
+#define M2AP_CARDVIEW_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "gameio.h"
+#include "glyphatlas.h"
+#include "textbatch.h"
+#include "textlayout.h"
+using namespace std;
+
+// What the screen asks for, so keys and clicks can be turned into answers
+enum class CardPrompt {
+    NONE,           // The round is over
+    FLIP,
+    STAR,
+    STUDY_STARRED,
+    RATING,
+    CHOICE
+};
+
+class CardView : public GameRenderer {
+public:
+    static const size_t LINES_PER_FRAME = 48;   // Most lines laid out in one frame, over all the text
+
+private:
+    // A piece of text and its layout, laid out again when either changes
+    struct Block {
+        string text;
+        TextLayout layout;
+        bool stale = true;
+    };
+
+    GlyphAtlas& atlas;
+    Block heading;                  // Messages from the game
+    Block term;
+    Block definition;
+    Block result;
+    Block hint;
+    vector<Block> choices;          // Kept between questions so their layouts' memory is reused
+    size_t choiceCount;
+    bool lastCorrect;
+    CardPrompt current;
+    size_t scrollLine;              // First line of the definition on screen
+    size_t definitionRows;          // Lines of the definition that fit on screen
+    vector<float> choiceTops;       // Where the options were drawn, for clicks
+    vector<float> choiceBottoms;
+    int lastWidth;
+    size_t budget;                  // Lines still to be laid out this frame
+    bool pending;                   // Text on screen was left partly laid out by the last draw()
+
+    void setText(Block& block, string_view text);
+    void layout(Block& block, int width, size_t linesWanted);
+
+public:
+    explicit CardView(GlyphAtlas& glyphAtlas);
+
+    /**
+     * Clears the game's messages, the options and the last result. The card itself stays: a flipped
+     * flashcard shows its definition under its term, until the next term replaces both.
+     */
+    void clear() override;
+    void message(string_view text) override;
+    void showTerm(string_view termText, bool typedAnswer) override;
+    void showDefinition(string_view definitionText) override;
+    void showChoices(const CardStore& cards, const vector<CardId>& options) override;
+    void askFlip() override;
+    void askStar() override;
+    void askStudyStarred() override;
+    void askRating() override;
+    void askChoice(size_t count, bool retry) override;
+    void showChoiceResult(bool correct, size_t correctChoice) override;
+    void showGrade(string_view definitionText, const GradeResult& grade) override;
+    void showScore(string_view gameName, int score, size_t total) override;
+    void showCountdown(int) override {}
+
+    /**
+     * Asks which game to play next, as after a score
+     */
+    void showMenu();
+
+    /**
+     * Adds the screen to a batch
+     * Inputs:
+     *   - TextBatch& batch: Batch begun for this frame; the caller flushes it.
+     *   - int width, int height: Framebuffer size in pixels.
+     */
+    void draw(TextBatch& batch, int width, int height);
+
+    /**
+     * Returns:
+     *   - bool: True while text on screen is still being laid out, so another frame should be drawn
+     *     even if nothing else happens.
+     */
+    bool laying() const { return pending; }
+
+    /**
+     * Scrolls the definition
+     * Inputs:
+     *   - int lines: Lines to move by; negative scrolls back up.
+     */
+    void scroll(int lines);
+
+    /**
+     * Returns:
+     *   - size_t: The option drawn at a point, counted from 1, or 0 if there is none there.
+     */
+    size_t choiceAt(float x, float y) const;
+
+    uint32_t background() const { return packColor(0x1E, 0x22, 0x2A); }
+    CardPrompt prompt() const { return current; }
+    size_t choicesShown() const { return choiceCount; }
+};
+
+#endif // M2AP_CARDVIEW_H
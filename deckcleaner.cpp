@@ -0,0 +1,511 @@
+/**
+ * deckcleaner.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the deck cleaner.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "deckcleaner.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include "textnorm.h"
+using namespace std;
+
+namespace {
+
+const size_t CHUNK_CARDS = 4096;
+const unsigned PARTITION_BITS = 6;
+const size_t PARTITIONS = size_t(1) << PARTITION_BITS;
+const CardId NO_CARD = numeric_limits<CardId>::max();
+
+// What a duplicate is judged on: the term, the definition, or both together
+enum KeyKind { TERM_KEY, DEFINITION_KEY, CARD_KEY, KEY_KINDS };
+
+enum CardStatus : uint8_t { CLEAN, TIDIED, EMPTY };
+
+/**
+ * Hands out items [0, itemCount) to a fixed set of workers. Each worker starts with an equal slice and
+ * takes from its front; a worker that runs dry steals the back half of another worker's slice. A slice
+ * is packed into one atomic word as begin << 32 | end, so taking and stealing are single CASes.
+ */
+class WorkStealer {
+private:
+    struct alignas(64) Slice {
+        atomic<uint64_t> bounds;
+    };
+
+    unique_ptr<Slice[]> slices;
+    size_t workerCount;
+
+    static uint64_t pack(uint64_t begin, uint64_t end) { return begin << 32 | end; }
+
+public:
+    WorkStealer(size_t itemCount, size_t workers) : slices(new Slice[workers]), workerCount(workers) {
+        for (size_t worker = 0; worker < workers; ++worker) {
+            slices[worker].bounds.store(pack(itemCount * worker / workers, itemCount * (worker + 1) / workers));
+        }
+    }
+
+    bool next(size_t worker, size_t& item) {
+        Slice& own = slices[worker];
+        uint64_t bounds = own.bounds.load();
+        while ((bounds >> 32) < (bounds & 0xFFFFFFFF)) {
+            if (own.bounds.compare_exchange_weak(bounds, bounds + (1ULL << 32))) {
+                item = bounds >> 32;
+                return true;
+            }
+        }
+
+        // Items only ever leave a slice, so a slice never returns to a value another thief saw earlier
+        for (size_t step = 1; step < workerCount; ++step) {
+            Slice& victim = slices[(worker + step) % workerCount];
+            uint64_t seen = victim.bounds.load();
+            while ((seen >> 32) < (seen & 0xFFFFFFFF)) {
+                uint64_t begin = seen >> 32;
+                uint64_t end = seen & 0xFFFFFFFF;
+                uint64_t middle = begin + (end - begin) / 2;
+                if (victim.bounds.compare_exchange_weak(seen, pack(begin, middle))) {
+                    own.bounds.store(pack(middle + 1, end));
+                    item = middle;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+};
+
+/**
+ * Runs work(worker, item) for every item on up to threads threads, the calling thread included
+ */
+template <class Work>
+void runParallel(size_t itemCount, unsigned threads, Work work) {
+    size_t workerCount = min<size_t>(threads, max<size_t>(1, itemCount));
+    WorkStealer stealer(itemCount, workerCount);
+    auto loop = [&stealer, &work](size_t worker) {
+        size_t item;
+        while (stealer.next(worker, item)) {
+            work(worker, item);
+        }
+    };
+
+    vector<thread> workers;
+    for (size_t worker = 1; worker < workerCount; ++worker) {
+        workers.emplace_back(loop, worker);
+    }
+    loop(0);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
+
+struct CleanChunk {
+    string text;                    // Cleaned terms and definitions, back to back
+    vector<uint32_t> offsets;       // 2 * cards + 1 offsets into text
+    vector<CardId> bins[KEY_KINDS]; // Non-empty cards grouped by partition, in card order within each
+    uint32_t binStarts[KEY_KINDS][PARTITIONS + 1];
+};
+
+struct ChunkSummary {
+    size_t kept = 0;
+    size_t bytes = 0;
+    size_t tidied = 0;
+    size_t empty = 0;
+    size_t repeated = 0;
+    size_t duplicateTerms = 0;
+    size_t sharedDefinitions = 0;
+    size_t distinctDefinitions = 0;
+    vector<CardId> emptyExamples;
+    vector<pair<CardId, CardId>> repeatedExamples;
+    vector<pair<CardId, CardId>> duplicateTermExamples;
+    vector<pair<CardId, CardId>> sharedDefinitionExamples;
+};
+
+struct Slot {
+    CardId card;    // First card with this key, or NO_CARD
+    uint32_t tag;   // High bits of the key, checked before comparing text
+};
+
+struct WorkerBuffers {
+    string tidied;
+    string normalized;
+    string other;
+    vector<Slot> table;
+};
+
+template <class Example>
+void addExample(vector<Example>& examples, const Example& example) {
+    if (examples.size() < DeckReport::MAX_EXAMPLES) {
+        examples.push_back(example);
+    }
+}
+
+// Chunks hold the earliest cards first, so appending chunk by chunk keeps the earliest examples
+template <class Example>
+void mergeExamples(vector<Example>& examples, const vector<Example>& more) {
+    for (const Example& example : more) {
+        addExample(examples, example);
+    }
+}
+
+uint64_t cardKey(uint64_t termKey, uint64_t definitionKey) {
+    return termKey ^ (definitionKey * 0x9E3779B97F4A7C15ULL);
+}
+
+// Writes a TSV field, quoted only when the loader would otherwise read it back differently
+void appendField(string& out, string_view field) {
+    if (field.find_first_of("\t\n\r") == string_view::npos && (field.empty() || field.front() != '"')) {
+        out.append(field.data(), field.size());
+        return;
+    }
+    out += '"';
+    for (char c : field) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+} // namespace
+
+/**
+ * Prints the report
+ * Inputs:
+ *   - const CardStore& source: The deck that was cleaned.
+ *   - ostream& out: Where to print.
+ */
+void DeckReport::print(const CardStore& source, ostream& out) const {
+    // Examples are shown as they read after cleaning
+    string tidied;
+    auto term = [&source, &tidied](CardId card) -> const string& {
+        tidyText(source.term(card), tidied);
+        return tidied;
+    };
+
+    out << "Cleaned " << inputCards << " cards into " << outputCards << " in " << seconds * 1000.0 << " ms on "
+        << threads << (threads == 1 ? " thread" : " threads") << endl;
+    if (tidiedCards > 0) {
+        out << "  Tidied the whitespace, control characters or encoding of " << tidiedCards << " cards" << endl;
+    }
+    if (emptyCards > 0) {
+        out << "  Dropped " << emptyCards << " cards without a term or definition (for example card "
+            << emptyExamples.front() + 1 << ")" << endl;
+    }
+    if (repeatedCards > 0) {
+        const pair<CardId, CardId>& example = repeatedExamples.front();
+        out << "  Dropped " << repeatedCards << " repeated cards (for example card " << example.second + 1
+            << " repeats card " << example.first + 1 << ", \"" << term(example.first) << "\")" << endl;
+    }
+    if (duplicateTermCards > 0) {
+        const pair<CardId, CardId>& example = duplicateTermExamples.front();
+        out << "  " << duplicateTermCards << " cards give another definition for an earlier term (for example \""
+            << term(example.first) << "\" on cards " << example.first + 1 << " and " << example.second + 1
+            << "); any of a term's definitions will be accepted" << endl;
+    }
+    if (sharedDefinitionCards > 0) {
+        const pair<CardId, CardId>& example = sharedDefinitionExamples.front();
+        out << "  " << sharedDefinitionCards << " cards share a definition with an earlier term (for example \""
+            << term(example.first) << "\" and \"";
+        // term() reuses one buffer, so the second term goes out in a statement of its own
+        out << term(example.second) << "\" on cards " << example.first + 1 << " and " << example.second + 1 << ")"
+            << endl;
+    }
+    out << "  " << distinctDefinitions << " distinct definitions";
+    if (!multipleChoiceReady()) {
+        out << "; multiple choice needs at least " << MIN_DISTINCT_DEFINITIONS;
+    }
+    out << endl;
+}
+
+/**
+ * Cleans and validates a deck
+ * Inputs:
+ *   - const CardStore& source: Deck to clean.
+ *   - CardStore& cleaned: Receives the kept cards with cleaned text.
+ *   - DeckReport& report: Receives the counts and examples.
+ *   - unsigned threads: Worker threads; 0 uses every core.
+ */
+void cleanDeck(const CardStore& source, CardStore& cleaned, DeckReport& report, unsigned threads) {
+    auto start = chrono::steady_clock::now();
+    const size_t cardCount = source.size();
+    const size_t chunkCount = (cardCount + CHUNK_CARDS - 1) / CHUNK_CARDS;
+
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, chunkCount)));
+    report = DeckReport();
+    report.inputCards = cardCount;
+    report.threads = threads;
+
+    vector<CleanChunk> chunks(chunkCount);
+    vector<WorkerBuffers> buffers(threads);
+    vector<CardStatus> status(cardCount);
+    vector<uint64_t> keys[KEY_KINDS];
+    vector<CardId> earlier[KEY_KINDS];     // Earlier card with the same key, or NO_CARD
+    for (size_t kind = 0; kind < KEY_KINDS; ++kind) {
+        keys[kind].resize(cardCount);
+        earlier[kind].resize(cardCount);
+    }
+
+    auto cleanedTerm = [&chunks](CardId card) {
+        const CleanChunk& chunk = chunks[card / CHUNK_CARDS];
+        size_t local = card % CHUNK_CARDS;
+        return string_view(chunk.text.data() + chunk.offsets[2 * local],
+                           chunk.offsets[2 * local + 1] - chunk.offsets[2 * local]);
+    };
+    auto cleanedDefinition = [&chunks](CardId card) {
+        const CleanChunk& chunk = chunks[card / CHUNK_CARDS];
+        size_t local = card % CHUNK_CARDS;
+        return string_view(chunk.text.data() + chunk.offsets[2 * local + 1],
+                           chunk.offsets[2 * local + 2] - chunk.offsets[2 * local + 1]);
+    };
+
+    // Pass 1: clean each chunk's text, hash the normalized forms and bin the cards by partition
+    runParallel(chunkCount, threads, [&](size_t worker, size_t chunkNumber) {
+        CleanChunk& chunk = chunks[chunkNumber];
+        WorkerBuffers& buffer = buffers[worker];
+        CardId begin = static_cast<CardId>(chunkNumber * CHUNK_CARDS);
+        CardId end = static_cast<CardId>(min(cardCount, (chunkNumber + 1) * CHUNK_CARDS));
+
+        size_t sourceBytes = source.offsetTable()[2 * end] - source.offsetTable()[2 * begin];
+        chunk.text.reserve(sourceBytes);
+        chunk.offsets.reserve(2 * (end - begin) + 1);
+        chunk.offsets.push_back(0);
+
+        for (CardId card = begin; card < end; ++card) {
+            bool changed = false;
+            bool empty = false;
+            uint64_t fieldKeys[2];
+            for (int field = 0; field < 2; ++field) {
+                string_view original = field == 0 ? source.term(card) : source.def(card);
+                tidyText(original, buffer.tidied);
+                changed = changed || buffer.tidied != original;
+                empty = empty || buffer.tidied.empty();
+                normalizeText(buffer.tidied, buffer.normalized);
+                fieldKeys[field] = hashText(buffer.normalized);
+                chunk.text += buffer.tidied;
+                chunk.offsets.push_back(static_cast<uint32_t>(chunk.text.size()));
+            }
+            status[card] = empty ? EMPTY : (changed ? TIDIED : CLEAN);
+            keys[TERM_KEY][card] = fieldKeys[0];
+            keys[DEFINITION_KEY][card] = fieldKeys[1];
+            keys[CARD_KEY][card] = cardKey(fieldKeys[0], fieldKeys[1]);
+            for (size_t kind = 0; kind < KEY_KINDS; ++kind) {
+                earlier[kind][card] = NO_CARD;
+            }
+        }
+
+        // A counting sort per kind, so pass 2 reads each partition's cards in order without a scan
+        for (size_t kind = 0; kind < KEY_KINDS; ++kind) {
+            uint32_t* starts = chunk.binStarts[kind];
+            fill(starts, starts + PARTITIONS + 1, 0);
+            for (CardId card = begin; card < end; ++card) {
+                if (status[card] != EMPTY) {
+                    ++starts[(keys[kind][card] >> (64 - PARTITION_BITS)) + 1];
+                }
+            }
+            for (size_t partition = 0; partition < PARTITIONS; ++partition) {
+                starts[partition + 1] += starts[partition];
+            }
+            vector<uint32_t> fillAt(starts, starts + PARTITIONS);
+            chunk.bins[kind].resize(starts[PARTITIONS]);
+            for (CardId card = begin; card < end; ++card) {
+                if (status[card] != EMPTY) {
+                    chunk.bins[kind][fillAt[keys[kind][card] >> (64 - PARTITION_BITS)]++] = card;
+                }
+            }
+        }
+    });
+
+    // Pass 2: one item per kind and partition finds each card's earliest match, with linear probing as in
+    // CardIndex. Hashes only nominate a match; the normalized text has to agree as well.
+    runParallel(KEY_KINDS * PARTITIONS, threads, [&](size_t worker, size_t item) {
+        size_t kind = item / PARTITIONS;
+        size_t partition = item % PARTITIONS;
+        WorkerBuffers& buffer = buffers[worker];
+
+        auto sameText = [&](string_view a, string_view b) {
+            normalizeText(a, buffer.normalized);
+            normalizeText(b, buffer.other);
+            return buffer.normalized == buffer.other;
+        };
+        auto sameCard = [&](CardId a, CardId b) {
+            return (kind == DEFINITION_KEY || sameText(cleanedTerm(a), cleanedTerm(b)))
+                   && (kind == TERM_KEY || sameText(cleanedDefinition(a), cleanedDefinition(b)));
+        };
+
+        size_t binned = 0;
+        for (const CleanChunk& chunk : chunks) {
+            binned += chunk.binStarts[kind][partition + 1] - chunk.binStarts[kind][partition];
+        }
+        size_t capacity = 16;
+        while (capacity < 2 * binned) {
+            capacity *= 2;
+        }
+        vector<Slot>& table = buffer.table;
+        table.assign(capacity, Slot{NO_CARD, 0});
+        size_t mask = capacity - 1;
+
+        for (const CleanChunk& chunk : chunks) {
+            const uint32_t* starts = chunk.binStarts[kind];
+            for (uint32_t at = starts[partition]; at < starts[partition + 1]; ++at) {
+                CardId card = chunk.bins[kind][at];
+                uint64_t key = keys[kind][card];
+                uint32_t tag = static_cast<uint32_t>(key >> 32);
+                size_t slot = static_cast<size_t>(key) & mask;
+                while (table[slot].card != NO_CARD
+                       && !(table[slot].tag == tag && keys[kind][table[slot].card] == key
+                            && sameCard(table[slot].card, card))) {
+                    slot = (slot + 1) & mask;
+                }
+                if (table[slot].card == NO_CARD) {
+                    table[slot] = Slot{card, tag};
+                } else {
+                    earlier[kind][card] = table[slot].card;
+                }
+            }
+        }
+    });
+
+    // Pass 3: decide which cards stay, and count each chunk's share of the output
+    vector<ChunkSummary> summaries(chunkCount);
+    runParallel(chunkCount, threads, [&](size_t, size_t chunkNumber) {
+        ChunkSummary& summary = summaries[chunkNumber];
+        CardId begin = static_cast<CardId>(chunkNumber * CHUNK_CARDS);
+        CardId end = static_cast<CardId>(min(cardCount, (chunkNumber + 1) * CHUNK_CARDS));
+        for (CardId card = begin; card < end; ++card) {
+            if (status[card] == EMPTY) {
+                ++summary.empty;
+                addExample(summary.emptyExamples, card);
+            } else if (earlier[CARD_KEY][card] != NO_CARD) {
+                ++summary.repeated;
+                addExample(summary.repeatedExamples, make_pair(earlier[CARD_KEY][card], card));
+            } else {
+                ++summary.kept;
+                summary.bytes += cleanedTerm(card).size() + cleanedDefinition(card).size();
+                summary.tidied += status[card] == TIDIED;
+                if (earlier[TERM_KEY][card] != NO_CARD) {
+                    ++summary.duplicateTerms;
+                    addExample(summary.duplicateTermExamples, make_pair(earlier[TERM_KEY][card], card));
+                }
+                if (earlier[DEFINITION_KEY][card] != NO_CARD) {
+                    ++summary.sharedDefinitions;
+                    addExample(summary.sharedDefinitionExamples, make_pair(earlier[DEFINITION_KEY][card], card));
+                } else {
+                    ++summary.distinctDefinitions;
+                }
+            }
+        }
+    });
+
+    vector<size_t> cardStarts(chunkCount + 1, 0);
+    vector<size_t> byteStarts(chunkCount + 1, 0);
+    for (size_t chunkNumber = 0; chunkNumber < chunkCount; ++chunkNumber) {
+        const ChunkSummary& summary = summaries[chunkNumber];
+        cardStarts[chunkNumber + 1] = cardStarts[chunkNumber] + summary.kept;
+        byteStarts[chunkNumber + 1] = byteStarts[chunkNumber] + summary.bytes;
+        report.tidiedCards += summary.tidied;
+        report.emptyCards += summary.empty;
+        report.repeatedCards += summary.repeated;
+        report.duplicateTermCards += summary.duplicateTerms;
+        report.sharedDefinitionCards += summary.sharedDefinitions;
+        report.distinctDefinitions += summary.distinctDefinitions;
+        mergeExamples(report.emptyExamples, summary.emptyExamples);
+        mergeExamples(report.repeatedExamples, summary.repeatedExamples);
+        mergeExamples(report.duplicateTermExamples, summary.duplicateTermExamples);
+        mergeExamples(report.sharedDefinitionExamples, summary.sharedDefinitionExamples);
+    }
+    report.outputCards = cardStarts[chunkCount];
+    if (byteStarts[chunkCount] > numeric_limits<uint32_t>::max()) {
+        throw length_error("card store is limited to 4 GiB of text");
+    }
+
+    // Pass 4: every chunk knows where its cards land, so the arena and offsets are filled in parallel
+    string arena(byteStarts[chunkCount], '\0');
+    vector<uint32_t> offsets(2 * report.outputCards + 1);
+    offsets[0] = 0;
+    runParallel(chunkCount, threads, [&](size_t, size_t chunkNumber) {
+        CardId begin = static_cast<CardId>(chunkNumber * CHUNK_CARDS);
+        CardId end = static_cast<CardId>(min(cardCount, (chunkNumber + 1) * CHUNK_CARDS));
+        size_t slot = cardStarts[chunkNumber];
+        size_t write = byteStarts[chunkNumber];
+        for (CardId card = begin; card < end; ++card) {
+            if (status[card] == EMPTY || earlier[CARD_KEY][card] != NO_CARD) {
+                continue;
+            }
+            string_view term = cleanedTerm(card);
+            string_view definition = cleanedDefinition(card);
+            memcpy(&arena[write], term.data(), term.size());
+            write += term.size();
+            offsets[2 * slot + 1] = static_cast<uint32_t>(write);
+            memcpy(&arena[write], definition.data(), definition.size());
+            write += definition.size();
+            offsets[2 * slot + 2] = static_cast<uint32_t>(write);
+            ++slot;
+        }
+    });
+
+    cleaned.adoptArena(std::move(arena), std::move(offsets));
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * Writes a deck as TSV
+ * Inputs:
+ *   - const CardStore& cards: Deck to write.
+ *   - const string& path: Output file.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool writeDeckTsv(const CardStore& cards, const string& path, string& error) {
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+
+        // The header keeps a first card that happens to read "term, definition" from being skipped
+        string chunk = "term\tdefinition\n";
+        for (CardId card = 0; card < cards.size(); ++card) {
+            appendField(chunk, cards.term(card));
+            chunk += '\t';
+            appendField(chunk, cards.def(card));
+            chunk += '\n';
+            if (chunk.size() >= 1 << 16) {
+                outFile.write(chunk.data(), static_cast<streamsize>(chunk.size()));
+                chunk.clear();
+            }
+        }
+        outFile.write(chunk.data(), static_cast<streamsize>(chunk.size()));
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
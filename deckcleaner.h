@@ -0,0 +1,84 @@
+/**
+ * deckcleaner.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the deck cleaner, which tidies and validates an imported deck before it is studied.
+ * Every card's text is cleaned for display (see tidyText), then cards are compared the way answers are
+ * graded (see normalizeText) to find empty cards, repeated cards, terms on more than one card and
+ * definitions shared by different terms. Multiple choice needs four distinct definitions per question,
+ * so a deck with fewer is flagged.
+ *
+ * The work runs on every core in three passes: cleaning chunks of cards, finding duplicates in
+ * hash partitions, and laying out the cleaned deck. Chunks and partitions are handed out with work
+ * stealing, so a thread that draws slow cards (long or non-ASCII text) does not hold the others up.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_DECKCLEANER_H
+#define M2AP_DECKCLEANER_H
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cardstore.h"
+using namespace std;
+
+struct DeckReport {
+    static constexpr size_t MIN_DISTINCT_DEFINITIONS = 4;   // The answer and three distractors
+    static constexpr size_t MAX_EXAMPLES = 5;
+
+    size_t inputCards = 0;
+    size_t outputCards = 0;
+    size_t tidiedCards = 0;             // Kept cards whose text cleaning changed
+    size_t emptyCards = 0;              // Dropped: no term or no definition left after cleaning
+    size_t repeatedCards = 0;           // Dropped: same term and definition as an earlier card
+    size_t duplicateTermCards = 0;      // Kept: term already on an earlier card, with another definition
+    size_t sharedDefinitionCards = 0;   // Kept: definition already on an earlier card, for another term
+    size_t distinctDefinitions = 0;     // In the cleaned deck
+    double seconds = 0.0;
+    unsigned threads = 0;
+
+    // Ids in the input deck, earliest first; pairs are (earlier card, later card)
+    vector<CardId> emptyExamples;
+    vector<pair<CardId, CardId>> repeatedExamples;
+    vector<pair<CardId, CardId>> duplicateTermExamples;
+    vector<pair<CardId, CardId>> sharedDefinitionExamples;
+
+    bool multipleChoiceReady() const { return distinctDefinitions >= MIN_DISTINCT_DEFINITIONS; }
+
+    /**
+     * Prints the report
+     * Inputs:
+     *   - const CardStore& source: The deck that was cleaned, for the examples' terms.
+     *   - ostream& out: Where to print.
+     */
+    void print(const CardStore& source, ostream& out) const;
+};
+
+/**
+ * Cleans and validates a deck
+ * Inputs:
+ *   - const CardStore& source: Deck to clean; it is only read.
+ *   - CardStore& cleaned: Receives the kept cards, in their original order, with cleaned text.
+ *   - DeckReport& report: Receives the counts and examples.
+ *   - unsigned threads: Worker threads; 0 uses every core.
+ * Description:
+ *   - Empty and repeated cards are dropped. Duplicate terms and shared definitions are kept, since the
+ *     games accept any of a term's definitions, and only reported.
+ */
+void cleanDeck(const CardStore& source, CardStore& cleaned, DeckReport& report, unsigned threads = 0);
+
+/**
+ * Writes a deck as TSV
+ * Inputs:
+ *   - const CardStore& cards: Deck to write.
+ *   - const string& path: Output file, replaced atomically.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: True if the file was written.
+ */
+bool writeDeckTsv(const CardStore& cards, const string& path, string& error);
+
+#endif // M2AP_DECKCLEANER_H
@@ -0,0 +1,245 @@
+/**
+ * deckfile.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the compiled (.stdeck) deck format.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "deckfile.h"
+#include "deckloader.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+using namespace std;
+
+namespace {
+
+const uint64_t PRIME1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME3 = 0x165667B19E3779F9ULL;
+
+inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t mixLane(uint64_t acc, uint64_t value) {
+    acc += value * PRIME2;
+    acc = rotl(acc, 31);
+    return acc * PRIME1;
+}
+
+inline uint64_t readWord(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+size_t padTo8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+bool statSource(const string& path, uint64_t& size, int64_t& mtime) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    size = static_cast<uint64_t>(info.st_size);
+    mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+    return true;
+}
+
+} // namespace
+
+/**
+ * Checksum used by compiled decks
+ * Inputs:
+ *   - const void* data: Bytes to hash.
+ *   - size_t size: Number of bytes.
+ * Returns:
+ *   - uint64_t: 64-bit hash of the bytes.
+ */
+uint64_t deckChecksum(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t lanes[4] = {PRIME1 + PRIME2, PRIME2, 0, 0 - PRIME1};
+
+    while (end - p >= 32) {
+        lanes[0] = mixLane(lanes[0], readWord(p));
+        lanes[1] = mixLane(lanes[1], readWord(p + 8));
+        lanes[2] = mixLane(lanes[2], readWord(p + 16));
+        lanes[3] = mixLane(lanes[3], readWord(p + 24));
+        p += 32;
+    }
+
+    uint64_t hash = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    hash += static_cast<uint64_t>(size);
+
+    while (end - p >= 8) {
+        hash ^= mixLane(0, readWord(p));
+        hash = rotl(hash, 27) * PRIME1 + PRIME3;
+        p += 8;
+    }
+    while (p < end) {
+        hash ^= (*p) * PRIME3;
+        hash = rotl(hash, 11) * PRIME1;
+        ++p;
+    }
+
+    hash ^= hash >> 33;
+    hash *= PRIME2;
+    hash ^= hash >> 29;
+    hash *= PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/**
+ * Checks whether mapped bytes start with the compiled deck magic
+ */
+bool isCompiledDeck(const char* data, size_t size) {
+    return size >= sizeof(DECK_FILE_MAGIC) && memcmp(data, DECK_FILE_MAGIC, sizeof(DECK_FILE_MAGIC)) == 0;
+}
+
+/**
+ * Compiles a TSV/CSV deck into a .stdeck file
+ * Inputs:
+ *   - const string& sourcePath: Text deck to compile.
+ *   - const string& outputPath: Compiled deck to write.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - size_t* cardCount: Optional number of cards written.
+ * Returns:
+ *   - bool: True if the compiled deck was written.
+ */
+bool compileDeck(const string& sourcePath, const string& outputPath, string& error, size_t* cardCount) {
+    CardStore store;
+    if (!loadDeck(sourcePath, store, error)) {
+        return false;
+    }
+
+    DeckFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, DECK_FILE_MAGIC, sizeof(header.magic));
+    header.version = DECK_FILE_VERSION;
+    header.sourcePathLength = static_cast<uint32_t>(sourcePath.size());
+    header.cardCount = store.size();
+    header.blobSize = store.textBytes();
+    statSource(sourcePath, header.sourceSize, header.sourceMtime);
+
+    // Everything after the header is assembled in one buffer so it can be checksummed in one pass
+    size_t pathBytes = padTo8(sourcePath.size());
+    size_t offsetCount = 2 * store.size() + 1;
+    size_t offsetBytes = padTo8(offsetCount * sizeof(uint32_t));
+    string body(pathBytes + offsetBytes + header.blobSize, '\0');
+
+    // The store already uses the on-disk layout, so the offsets and text are copied across wholesale
+    memcpy(&body[0], sourcePath.data(), sourcePath.size());
+    memcpy(&body[pathBytes], store.offsetTable(), offsetCount * sizeof(uint32_t));
+    memcpy(&body[pathBytes + offsetBytes], store.textData(), header.blobSize);
+
+    header.checksum = deckChecksum(body.data(), body.size());
+
+    string tempPath = outputPath + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outFile.write(body.data(), static_cast<streamsize>(body.size()));
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), outputPath.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + outputPath + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    if (cardCount) {
+        *cardCount = store.size();
+    }
+    return true;
+}
+
+/**
+ * Opens a compiled deck
+ * Inputs:
+ *   - MappedFile&& file: The mapped .stdeck file; ownership moves into the deck.
+ *   - const string& path: Path of the file, for error messages.
+ *   - CardStore& store: Receives the cards, served from the mapping.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: False if the file is truncated, corrupt, of another version, or older than its source deck.
+ */
+bool openCompiledDeck(MappedFile&& file, const string& path, CardStore& store, string& error) {
+    store = CardStore();
+
+    const char* data = file.data();
+    size_t size = file.size();
+
+    if (size < sizeof(DeckFileHeader) || !isCompiledDeck(data, size)) {
+        error = path + " is not a compiled deck";
+        return false;
+    }
+
+    DeckFileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.version != DECK_FILE_VERSION) {
+        error = path + " was compiled by an incompatible version (format " + to_string(header.version)
+                + ", expected " + to_string(DECK_FILE_VERSION) + "); recompile it";
+        return false;
+    }
+
+    size_t pathBytes = padTo8(header.sourcePathLength);
+    size_t offsetCount = 2 * header.cardCount + 1;
+    size_t offsetBytes = padTo8(offsetCount * sizeof(uint32_t));
+    size_t bodySize = pathBytes + offsetBytes + header.blobSize;
+
+    if (header.cardCount > size || size - sizeof(header) != bodySize) {
+        error = path + " is truncated or corrupt";
+        return false;
+    }
+
+    const char* body = data + sizeof(header);
+    if (deckChecksum(body, bodySize) != header.checksum) {
+        error = path + " failed its checksum; the file is corrupt";
+        return false;
+    }
+
+    string sourcePath(body, header.sourcePathLength);
+    uint64_t sourceSize = 0;
+    int64_t sourceMtime = 0;
+    if (statSource(sourcePath, sourceSize, sourceMtime)
+        && (sourceSize != header.sourceSize || sourceMtime != header.sourceMtime)) {
+        error = path + " is stale: " + sourcePath + " changed after it was compiled; recompile it";
+        return false;
+    }
+
+    // The header and path are padded to 8 bytes, so the table is aligned inside the page-aligned mapping
+    const uint32_t* offsets = reinterpret_cast<const uint32_t*>(body + pathBytes);
+    const char* blob = body + pathBytes + offsetBytes;
+
+    if (offsets[0] != 0 || offsets[offsetCount - 1] != header.blobSize) {
+        error = path + " has an invalid offset table";
+        return false;
+    }
+    for (size_t i = 1; i < offsetCount; ++i) {
+        if (offsets[i] < offsets[i - 1]) {
+            error = path + " has an invalid offset table";
+            return false;
+        }
+    }
+
+    store.adoptMapping(std::move(file), blob, offsets, static_cast<size_t>(header.cardCount));
+    return true;
+}
@@ -0,0 +1,85 @@
+/**
+ * deckfile.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the compiled (.stdeck) deck format. A compiled deck is mapped and played directly,
+ * so even a deck of millions of cards starts without parsing anything.
+ *
+ * Layout (all integers little-endian):
+ *   DeckFileHeader
+ *   source path bytes, zero padded to a multiple of 8
+ *   uint32_t offsets[2 * cardCount + 1]   term i is blob[offsets[2i], offsets[2i+1]),
+ *                                          definition i is blob[offsets[2i+1], offsets[2i+2])
+ *   zero padding to a multiple of 8
+ *   char blob[blobSize]                    UTF-8 text of every card, back to back
+ *
+ * The checksum covers everything after the header. The source size and modification time let a stale
+ * compiled deck be rejected when the deck it was compiled from has since changed.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_DECKFILE_H
+#define M2AP_DECKFILE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "cardstore.h"
+#include "mappedfile.h"
+using namespace std;
+
+const char DECK_FILE_MAGIC[8] = {'S', 'T', 'D', 'E', 'C', 'K', '\r', '\n'};
+const uint32_t DECK_FILE_VERSION = 1;
+
+struct DeckFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t sourcePathLength;
+    uint64_t cardCount;
+    uint64_t blobSize;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t checksum;
+};
+
+/**
+ * Checksum used by compiled decks
+ * Inputs:
+ *   - const void* data: Bytes to hash.
+ *   - size_t size: Number of bytes.
+ * Returns:
+ *   - uint64_t: 64-bit hash of the bytes. Processes four 64-bit lanes at a time so verifying a large
+ *     deck costs a few milliseconds.
+ */
+uint64_t deckChecksum(const void* data, size_t size);
+
+/**
+ * Compiles a TSV/CSV deck into a .stdeck file
+ * Inputs:
+ *   - const string& sourcePath: Text deck to compile.
+ *   - const string& outputPath: Compiled deck to write. Written to a temporary file and renamed into place.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - size_t* cardCount: Optional number of cards written.
+ * Returns:
+ *   - bool: True if the compiled deck was written.
+ */
+bool compileDeck(const string& sourcePath, const string& outputPath, string& error, size_t* cardCount = nullptr);
+
+/**
+ * Checks whether mapped bytes start with the compiled deck magic
+ */
+bool isCompiledDeck(const char* data, size_t size);
+
+/**
+ * Opens a compiled deck
+ * Inputs:
+ *   - MappedFile&& file: The mapped .stdeck file; ownership moves into the deck.
+ *   - const string& path: Path of the file, for error messages.
+ *   - CardStore& store: Receives the cards, served from the mapping.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: False if the file is truncated, corrupt, of another version, or older than its source deck.
+ */
+bool openCompiledDeck(MappedFile&& file, const string& path, CardStore& store, string& error);
+
+#endif // M2AP_DECKFILE_H
@@ -0,0 +1,297 @@
+/**
+ * deckloader.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the bulk deck importer.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "deckloader.h"
+#include "deckfile.h"
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <string_view>
+using namespace std;
+
+namespace {
+
+bool equalsIgnoreCase(string_view field, const char* word) {
+    size_t n = strlen(word);
+    if (field.size() != n) {
+        return false;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        char c = field[i];
+        if (c >= 'A' && c <= 'Z') {
+            c = static_cast<char>(c - 'A' + 'a');
+        }
+        if (c != word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t countLines(const char* data, size_t size) {
+    size_t lines = 0;
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!nl) {
+            return lines + 1;
+        }
+        ++lines;
+        p = nl + 1;
+    }
+    return lines;
+}
+
+} // namespace
+
+char deckDelimiter(const string& path, const char* data, size_t size) {
+    auto endsWith = [&path](const char* suffix) {
+        size_t n = strlen(suffix);
+        if (path.size() < n) {
+            return false;
+        }
+        for (size_t i = 0; i < n; ++i) {
+            char c = path[path.size() - n + i];
+            if (c >= 'A' && c <= 'Z') {
+                c = static_cast<char>(c - 'A' + 'a');
+            }
+            if (c != suffix[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (endsWith(".tsv") || endsWith(".tab")) {
+        return '\t';
+    }
+    if (endsWith(".csv")) {
+        return ',';
+    }
+
+    const char* lineEnd = static_cast<const char*>(memchr(data, '\n', size));
+    size_t firstLine = lineEnd ? static_cast<size_t>(lineEnd - data) : size;
+    return memchr(data, '\t', firstLine) ? '\t' : ',';
+}
+
+/**
+ * Finds where a row ends
+ * Description:
+ *   - Walks the fields the way parseDeckRow() does, so a delimiter or newline inside quotes is skipped.
+ */
+size_t findDeckRowEnd(const char* data, size_t size, size_t pos, char delim) {
+    while (pos < size) {
+        if (data[pos] == '"') {
+            ++pos;
+            while (true) {
+                const char* quote = static_cast<const char*>(memchr(data + pos, '"', size - pos));
+                if (quote == nullptr) {
+                    return SIZE_MAX;
+                }
+                pos = static_cast<size_t>(quote - data) + 1;
+                if (pos >= size) {
+                    return SIZE_MAX;        // "" or the closing quote: the next character decides
+                }
+                if (data[pos] != '"') {
+                    break;
+                }
+                ++pos;
+            }
+        }
+        while (pos < size && data[pos] != delim && data[pos] != '\n') {
+            ++pos;
+        }
+        if (pos >= size) {
+            return SIZE_MAX;
+        }
+        if (data[pos] == '\n') {
+            return pos + 1;
+        }
+        ++pos; // delimiter
+    }
+    return SIZE_MAX;
+}
+
+bool parseDeckRow(char* data, size_t size, char delim, size_t& pos, size_t& line, DeckRow& row) {
+    row.term = string_view();
+    row.def = string_view();
+    row.fields = 0;
+    row.line = line;
+    bool rowDone = false;
+
+    while (!rowDone) {
+        string_view field;
+
+        if (pos < size && data[pos] == '"') {
+            // Quoted field: copy characters down over the doubled quotes as we go
+            size_t read = pos + 1;
+            size_t write = read;
+            bool closed = false;
+
+            while (read < size) {
+                char c = data[read];
+                if (c == '"') {
+                    if (read + 1 < size && data[read + 1] == '"') {
+                        data[write++] = '"';
+                        read += 2;
+                        continue;
+                    }
+                    closed = true;
+                    ++read;
+                    break;
+                }
+                if (c == '\n') {
+                    ++line;
+                }
+                if (write != read) {
+                    data[write] = c;
+                }
+                ++write;
+                ++read;
+            }
+
+            if (!closed) {
+                return false;
+            }
+
+            field = string_view(data + pos + 1, write - pos - 1);
+
+            // Anything between the closing quote and the delimiter is dropped
+            while (read < size && data[read] != delim && data[read] != '\n') {
+                ++read;
+            }
+            pos = read;
+        } else {
+            size_t start = pos;
+            while (pos < size && data[pos] != delim && data[pos] != '\n') {
+                ++pos;
+            }
+            size_t end = pos;
+            if (end > start && data[end - 1] == '\r') {
+                --end;
+            }
+            field = string_view(data + start, end - start);
+        }
+
+        if (row.fields == 0) {
+            row.term = field;
+        } else if (row.fields == 1) {
+            row.def = field;
+        }
+        ++row.fields;
+
+        if (pos >= size) {
+            rowDone = true;
+        } else if (data[pos] == '\n') {
+            ++pos;
+            ++line;
+            rowDone = true;
+        } else {
+            ++pos; // delimiter
+        }
+    }
+    return true;
+}
+
+bool isDeckHeader(const DeckRow& row) {
+    return row.fields >= 2 && equalsIgnoreCase(row.term, "term")
+           && (equalsIgnoreCase(row.def, "definition") || equalsIgnoreCase(row.def, "def"));
+}
+
+/**
+ * Loads a TSV or CSV deck
+ * Inputs:
+ *   - const string& path: Deck file.
+ *   - CardStore& store: Receives the cards.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - DeckLoadReport* report: Optional details about skipped rows.
+ * Returns:
+ *   - bool: True if the deck was parsed.
+ * Description:
+ *   - Compiled (.stdeck) decks are recognised by their magic and opened directly.
+ *   - The file is mapped copy-on-write so quoted fields can be unescaped in place before they are copied
+ *     into the store's arena. The mapping is released once the deck is parsed.
+ */
+bool loadDeck(const string& path, CardStore& store, string& error, DeckLoadReport* report) {
+    store = CardStore();
+    DeckLoadReport details;
+    MappedFile source;
+
+    if (!source.open(path, error, true)) {
+        return false;
+    }
+
+    if (isCompiledDeck(source.data(), source.size())) {
+        return openCompiledDeck(std::move(source), path, store, error);
+    }
+
+    char* data = source.mutableData();
+    size_t size = source.size();
+    const char delim = deckDelimiter(path, data, size);
+
+    // The text never outgrows the file, so one reservation covers every card
+    size_t expectedRows = countLines(data, size);
+    store.reserve(expectedRows, size);
+    size_t textBytes = 0;
+
+    // Skip a UTF-8 byte order mark
+    size_t pos = 0;
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) {
+        pos = 3;
+    }
+
+    size_t line = 1;
+    bool firstRow = true;
+
+    DeckRow row;
+    while (pos < size) {
+        size_t rowLine = line;
+        if (!parseDeckRow(data, size, delim, pos, line, row)) {
+            error = path + ":" + to_string(rowLine) + ": unterminated quoted field";
+            store = CardStore();
+            return false;
+        }
+
+        bool blank = row.fields == 1 && row.term.empty();
+        if (blank) {
+            continue;
+        }
+
+        if (firstRow) {
+            firstRow = false;
+            if (isDeckHeader(row)) {
+                details.headerSkipped = true;
+                continue;
+            }
+        }
+
+        if (row.fields < 2) {
+            if (details.skippedRows == 0) {
+                details.firstSkippedLine = rowLine;
+            }
+            ++details.skippedRows;
+            continue;
+        }
+
+        textBytes += row.term.size() + row.def.size();
+        if (textBytes > numeric_limits<uint32_t>::max()) {
+            error = path + ": decks with more than 4 GiB of text are not supported";
+            store = CardStore();
+            return false;
+        }
+        store.addCard(row.term, row.def);
+    }
+
+    if (report) {
+        *report = details;
+    }
+    return true;
+}
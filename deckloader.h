@@ -0,0 +1,89 @@
+/**
+ * deckloader.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the bulk deck importer. Decks exported from other systems (TSV or CSV) are
+ * memory-mapped and parsed in a single pass straight into a CardStore, so a deck of millions of cards
+ * is loaded without a heap allocation per card.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_DECKLOADER_H
+#define M2AP_DECKLOADER_H
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "cardstore.h"
+using namespace std;
+
+struct DeckLoadReport {
+    size_t skippedRows = 0;       // Rows with fewer than two fields
+    size_t firstSkippedLine = 0;  // 1-based line of the first skipped row, 0 if none
+    bool headerSkipped = false;
+};
+
+/**
+ * Loads a TSV or CSV deck
+ * Inputs:
+ *   - const string& path: Deck file. ".tsv" files are tab separated, ".csv" comma separated; any other
+ *     extension is sniffed from the first line.
+ *   - CardStore& store: Receives the cards. Any previous contents are replaced.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - DeckLoadReport* report: Optional details about skipped rows.
+ * Returns:
+ *   - bool: True if the deck was parsed.
+ * Description:
+ *   - The first two fields of each row are the term and the definition; extra columns are ignored.
+ *   - Fields may be quoted ("...") to contain the delimiter, newlines or doubled "" quotes.
+ *   - A leading "term<delim>definition" header row is skipped.
+ *   - Compiled decks (see deckfile.h) are detected by content and opened without parsing.
+ */
+bool loadDeck(const string& path, CardStore& store, string& error, DeckLoadReport* report = nullptr);
+
+// One row of a TSV or CSV deck, as parseDeckRow() found it
+struct DeckRow {
+    string_view term;       // First field
+    string_view def;        // Second field, if the row has one
+    size_t fields;          // Fields in the row; a blank line is one empty field
+    size_t line;            // 1-based line the row starts on
+};
+
+/**
+ * Returns:
+ *   - char: The field delimiter of a text deck: from the extension of path, else tab if the first line of
+ *     data has one, else comma.
+ */
+char deckDelimiter(const string& path, const char* data, size_t size);
+
+/**
+ * Finds where a row ends without changing anything, for readers that only hold part of a deck
+ * Inputs:
+ *   - const char* data, size_t size: Text read so far.
+ *   - size_t pos: Start of the row.
+ *   - char delim: Field delimiter.
+ * Returns:
+ *   - size_t: Offset just past the row's newline, or SIZE_MAX if the row (or a quoted field in it) runs
+ *     past size, so more text is needed to parse it.
+ */
+size_t findDeckRowEnd(const char* data, size_t size, size_t pos, char delim);
+
+/**
+ * Parses one row, unescaping quoted fields in place
+ * Inputs:
+ *   - char* data, size_t size: Deck text; the row must lie entirely inside it.
+ *   - char delim: Field delimiter.
+ *   - size_t& pos, size_t& line: Start of the row and its line; advanced past the row.
+ *   - DeckRow& row: Receives the fields, which point into data.
+ * Returns:
+ *   - bool: False if a quoted field is not closed before size.
+ */
+bool parseDeckRow(char* data, size_t size, char delim, size_t& pos, size_t& line, DeckRow& row);
+
+/**
+ * Returns:
+ *   - bool: True if a row is a "term<delim>definition" (or "def") header.
+ */
+bool isDeckHeader(const DeckRow& row);
+
+#endif // M2AP_DECKLOADER_H
@@ -0,0 +1,336 @@
+/**
+ * deckstream.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the streaming deck reader.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "deckstream.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "deckfile.h"
+#include "deckloader.h"
+using namespace std;
+
+namespace {
+
+const size_t READ_SIZE = 64 * 1024;     // Bytes read from the file at a time
+
+} // namespace
+
+DeckStream::DeckStream()
+        : chunkBytes(0), bufferStart(0), bufferEnd(0), endOfFile(false), delim('\t'), line(1), firstRow(true),
+          cardsRead(0), poolText(0), poolTextLimit(0), aheadBytes(0), windowBytes(0), largestChunk(0),
+          readerDone(true), stopping(false), started(false), chunksPlayed(0), stalls(0), stallNanos(0),
+          peakBytes(0) {}
+
+DeckStream::~DeckStream() {
+    stopReader();
+}
+
+bool DeckStream::open(const string& deckPath, const DeckStreamConfig& streamConfig, string& error) {
+    stopReader();
+    if (streamConfig.memoryBudget < MIN_BUDGET) {
+        error = "The memory budget must be at least " + to_string(MIN_BUDGET >> 20) + " MiB";
+        return false;
+    }
+    // A chunk's offsets, term index and reservoir copy come to about half its text again
+    chunkBytes = streamConfig.chunkBytes != 0 ? streamConfig.chunkBytes : streamConfig.memoryBudget / 6;
+    if (chunkBytes * 3 > streamConfig.memoryBudget) {
+        error = "A memory budget of " + to_string(streamConfig.memoryBudget) + " bytes cannot hold three chunks of " +
+                to_string(chunkBytes) + " bytes";
+        return false;
+    }
+    path = deckPath;
+    config = streamConfig;
+    poolTextLimit = config.memoryBudget / 16;
+    file.close();
+    file.open(path, ios::binary);
+    if (!file.is_open()) {
+        error = "Unable to open " + path;
+        return false;
+    }
+    buffer.assign(READ_SIZE, '\0');
+    bufferStart = 0;
+    bufferEnd = 0;
+    endOfFile = false;
+    if (!fillBuffer(error)) {
+        return false;
+    }
+    if (isCompiledDeck(buffer.data(), bufferEnd)) {
+        error = path + " is a compiled deck, which is already paged in from disk as it is played; open it "
+                       "without streaming";
+        return false;
+    }
+    delim = deckDelimiter(path, buffer.data(), bufferEnd);
+    peakBytes = 0;
+    stalls = 0;
+    stallNanos = 0;
+    startReader();
+    return true;
+}
+
+/**
+ * Starts reading from the beginning of the deck
+ * Description:
+ *   - The buffer already holds the file's first bytes: open() read them, and rewind() reads them again.
+ */
+void DeckStream::startReader() {
+    bufferStart = 0;
+    if (bufferEnd >= 3 && memcmp(buffer.data(), "\xEF\xBB\xBF", 3) == 0) {
+        bufferStart = 3;
+    }
+    line = 1;
+    firstRow = true;
+    cardsRead = 0;
+    rng.seed(config.seed);
+    poolTerms.clear();
+    poolDefs.clear();
+    poolText = 0;
+
+    ahead.clear();
+    aheadBytes = 0;
+    windowBytes = 0;
+    largestChunk = chunkBytes;
+    readerDone = false;
+    stopping = false;
+    failure.clear();
+    window = Chunk();
+    started = false;
+    chunksPlayed = 0;
+    prefetcher = thread(&DeckStream::readerLoop, this);
+}
+
+void DeckStream::stopReader() {
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    roomFreed.notify_all();
+    if (prefetcher.joinable()) {
+        prefetcher.join();
+    }
+}
+
+void DeckStream::rewind() {
+    if (!started) {
+        return;
+    }
+    stopReader();
+    string error;
+    file.clear();
+    file.seekg(0);
+    bufferStart = 0;
+    bufferEnd = 0;
+    endOfFile = false;
+    if (!fillBuffer(error)) {
+        lock_guard<mutex> guard(lock);
+        failure = error;
+        readerDone = true;
+        window = Chunk();
+        return;
+    }
+    startReader();
+}
+
+/**
+ * Reads ahead while the budget has room
+ * Description:
+ *   - One chunk ahead is always read, whatever its size, so the game never waits on a chunk that does
+ *     not fit; beyond that a chunk is only started if one as large as the largest so far still fits.
+ */
+void DeckStream::readerLoop() {
+    while (true) {
+        {
+            unique_lock<mutex> guard(lock);
+            roomFreed.wait(guard, [this] {
+                return stopping || ahead.empty() || windowBytes + aheadBytes + largestChunk <= config.memoryBudget;
+            });
+            if (stopping) {
+                return;
+            }
+        }
+
+        auto chunk = make_unique<Chunk>();
+        string error;
+        bool read = readChunk(*chunk, error);
+
+        lock_guard<mutex> guard(lock);
+        if (!read || chunk->cards.empty()) {
+            failure = error;
+            readerDone = true;
+            chunkReady.notify_all();
+            return;
+        }
+        largestChunk = max(largestChunk, chunk->bytes);
+        aheadBytes += chunk->bytes;
+        ahead.push_back(std::move(chunk));
+        peakBytes = max(peakBytes, windowBytes + aheadBytes);
+        chunkReady.notify_all();
+    }
+}
+
+/**
+ * Moves the unparsed text to the front of the buffer and reads more after it
+ * Description:
+ *   - The buffer only grows when a single row does not fit in it.
+ */
+bool DeckStream::fillBuffer(string& error) {
+    if (bufferStart > 0) {
+        memmove(buffer.data(), buffer.data() + bufferStart, bufferEnd - bufferStart);
+        bufferEnd -= bufferStart;
+        bufferStart = 0;
+    }
+    if (bufferEnd == buffer.size()) {
+        buffer.resize(buffer.size() * 2);
+    }
+    file.read(buffer.data() + bufferEnd, static_cast<streamsize>(buffer.size() - bufferEnd));
+    if (file.bad()) {
+        error = "Unable to read " + path;
+        return false;
+    }
+    bufferEnd += static_cast<size_t>(file.gcount());
+    endOfFile = file.eof();
+    return true;
+}
+
+/**
+ * Keeps a uniform sample of every card read so far (Algorithm R), skipping cards that would take the
+ * reservoir's text past its limit
+ */
+void DeckStream::sampleCard(string_view term, string_view def) {
+    size_t text = term.size() + def.size();
+    if (poolTerms.size() < config.poolSize) {
+        if (poolText + text <= poolTextLimit) {
+            poolTerms.emplace_back(term);
+            poolDefs.emplace_back(def);
+            poolText += text;
+        }
+    } else if (config.poolSize > 0) {
+        uint32_t slot = rng.below(static_cast<uint32_t>(min<size_t>(cardsRead + 1, UINT32_MAX)));
+        if (slot < config.poolSize) {
+            size_t replaced = poolTerms[slot].size() + poolDefs[slot].size();
+            if (poolText - replaced + text <= poolTextLimit) {
+                poolTerms[slot].assign(term);
+                poolDefs[slot].assign(def);
+                poolText += text - replaced;
+            }
+        }
+    }
+}
+
+/**
+ * Parses the next chunk of the deck
+ * Inputs:
+ *   - Chunk& chunk: Receives the cards, their index and a copy of the reservoir. Left empty at the end of
+ *     the deck.
+ *   - string& error: Receives a description of the failure, if any.
+ * Description:
+ *   - Rows are skipped as loadDeck() skips them: blank lines, a header and rows without a definition.
+ *   - A chunk is closed before a row whose raw text would take it past the chunk size, so its text never
+ *     outgrows the reservation (a row longer than a chunk gets a chunk of its own).
+ */
+bool DeckStream::readChunk(Chunk& chunk, string& error) {
+    chunk.firstCard = cardsRead;
+    chunk.cards.reserve(chunkBytes / 64, chunkBytes);
+    size_t textBytes = 0;
+    DeckRow row;
+
+    while (true) {
+        size_t rowEnd = findDeckRowEnd(buffer.data(), bufferEnd, bufferStart, delim);
+        if (rowEnd == SIZE_MAX) {
+            if (!endOfFile) {
+                if (!fillBuffer(error)) {
+                    return false;
+                }
+                continue;
+            }
+            if (bufferStart >= bufferEnd) {
+                break;
+            }
+            rowEnd = bufferEnd;     // The last row, without a newline
+        }
+        if (!chunk.cards.empty() && textBytes + (rowEnd - bufferStart) > chunkBytes) {
+            break;
+        }
+
+        size_t rowLine = line;
+        if (!parseDeckRow(buffer.data(), rowEnd, delim, bufferStart, line, row)) {
+            error = path + ":" + to_string(rowLine) + ": unterminated quoted field";
+            return false;
+        }
+        if (row.fields == 1 && row.term.empty()) {
+            continue;
+        }
+        if (firstRow) {
+            firstRow = false;
+            if (isDeckHeader(row)) {
+                continue;
+            }
+        }
+        if (row.fields < 2) {
+            continue;
+        }
+
+        chunk.cards.addCard(row.term, row.def);
+        textBytes += row.term.size() + row.def.size();
+        sampleCard(row.term, row.def);
+        ++cardsRead;
+    }
+
+    if (chunk.cards.empty()) {
+        return true;
+    }
+    chunk.index.build(chunk.cards);
+    chunk.pool.reserve(poolTerms.size(), 0);
+    for (size_t i = 0; i < poolTerms.size(); ++i) {
+        chunk.pool.addCard(poolTerms[i], poolDefs[i]);
+    }
+    chunk.bytes = chunk.cards.heapBytes() + chunk.index.heapBytes() + chunk.pool.heapBytes();
+    return true;
+}
+
+bool DeckStream::next(string& error) {
+    error.clear();
+    unique_ptr<Chunk> chunk;
+    {
+        unique_lock<mutex> guard(lock);
+        if (ahead.empty() && !readerDone) {
+            auto waitStart = chrono::steady_clock::now();
+            chunkReady.wait(guard, [this] { return !ahead.empty() || readerDone; });
+            if (started && !ahead.empty()) {
+                ++stalls;
+                stallNanos += static_cast<uint64_t>(
+                        chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - waitStart).count());
+            }
+        }
+        if (ahead.empty()) {
+            error = failure;
+            return false;
+        }
+        chunk = std::move(ahead.front());
+        ahead.pop_front();
+    }
+
+    // The chunk stays counted as read ahead until the one it replaces is freed
+    size_t bytes = chunk->bytes;
+    window = std::move(*chunk);
+    chunk.reset();
+    {
+        lock_guard<mutex> guard(lock);
+        aheadBytes -= bytes;
+        windowBytes = bytes;
+    }
+    roomFreed.notify_all();
+    started = true;
+    ++chunksPlayed;
+    return true;
+}
+
+size_t DeckStream::peakMemory() const {
+    lock_guard<mutex> guard(lock);
+    return peakBytes;
+}
@@ -0,0 +1,168 @@
+/**
+ * deckstream.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for DeckStream, which plays a TSV or CSV deck too large to load whole. The deck is read in
+ * play order a chunk at a time: each chunk is parsed into its own CardStore and CardIndex on a background
+ * thread, which keeps the next chunks ready while the current one is played. Chunks in memory (the one
+ * being played and those read ahead) are held under a byte budget; the prefetcher waits for a chunk to be
+ * played before reading past it, and the budget always leaves room for one chunk ahead, so moving to the
+ * next chunk does not wait on the disk unless the disk is slower than the learner.
+ *
+ * The multiple-choice game needs wrong definitions from the whole deck, not just the chunk in play, so
+ * the prefetcher also keeps a reservoir sample of the cards read so far; each chunk carries a copy of it
+ * as it stood after that chunk was read, so a seed replays the same distractors however far ahead the
+ * prefetcher happened to be. The reservoir's text is held to a sixteenth of the budget: a card that would
+ * take it past that is not sampled, which only matters for decks of very long definitions.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_DECKSTREAM_H
+#define M2AP_DECKSTREAM_H
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "cardindex.h"
+#include "cardstore.h"
+#include "fastrng.h"
+using namespace std;
+
+struct DeckStreamConfig {
+    size_t memoryBudget = size_t{64} << 20;     // Bytes of chunks in memory, played or read ahead
+    size_t chunkBytes = 0;                      // Card text per chunk; 0 sizes chunks from the budget
+    size_t poolSize = 512;                      // Cards kept in the distractor reservoir
+    uint64_t seed = 0;                          // Seeds the reservoir
+};
+
+class DeckStream {
+public:
+    static const size_t MIN_BUDGET = size_t{1} << 20;
+
+private:
+    // A parsed piece of the deck
+    struct Chunk {
+        CardStore cards;
+        CardIndex index;
+        CardStore pool;             // The reservoir once this chunk was read
+        size_t firstCard = 0;       // Position in the deck of the chunk's first card
+        size_t bytes = 0;           // Heap bytes of all of the above
+    };
+
+    string path;
+    DeckStreamConfig config;
+    size_t chunkBytes;
+
+    // Prefetch thread only
+    ifstream file;
+    vector<char> buffer;            // Text read from the file and not yet parsed
+    size_t bufferStart;
+    size_t bufferEnd;
+    bool endOfFile;
+    char delim;
+    size_t line;
+    bool firstRow;
+    size_t cardsRead;
+    FastRng rng;
+    vector<string> poolTerms;       // Reservoir sample of the cards read so far
+    vector<string> poolDefs;
+    size_t poolText;                // Bytes of text in the reservoir
+    size_t poolTextLimit;           // Its share of the budget, as every chunk carries a copy
+
+    // Shared with the prefetch thread
+    mutable mutex lock;
+    condition_variable chunkReady;
+    condition_variable roomFreed;
+    deque<unique_ptr<Chunk>> ahead; // Read, not yet played
+    size_t aheadBytes;
+    size_t windowBytes;
+    size_t largestChunk;            // Most bytes any chunk took, to judge whether another fits
+    bool readerDone;
+    bool stopping;
+    string failure;
+    thread prefetcher;
+
+    // Playing thread only
+    Chunk window;
+    bool started;                   // A chunk has been taken since the last rewind
+    size_t chunksPlayed;
+    size_t stalls;
+    uint64_t stallNanos;
+    size_t peakBytes;               // Guarded by lock
+
+    void startReader();
+    void stopReader();
+    void readerLoop();
+    bool fillBuffer(string& error);
+    bool readChunk(Chunk& chunk, string& error);
+    void sampleCard(string_view term, string_view def);
+
+public:
+    DeckStream();
+    ~DeckStream();
+
+    DeckStream(const DeckStream&) = delete;
+    DeckStream& operator=(const DeckStream&) = delete;
+
+    /**
+     * Opens a deck and starts reading it ahead
+     * Inputs:
+     *   - const string& deckPath: TSV or CSV deck, as loadDeck() reads.
+     *   - const DeckStreamConfig& streamConfig: Memory budget, chunk size and reservoir size.
+     *   - string& error: Receives a description of the failure, if any.
+     * Description:
+     *   - A budget under MIN_BUDGET, or one that cannot hold three chunks, is refused.
+     *   - Compiled decks are refused: they are mapped, so they are already paged in from disk as played.
+     */
+    bool open(const string& deckPath, const DeckStreamConfig& streamConfig, string& error);
+
+    /**
+     * Moves to the next chunk of the deck, dropping the one in play
+     * Inputs:
+     *   - string& error: Receives a description of a read or parse failure, if any.
+     * Returns:
+     *   - bool: False at the end of the deck (error empty) or on a failure.
+     * Description:
+     *   - Waits only if the prefetcher has not finished the chunk yet; such waits for any chunk but the
+     *     first are counted as stalls.
+     */
+    bool next(string& error);
+
+    /**
+     * Goes back to the start of the deck for another game. Does nothing if no chunk was taken yet.
+     */
+    void rewind();
+
+    /**
+     * The chunk in play. The references stay valid across next(); their contents are replaced.
+     */
+    const CardStore& cards() const { return window.cards; }
+    const CardIndex& index() const { return window.index; }
+    const CardStore& pool() const { return window.pool; }
+    size_t firstCard() const { return window.firstCard; }
+
+    const string& deckPath() const { return path; }
+    size_t budget() const { return config.memoryBudget; }
+    size_t chunkSize() const { return chunkBytes; }
+    size_t chunkCount() const { return chunksPlayed; }     // Since the last rewind
+
+    // Waits for the prefetcher since the deck was opened, across rewinds
+    size_t stallCount() const { return stalls; }
+    uint64_t stallTimeNanos() const { return stallNanos; }
+
+    /**
+     * Returns:
+     *   - size_t: Most bytes of chunks that were in memory at once, played and read ahead.
+     */
+    size_t peakMemory() const;
+};
+
+#endif // M2AP_DECKSTREAM_H
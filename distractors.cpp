@@ -0,0 +1,79 @@
+/**
+ * distractors.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for DistractorSampler.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "distractors.h"
+#include <algorithm>
+using namespace std;
+
+DistractorSampler::DistractorSampler(const CardIndex& cardIndex, const SimilarityIndex* similarIndex)
+        : index(&cardIndex), similar(similarIndex) {}
+
+/**
+ * Picks distinct wrong definitions for a card
+ * Inputs:
+ *   - CardId card: Card being asked.
+ *   - size_t k: Number of distractors wanted.
+ *   - FastRng& rng: Random source.
+ *   - vector<CardId>& out: Receives one card per distractor.
+ * Returns:
+ *   - size_t: Number of distractors picked.
+ */
+size_t DistractorSampler::sample(CardId card, size_t k, FastRng& rng, vector<CardId>& out) const {
+    out.clear();
+
+    // Definition groups that would be a right answer: this card's and those of cards with the same term
+    vector<uint32_t> excluded;
+    CardId other = card;
+    do {
+        excluded.push_back(index->definitionGroup(other));
+        other = index->nextWithSameTerm(other);
+    } while (other != card);
+    sort(excluded.begin(), excluded.end());
+    excluded.erase(unique(excluded.begin(), excluded.end()), excluded.end());
+
+    // Hard mode: nearest wrong definitions first; they join the exclusions so the random fill skips them
+    if (similar) {
+        vector<uint32_t> near;
+        similar->nearest(index->definitionGroup(card), k, excluded, near);
+        for (uint32_t group : near) {
+            out.push_back(index->definitionGroupCard(group));
+            excluded.insert(lower_bound(excluded.begin(), excluded.end(), group), group);
+        }
+    }
+
+    size_t available = index->distinctDefinitionCount() - excluded.size();
+    size_t count = min(k - out.size(), available);
+
+    // Floyd's algorithm: one draw per pick, each from a range that shrinks by design rather than by retrying
+    vector<uint32_t> picks;
+    for (size_t j = available - count; j < available; ++j) {
+        uint32_t t = rng.below(static_cast<uint32_t>(j + 1));
+        if (find(picks.begin(), picks.end(), t) != picks.end()) {
+            t = static_cast<uint32_t>(j);
+        }
+        picks.push_back(t);
+    }
+
+    // Map each pick from [0, available) onto the group ids, stepping over the excluded groups
+    for (uint32_t pick : picks) {
+        uint32_t group = pick;
+        for (uint32_t skip : excluded) {
+            if (skip <= group) {
+                ++group;
+            } else {
+                break;
+            }
+        }
+        out.push_back(index->definitionGroupCard(group));
+    }
+
+    // Floyd's picks are a uniform set but not in uniform order
+    shuffle(out.begin(), out.end(), rng);
+    return out.size();
+}
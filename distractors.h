@@ -0,0 +1,53 @@
+/**
+ * distractors.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for DistractorSampler, which picks the wrong answers shown in the multiple-choice game.
+ * Distractors are drawn over distinct-definition ids rather than cards, so decks where many cards share
+ * a definition cost no retries, and every draw finishes in time bounded by the number requested.
+ * With a SimilarityIndex attached ("hard" mode) the nearest wrong definitions are preferred, and random
+ * ones only fill in when a definition has too few near neighbours.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_DISTRACTORS_H
+#define M2AP_DISTRACTORS_H
+#include <cstddef>
+#include <vector>
+#include "cardindex.h"
+#include "fastrng.h"
+#include "similarity.h"
+using namespace std;
+
+class DistractorSampler {
+private:
+    const CardIndex* index;
+    const SimilarityIndex* similar;
+
+public:
+    /**
+     * Constructor
+     * @param cardIndex Distinct-definition numbering to draw from.
+     * @param similarIndex Optional similarity index; when given, near definitions are picked first.
+     */
+    explicit DistractorSampler(const CardIndex& cardIndex, const SimilarityIndex* similarIndex = nullptr);
+
+    /**
+     * Picks distinct wrong definitions for a card
+     * Inputs:
+     *   - CardId card: Card being asked.
+     *   - size_t k: Number of distractors wanted.
+     *   - FastRng& rng: Random source; the same seed gives the same distractors.
+     *   - vector<CardId>& out: Receives one card per distractor; read its definition.
+     * Returns:
+     *   - size_t: Number of distractors picked. Fewer than k only when the deck has fewer than k
+     *     definitions that are wrong for this card.
+     * Description:
+     *   - A definition is wrong if it differs from the definitions of every card sharing this card's term.
+     *   - Uses Floyd's sampling over the remaining distinct-definition ids: exactly k random draws, no rejection.
+     */
+    size_t sample(CardId card, size_t k, FastRng& rng, vector<CardId>& out) const;
+};
+
+#endif // M2AP_DISTRACTORS_H
@@ -0,0 +1,78 @@
+/**
+ * fastrng.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for FastRng, a small seedable xoshiro256** generator used by every game mode in place of
+ * rand(), so a quiz can be replayed exactly from its seed.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_FASTRNG_H
+#define M2AP_FASTRNG_H
+#include <cstdint>
+using namespace std;
+
+class FastRng {
+private:
+    uint64_t state[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    typedef uint64_t result_type;
+
+    explicit FastRng(uint64_t seedValue = 0) { seed(seedValue); }
+
+    /**
+     * Restarts the sequence
+     * Inputs:
+     *   - uint64_t seedValue: Any value; expanded with splitmix64 so nearby seeds give unrelated sequences.
+     */
+    void seed(uint64_t seedValue) {
+        for (uint64_t& word : state) {
+            seedValue += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = seedValue;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t next() {
+        uint64_t result = rotl(state[1] * 5, 7) * 9;
+        uint64_t t = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= t;
+        state[3] = rotl(state[3], 45);
+        return result;
+    }
+
+    /**
+     * Uniform integer in [0, bound) without modulo bias (Lemire's multiply-and-reject)
+     * Inputs:
+     *   - uint32_t bound: Exclusive upper bound, greater than zero.
+     */
+    uint32_t below(uint32_t bound) {
+        uint64_t product = static_cast<uint64_t>(static_cast<uint32_t>(next() >> 32)) * bound;
+        uint32_t low = static_cast<uint32_t>(product);
+        if (low < bound) {
+            uint32_t threshold = (0u - bound) % bound;
+            while (low < threshold) {
+                product = static_cast<uint64_t>(static_cast<uint32_t>(next() >> 32)) * bound;
+                low = static_cast<uint32_t>(product);
+            }
+        }
+        return static_cast<uint32_t>(product >> 32);
+    }
+
+    // UniformRandomBitGenerator, so FastRng works with std::shuffle
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+    uint64_t operator()() { return next(); }
+};
+
+#endif // M2AP_FASTRNG_H
@@ -0,0 +1,103 @@
+/**
+ * gameio.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for TextRenderer, ConsoleRenderer, ConsoleInput and the default timed read.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "gameio.h"
+#include <cstdlib>
+#include <iostream>
+using namespace std;
+
+void TextRenderer::message(string_view text) {
+    out << text << '\n';
+}
+
+void TextRenderer::showTerm(string_view term, bool typedAnswer) {
+    if (typedAnswer) {
+        out << term << " -> ";
+    } else {
+        out << term << '\n';
+    }
+}
+
+void TextRenderer::showDefinition(string_view definition) {
+    out << definition << '\n';
+}
+
+void TextRenderer::showChoices(const CardStore& cards, const vector<CardId>& options) {
+    for (size_t cycle = 0; cycle < options.size(); ++cycle) {
+        out << cycle + 1 << ": " << cards.def(options[cycle]) << '\n';
+    }
+}
+
+void TextRenderer::askFlip() {
+    out << "Click enter to flip card";
+}
+
+void TextRenderer::askStar() {
+    out << "Do you want to star this term or move on? [type 'star' to star or click enter to advance]";
+}
+
+void TextRenderer::askStudyStarred() {
+    out << "Would you now like to study your starred terms? ['y' for yes, 'n' for no]: ";
+}
+
+void TextRenderer::askRating() {
+    out << "How well did you know it? [1 again, 2 hard, 3 good, 4 easy, 'q' to stop]: ";
+}
+
+void TextRenderer::askChoice(size_t choices, bool retry) {
+    if (retry) {
+        out << "Invalid input. Please enter a number between 1 and " << choices << ": ";
+    } else {
+        out << "What is your guess? [enter a number 1-" << choices << "]: ";
+    }
+}
+
+void TextRenderer::showChoiceResult(bool correct, size_t correctChoice) {
+    if (correct) {
+        out << "You were correct!" << '\n';
+    } else {
+        out << "That's not correct. The correct answer was: " << correctChoice << '\n';
+    }
+}
+
+void TextRenderer::showGrade(string_view definition, const GradeResult& result) {
+    if (!result.accepted) {
+        out << "Incorrect. The correct definition was: " << definition << '\n';
+    } else if (result.distance > 0) {
+        out << "Correct! (close enough - the exact definition is: " << definition << ")" << '\n';
+    } else {
+        out << "Correct!" << '\n';
+    }
+}
+
+void TextRenderer::showScore(string_view gameName, int score, size_t total) {
+    out << gameName << " Score: " << score << " out of " << total << '\n';
+}
+
+ConsoleRenderer::ConsoleRenderer() : TextRenderer(cout) {}
+
+void ConsoleRenderer::clear() {
+    cout.flush();
+    system("clear");
+}
+
+AnswerWait AnswerProvider::nextAnswerBy(string_view& answer, chrono::steady_clock::time_point deadline) {
+    if (!nextAnswer(answer)) {
+        return AnswerWait::ENDED;
+    }
+    return chrono::steady_clock::now() < deadline ? AnswerWait::ANSWERED : AnswerWait::EXPIRED;
+}
+
+bool ConsoleInput::nextAnswer(string_view& answer) {
+    if (!getline(cin, line)) {
+        return false;
+    }
+    answer = line;
+    return true;
+}
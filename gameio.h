@@ -0,0 +1,179 @@
+/**
+ * gameio.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the interfaces between the game modes and the outside world.
+ * A GameRenderer receives what a game wants shown, as events rather than text, so a renderer that
+ * ignores them costs nothing; an AnswerProvider supplies whatever the learner typed, one line at a time.
+ * TextRenderer writes the terminal game's text to any stream; ConsoleRenderer and ConsoleInput are the
+ * terminal game itself, and NullRenderer is for scripted runs.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_GAMEIO_H
+#define M2AP_GAMEIO_H
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "cardstore.h"
+#include "grader.h"
+using namespace std;
+
+class GameRenderer {
+public:
+    virtual ~GameRenderer() = default;
+
+    virtual void clear() = 0;
+    virtual void message(string_view text) = 0;
+
+    /**
+     * Shows a card's term
+     * Inputs:
+     *   - string_view term: The term.
+     *   - bool typedAnswer: True when the learner types the definition next, false for flips and choices.
+     */
+    virtual void showTerm(string_view term, bool typedAnswer) = 0;
+    virtual void showDefinition(string_view definition) = 0;
+    virtual void showChoices(const CardStore& cards, const vector<CardId>& options) = 0;
+
+    virtual void askFlip() = 0;
+    virtual void askStar() = 0;
+    virtual void askStudyStarred() = 0;
+    virtual void askRating() = 0;
+
+    /**
+     * Asks for a multiple-choice answer
+     * Inputs:
+     *   - size_t choices: Number of options.
+     *   - bool retry: True if the last answer was not a number in range.
+     */
+    virtual void askChoice(size_t choices, bool retry) = 0;
+
+    /**
+     * Inputs:
+     *   - bool correct: Whether the chosen option was right.
+     *   - size_t correctChoice: The right option, counted from 1.
+     */
+    virtual void showChoiceResult(bool correct, size_t correctChoice) = 0;
+
+    /**
+     * Inputs:
+     *   - string_view definition: The card's definition.
+     *   - const GradeResult& result: Grade of the typed answer.
+     */
+    virtual void showGrade(string_view definition, const GradeResult& result) = 0;
+
+    /**
+     * Inputs:
+     *   - string_view gameName: Game shown before "Score", e.g. "Matching Game".
+     *   - int score: Correct answers.
+     *   - size_t total: Questions in the game.
+     */
+    virtual void showScore(string_view gameName, int score, size_t total) = 0;
+
+    /**
+     * Shows the time left before a timed question's term
+     * Inputs:
+     *   - int secondsLeft: Whole seconds left, rounded up.
+     */
+    virtual void showCountdown(int secondsLeft) = 0;
+};
+
+enum class AnswerWait {
+    ANSWERED,
+    EXPIRED,        // The deadline passed first
+    ENDED           // Input ran out
+};
+
+class AnswerProvider {
+public:
+    virtual ~AnswerProvider() = default;
+
+    /**
+     * Reads the learner's next answer
+     * Inputs:
+     *   - string_view& answer: Receives one line without its newline; valid until the next call.
+     * Returns:
+     *   - bool: False once input has run out.
+     */
+    virtual bool nextAnswer(string_view& answer) = 0;
+
+    /**
+     * Reads the learner's next answer unless a deadline passes first
+     * Inputs:
+     *   - string_view& answer: Receives one line without its newline; valid until the next call.
+     *   - chrono::steady_clock::time_point deadline: When to stop waiting.
+     * Returns:
+     *   - AnswerWait: Whether an answer arrived, the deadline passed or input ran out.
+     * Description:
+     *   - The default waits for nextAnswer() and only then checks the deadline; providers that can wait on
+     *     a timer return EXPIRED at the deadline itself.
+     */
+    virtual AnswerWait nextAnswerBy(string_view& answer, chrono::steady_clock::time_point deadline);
+};
+
+// The terminal game's text, written to a stream (a socket buffer, a string, cout)
+class TextRenderer : public GameRenderer {
+protected:
+    ostream& out;
+
+public:
+    explicit TextRenderer(ostream& stream) : out(stream) {}
+
+    void clear() override {}
+    void message(string_view text) override;
+    void showTerm(string_view term, bool typedAnswer) override;
+    void showDefinition(string_view definition) override;
+    void showChoices(const CardStore& cards, const vector<CardId>& options) override;
+    void askFlip() override;
+    void askStar() override;
+    void askStudyStarred() override;
+    void askRating() override;
+    void askChoice(size_t choices, bool retry) override;
+    void showChoiceResult(bool correct, size_t correctChoice) override;
+    void showGrade(string_view definition, const GradeResult& result) override;
+    void showScore(string_view gameName, int score, size_t total) override;
+    void showCountdown(int) override {}
+};
+
+// The terminal game: prints to cout and clears the screen between the sides of a card
+class ConsoleRenderer : public TextRenderer {
+public:
+    ConsoleRenderer();
+
+    void clear() override;
+};
+
+// Discards everything, for replays and benchmarks
+class NullRenderer : public GameRenderer {
+public:
+    void clear() override {}
+    void message(string_view) override {}
+    void showTerm(string_view, bool) override {}
+    void showDefinition(string_view) override {}
+    void showChoices(const CardStore&, const vector<CardId>&) override {}
+    void askFlip() override {}
+    void askStar() override {}
+    void askStudyStarred() override {}
+    void askRating() override {}
+    void askChoice(size_t, bool) override {}
+    void showChoiceResult(bool, size_t) override {}
+    void showGrade(string_view, const GradeResult&) override {}
+    void showScore(string_view, int, size_t) override {}
+    void showCountdown(int) override {}
+};
+
+// Reads answers from cin, one line each
+class ConsoleInput : public AnswerProvider {
+private:
+    string line;
+
+public:
+    bool nextAnswer(string_view& answer) override;
+};
+
+#endif // M2AP_GAMEIO_H
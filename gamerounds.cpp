@@ -0,0 +1,484 @@
+/**
+ * gamerounds.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the game rounds. The prompts and feedback are the same, in the same order,
+ * as the terminal games always showed; only the reading of input has moved out to the caller.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "gamerounds.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <iomanip>
+#include <sstream>
+#include <string>
+using namespace std;
+
+/**
+ * Grades a typed answer against a card
+ * Inputs:
+ *   - CardId card: Card being asked.
+ *   - string_view answer: Definition given by the user.
+ * Returns:
+ *   - GradeResult: Accepted if the answer is close enough to the card's definition, or to the definition
+ *     of another card with the same term. An exact match after normalization has distance 0.
+ */
+GradeResult gradeAgainstTerm(const CardStore& cards, const CardIndex& index, AnswerGrader& grader, CardId card,
+                             string_view answer) {
+    GradeResult best{false, UINT32_MAX};
+    CardId other = card;
+    do {
+        GradeResult result = grader.grade(cards.def(other), answer);
+        if (result.accepted && (!best.accepted || result.distance < best.distance)) {
+            best = result;
+        } else if (!best.accepted && result.distance < best.distance) {
+            best.distance = result.distance;
+        }
+        if (best.accepted && best.distance == 0) {
+            break;
+        }
+        other = index.nextWithSameTerm(other);
+    } while (other != card);
+    return best;
+}
+
+bool parseChoice(string_view answer, size_t choices, size_t& guess) {
+    while (!answer.empty() && (answer.front() == ' ' || answer.front() == '\t')) {
+        answer.remove_prefix(1);
+    }
+    while (!answer.empty() && (answer.back() == ' ' || answer.back() == '\t' || answer.back() == '\r')) {
+        answer.remove_suffix(1);
+    }
+    guess = 0;
+    auto parsed = from_chars(answer.data(), answer.data() + answer.size(), guess);
+    return !answer.empty() && parsed.ec == errc() && parsed.ptr == answer.data() + answer.size() && guess >= 1 &&
+           guess <= choices;
+}
+
+string describeAnswerTimes(const vector<CardOutcome>& outcomes) {
+    uint64_t totalMicros = 0;
+    uint32_t fastestMicros = UINT32_MAX;
+    for (const CardOutcome& outcome : outcomes) {
+        totalMicros += outcome.answerMicros;
+        fastestMicros = min(fastestMicros, outcome.answerMicros);
+    }
+    ostringstream times;
+    times << fixed << setprecision(1) << "Answered " << outcomes.size() << " in "
+          << totalMicros / 1e6 << " s: " << totalMicros / 1e6 / outcomes.size() << " s per answer, fastest "
+          << fastestMicros / 1e6 << " s";
+    return times.str();
+}
+
+FlashcardRound::FlashcardRound(const CardStore& deckCards, ReviewScheduler* reviewScheduler, size_t newCardLimit)
+        : GameRound(deckCards), scheduler(reviewScheduler), newLimit(newCardLimit), step(Step::FLIP), card(0),
+          pass(0), position(0), newShown(0), reviewed(0), shownAt(0) {}
+
+/**
+ * Shows the next due or new card of a scheduled session, or ends the session if there is none
+ */
+void FlashcardRound::showNextScheduled(GameRenderer& out) {
+    shownAt = ReviewScheduler::currentMinute();
+    uint64_t questionStart = phaseStart();
+    card = scheduler->nextCard(shownAt, newShown < newLimit);
+    phaseEnd(Phase::QUESTION, questionStart);
+    if (card == NO_CARD) {
+        finishScheduled(out);
+        return;
+    }
+    if (scheduler->schedule(card).heapSlot == 0) {
+        ++newShown;
+    }
+    step = Step::FLIP;
+    out.showTerm(cards.term(card), false);
+    out.askFlip();
+}
+
+/**
+ * Ends a scheduled session with a summary of where the schedule stands
+ */
+void FlashcardRound::finishScheduled(GameRenderer& out) {
+    string summary = "Reviewed " + to_string(reviewed) + " cards. " + to_string(scheduler->studiedCount()) +
+                     " of " + to_string(cards.size()) + " cards are in rotation";
+    uint32_t nextDue = scheduler->nextDueTime();
+    if (nextDue != UINT32_MAX) {
+        uint32_t now = ReviewScheduler::currentMinute();
+        uint32_t wait = nextDue > now ? nextDue - now : 0;
+        summary += "; the next review is due in " + to_string(wait / 60) + "h " + to_string(wait % 60) + "m";
+    }
+    summary += ".";
+    out.message(summary);
+    done = true;
+}
+
+void FlashcardRound::start(GameRenderer& out) {
+    if (scheduler != nullptr && scheduler->isOpen() && selection.wholeDeck()) {
+        showNextScheduled(out);
+        return;
+    }
+    scheduler = nullptr;    // A plain pass from here on, even with a schedule open
+    if (selection.empty()) {
+        step = Step::STUDY_STARRED;
+        out.askStudyStarred();
+        return;
+    }
+    card = selection[0];
+    out.showTerm(cards.term(card), false);
+    out.askFlip();
+}
+
+/**
+ * Advances the flashcard round
+ * Description:
+ *   - Scheduled: a flip shows the definition, then a rating of 1-4 reschedules the card ('q' stops).
+ *   - Unscheduled: a flip shows the definition, then "star" or an empty line moves on; after the last card
+ *     the learner may flip through the starred cards.
+ *   Anything else is asked again.
+ */
+void FlashcardRound::submit(string_view answer, GameRenderer& out) {
+    switch (step) {
+        case Step::FLIP:
+            out.clear();
+            out.showDefinition(cards.def(card));
+            if (scheduler != nullptr && scheduler->isOpen()) {
+                step = Step::RATING;
+                out.askRating();
+            } else {
+                step = Step::STAR;
+                out.askStar();
+            }
+            break;
+
+        case Step::STAR:
+            if (answer == "star") {
+                starred.push_back(card);
+            } else if (!answer.empty()) {
+                out.askStar();
+                break;
+            }
+            if (++pass < selection.size()) {
+                card = selection[pass];
+                step = Step::FLIP;
+                out.showTerm(cards.term(card), false);
+                out.askFlip();
+            } else {
+                step = Step::STUDY_STARRED;
+                out.askStudyStarred();
+            }
+            break;
+
+        case Step::STUDY_STARRED:
+            if (answer == "y" && !starred.empty()) {
+                step = Step::STARRED_FLIP;
+                position = 0;
+                out.showTerm(cards.term(starred[0]), false);
+                out.askFlip();
+            } else if (answer == "y" || answer == "n") {
+                done = true;
+            } else {
+                out.message("That was an invalid response, try again.");
+                out.askStudyStarred();
+            }
+            break;
+
+        case Step::STARRED_FLIP:
+            out.clear();
+            out.showDefinition(cards.def(starred[position]));
+            if (++position < starred.size()) {
+                out.showTerm(cards.term(starred[position]), false);
+                out.askFlip();
+            } else {
+                done = true;
+            }
+            break;
+
+        case Step::RATING:
+            if (answer == "q") {
+                finishScheduled(out);
+            } else if (answer.size() == 1 && answer[0] >= '1' && answer[0] <= '4') {
+                scheduler->review(card, static_cast<ReviewScheduler::Rating>(answer[0] - '0'), shownAt);
+                ++reviewed;
+                showNextScheduled(out);
+            } else {
+                out.askRating();
+            }
+            break;
+    }
+}
+
+MultipleChoiceRound::MultipleChoiceRound(const CardStore& deckCards, const CardIndex& index,
+                                         const SimilarityIndex* similar, FastRng& random)
+        : GameRound(deckCards), distractors(index, similar), rng(random), hard(similar != nullptr), position(0),
+          question(0), correctChoice(0), samplingTime{} {}
+
+MultipleChoiceRound::~MultipleChoiceRound() {
+    if (preparer.joinable()) {
+        ready->close();
+        preparer.join();
+    }
+}
+
+/**
+ * Samples a question's distractors and slots the right answer in among them
+ * Inputs:
+ *   - size_t at: Position of the question in the selection.
+ *   - Prepared& out: Receives the options.
+ * Description:
+ *   - Questions are prepared strictly in order from questionRng, on whichever thread prepares them, so a
+ *     seed gives the same quiz with or without preparing ahead.
+ */
+void MultipleChoiceRound::prepare(size_t at, Prepared& out) {
+    CardId card = selection[at];
+    auto sampleStart = chrono::steady_clock::now();
+    distractors.sample(card, 3, questionRng, sampled);
+    out.samplingNanos = static_cast<uint64_t>(
+            chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - sampleStart).count());
+
+    size_t randomIndex = questionRng.below(static_cast<uint32_t>(sampled.size() + 1));
+    sampled.insert(sampled.begin() + randomIndex, card);
+    out.optionCount = static_cast<uint32_t>(min<size_t>(sampled.size(), 4));
+    copy(sampled.begin(), sampled.begin() + out.optionCount, out.options);
+    out.correctChoice = static_cast<uint32_t>(randomIndex + 1);
+}
+
+/**
+ * Background thread: prepares every question from first on, staying at most the ring's size ahead
+ */
+void MultipleChoiceRound::prepareFrom(size_t first) {
+    Prepared next;
+    for (size_t at = first; at < selection.size(); ++at) {
+        prepare(at, next);
+        if (!ready->push(next)) {
+            return;
+        }
+    }
+}
+
+/**
+ * Shows the current question, taking it from the prepared questions if there are any
+ */
+void MultipleChoiceRound::ask(GameRenderer& out) {
+    out.showTerm(cards.term(question), false);
+    uint64_t questionStart = phaseStart();
+    Prepared current;
+    if (ready != nullptr) {
+        ready->pop(current);
+    } else {
+        prepare(position, current);
+    }
+    options.assign(current.options, current.options + current.optionCount);
+    correctChoice = current.correctChoice;
+    samplingTime += chrono::nanoseconds(current.samplingNanos);
+    phaseEnd(Phase::QUESTION, questionStart);
+
+    out.showChoices(cards, options);
+    out.askChoice(options.size(), false);
+}
+
+/**
+ * Starts the quiz
+ * Description:
+ *   - The round's questions are drawn from their own generator, seeded with one draw from the player's, so
+ *     the player's generator moves on by the same amount however far ahead questions were prepared.
+ *   - With prepareAhead set, the first question is prepared here and the rest on a background thread.
+ */
+void MultipleChoiceRound::start(GameRenderer& out) {
+    if (selection.empty()) {
+        done = true;
+        return;
+    }
+    questionRng.seed(rng.next());
+    question = selection[0];
+    ask(out);
+    if (prepareAhead > 0 && selection.size() > 1) {
+        ready = make_unique<SpscRing<Prepared>>(min(prepareAhead, selection.size() - 1));
+        preparer = thread(&MultipleChoiceRound::prepareFrom, this, 1);
+    }
+}
+
+/**
+ * Takes a guess at the current question
+ * Description:
+ *   - Anything but a number between 1 and the number of options is asked again.
+ *   - After the last question in hard mode, reports the average time spent choosing distractors.
+ */
+void MultipleChoiceRound::submit(string_view answer, GameRenderer& out) {
+    uint64_t gradeStart = phaseStart();
+    size_t guess = 0;
+    if (!parseChoice(answer, options.size(), guess)) {
+        out.askChoice(options.size(), true);
+        return;
+    }
+
+    bool correct = guess == correctChoice;
+    phaseEnd(Phase::GRADE, gradeStart);
+    outcomes.push_back({question, correct, 0});
+    out.showChoiceResult(correct, correctChoice);
+    if (correct) {
+        ++score;
+    }
+
+    if (++position < selection.size()) {
+        question = selection[position];
+        ask(out);
+        return;
+    }
+    if (hard) {
+        ostringstream report;
+        report << "Hard distractors took " << chrono::duration<double, micro>(samplingTime).count() / selection.size()
+               << " microseconds per question on average.";
+        out.message(report.str());
+    }
+    done = true;
+}
+
+MatchingRound::MatchingRound(const CardStore& deckCards, const CardIndex& cardIndex, AnswerGrader& answerGrader,
+                             FastRng& random)
+        : GameRound(deckCards), index(cardIndex), grader(answerGrader), rng(random), position(0) {}
+
+void MatchingRound::start(GameRenderer& out) {
+    // Check if there are enough terms and definitions
+    if (selection.size() < 2) {
+        out.message("Insufficient terms and definitions for the matching game.");
+        done = true;
+        return;
+    }
+
+    // Shuffle card ids with the seeded generator, so a seed replays the same order
+    uint64_t questionStart = phaseStart();
+    order.resize(selection.size());
+    for (size_t i = 0; i < selection.size(); ++i) {
+        order[i] = selection[i];
+    }
+    shuffle(order.begin(), order.end(), rng);
+    phaseEnd(Phase::QUESTION, questionStart);
+
+    out.message("Matching Game: Match the terms with their correct definitions");
+    out.showTerm(cards.term(order[0]), true);
+}
+
+void MatchingRound::submit(string_view answer, GameRenderer& out) {
+    CardId card = order[position];
+    uint64_t gradeStart = phaseStart();
+    GradeResult result = gradeAgainstTerm(cards, index, grader, card, answer);
+    phaseEnd(Phase::GRADE, gradeStart);
+    out.showGrade(cards.def(card), result);
+    outcomes.push_back({card, result.accepted, 0});
+    if (result.accepted) {
+        ++score;
+    }
+
+    if (++position < order.size()) {
+        out.showTerm(cards.term(order[position]), true);
+        return;
+    }
+    out.showScore("Matching Game", score, order.size());
+    done = true;
+}
+
+TimedRound::TimedRound(const CardStore& deckCards, const CardIndex& cardIndex, AnswerGrader& answerGrader,
+                       int timeLimitSeconds)
+        : GameRound(deckCards), index(cardIndex), grader(answerGrader), timeLimit(timeLimitSeconds), started(false),
+          position(0), card(0) {}
+
+/**
+ * Shows the current term with the seconds left, or ends the challenge if time is up or the deck is done
+ */
+void TimedRound::ask(GameRenderer& out) {
+    auto now = chrono::steady_clock::now();
+    if (position >= selection.size() || now >= endTime) {
+        finish(out, position < selection.size());
+        return;
+    }
+    card = selection[position];
+    auto left = chrono::duration_cast<chrono::milliseconds>(endTime - now).count();
+    out.showCountdown(static_cast<int>((left + 999) / 1000));
+    out.showTerm(cards.term(card), true);
+    askedAt = now;
+}
+
+/**
+ * Shows the answer times and the score and ends the challenge
+ */
+void TimedRound::finish(GameRenderer& out, bool timedOut) {
+    if (timedOut) {
+        out.message("Time's up! Challenge completed.");
+    }
+    if (!outcomes.empty()) {
+        out.message(describeAnswerTimes(outcomes));
+    }
+    out.showScore("Time-Based Challenge", score, selection.size());
+    done = true;
+}
+
+void TimedRound::start(GameRenderer& out) {
+    out.message("Time-Based Challenge: Answer as many questions as possible within " + to_string(timeLimit) +
+                " seconds.");
+    out.message("Press enter to start the challenge...");
+}
+
+/**
+ * Pushes an answer. The limit is strict: an answer that arrives after the deadline is not graded.
+ */
+void TimedRound::submit(string_view answer, GameRenderer& out) {
+    auto now = chrono::steady_clock::now();
+    if (!started) {
+        started = true;
+        endTime = now + chrono::seconds(timeLimit);
+        ask(out);
+        return;
+    }
+    if (now >= endTime) {
+        expire(out);
+        return;
+    }
+
+    int64_t answerMicros = chrono::duration_cast<chrono::microseconds>(now - askedAt).count();
+    uint64_t gradeStart = phaseStart();
+    GradeResult result = gradeAgainstTerm(cards, index, grader, card, answer);
+    phaseEnd(Phase::GRADE, gradeStart);
+    out.showGrade(cards.def(card), result);
+    outcomes.push_back({card, result.accepted, static_cast<uint32_t>(min<int64_t>(answerMicros, UINT32_MAX))});
+    if (result.accepted) {
+        ++score;
+    }
+    ++position;
+    ask(out);
+}
+
+bool TimedRound::deadline(chrono::steady_clock::time_point& when) const {
+    if (!started || done) {
+        return false;
+    }
+    when = endTime;
+    return true;
+}
+
+void TimedRound::expire(GameRenderer& out) {
+    if (!done) {
+        finish(out, true);
+    }
+}
+
+/**
+ * Creates a round of a game mode
+ * Returns:
+ *   - unique_ptr<GameRound>: The round, not yet started.
+ */
+unique_ptr<GameRound> makeRound(RoundKind kind, const CardStore& cards, const CardIndex& index,
+                                const SimilarityIndex* similar, FastRng& rng, AnswerGrader& grader,
+                                ReviewScheduler* scheduler, int timeLimit) {
+    switch (kind) {
+        case RoundKind::FLASHCARDS:
+            return make_unique<FlashcardRound>(cards, scheduler, FlashcardRound::NEW_CARDS_PER_SESSION);
+        case RoundKind::MULTIPLE_CHOICE:
+            return make_unique<MultipleChoiceRound>(cards, index, similar, rng);
+        case RoundKind::MATCHING:
+            return make_unique<MatchingRound>(cards, index, grader, rng);
+        case RoundKind::TIMED:
+            break;
+    }
+    return make_unique<TimedRound>(cards, index, grader, timeLimit);
+}
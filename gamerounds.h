@@ -0,0 +1,338 @@
+/**
+ * gamerounds.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the four game modes as rounds: small state machines that are started once and then
+ * pushed one answer at a time. A round never reads input or writes output itself; it reports everything
+ * through a GameRenderer, so the same game logic runs in the terminal, behind a socket, or from a
+ * scripted replay at machine speed. Rounds only read the deck, so many can share one CardStore.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_GAMEROUNDS_H
+#define M2AP_GAMEROUNDS_H
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "cardindex.h"
+#include "cardstore.h"
+#include "distractors.h"
+#include "fastrng.h"
+#include "gameio.h"
+#include "grader.h"
+#include "scheduler.h"
+#include "similarity.h"
+#include "spscring.h"
+#include "telemetry.h"
+using namespace std;
+
+struct CardOutcome {
+    CardId card;
+    bool correct;
+    uint32_t answerMicros;      // From the question appearing to the answer; 0 where a mode does not time answers
+};
+
+/**
+ * The cards a round plays, in order: the whole deck, or a list of card ids such as a search's results.
+ * It only refers to the list, which must outlive the rounds that use it.
+ */
+class CardSelection {
+private:
+    const CardId* ids;      // nullptr for the whole deck
+    size_t count;
+
+    CardSelection(const CardId* cardIds, size_t cardCount) : ids(cardIds), count(cardCount) {}
+
+public:
+    static CardSelection all(size_t cardCount) { return CardSelection(nullptr, cardCount); }
+    static CardSelection of(const vector<CardId>& cardIds) { return CardSelection(cardIds.data(), cardIds.size()); }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool wholeDeck() const { return ids == nullptr; }
+    CardId operator[](size_t i) const { return ids != nullptr ? ids[i] : static_cast<CardId>(i); }
+};
+
+enum class RoundKind {
+    FLASHCARDS,
+    MULTIPLE_CHOICE,
+    MATCHING,
+    TIMED
+};
+
+class GameRound {
+protected:
+    const CardStore& cards;
+    CardSelection selection;
+    int score;
+    bool done;
+    vector<CardOutcome> outcomes;
+    ModeLatency* latency;
+    uint64_t phaseNanos;    // Time recorded by phaseEnd() since takePhaseNanos()
+    size_t prepareAhead;
+
+    // Times an engine phase when telemetry is attached; otherwise costs a branch
+    uint64_t phaseStart() const { return latency != nullptr ? Telemetry::now() : 0; }
+    void phaseEnd(Phase phase, uint64_t start) {
+        if (latency != nullptr) {
+            uint64_t spent = Telemetry::now() - start;
+            latency->record(phase, spent);
+            phaseNanos += spent;
+        }
+    }
+
+public:
+    explicit GameRound(const CardStore& deckCards)
+            : cards(deckCards), selection(CardSelection::all(deckCards.size())), score(0), done(false),
+              latency(nullptr), phaseNanos(0), prepareAhead(0) {}
+    virtual ~GameRound() = default;
+
+    /**
+     * Plays only some of the deck's cards, before the round is started
+     * @param cardSelection Cards to ask, in order; the default is every card. Flashcards over a selection
+     *                      are a plain pass, as a schedule covers the whole deck. Streaming rounds ignore it.
+     */
+    void setSelection(CardSelection cardSelection) { selection = cardSelection; }
+
+    /**
+     * Lets the round prepare questions on a background thread while the current one is answered, before the
+     * round is started
+     * @param questions Questions to keep ready; 0 (the default) prepares each one when it is asked. Only
+     *                  multiple choice has work worth moving off the answer path. The quiz is the same
+     *                  either way.
+     */
+    void setPrepareAhead(size_t questions) { prepareAhead = questions; }
+
+    /**
+     * Times the round's question and grade phases into a mode's histograms
+     * @param modeLatency Histograms to record into, or nullptr (the default) to not time anything.
+     */
+    void setLatency(ModeLatency* modeLatency) { latency = modeLatency; }
+
+    /**
+     * Returns:
+     *   - uint64_t: Nanoseconds of question and grade phases timed since the last call, so the caller can
+     *     tell them apart from the rest of a step.
+     */
+    uint64_t takePhaseNanos() {
+        uint64_t taken = phaseNanos;
+        phaseNanos = 0;
+        return taken;
+    }
+
+    /**
+     * Shows the first prompt (or finishes at once if there is nothing to play)
+     */
+    virtual void start(GameRenderer& out) = 0;
+
+    /**
+     * Pushes the learner's answer to the current prompt
+     * Inputs:
+     *   - string_view answer: One line of input.
+     *   - GameRenderer& out: Receives the feedback and the next prompt.
+     */
+    virtual void submit(string_view answer, GameRenderer& out) = 0;
+
+    /**
+     * Returns:
+     *   - const char*: Mode name used for the session history, e.g. "MatchingGame".
+     */
+    virtual const char* name() const = 0;
+
+    /**
+     * Returns:
+     *   - bool: True if the current prompt has a deadline, which is then stored in when.
+     */
+    virtual bool deadline(chrono::steady_clock::time_point& when) const {
+        (void)when;
+        return false;
+    }
+
+    /**
+     * Ends the round because its deadline passed before an answer arrived
+     */
+    virtual void expire(GameRenderer& out) { (void)out; }
+
+    bool finished() const { return done; }
+    int getScore() const { return score; }
+    const vector<CardOutcome>& getOutcomes() const { return outcomes; }
+};
+
+/**
+ * Grades a typed answer against a card
+ * Returns:
+ *   - GradeResult: The best grade against the card's definition and those of other cards with the same term.
+ */
+GradeResult gradeAgainstTerm(const CardStore& cards, const CardIndex& index, AnswerGrader& grader, CardId card,
+                             string_view answer);
+
+/**
+ * Reads a multiple-choice guess
+ * Inputs:
+ *   - string_view answer: One line of input; spaces around the number are ignored.
+ *   - size_t choices: Options shown.
+ *   - size_t& guess: Receives the option chosen, from 1.
+ * Returns:
+ *   - bool: False if the answer is not a number between 1 and choices.
+ */
+bool parseChoice(string_view answer, size_t choices, size_t& guess);
+
+/**
+ * Returns:
+ *   - string: "Answered n in t s: ..." for a timed challenge's answers; outcomes must not be empty.
+ */
+string describeAnswerTimes(const vector<CardOutcome>& outcomes);
+
+// Flashcards: a spaced-repetition session when given a scheduler, otherwise one pass with starring
+class FlashcardRound : public GameRound {
+private:
+    enum class Step { FLIP, STAR, STUDY_STARRED, STARRED_FLIP, RATING };
+
+    ReviewScheduler* scheduler;
+    size_t newLimit;
+    Step step;
+    CardId card;
+    size_t pass;                // Position in the selection of an unscheduled pass
+    size_t position;
+    vector<CardId> starred;
+    size_t newShown;
+    size_t reviewed;
+    uint32_t shownAt;
+
+    void showNextScheduled(GameRenderer& out);
+    void finishScheduled(GameRenderer& out);
+
+public:
+    static constexpr size_t NEW_CARDS_PER_SESSION = 20;
+
+    /**
+     * Constructor
+     * @param deckCards Cards to study.
+     * @param reviewScheduler Schedule for the deck, or nullptr for a plain pass with starring.
+     * @param newCardLimit New cards a scheduled session may introduce.
+     */
+    FlashcardRound(const CardStore& deckCards, ReviewScheduler* reviewScheduler, size_t newCardLimit);
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "Flashcards"; }
+};
+
+// Multiple choice over every selected card in order, with up to three distractors each
+class MultipleChoiceRound : public GameRound {
+private:
+    struct Prepared {
+        CardId options[4];
+        uint32_t optionCount;
+        uint32_t correctChoice;
+        uint64_t samplingNanos;
+    };
+
+    DistractorSampler distractors;
+    FastRng& rng;
+    FastRng questionRng;        // Seeded from rng at the start; only the thread preparing questions draws from it
+    bool hard;
+    size_t position;            // In the selection
+    CardId question;
+    vector<CardId> options;
+    size_t correctChoice;
+    chrono::steady_clock::duration samplingTime;
+
+    // Questions prepared ahead, when prepareAhead is set
+    unique_ptr<SpscRing<Prepared>> ready;
+    thread preparer;
+    vector<CardId> sampled;     // The preparing thread's scratch
+
+    void prepare(size_t at, Prepared& out);
+    void prepareFrom(size_t first);
+    void ask(GameRenderer& out);
+
+public:
+    static constexpr size_t PREPARE_AHEAD = 8;
+
+    /**
+     * Constructor
+     * @param deckCards Cards to study.
+     * @param index Term index over deckCards.
+     * @param similar Similarity index for hard distractors, or nullptr.
+     * @param random Random source for distractors and answer order.
+     */
+    MultipleChoiceRound(const CardStore& deckCards, const CardIndex& index, const SimilarityIndex* similar,
+                        FastRng& random);
+    ~MultipleChoiceRound() override;
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "MultipleChoiceGame"; }
+};
+
+// Matching: every term once in shuffled order, definitions typed and graded
+class MatchingRound : public GameRound {
+private:
+    const CardIndex& index;
+    AnswerGrader& grader;
+    FastRng& rng;
+    vector<CardId> order;
+    size_t position;
+
+public:
+    MatchingRound(const CardStore& deckCards, const CardIndex& cardIndex, AnswerGrader& answerGrader, FastRng& random);
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "MatchingGame"; }
+};
+
+// Timed challenge: selected terms in order until the time limit passes
+class TimedRound : public GameRound {
+private:
+    const CardIndex& index;
+    AnswerGrader& grader;
+    int timeLimit;
+    bool started;
+    size_t position;            // In the selection
+    CardId card;
+    chrono::steady_clock::time_point endTime;
+    chrono::steady_clock::time_point askedAt;
+
+    void ask(GameRenderer& out);
+    void finish(GameRenderer& out, bool timedOut);
+
+public:
+    /**
+     * Constructor
+     * @param timeLimitSeconds Seconds from the first answer (the "press enter" line) to the end.
+     */
+    TimedRound(const CardStore& deckCards, const CardIndex& cardIndex, AnswerGrader& answerGrader,
+               int timeLimitSeconds);
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "TimeChallenge"; }
+    bool deadline(chrono::steady_clock::time_point& when) const override;
+    void expire(GameRenderer& out) override;
+};
+
+/**
+ * Creates a round of a game mode
+ * Inputs:
+ *   - RoundKind kind: Game mode.
+ *   - const CardStore& cards, const CardIndex& index: Deck and its term index, shared read-only.
+ *   - const SimilarityIndex* similar: Hard multiple-choice distractors, or nullptr.
+ *   - FastRng& rng, AnswerGrader& grader: Belong to the player; a round uses them until it is destroyed.
+ *   - ReviewScheduler* scheduler: Flashcard schedule, or nullptr for a plain pass through the deck.
+ *   - int timeLimit: Seconds for a timed round; ignored by the other modes.
+ * Returns:
+ *   - unique_ptr<GameRound>: The round, not yet started.
+ */
+unique_ptr<GameRound> makeRound(RoundKind kind, const CardStore& cards, const CardIndex& index,
+                                const SimilarityIndex* similar, FastRng& rng, AnswerGrader& grader,
+                                ReviewScheduler* scheduler, int timeLimit);
+
+#endif // M2AP_GAMEROUNDS_H
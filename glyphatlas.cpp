@@ -0,0 +1,211 @@
+/**
+ * glyphatlas.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the glyph atlas.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "glyphatlas.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+using namespace std;
+
+namespace {
+
+const int FIRST_ROWS = 256;         // Height of a new atlas; it doubles as shelves fill it
+
+const char* const DEFAULT_FONTS[] = {
+    "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/dejavu/DejaVuSans.ttf",
+    "/usr/share/fonts/TTF/DejaVuSans.ttf",
+    "/usr/share/fonts/truetype/liberation/LiberationSans-Regular.ttf",
+    "/usr/share/fonts/noto/NotoSans-Regular.ttf",
+    "/System/Library/Fonts/Supplemental/Arial.ttf",
+    "/Library/Fonts/Arial.ttf",
+    "C:\\Windows\\Fonts\\segoeui.ttf",
+    "C:\\Windows\\Fonts\\arial.ttf"
+};
+
+} // namespace
+
+GlyphAtlas::GlyphAtlas()
+        : library(nullptr), face(nullptr), pixelSize(0), ascent(0), lineGap(0), height(0), shelfX(0), shelfY(0),
+          shelfHeight(0), dirtyTop(0), dirtyBottom(0), ascii(), asciiLoaded(), rasterized(0) {}
+
+GlyphAtlas::~GlyphAtlas() {
+    if (face != nullptr) {
+        FT_Done_Face(static_cast<FT_Face>(face));
+    }
+    if (library != nullptr) {
+        FT_Done_FreeType(static_cast<FT_Library>(library));
+    }
+}
+
+string GlyphAtlas::findDefaultFont() {
+    error_code ignored;
+    for (const char* path : DEFAULT_FONTS) {
+        if (filesystem::is_regular_file(path, ignored)) {
+            return path;
+        }
+    }
+    return "";
+}
+
+/**
+ * Opens a font
+ * Inputs:
+ *   - const string& fontPath: Font file.
+ *   - int size: Pixel size.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool GlyphAtlas::open(const string& fontPath, int size, string& error) {
+    if (library == nullptr) {
+        FT_Library ftLibrary;
+        if (FT_Init_FreeType(&ftLibrary) != 0) {
+            error = "Unable to start FreeType";
+            return false;
+        }
+        library = ftLibrary;
+    }
+    FT_Face ftFace;
+    if (FT_New_Face(static_cast<FT_Library>(library), fontPath.c_str(), 0, &ftFace) != 0) {
+        error = "Unable to open the font " + fontPath;
+        return false;
+    }
+    if (FT_Set_Pixel_Sizes(ftFace, 0, static_cast<FT_UInt>(size)) != 0) {
+        FT_Done_Face(ftFace);
+        error = "The font " + fontPath + " has no " + to_string(size) + " pixel size";
+        return false;
+    }
+    if (face != nullptr) {
+        FT_Done_Face(static_cast<FT_Face>(face));
+    }
+    face = ftFace;
+
+    // Metrics are 26.6 fixed point
+    pixelSize = size;
+    ascent = static_cast<int>((ftFace->size->metrics.ascender + 63) >> 6);
+    lineGap = static_cast<int>((ftFace->size->metrics.height + 63) >> 6);
+
+    height = FIRST_ROWS;
+    pixels.assign(static_cast<size_t>(WIDTH) * height, 0);
+    shelfX = 0;
+    shelfY = 0;
+    shelfHeight = 0;
+    dirtyTop = 0;
+    dirtyBottom = height;
+    others.clear();
+    rasterized = 0;
+
+    fill(begin(asciiLoaded), end(asciiLoaded), false);
+    for (char32_t c = 32; c < 127; ++c) {
+        ascii[c] = rasterize(c);
+        asciiLoaded[c] = true;
+    }
+    return true;
+}
+
+/**
+ * Finds room for a bitmap
+ * Description:
+ *   - Bitmaps go left to right along the current shelf; one that does not fit starts a new shelf below,
+ *     as tall as it is. The atlas doubles in height when the shelves reach its bottom.
+ */
+bool GlyphAtlas::place(int glyphWidth, int glyphHeight, int& x, int& y) {
+    if (shelfX + glyphWidth + PADDING > WIDTH) {
+        shelfY += shelfHeight + PADDING;
+        shelfX = 0;
+        shelfHeight = 0;
+    }
+    while (shelfY + glyphHeight + PADDING > height) {
+        if (height * 2 > MAX_HEIGHT) {
+            return false;
+        }
+        // The texture has to be made again at the new size, so all of it is dirty
+        pixels.resize(static_cast<size_t>(WIDTH) * height * 2, 0);
+        height *= 2;
+        dirtyTop = 0;
+        dirtyBottom = height;
+    }
+    x = shelfX;
+    y = shelfY;
+    shelfX += glyphWidth + PADDING;
+    shelfHeight = max(shelfHeight, glyphHeight);
+    return true;
+}
+
+/**
+ * Renders a character and copies it into the atlas
+ */
+Glyph GlyphAtlas::rasterize(char32_t codepoint) {
+    Glyph glyph = {0.0f, 0, 0, 0, 0, 0, 0};
+    FT_Face ftFace = static_cast<FT_Face>(face);
+    if (FT_Load_Char(ftFace, codepoint, FT_LOAD_RENDER) != 0) {
+        glyph.advance = static_cast<float>(pixelSize) / 2.0f;
+        return glyph;
+    }
+    FT_GlyphSlot slot = ftFace->glyph;
+    glyph.advance = static_cast<float>(slot->advance.x) / 64.0f;
+    const FT_Bitmap& bitmap = slot->bitmap;
+    if (bitmap.width == 0 || bitmap.rows == 0) {
+        return glyph;
+    }
+
+    int x = 0;
+    int y = 0;
+    if (!place(static_cast<int>(bitmap.width), static_cast<int>(bitmap.rows), x, y)) {
+        return glyph;
+    }
+    for (unsigned row = 0; row < bitmap.rows; ++row) {
+        memcpy(&pixels[static_cast<size_t>(y + row) * WIDTH + x], bitmap.buffer + static_cast<ptrdiff_t>(row) *
+               bitmap.pitch, bitmap.width);
+    }
+    if (dirtyTop == dirtyBottom) {
+        dirtyTop = y;
+        dirtyBottom = y + static_cast<int>(bitmap.rows);
+    } else {
+        dirtyTop = min(dirtyTop, y);
+        dirtyBottom = max(dirtyBottom, y + static_cast<int>(bitmap.rows));
+    }
+
+    glyph.left = static_cast<int16_t>(slot->bitmap_left);
+    glyph.top = static_cast<int16_t>(slot->bitmap_top);
+    glyph.width = static_cast<uint16_t>(bitmap.width);
+    glyph.height = static_cast<uint16_t>(bitmap.rows);
+    glyph.x = static_cast<uint16_t>(x);
+    glyph.y = static_cast<uint16_t>(y);
+    ++rasterized;
+    return glyph;
+}
+
+const Glyph& GlyphAtlas::slowGlyph(char32_t codepoint) {
+    auto found = others.find(codepoint);
+    if (found != others.end()) {
+        return found->second;
+    }
+    if (face == nullptr) {
+        return others.emplace(codepoint, Glyph{0.0f, 0, 0, 0, 0, 0, 0}).first->second;
+    }
+    if (codepoint < 128) {
+        // Control characters take no room
+        asciiLoaded[codepoint] = true;
+        ascii[codepoint] = codepoint < 32 ? Glyph{0.0f, 0, 0, 0, 0, 0, 0} : rasterize(codepoint);
+        return ascii[codepoint];
+    }
+    return others.emplace(codepoint, rasterize(codepoint)).first->second;
+}
+
+bool GlyphAtlas::takeDirtyRows(int& top, int& bottom) {
+    if (dirtyTop == dirtyBottom) {
+        return false;
+    }
+    top = dirtyTop;
+    bottom = dirtyBottom;
+    dirtyTop = dirtyBottom = 0;
+    return true;
+}
@@ -0,0 +1,119 @@
+/**
+ * glyphatlas.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the glyph atlas of the graphical front end. Glyphs are rasterized by FreeType once, the
+ * first time they are needed, into one 8-bit coverage image packed shelf by shelf; drawing text is then
+ * only copying rectangles out of that image, so a frame never waits on FreeType once the characters of
+ * a deck have been seen. The atlas knows nothing of OpenGL: it reports the rows that changed since they
+ * were last taken, and the renderer uploads just those (see textbatch.h).
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_GLYPHATLAS_H
+#define M2AP_GLYPHATLAS_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Where a glyph sits in the atlas and how to place it on the baseline, in pixels
+struct Glyph {
+    float advance;          // Pen movement after the glyph
+    int16_t left;           // From the pen to the bitmap's left edge
+    int16_t top;            // From the baseline up to the bitmap's top edge
+    uint16_t width;
+    uint16_t height;
+    uint16_t x;             // Top-left corner in the atlas
+    uint16_t y;
+};
+
+class GlyphAtlas {
+public:
+    static const int WIDTH = 1024;          // Pixels across; the atlas grows downwards
+    static const int MAX_HEIGHT = 4096;
+    static const int PADDING = 1;           // Between glyphs, so one never bleeds into another
+
+private:
+    void* library;                          // FT_Library and FT_Face, kept opaque so users of the atlas
+    void* face;                             // need not see FreeType's headers
+    int pixelSize;
+    int ascent;
+    int lineGap;
+    int height;
+    vector<uint8_t> pixels;                 // WIDTH x height coverage, one byte per pixel
+    int shelfX;
+    int shelfY;
+    int shelfHeight;
+    int dirtyTop;                           // Rows changed since takeDirtyRows(), as [dirtyTop, dirtyBottom)
+    int dirtyBottom;
+    Glyph ascii[128];
+    bool asciiLoaded[128];
+    unordered_map<char32_t, Glyph> others;
+    size_t rasterized;
+
+    bool place(int width, int height, int& x, int& y);
+    Glyph rasterize(char32_t codepoint);
+    const Glyph& slowGlyph(char32_t codepoint);
+
+public:
+    GlyphAtlas();
+    ~GlyphAtlas();
+
+    GlyphAtlas(const GlyphAtlas&) = delete;
+    GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+    /**
+     * Opens a font
+     * Inputs:
+     *   - const string& fontPath: TrueType or OpenType font file.
+     *   - int size: Pixel height of the em square.
+     *   - string& error: Receives a description of the failure, if any.
+     * Description:
+     *   - Printable ASCII is rasterized straight away; anything else on first use.
+     */
+    bool open(const string& fontPath, int size, string& error);
+
+    /**
+     * Returns:
+     *   - string: The first of a list of common system fonts that exists, or "" if none does.
+     */
+    static string findDefaultFont();
+
+    /**
+     * A glyph, rasterizing it if it has not been used before
+     * Inputs:
+     *   - char32_t codepoint: The character.
+     * Returns:
+     *   - const Glyph&: Valid for the atlas's lifetime. Characters the font lacks get its missing-glyph
+     *     box; once the atlas is full, new characters get an empty glyph with only an advance.
+     */
+    const Glyph& glyph(char32_t codepoint) {
+        if (codepoint < 128 && asciiLoaded[codepoint]) {
+            return ascii[codepoint];
+        }
+        return slowGlyph(codepoint);
+    }
+
+    /**
+     * Takes the rows changed since the last call
+     * Inputs:
+     *   - int& top, int& bottom: Receive the changed rows as [top, bottom).
+     * Returns:
+     *   - bool: False if nothing has changed.
+     */
+    bool takeDirtyRows(int& top, int& bottom);
+
+    const uint8_t* data() const { return pixels.data(); }
+    int width() const { return WIDTH; }
+    int rows() const { return height; }
+    int size() const { return pixelSize; }
+    int baseline() const { return ascent; }     // From the top of a line down to its baseline
+    int lineHeight() const { return lineGap; }
+    size_t glyphsRasterized() const { return rasterized; }
+};
+
+#endif // M2AP_GLYPHATLAS_H
@@ -0,0 +1,257 @@
+/**
+ * grader.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for AnswerGrader.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "grader.h"
+#include "textnorm.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <thread>
+using namespace std;
+
+namespace {
+
+/**
+ * Advances one 64-row block of the distance matrix by one column (Hyyro 2003)
+ * Inputs:
+ *   - uint64_t& pv, uint64_t& mv: Vertical +1 / -1 deltas of the block, updated in place.
+ *   - uint64_t eq: Rows of the block whose pattern character equals the text character.
+ *   - int hin: Horizontal delta entering the top of the block (-1, 0 or +1).
+ *   - int outBit: Row within the block whose horizontal delta is returned.
+ * Returns:
+ *   - int: Horizontal delta leaving row outBit.
+ */
+inline int advanceBlock(uint64_t& pv, uint64_t& mv, uint64_t eq, int hin, int outBit) {
+    uint64_t hinNegative = static_cast<uint64_t>(hin < 0);
+    uint64_t xv = eq | mv;
+    eq |= hinNegative;
+    uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+    uint64_t ph = mv | ~(xh | pv);
+    uint64_t mh = pv & xh;
+
+    int hout = static_cast<int>((ph >> outBit) & 1) - static_cast<int>((mh >> outBit) & 1);
+
+    ph = (ph << 1) | static_cast<uint64_t>(hin > 0);
+    mh = (mh << 1) | hinNegative;
+    pv = mh | ~(xv | ph);
+    mv = ph & xv;
+    return hout;
+}
+
+} // namespace
+
+AnswerGrader::AnswerGrader(const GradeConfig& gradeConfig)
+        : config(gradeConfig), cacheValid(false), blocks(0) {
+    memset(asciiSymbol, 0, sizeof(asciiSymbol));
+}
+
+/**
+ * Number of edits allowed for a definition
+ * Inputs:
+ *   - size_t length: Definition length in characters, after normalization.
+ */
+uint32_t AnswerGrader::allowedEdits(size_t length) const {
+    if (length < config.minFuzzyLength) {
+        return 0;
+    }
+    double edits = floor(config.maxRatio * static_cast<double>(length));
+    return static_cast<uint32_t>(min<double>(edits, config.maxEdits));
+}
+
+/**
+ * Normalizes a definition and builds its match masks, unless it is the one already prepared
+ */
+void AnswerGrader::preparePattern(string_view expected) {
+    if (cacheValid && expected == cachedExpected) {
+        return;
+    }
+    cachedExpected.assign(expected.data(), expected.size());
+    cacheValid = true;
+
+    normalizeCodepoints(expected, pattern);
+    blocks = (pattern.size() + 63) / 64;
+
+    // Symbol ids: 0 for "not in the pattern", then one per distinct character
+    memset(asciiSymbol, 0, sizeof(asciiSymbol));
+    otherChars.clear();
+    uint32_t symbols = 1;
+    for (char32_t c : pattern) {
+        if (c < 128) {
+            if (asciiSymbol[c] == 0) {
+                asciiSymbol[c] = symbols++;
+            }
+        } else {
+            otherChars.push_back(c);
+        }
+    }
+    sort(otherChars.begin(), otherChars.end());
+    otherChars.erase(unique(otherChars.begin(), otherChars.end()), otherChars.end());
+    otherSymbols.resize(otherChars.size());
+    for (size_t i = 0; i < otherChars.size(); ++i) {
+        otherSymbols[i] = symbols++;
+    }
+
+    peq.assign(static_cast<size_t>(symbols) * blocks, 0);
+    for (size_t row = 0; row < pattern.size(); ++row) {
+        char32_t c = pattern[row];
+        uint32_t symbol;
+        if (c < 128) {
+            symbol = asciiSymbol[c];
+        } else {
+            symbol = otherSymbols[lower_bound(otherChars.begin(), otherChars.end(), c) - otherChars.begin()];
+        }
+        peq[symbol * blocks + row / 64] |= 1ULL << (row % 64);
+    }
+}
+
+/**
+ * Match masks of one text character against the prepared pattern, one word per block
+ */
+const uint64_t* AnswerGrader::matchMask(char32_t c) const {
+    uint32_t symbol = 0;
+    if (c < 128) {
+        symbol = asciiSymbol[c];
+    } else {
+        auto it = lower_bound(otherChars.begin(), otherChars.end(), c);
+        if (it != otherChars.end() && *it == c) {
+            symbol = otherSymbols[it - otherChars.begin()];
+        }
+    }
+    return &peq[symbol * blocks];
+}
+
+/**
+ * Levenshtein distance between the prepared pattern and a text
+ * Inputs:
+ *   - const u32string& text: Normalized answer.
+ *   - uint32_t limit: Largest distance of interest.
+ * Returns:
+ *   - uint32_t: The distance if it is at most limit, otherwise limit + 1.
+ * Description:
+ *   - A path costing at most limit never strays more than limit rows from the diagonal, so each column
+ *     only updates the blocks overlapping that band (Ukkonen's cut-off). Cells outside the band are
+ *     over-estimated, which cannot lower a result that is within the limit.
+ */
+uint32_t AnswerGrader::distanceTo(const u32string& text, uint32_t limit) {
+    size_t m = pattern.size();
+    size_t n = text.size();
+    size_t lengthGap = m > n ? m - n : n - m;
+    if (lengthGap > limit) {
+        return limit + 1;
+    }
+    if (m == 0) {
+        return static_cast<uint32_t>(n);
+    }
+
+    const size_t lastBlock = blocks - 1;
+    const int lastBit = static_cast<int>((m - 1) % 64);
+    auto blockRows = [&](size_t b) { return b == lastBlock ? static_cast<long>(lastBit + 1) : 64L; };
+
+    pv.resize(blocks);
+    mv.resize(blocks);
+    blockScore.resize(blocks);
+
+    // Column 0: D[i][0] = i
+    size_t firstActive = 0;
+    size_t lastActive = min(lastBlock, static_cast<size_t>(limit) / 64);
+    for (size_t b = 0; b <= lastActive; ++b) {
+        pv[b] = ~0ULL;
+        mv[b] = 0;
+        blockScore[b] = (b > 0 ? blockScore[b - 1] : 0) + blockRows(b);
+    }
+
+    for (size_t j = 0; j < n; ++j) {
+        // Rows j + 1 - limit .. j + 1 + limit (1-based) can still be on a path within the limit
+        size_t column = j + 1;
+        size_t lowRow = min(m, column + limit);
+        while (lastActive < lastBlock && (lastActive + 1) * 64 < lowRow) {
+            ++lastActive;
+            pv[lastActive] = ~0ULL;
+            mv[lastActive] = 0;
+            blockScore[lastActive] = blockScore[lastActive - 1] + blockRows(lastActive);
+        }
+        if (column > limit + 1) {
+            firstActive = max(firstActive, (column - limit - 1) / 64);
+        }
+
+        const uint64_t* eq = matchMask(text[j]);
+        int hin = 1;   // Row 0 is 0, 1, 2, ... and rows above the band are only ever over-estimated
+        for (size_t b = firstActive; b <= lastActive; ++b) {
+            hin = advanceBlock(pv[b], mv[b], eq[b], hin, b == lastBlock ? lastBit : 63);
+            blockScore[b] += hin;
+        }
+
+        // Once the last row is in the band, the distance can drop by at most one per remaining character
+        if (lastActive == lastBlock
+            && blockScore[lastBlock] - static_cast<long>(n - column) > static_cast<long>(limit)) {
+            return limit + 1;
+        }
+    }
+    return static_cast<uint32_t>(min<long>(blockScore[lastBlock], static_cast<long>(limit) + 1));
+}
+
+/**
+ * Grades one answer
+ * Inputs:
+ *   - string_view expected: The definition.
+ *   - string_view answer: What the user typed.
+ * Returns:
+ *   - GradeResult: Whether the answer is accepted, and its distance from the definition.
+ */
+GradeResult AnswerGrader::grade(string_view expected, string_view answer) {
+    preparePattern(expected);
+    normalizeCodepoints(answer, answerChars);
+
+    if (answerChars == pattern) {
+        return GradeResult{true, 0};
+    }
+    uint32_t limit = allowedEdits(pattern.size());
+    if (limit == 0) {
+        return GradeResult{false, 1};
+    }
+    uint32_t distance = distanceTo(answerChars, limit);
+    return GradeResult{distance <= limit, distance};
+}
+
+/**
+ * Grades many answers
+ * Inputs:
+ *   - const vector<GradeRequest>& requests: Answers to grade.
+ *   - vector<GradeResult>& results: Receives one result per request, in the same order.
+ *   - unsigned threads: Worker threads; 0 uses every core.
+ */
+void AnswerGrader::gradeBulk(const vector<GradeRequest>& requests, vector<GradeResult>& results,
+                             unsigned threads) const {
+    size_t count = requests.size();
+    results.resize(count);
+
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, count / 4096)));
+
+    // Each worker has its own grader, so pattern caches are never shared
+    auto gradeRange = [&](size_t begin, size_t end) {
+        AnswerGrader worker(config);
+        for (size_t i = begin; i < end; ++i) {
+            results[i] = worker.grade(requests[i].expected, requests[i].answer);
+        }
+    };
+
+    vector<thread> workers;
+    size_t chunk = (count + threads - 1) / threads;
+    for (unsigned t = 1; t < threads; ++t) {
+        size_t begin = min(count, t * chunk);
+        workers.emplace_back(gradeRange, begin, min(count, begin + chunk));
+    }
+    gradeRange(0, min(count, chunk));
+    for (thread& worker : workers) {
+        worker.join();
+    }
+}
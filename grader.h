@@ -0,0 +1,101 @@
+/**
+ * grader.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for AnswerGrader, which decides whether a typed answer is close enough to a definition.
+ * Both texts are normalized (case, accents, punctuation variants, whitespace) and compared by Levenshtein
+ * distance over characters, computed with Myers' bit-parallel algorithm in Hyyro's multi-word form: one
+ * 64-bit word covers 64 characters of the definition, so a 500-character definition takes 8 words per
+ * typed character.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_GRADER_H
+#define M2AP_GRADER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+struct GradeConfig {
+    double maxRatio = 0.15;       // Edits allowed per character of the definition
+    uint32_t maxEdits = 12;       // Upper limit on edits however long the definition is
+    uint32_t minFuzzyLength = 4;  // Shorter definitions must match exactly (after normalization)
+};
+
+struct GradeRequest {
+    string_view expected;   // Definition
+    string_view answer;     // What the user typed
+};
+
+struct GradeResult {
+    bool accepted;
+    uint32_t distance;      // Edit distance; only exact when accepted, otherwise a value over the limit
+};
+
+class AnswerGrader {
+private:
+    GradeConfig config;
+
+    // Pattern cache for the last definition graded, so repeated answers to one card skip the setup
+    string cachedExpected;
+    bool cacheValid;
+    u32string pattern;
+    size_t blocks;
+    uint32_t asciiSymbol[128];          // Symbol id for each ASCII character, 0 if not in the pattern
+    vector<char32_t> otherChars;        // Sorted non-ASCII characters in the pattern
+    vector<uint32_t> otherSymbols;      // Symbol id for each of otherChars
+    vector<uint64_t> peq;               // blocks words per symbol; symbol 0 matches nothing
+
+    // Scratch reused between answers
+    u32string answerChars;
+    vector<uint64_t> pv;                // Vertical +1 deltas, one word per block
+    vector<uint64_t> mv;                // Vertical -1 deltas
+    vector<long> blockScore;            // Distance at the bottom row of each block
+
+    void preparePattern(string_view expected);
+    const uint64_t* matchMask(char32_t c) const;
+    uint32_t distanceTo(const u32string& text, uint32_t limit);
+
+public:
+    explicit AnswerGrader(const GradeConfig& gradeConfig = GradeConfig());
+
+    void setConfig(const GradeConfig& gradeConfig) { config = gradeConfig; }
+    const GradeConfig& getConfig() const { return config; }
+
+    /**
+     * Number of edits allowed for a definition
+     * Inputs:
+     *   - size_t length: Definition length in characters, after normalization.
+     */
+    uint32_t allowedEdits(size_t length) const;
+
+    /**
+     * Grades one answer
+     * Inputs:
+     *   - string_view expected: The definition.
+     *   - string_view answer: What the user typed.
+     * Returns:
+     *   - GradeResult: Whether the answer is accepted, and its distance from the definition.
+     * Description:
+     *   - Grading the same definition again reuses its prepared pattern.
+     *   - Stops early once the distance can no longer come under the limit.
+     */
+    GradeResult grade(string_view expected, string_view answer);
+
+    /**
+     * Grades many answers
+     * Inputs:
+     *   - const vector<GradeRequest>& requests: Answers to grade; the texts must stay alive during the call.
+     *   - vector<GradeResult>& results: Receives one result per request, in the same order.
+     *   - unsigned threads: Worker threads; 0 uses every core.
+     * Description:
+     *   - Each worker takes a contiguous run of requests, so requests grouped by definition share patterns.
+     */
+    void gradeBulk(const vector<GradeRequest>& requests, vector<GradeResult>& results, unsigned threads = 0) const;
+};
+
+#endif // M2AP_GRADER_H
@@ -0,0 +1,337 @@
+/**
+ * guimain.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Graphical front end, built as the studytool_gl target: flashcards and the multiple-choice game in a
+ * GLFW window, drawn by CardView with one draw call a frame. The games are the same GameRounds the
+ * terminal plays; keys and clicks are turned into the answers the terminal would have read.
+ *   ./studytool_gl --deck deck.tsv [--mode flip|mult] [--font <file.ttf>] [--size <px>] [--seed <n>]
+ * A frame is only drawn when something changed (or a long text is still being laid out); otherwise the
+ * loop sleeps in glfwWaitEvents().
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include "cardview.h"
+#include "deckloader.h"
+#include "gamerounds.h"
+#include "glyphatlas.h"
+#include "studytool.h"
+#include "textbatch.h"
+using namespace std;
+
+// Everything the callbacks reach through the window's user pointer
+struct GuiState {
+    StudyTool& studyTool;
+    CardView view;
+    unique_ptr<GameRound> round;
+    RoundKind kind = RoundKind::FLASHCARDS;
+    bool dirty = true;
+
+    GuiState(StudyTool& tool, GlyphAtlas& atlas) : studyTool(tool), view(atlas) {}
+};
+
+/**
+ * Starts a game in the window
+ */
+static void startRound(GuiState& state, RoundKind kind) {
+    state.round = state.studyTool.newRound(kind);
+    state.kind = kind;
+    state.view.clear();
+    state.round->start(state.view);
+    if (state.round->finished()) {
+        state.view.showMenu();
+        state.round.reset();
+    }
+    state.dirty = true;
+}
+
+/**
+ * Passes an answer to the game, and goes back to the menu once it is over
+ */
+static void submitAnswer(GuiState& state, string_view answer) {
+    if (state.round == nullptr) {
+        return;
+    }
+    state.round->submit(answer, state.view);
+    if (state.round->finished()) {
+        if (state.kind == RoundKind::MULTIPLE_CHOICE) {
+            state.view.showScore("Multiple Choice Game", state.round->getScore(), state.round->getOutcomes().size());
+        } else {
+            state.view.showMenu();
+        }
+        state.round.reset();
+    }
+    state.dirty = true;
+}
+
+/**
+ * Turns a key into an answer to what the screen is asking
+ * Description:
+ *   - Space or Enter flips a card and moves on from it; S stars it.
+ *   - Y and N answer whether to study the starred cards; 1-4 rate a scheduled card and Q stops.
+ *   - Digits (on either row or the keypad) choose an option; F and M start a game from the menu.
+ *   - The arrows and Page Up/Down scroll a long definition; Escape quits.
+ */
+static void keyPressed(GLFWwindow* window, int key, int, int action, int) {
+    if (action == GLFW_RELEASE) {
+        return;
+    }
+    GuiState& state = *static_cast<GuiState*>(glfwGetWindowUserPointer(window));
+    bool confirm = key == GLFW_KEY_SPACE || key == GLFW_KEY_ENTER || key == GLFW_KEY_KP_ENTER;
+    int digit = 0;
+    if (key >= GLFW_KEY_1 && key <= GLFW_KEY_9) {
+        digit = key - GLFW_KEY_1 + 1;
+    } else if (key >= GLFW_KEY_KP_1 && key <= GLFW_KEY_KP_9) {
+        digit = key - GLFW_KEY_KP_1 + 1;
+    }
+
+    switch (key) {
+        case GLFW_KEY_ESCAPE:
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+            return;
+        case GLFW_KEY_UP:
+            state.view.scroll(-1);
+            state.dirty = true;
+            return;
+        case GLFW_KEY_DOWN:
+            state.view.scroll(1);
+            state.dirty = true;
+            return;
+        case GLFW_KEY_PAGE_UP:
+            state.view.scroll(-10);
+            state.dirty = true;
+            return;
+        case GLFW_KEY_PAGE_DOWN:
+            state.view.scroll(10);
+            state.dirty = true;
+            return;
+        default:
+            break;
+    }
+    // Held keys repeat for scrolling only, so a held Space does not skip through the deck
+    if (action == GLFW_REPEAT) {
+        return;
+    }
+
+    switch (state.view.prompt()) {
+        case CardPrompt::NONE:
+            if (key == GLFW_KEY_F) {
+                startRound(state, RoundKind::FLASHCARDS);
+            } else if (key == GLFW_KEY_M) {
+                startRound(state, RoundKind::MULTIPLE_CHOICE);
+            }
+            break;
+        case CardPrompt::FLIP:
+            if (confirm) {
+                submitAnswer(state, "");
+            }
+            break;
+        case CardPrompt::STAR:
+            if (key == GLFW_KEY_S) {
+                submitAnswer(state, "star");
+            } else if (confirm) {
+                submitAnswer(state, "");
+            }
+            break;
+        case CardPrompt::STUDY_STARRED:
+            if (key == GLFW_KEY_Y) {
+                submitAnswer(state, "y");
+            } else if (key == GLFW_KEY_N) {
+                submitAnswer(state, "n");
+            }
+            break;
+        case CardPrompt::RATING:
+            if (key == GLFW_KEY_Q) {
+                submitAnswer(state, "q");
+            } else if (digit >= 1 && digit <= 4) {
+                submitAnswer(state, to_string(digit));
+            }
+            break;
+        case CardPrompt::CHOICE:
+            if (digit >= 1 && static_cast<size_t>(digit) <= state.view.choicesShown()) {
+                submitAnswer(state, to_string(digit));
+            }
+            break;
+    }
+}
+
+/**
+ * Chooses the option clicked on
+ */
+static void mousePressed(GLFWwindow* window, int button, int action, int) {
+    GuiState& state = *static_cast<GuiState*>(glfwGetWindowUserPointer(window));
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS || state.view.prompt() != CardPrompt::CHOICE) {
+        return;
+    }
+    // The cursor is in window coordinates; the screen was laid out in framebuffer pixels
+    double cursorX = 0.0;
+    double cursorY = 0.0;
+    int windowWidth = 1;
+    int windowHeight = 1;
+    int framebufferWidth = 1;
+    int framebufferHeight = 1;
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    glfwGetWindowSize(window, &windowWidth, &windowHeight);
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    size_t choice = state.view.choiceAt(
+            static_cast<float>(cursorX * framebufferWidth / max(windowWidth, 1)),
+            static_cast<float>(cursorY * framebufferHeight / max(windowHeight, 1)));
+    if (choice != 0) {
+        submitAnswer(state, to_string(choice));
+    }
+}
+
+static void wheelScrolled(GLFWwindow* window, double, double offsetY) {
+    GuiState& state = *static_cast<GuiState*>(glfwGetWindowUserPointer(window));
+    state.view.scroll(static_cast<int>(lround(-3.0 * offsetY)));
+    state.dirty = true;
+}
+
+static void windowChanged(GLFWwindow* window) {
+    static_cast<GuiState*>(glfwGetWindowUserPointer(window))->dirty = true;
+}
+
+static void framebufferResized(GLFWwindow* window, int, int) {
+    windowChanged(window);
+}
+
+static void glfwFailed(int code, const char* description) {
+    cerr << "Error: GLFW " << code << ": " << description << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string deckPath;
+    string mode;
+    string fontPath;
+    int fontSize = 22;
+    uint64_t seed = random_device()();
+    seed = (seed << 32) ^ random_device()();
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--deck") == 0 && i + 1 < argc) {
+            deckPath = argv[++i];
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            fontPath = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            fontSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else {
+            deckPath.clear();
+            break;
+        }
+    }
+    if (deckPath.empty() || (!mode.empty() && mode != "flip" && mode != "mult")) {
+        cerr << "Usage: " << argv[0] << " --deck <file.tsv|file.csv|file.stdeck> [--mode flip|mult]"
+             << " [--font <file.ttf>] [--size <px>] [--seed <n>]" << endl;
+        return 1;
+    }
+    if (fontSize < 6) {
+        cerr << "Error: --size must be at least 6 pixels" << endl;
+        return 1;
+    }
+    if (fontPath.empty()) {
+        fontPath = GlyphAtlas::findDefaultFont();
+        if (fontPath.empty()) {
+            cerr << "Error: no system font found; pass one with --font" << endl;
+            return 1;
+        }
+    }
+
+    string error;
+    CardStore deck;
+    if (!loadDeck(deckPath, deck, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    size_t cardCount = deck.size();
+    StudyTool studyTool(std::move(deck), seed);
+    studyTool.setPrepareAhead(MultipleChoiceRound::PREPARE_AHEAD);
+
+    glfwSetErrorCallback(glfwFailed);
+    if (glfwInit() != GLFW_TRUE) {
+        return 1;
+    }
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    glfwWindowHint(GLFW_SCALE_TO_MONITOR, GLFW_TRUE);
+    GLFWwindow* window = glfwCreateWindow(1024, 640, "C++ Study Tool", nullptr, nullptr);
+    if (window == nullptr) {
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    glfwSwapInterval(1);
+    if (gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress)) == 0) {
+        cerr << "Error: Unable to load the OpenGL functions" << endl;
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 1;
+    }
+
+    int exitCode = 0;
+    {
+        // Text is rasterized at the pixels it is shown at, so a high-DPI screen gets a larger font
+        float scaleX = 1.0f;
+        float scaleY = 1.0f;
+        glfwGetWindowContentScale(window, &scaleX, &scaleY);
+        GlyphAtlas atlas;
+        TextBatch batch(atlas);
+        if (!atlas.open(fontPath, static_cast<int>(lround(fontSize * max(scaleY, 1.0f))), error)
+            || !batch.init(error)) {
+            cerr << "Error: " << error << endl;
+            exitCode = 1;
+        } else {
+            GuiState state(studyTool, atlas);
+            glfwSetWindowUserPointer(window, &state);
+            glfwSetKeyCallback(window, keyPressed);
+            glfwSetMouseButtonCallback(window, mousePressed);
+            glfwSetScrollCallback(window, wheelScrolled);
+            glfwSetWindowRefreshCallback(window, windowChanged);
+            glfwSetFramebufferSizeCallback(window, framebufferResized);
+
+            state.view.message("Loaded " + to_string(cardCount) + " cards from " + deckPath);
+            state.view.showMenu();
+            if (mode == "flip") {
+                startRound(state, RoundKind::FLASHCARDS);
+            } else if (mode == "mult") {
+                startRound(state, RoundKind::MULTIPLE_CHOICE);
+            }
+
+            while (glfwWindowShouldClose(window) == 0) {
+                if (!state.dirty && !state.view.laying()) {
+                    glfwWaitEvents();
+                    continue;
+                }
+                int width = 1;
+                int height = 1;
+                glfwGetFramebufferSize(window, &width, &height);
+                state.dirty = false;
+                batch.begin(width, height, state.view.background());
+                state.view.draw(batch, width, height);
+                batch.flush();
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            glfwSetWindowUserPointer(window, nullptr);
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return exitCode;
+}
@@ -0,0 +1,617 @@
+/**
+ * historystore.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for HistoryStore.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "historystore.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "textnorm.h"
+using namespace std;
+
+namespace {
+
+const char FILE_MAGIC[8] = {'S', 'T', 'H', 'I', 'S', 'T', '0', '1'};
+const uint32_t BLOCK_MAGIC = 0x42485453u;      // "STHB"
+const size_t PREFIX_BYTES = 12;                 // uint32 magic, uint32 header length, uint32 CRC32 of the header
+const size_t MAX_HEADER_BYTES = 1 << 24;
+
+template <class T>
+void appendRaw(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putVarint(string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+bool getVarint(const char*& at, const char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && at < end; shift += 7) {
+        uint8_t byte = static_cast<uint8_t>(*at++);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+// Reads fixed-size fields from a block header, failing once past its end
+struct FieldReader {
+    const char* at;
+    const char* end;
+
+    template <class T>
+    bool read(T& value) {
+        if (static_cast<size_t>(end - at) < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, at, sizeof(value));
+        at += sizeof(value);
+        return true;
+    }
+};
+
+bool readAt(int fd, char* buffer, size_t length, uint64_t offset) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t got = pread(fd, buffer + done, length - done, static_cast<off_t>(offset + done));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeAt(int fd, const string& data, uint64_t offset) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t wrote = pwrite(fd, data.data() + done, data.size() - done, static_cast<off_t>(offset + done));
+        if (wrote < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += static_cast<size_t>(wrote);
+    }
+    return true;
+}
+
+template <class T>
+uint32_t codeFor(vector<T>& dictionary, const T& value) {
+    auto found = find(dictionary.begin(), dictionary.end(), value);
+    if (found != dictionary.end()) {
+        return static_cast<uint32_t>(found - dictionary.begin());
+    }
+    dictionary.push_back(value);
+    return static_cast<uint32_t>(dictionary.size() - 1);
+}
+
+} // namespace
+
+uint32_t crc32(const char* data, size_t length) {
+    static const array<uint32_t, 256> table = [] {
+        array<uint32_t, 256> entries;
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+        return entries;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; ++i) {
+        crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+/**
+ * Identifies a deck in the history
+ * Inputs:
+ *   - const CardStore& cards: The deck.
+ */
+uint64_t deckIdentity(const CardStore& cards) {
+    uint64_t id = 0xCBF29CE484222325ull ^ cards.size();
+    for (CardId card = 0; card < cards.size(); ++card) {
+        id = (id ^ hashText(cards.term(card))) * 0x100000001B3ull;
+        id = (id ^ hashText(cards.def(card))) * 0x100000001B3ull;
+    }
+    return id != 0 ? id : 1;
+}
+
+HistoryStore::HistoryStore() : fd(-1), fileEnd(0) {}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+/**
+ * Opens the store, creating it if missing
+ * Inputs:
+ *   - const string& storePath: The store's file.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: True if games can be appended and queried.
+ */
+bool HistoryStore::open(const string& storePath, string& error) {
+    close();
+    path = storePath;
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "Unable to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = "Unable to read " + path + ": " + strerror(errno);
+        close();
+        return false;
+    }
+    uint64_t size = static_cast<uint64_t>(info.st_size);
+
+    char magic[sizeof(FILE_MAGIC)];
+    if (size < sizeof(FILE_MAGIC)) {
+        // New, or torn before its first block: start it again
+        string header(FILE_MAGIC, sizeof(FILE_MAGIC));
+        if (ftruncate(fd, 0) != 0 || !writeAt(fd, header, 0) || fdatasync(fd) != 0) {
+            error = "Unable to create " + path + ": " + strerror(errno);
+            close();
+            return false;
+        }
+        size = sizeof(FILE_MAGIC);
+    } else if (!readAt(fd, magic, sizeof(magic), 0) || memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0) {
+        error = path + " is not a study history file";
+        close();
+        return false;
+    }
+
+    uint64_t offset = sizeof(FILE_MAGIC);
+    Block block;
+    uint64_t next;
+    bool torn = false;
+    while (offset < size && readHeader(offset, size, block, next, torn)) {
+        blocks.push_back(std::move(block));
+        offset = next;
+    }
+
+    // Blocks are synced one at a time, so only the last block in the file can have been torn by a crash. A bad
+    // header with an intact block somewhere after it is damage instead, and cutting the file there would throw
+    // the later blocks away
+    if (offset < size && !torn && intactBlockAfter(offset, size)) {
+        error = path + " is damaged at byte " + to_string(offset) + "; move it aside to start a new history";
+        close();
+        return false;
+    }
+    string columns;
+    string ignored;
+    if (offset == size && !blocks.empty() && !readColumns(blocks.back(), SEQUENCES, OUTCOMES, columns, ignored)) {
+        offset = blocks.back().start;
+        blocks.pop_back();
+    }
+    if (offset < size && (ftruncate(fd, static_cast<off_t>(offset)) != 0 || fdatasync(fd) != 0)) {
+        error = "Unable to repair " + path + ": " + strerror(errno);
+        close();
+        return false;
+    }
+    fileEnd = offset;
+    return true;
+}
+
+/**
+ * Reads and checks one block header
+ * Inputs:
+ *   - uint64_t offset: Where the block starts.
+ *   - uint64_t fileSize: Bytes in the file; a block running past the end is torn.
+ *   - Block& block: Receives the header.
+ *   - uint64_t& next: Receives where the next block starts.
+ *   - bool& torn: Set if the block runs past the end of the file.
+ * Returns:
+ *   - bool: False at a torn or damaged block.
+ */
+bool HistoryStore::readHeader(uint64_t offset, uint64_t fileSize, Block& block, uint64_t& next, bool& torn) const {
+    torn = false;
+    char prefix[PREFIX_BYTES];
+    if (fileSize - offset < PREFIX_BYTES) {
+        torn = true;
+        return false;
+    }
+    if (!readAt(fd, prefix, PREFIX_BYTES, offset)) {
+        return false;
+    }
+    uint32_t magic;
+    uint32_t headerBytes;
+    uint32_t headerCrc;
+    memcpy(&magic, prefix, 4);
+    memcpy(&headerBytes, prefix + 4, 4);
+    memcpy(&headerCrc, prefix + 8, 4);
+    if (magic != BLOCK_MAGIC || headerBytes > MAX_HEADER_BYTES) {
+        return false;
+    }
+    if (fileSize - offset - PREFIX_BYTES < headerBytes) {
+        torn = true;
+        return false;
+    }
+
+    string header(headerBytes, '\0');
+    if (!readAt(fd, &header[0], headerBytes, offset + PREFIX_BYTES) || crc32(header.data(), headerBytes) != headerCrc) {
+        return false;
+    }
+
+    FieldReader fields{header.data(), header.data() + header.size()};
+    uint32_t bodyBytes;
+    uint32_t modeCount;
+    uint32_t deckCount;
+    if (!fields.read(bodyBytes) || !fields.read(block.games) || !fields.read(block.firstSequence)
+        || !fields.read(block.lastSequence) || !fields.read(block.minTimestamp) || !fields.read(block.maxTimestamp)) {
+        return false;
+    }
+    for (ColumnExtent& column : block.columns) {
+        if (!fields.read(column.offset) || !fields.read(column.length) || !fields.read(column.crc)
+            || column.offset > bodyBytes || bodyBytes - column.offset < column.length) {
+            return false;
+        }
+    }
+
+    block.modes.clear();
+    if (!fields.read(modeCount)) {
+        return false;
+    }
+    for (uint32_t i = 0; i < modeCount; ++i) {
+        uint16_t length;
+        if (!fields.read(length) || static_cast<size_t>(fields.end - fields.at) < length) {
+            return false;
+        }
+        block.modes.emplace_back(fields.at, length);
+        fields.at += length;
+    }
+    if (!fields.read(deckCount) || static_cast<size_t>(fields.end - fields.at) / sizeof(uint64_t) < deckCount) {
+        return false;
+    }
+    block.decks.resize(deckCount);
+    for (uint64_t& deck : block.decks) {
+        fields.read(deck);
+    }
+
+    block.start = offset;
+    block.body = offset + PREFIX_BYTES + headerBytes;
+    if (fileSize - block.body < bodyBytes) {
+        torn = true;
+        return false;
+    }
+    next = block.body + bodyBytes;
+    return true;
+}
+
+/**
+ * Looks for an intact block header after a damaged one
+ * Inputs:
+ *   - uint64_t offset: Where the damaged block starts.
+ *   - uint64_t fileSize: Bytes in the file.
+ * Returns:
+ *   - bool: True if a later header passes its checksum, so the damage is not a torn tail.
+ */
+bool HistoryStore::intactBlockAfter(uint64_t offset, uint64_t fileSize) const {
+    string rest(fileSize - offset, '\0');
+    if (!readAt(fd, &rest[0], rest.size(), offset)) {
+        // Unreadable is not evidence of a torn tail; keep the file as it is
+        return true;
+    }
+    uint32_t magic = BLOCK_MAGIC;
+    Block block;
+    uint64_t next;
+    bool torn;
+    for (size_t at = 1; at + sizeof(magic) <= rest.size(); ++at) {
+        if (memcmp(rest.data() + at, &magic, sizeof(magic)) == 0
+            && readHeader(offset + at, fileSize, block, next, torn)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads a run of a block's columns with one read and checks them
+ * Inputs:
+ *   - const Block& block: The block.
+ *   - Column first, Column last: The run, inclusive; columns are stored in order, back to back.
+ *   - string& out: Receives the bytes from the start of first to the end of last.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool HistoryStore::readColumns(const Block& block, Column first, Column last, string& out, string& error) const {
+    uint32_t begin = block.columns[first].offset;
+    uint32_t end = block.columns[last].offset + block.columns[last].length;
+    out.resize(end - begin);
+    if (!readAt(fd, &out[0], out.size(), block.body + begin)) {
+        error = "Unable to read " + path + ": " + strerror(errno);
+        return false;
+    }
+    for (int column = first; column <= last; ++column) {
+        const ColumnExtent& extent = block.columns[column];
+        if (crc32(out.data() + (extent.offset - begin), extent.length) != extent.crc) {
+            error = "The block at byte " + to_string(block.start) + " of " + path + " fails its checksum";
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Encodes games as one block: prefix, header, then the columns in order
+ * Inputs:
+ *   - const HistoryRecord* games, size_t count: At most BLOCK_GAMES games, in sequence order.
+ *   - string& out: The block is appended to it.
+ *   - Block& block: Receives the header, with offsets relative to the start of out.
+ */
+void HistoryStore::encodeBlock(const HistoryRecord* games, size_t count, string& out, Block& block) {
+    string columns[COLUMN_COUNT];
+    block.games = static_cast<uint32_t>(count);
+    block.firstSequence = games[0].sequence;
+    block.lastSequence = games[count - 1].sequence;
+    block.minTimestamp = games[0].session.timestamp;
+    block.maxTimestamp = games[0].session.timestamp;
+    block.modes.clear();
+    block.decks.clear();
+    for (size_t i = 0; i < count; ++i) {
+        block.minTimestamp = min(block.minTimestamp, games[i].session.timestamp);
+        block.maxTimestamp = max(block.maxTimestamp, games[i].session.timestamp);
+    }
+
+    uint64_t previousSequence = block.firstSequence;
+    int64_t previousTimestamp = block.minTimestamp;
+    for (size_t i = 0; i < count; ++i) {
+        const GameSession& session = games[i].session;
+        putVarint(columns[SEQUENCES], games[i].sequence - previousSequence);
+        putVarint(columns[TIMESTAMPS], zigzag(session.timestamp - previousTimestamp));
+        putVarint(columns[MODES], codeFor(block.modes, session.gameMode.substr(0, 0xFFFF)));
+        putVarint(columns[DECKS], codeFor(block.decks, session.deckId));
+        putVarint(columns[SCORES], zigzag(session.numCorrectAnswers));
+        putVarint(columns[TOTALS], static_cast<uint64_t>(max(session.total, 0)));
+        putVarint(columns[OUTCOME_COUNTS], session.outcomes.size());
+        previousSequence = games[i].sequence;
+        previousTimestamp = session.timestamp;
+
+        // Cards asked in deck order, as most rounds do, differ by a small gap
+        CardId previousCard = 0;
+        for (const CardOutcome& outcome : session.outcomes) {
+            int64_t gap = static_cast<int64_t>(outcome.card) - static_cast<int64_t>(previousCard);
+            putVarint(columns[OUTCOMES], zigzag(gap) << 1 | (outcome.correct ? 1 : 0));
+            putVarint(columns[OUTCOMES], outcome.answerMicros);
+            previousCard = outcome.card;
+        }
+    }
+
+    uint32_t bodyBytes = 0;
+    for (int column = 0; column < COLUMN_COUNT; ++column) {
+        block.columns[column] = ColumnExtent{bodyBytes, static_cast<uint32_t>(columns[column].size()),
+                                             crc32(columns[column].data(), columns[column].size())};
+        bodyBytes += static_cast<uint32_t>(columns[column].size());
+    }
+
+    string header;
+    appendRaw(header, bodyBytes);
+    appendRaw(header, block.games);
+    appendRaw(header, block.firstSequence);
+    appendRaw(header, block.lastSequence);
+    appendRaw(header, block.minTimestamp);
+    appendRaw(header, block.maxTimestamp);
+    for (const ColumnExtent& column : block.columns) {
+        appendRaw(header, column.offset);
+        appendRaw(header, column.length);
+        appendRaw(header, column.crc);
+    }
+    appendRaw(header, static_cast<uint32_t>(block.modes.size()));
+    for (const string& mode : block.modes) {
+        appendRaw(header, static_cast<uint16_t>(mode.size()));
+        header += mode;
+    }
+    appendRaw(header, static_cast<uint32_t>(block.decks.size()));
+    for (uint64_t deck : block.decks) {
+        appendRaw(header, deck);
+    }
+
+    block.start = out.size();
+    block.body = out.size() + PREFIX_BYTES + header.size();
+    appendRaw(out, BLOCK_MAGIC);
+    appendRaw(out, static_cast<uint32_t>(header.size()));
+    appendRaw(out, crc32(header.data(), header.size()));
+    out += header;
+    for (const string& column : columns) {
+        out += column;
+    }
+}
+
+/**
+ * Appends games as new blocks and waits until they are on disk
+ * Inputs:
+ *   - const vector<HistoryRecord>& games: Games in increasing sequence order.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool HistoryStore::append(const vector<HistoryRecord>& games, string& error) {
+    if (fd < 0) {
+        error = "The study history is not open";
+        return false;
+    }
+
+    vector<HistoryRecord> fresh;
+    uint64_t last = lastSequence();
+    for (const HistoryRecord& game : games) {
+        if (game.sequence > last) {
+            fresh.push_back(game);
+            last = game.sequence;
+        }
+    }
+
+    // Each block is on disk before the next is written, so a crash can only tear the last block in the file
+    string data;
+    for (size_t first = 0; first < fresh.size(); first += BLOCK_GAMES) {
+        Block block;
+        data.clear();
+        encodeBlock(fresh.data() + first, min(BLOCK_GAMES, fresh.size() - first), data, block);
+        if (data.size() > numeric_limits<uint32_t>::max()) {
+            throw length_error("History block too large");
+        }
+        block.start += fileEnd;
+        block.body += fileEnd;
+
+        if (!writeAt(fd, data, fileEnd) || fdatasync(fd) != 0) {
+            error = "Unable to append to " + path + ": " + strerror(errno);
+            if (ftruncate(fd, static_cast<off_t>(fileEnd)) != 0) {
+                error += " (and unable to undo a partial write)";
+            }
+            return false;
+        }
+        fileEnd += data.size();
+        blocks.push_back(std::move(block));
+    }
+    return true;
+}
+
+/**
+ * Visits the games matching a query, oldest first
+ * Inputs:
+ *   - const HistoryQuery& query: Mode, deck, time and sequence bounds.
+ *   - const function<void(uint64_t, const GameSession&)>& visit: Called with each game and its sequence.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - HistoryScan* scan: If not nullptr, receives how many blocks were read and skipped.
+ */
+bool HistoryStore::query(const HistoryQuery& query, const function<void(uint64_t, const GameSession&)>& visit,
+                         string& error, HistoryScan* scan) const {
+    HistoryScan counted;
+    string columns;
+    string outcomeColumns;
+    GameSession session{"", 0, 0, 0, 0, {}};
+
+    for (const Block& block : blocks) {
+        // The header alone rules out most blocks of a narrow query
+        size_t modeCode = block.modes.size();
+        size_t deckCode = block.decks.size();
+        if (!query.gameMode.empty()) {
+            modeCode = find(block.modes.begin(), block.modes.end(), query.gameMode) - block.modes.begin();
+        }
+        if (query.deckId != 0) {
+            deckCode = find(block.decks.begin(), block.decks.end(), query.deckId) - block.decks.begin();
+        }
+        if (block.lastSequence <= query.afterSequence || block.maxTimestamp < query.fromTimestamp
+            || block.minTimestamp > query.untilTimestamp || (!query.gameMode.empty() && modeCode == block.modes.size())
+            || (query.deckId != 0 && deckCode == block.decks.size())) {
+            ++counted.blocksSkipped;
+            continue;
+        }
+
+        // Everything but the per-card results is a few bytes a game, so it is read in one go
+        if (!readColumns(block, SEQUENCES, TOTALS, columns, error)) {
+            return false;
+        }
+        ++counted.blocksRead;
+        counted.bytesRead += columns.size();
+        const char* at[COLUMN_COUNT] = {};
+        const char* end[COLUMN_COUNT] = {};
+        for (int column = SEQUENCES; column <= TOTALS; ++column) {
+            at[column] = columns.data() + (block.columns[column].offset - block.columns[SEQUENCES].offset);
+            end[column] = at[column] + block.columns[column].length;
+        }
+        if (query.outcomes) {
+            if (!readColumns(block, OUTCOME_COUNTS, OUTCOMES, outcomeColumns, error)) {
+                return false;
+            }
+            counted.bytesRead += outcomeColumns.size();
+            for (int column = OUTCOME_COUNTS; column <= OUTCOMES; ++column) {
+                at[column] = outcomeColumns.data()
+                             + (block.columns[column].offset - block.columns[OUTCOME_COUNTS].offset);
+                end[column] = at[column] + block.columns[column].length;
+            }
+        }
+
+        uint64_t sequence = block.firstSequence;
+        int64_t timestamp = block.minTimestamp;
+        for (uint32_t game = 0; game < block.games; ++game) {
+            uint64_t gap, stamp, mode, deck, score, total, outcomeCount = 0;
+            bool ok = getVarint(at[SEQUENCES], end[SEQUENCES], gap) && getVarint(at[TIMESTAMPS], end[TIMESTAMPS], stamp)
+                      && getVarint(at[MODES], end[MODES], mode) && getVarint(at[DECKS], end[DECKS], deck)
+                      && getVarint(at[SCORES], end[SCORES], score) && getVarint(at[TOTALS], end[TOTALS], total)
+                      && mode < block.modes.size() && deck < block.decks.size();
+            session.outcomes.clear();
+            if (ok && query.outcomes) {
+                ok = getVarint(at[OUTCOME_COUNTS], end[OUTCOME_COUNTS], outcomeCount);
+                CardId card = 0;
+                for (uint64_t i = 0; ok && i < outcomeCount; ++i) {
+                    uint64_t packed = 0, micros = 0;
+                    ok = getVarint(at[OUTCOMES], end[OUTCOMES], packed)
+                         && getVarint(at[OUTCOMES], end[OUTCOMES], micros);
+                    if (!ok) {
+                        break;
+                    }
+                    card = static_cast<CardId>(card + unzigzag(packed >> 1));
+                    session.outcomes.push_back(CardOutcome{card, (packed & 1) != 0, static_cast<uint32_t>(micros)});
+                }
+            }
+            if (!ok) {
+                error = "The block at byte " + to_string(block.start) + " of " + path + " is damaged";
+                return false;
+            }
+            sequence += gap;
+            timestamp += unzigzag(stamp);
+
+            if (sequence <= query.afterSequence || timestamp < query.fromTimestamp || timestamp > query.untilTimestamp
+                || (!query.gameMode.empty() && mode != modeCode) || (query.deckId != 0 && deck != deckCode)) {
+                continue;
+            }
+            session.gameMode = block.modes[mode];
+            session.numCorrectAnswers = static_cast<int>(unzigzag(score));
+            session.timestamp = timestamp;
+            session.deckId = block.decks[deck];
+            session.total = static_cast<int>(total);
+            visit(sequence, session);
+        }
+    }
+
+    if (scan != nullptr) {
+        *scan = counted;
+    }
+    return true;
+}
+
+/**
+ * Closes the file
+ */
+void HistoryStore::close() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+    blocks.clear();
+    fileEnd = 0;
+}
@@ -0,0 +1,153 @@
+/**
+ * historystore.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for HistoryStore, the long-term home of finished games once the session journal is compacted.
+ * Games are kept column by column in blocks of up to BLOCK_GAMES: sequence numbers and timestamps as
+ * varint-coded deltas, game modes and deck ids as codes into a small per-block dictionary, scores and
+ * totals as varints, and each game's per-card results in a column of their own. Every block starts with a
+ * CRC-checked header holding its sequence and timestamp ranges, its dictionaries and where each column
+ * lies, and the headers are read once on open. A query such as "MatchingGame over the last 30 days" then
+ * reads only the blocks whose ranges and dictionaries can match, and leaves the per-card results on disk
+ * unless it asks for them. Blocks are only ever appended, each synced before the next is written, and a
+ * final block torn by a crash is cut off on open.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_HISTORYSTORE_H
+#define M2AP_HISTORYSTORE_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+#include "cardstore.h"
+#include "studytool.h"
+using namespace std;
+
+struct HistoryRecord {
+    uint64_t sequence;
+    GameSession session;
+};
+
+struct HistoryQuery {
+    string gameMode;                                    // Empty for every mode
+    uint64_t deckId = 0;                                // 0 for every deck
+    int64_t fromTimestamp = numeric_limits<int64_t>::min();    // Milliseconds since the epoch, inclusive
+    int64_t untilTimestamp = numeric_limits<int64_t>::max();
+    uint64_t afterSequence = 0;                         // Games up to and including this one are skipped
+    bool outcomes = false;                              // Also read each game's per-card results
+};
+
+struct HistoryScan {
+    size_t blocksRead = 0;
+    size_t blocksSkipped = 0;
+    size_t bytesRead = 0;
+};
+
+class HistoryStore {
+private:
+    enum Column { SEQUENCES, TIMESTAMPS, MODES, DECKS, SCORES, TOTALS, OUTCOME_COUNTS, OUTCOMES, COLUMN_COUNT };
+
+    struct ColumnExtent {
+        uint32_t offset;        // From the start of the block's body
+        uint32_t length;
+        uint32_t crc;
+    };
+
+    struct Block {
+        uint64_t start;         // File offset of the block's header
+        uint64_t body;          // File offset of its columns
+        uint32_t games;
+        uint64_t firstSequence;
+        uint64_t lastSequence;
+        int64_t minTimestamp;
+        int64_t maxTimestamp;
+        vector<string> modes;
+        vector<uint64_t> decks;
+        ColumnExtent columns[COLUMN_COUNT];
+    };
+
+    string path;
+    int fd;
+    uint64_t fileEnd;
+    vector<Block> blocks;
+
+    bool readHeader(uint64_t offset, uint64_t fileSize, Block& block, uint64_t& next, bool& torn) const;
+    bool intactBlockAfter(uint64_t offset, uint64_t fileSize) const;
+    bool readColumns(const Block& block, Column first, Column last, string& out, string& error) const;
+    static void encodeBlock(const HistoryRecord* games, size_t count, string& out, Block& block);
+
+public:
+    static const size_t BLOCK_GAMES = 4096;
+
+    HistoryStore();
+    ~HistoryStore();
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    /**
+     * Opens the store, creating it if missing
+     * Inputs:
+     *   - const string& storePath: The store's file.
+     *   - string& error: Receives a description of the failure, if any.
+     * Returns:
+     *   - bool: True if games can be appended and queried.
+     * Description:
+     *   - Reads every block header, and cuts off a block left incomplete by a crash. Only the last block in the
+     *     file can be torn, since blocks are synced one at a time; damage before it makes open() fail instead.
+     */
+    bool open(const string& storePath, string& error);
+
+    /**
+     * Appends games as new blocks and waits until they are on disk, one block at a time
+     * Inputs:
+     *   - const vector<HistoryRecord>& games: Games in increasing sequence order. Games at or before
+     *     lastSequence() are skipped, so appending the same games twice is harmless.
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool append(const vector<HistoryRecord>& games, string& error);
+
+    /**
+     * Visits the games matching a query, oldest first
+     * Inputs:
+     *   - const HistoryQuery& query: Mode, deck, time and sequence bounds.
+     *   - const function<void(uint64_t, const GameSession&)>& visit: Called with each game and its sequence;
+     *     outcomes are empty unless the query asks for them.
+     *   - string& error: Receives a description of the failure, such as a block that fails its checksum.
+     *   - HistoryScan* scan: If not nullptr, receives how many blocks were read and skipped.
+     */
+    bool query(const HistoryQuery& query, const function<void(uint64_t, const GameSession&)>& visit, string& error,
+               HistoryScan* scan = nullptr) const;
+
+    /**
+     * Closes the file. Also done by the destructor.
+     */
+    void close();
+
+    uint64_t lastSequence() const { return blocks.empty() ? 0 : blocks.back().lastSequence; }
+    size_t blockCount() const { return blocks.size(); }
+    uint64_t fileBytes() const { return fileEnd; }
+    bool isOpen() const { return fd >= 0; }
+};
+
+/**
+ * Identifies a deck in the history
+ * Inputs:
+ *   - const CardStore& cards: The deck.
+ * Returns:
+ *   - uint64_t: A hash of every card's term and definition, the same however the deck was loaded; never 0,
+ *     which stands for games recorded without a deck id.
+ */
+uint64_t deckIdentity(const CardStore& cards);
+
+/**
+ * Returns:
+ *   - uint32_t: CRC-32 (IEEE) of the bytes, as checked on journal records and history blocks.
+ */
+uint32_t crc32(const char* data, size_t length);
+
+#endif // M2AP_HISTORYSTORE_H
@@ -11,7 +11,32 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <csignal>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <ctime>
+#include <filesystem>
+#include <spawn.h>
+#include <sys/wait.h>
 #include "studytool.h"
+#include "deckloader.h"
+#include "deckfile.h"
+#include "deckcleaner.h"
+#include "deckstream.h"
+#include "similarity.h"
+#include "sessionlog.h"
+#include "historystore.h"
+#include "stats.h"
+#include "replay.h"
+#include "studyserver.h"
+#include "telemetry.h"
+#include "textnorm.h"
 using namespace std;
 
 enum GameMode {
@@ -21,47 +46,541 @@ enum GameMode {
     TIME_CHALLENGE
 };
 
-void writeToCSV(const std::vector<GameSession>& sessions) {
-    ofstream outFile("../game_sessions.csv");
+/**
+ * Records a finished game at a commit point and folds it into the statistics
+ * Inputs:
+ *   - SessionJournal& journal: History of finished games.
+ *   - SessionStats& stats: Aggregates kept next to the journal.
+ *   - const StudyTool& studyTool: The game just played, for its per-card results.
+ *   - uint64_t deckId: deckIdentity() of the deck played.
+ *   - const string& gameMode: Mode name.
+ *   - int score: The game's score.
+ */
+void recordSession(SessionJournal& journal, SessionStats& stats, const StudyTool& studyTool, uint64_t deckId,
+                   const string& gameMode, int score) {
+    const vector<CardOutcome>& outcomes = studyTool.getLastOutcomes();
+    GameSession session{gameMode, score, 0, deckId, static_cast<int>(outcomes.size()), outcomes};
+    uint64_t sequence = journal.append(session);
+    string error;
+    if (journal.isOpen() && !journal.commit(error)) {
+        cerr << "Warning: " << error << endl;
+    }
+
+    stats.record(sequence, session);
+    stats.recordOutcomes(outcomes);
+    if (journal.isOpen()
+        && (!stats.save(journal.dataPath() + "/stats.state", error)
+            || !stats.writeSummary(journal.dataPath() + "/summary.json", studyTool.getCards(), error))) {
+        cerr << "Warning: " << error << endl;
+    }
+}
+
+extern char** environ;
+
+/**
+ * Finds plots.py
+ * Returns:
+ *   - string: Path of plots.py next to the executable, in the source tree above a build directory, or where an
+ *     install puts it (<prefix>/share/cppstudytool); empty if none exists.
+ */
+string findPlotsScript() {
+    error_code failed;
+    filesystem::path executable = filesystem::read_symlink("/proc/self/exe", failed);
+    if (failed) {
+        return "";
+    }
+    filesystem::path directory = executable.parent_path();
+    for (const filesystem::path& candidate : {directory / "plots.py", directory.parent_path() / "plots.py",
+                                              directory.parent_path() / "share" / "cppstudytool" / "plots.py"}) {
+        if (filesystem::is_regular_file(candidate, failed)) {
+            return candidate.string();
+        }
+    }
+    return "";
+}
+
+/**
+ * Runs plots.py on summary.json and waits for it
+ * Inputs:
+ *   - const string& summaryPath: The summary to plot.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: True if the script ran and exited cleanly.
+ * Description:
+ *   - The script gets its arguments directly rather than through a shell, so no path needs quoting.
+ */
+bool runPlots(const string& summaryPath, string& error) {
+    string script = findPlotsScript();
+    if (script.empty()) {
+        error = "plots.py was not found next to the program";
+        return false;
+    }
+    string interpreter = "python3";
+    vector<char*> arguments = {&interpreter[0], &script[0], const_cast<char*>(summaryPath.c_str()), nullptr};
+    cout.flush();
+    pid_t child;
+    int failed = posix_spawnp(&child, interpreter.c_str(), nullptr, nullptr, arguments.data(), environ);
+    if (failed != 0) {
+        error = "Unable to run python3: " + string(strerror(failed));
+        return false;
+    }
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+        if (errno != EINTR) {
+            error = "Unable to wait for plots.py: " + string(strerror(errno));
+            return false;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        error = WIFEXITED(status) ? "plots.py exited with status " + to_string(WEXITSTATUS(status))
+                                  : "plots.py was stopped by signal " + to_string(WTERMSIG(status));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Shows a game mode's statistics, and optionally the python plot of summary.json
+ * Inputs:
+ *   - const SessionStats& stats: Aggregates.
+ *   - const StudyTool& studyTool: For the terms of the weakest cards.
+ *   - const string& gameMode: Mode to show.
+ *   - const SessionJournal& journal: Locates summary.json.
+ *   - bool plot: Whether to also run plots.py.
+ */
+void showBreakdown(const SessionStats& stats, const StudyTool& studyTool, const string& gameMode,
+                   const SessionJournal& journal, bool plot) {
+    stats.print(gameMode, studyTool.getCards(), cout);
+    string error;
+    if (plot && journal.isOpen() && !runPlots(journal.dataPath() + "/summary.json", error)) {
+        cerr << "Warning: " << error << endl;
+    }
+}
+
+/**
+ * Narrows every game to the cards matching a search
+ * Inputs:
+ *   - StudyTool& studyTool: Cards to search; the matches become its filter.
+ *   - const string& query: Search as typed (see searchindex.h).
+ *   - string& error: Receives why the search was not applied.
+ * Returns:
+ *   - bool: False if the search is malformed or matches no cards; the filter is then left as it was.
+ */
+bool applySearch(StudyTool& studyTool, const string& query, string& error) {
+    vector<CardId> found;
+    auto searchStart = chrono::steady_clock::now();
+    if (!studyTool.findCards(query, found, error)) {
+        return false;
+    }
+    if (found.empty()) {
+        error = "No cards match \"" + query + "\"";
+        return false;
+    }
+    auto ms = chrono::duration<double, milli>(chrono::steady_clock::now() - searchStart).count();
+    cout << "Playing the " << found.size() << " of " << studyTool.getCards().size() << " cards matching \"" << query
+         << "\" (searched in " << ms << " ms)" << endl;
+    studyTool.setFilter(std::move(found));
+    return true;
+}
+
+static StudyServer* runningServer = nullptr;
 
-    if (!outFile.is_open()) {
-        cerr << "Error: Unable to open file game_sessions.csv" << endl;
-        return;
+/**
+ * Stops the server on SIGINT or SIGTERM
+ */
+void stopServer(int) {
+    if (runningServer != nullptr) {
+        runningServer->stop();
     }
+}
 
-    outFile << "GameMode,NumCorrectAnswers\n";
+/**
+ * Compiles a text deck into a .stdeck file
+ * Usage: studytool compile deck.tsv -o deck.stdeck
+ */
+int compileCommand(int argc, char* argv[]) {
+    string sourcePath;
+    string outputPath;
+
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (sourcePath.empty()) {
+            sourcePath = argv[i];
+        } else {
+            sourcePath.clear();
+            break;
+        }
+    }
+
+    if (sourcePath.empty() || outputPath.empty()) {
+        cerr << "Usage: " << argv[0] << " compile <deck.tsv|deck.csv> -o <deck.stdeck>" << endl;
+        return 1;
+    }
+
+    string error;
+    size_t cardCount = 0;
+    auto start = chrono::steady_clock::now();
+
+    if (!compileDeck(sourcePath, outputPath, error, &cardCount)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    auto ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "Compiled " << cardCount << " cards into " << outputPath << " in " << ms << " ms" << endl;
+    return 0;
+}
+
+/**
+ * Cleans and validates a text deck
+ * Usage: studytool clean deck.tsv -o clean.tsv [--threads n]
+ */
+int cleanCommand(int argc, char* argv[]) {
+    string sourcePath;
+    string outputPath;
+    unsigned threads = 0;
+
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = static_cast<unsigned>(strtoul(argv[++i], nullptr, 10));
+        } else if (sourcePath.empty()) {
+            sourcePath = argv[i];
+        } else {
+            sourcePath.clear();
+            break;
+        }
+    }
+
+    if (sourcePath.empty() || outputPath.empty()) {
+        cerr << "Usage: " << argv[0] << " clean <deck.tsv|deck.csv> -o <clean.tsv> [--threads <n>]" << endl;
+        return 1;
+    }
+
+    string error;
+    CardStore source;
+    if (!loadDeck(sourcePath, source, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    CardStore cleaned;
+    DeckReport report;
+    cleanDeck(source, cleaned, report, threads);
+    report.print(source, cout);
+    if (!report.multipleChoiceReady()) {
+        cerr << "Warning: " << outputPath << " has too few distinct definitions for the multiple choice game" << endl;
+    }
+
+    if (!writeDeckTsv(cleaned, outputPath, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    cout << "Wrote " << cleaned.size() << " cards to " << outputPath << endl;
+    return 0;
+}
+
+/**
+ * Shows the scores kept in the history, or exports them as CSV
+ * Usage: studytool history [--mode name] [--days n] [--deck deck.tsv] | history --export sessions.csv
+ */
+int historyCommand(int argc, char* argv[]) {
+    HistoryQuery query;
+    string deckPath;
+    string exportPath;
+    long days = 0;
+
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            query.gameMode = argv[++i];
+        } else if (strcmp(argv[i], "--days") == 0 && i + 1 < argc) {
+            days = strtol(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--deck") == 0 && i + 1 < argc) {
+            deckPath = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " history [--mode <name>] [--days <n>] [--deck <file>]" << endl;
+            cerr << "       " << argv[0] << " history --export <sessions.csv>" << endl;
+            return 1;
+        }
+    }
+
+    string error;
+    SessionJournal journal;
+    if (!journal.open(SessionJournal::dataDirectory(), error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    if (journal.importedGames() > 0) {
+        cout << "Imported " << journal.importedGames() << " games from ../game_sessions.csv" << endl;
+    }
+
+    if (!exportPath.empty()) {
+        size_t games = 0;
+        if (!journal.exportCsv(exportPath, error, &games)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+        cout << "Exported " << games << " games to " << exportPath << endl;
+        return 0;
+    }
 
-    for (const auto& session : sessions) {
-        outFile << session.gameMode << "," << session.numCorrectAnswers << "\n";
+    if (!deckPath.empty()) {
+        CardStore deck;
+        if (!loadDeck(deckPath, deck, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+        query.deckId = deckIdentity(deck);
+    }
+    int64_t now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    if (days > 0) {
+        query.fromTimestamp = now - static_cast<int64_t>(days) * 86400000;
     }
 
-    outFile.close();
+    // Games per local day and mode, in date order
+    struct DayScores {
+        uint64_t games = 0;
+        int64_t score = 0;
+        int64_t total = 0;
+    };
+    map<pair<string, string>, DayScores> byDay;
+    HistoryScan scan;
+    auto queryStart = chrono::steady_clock::now();
+    bool ok = journal.query(query, [&byDay](uint64_t, const GameSession& session) {
+        time_t seconds = static_cast<time_t>(session.timestamp / 1000);
+        tm local{};
+        char date[16] = "undated";      // Games imported from the first version's CSV have no time
+        if (session.timestamp != 0) {
+            localtime_r(&seconds, &local);
+            strftime(date, sizeof(date), "%Y-%m-%d", &local);
+        }
+        DayScores& day = byDay[make_pair(string(date), session.gameMode)];
+        ++day.games;
+        day.score += session.numCorrectAnswers;
+        day.total += session.total;
+    }, error, &scan);
+    auto ms = chrono::duration<double, milli>(chrono::steady_clock::now() - queryStart).count();
+    if (!ok) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
 
-    cout << "Data written to game_sessions.csv" << endl;
+    uint64_t games = 0;
+    for (const auto& entry : byDay) {
+        const DayScores& day = entry.second;
+        cout << entry.first.first << "  " << entry.first.second << ": " << day.games
+             << (day.games == 1 ? " game" : " games") << ", mean score "
+             << static_cast<double>(day.score) / static_cast<double>(day.games);
+        if (day.total > 0) {
+            cout << " (" << 100.0 * static_cast<double>(day.score) / static_cast<double>(day.total) << "% correct)";
+        }
+        cout << endl;
+        games += day.games;
+    }
+    const HistoryStore& history = journal.getHistory();
+    cout << games << (games == 1 ? " game" : " games") << " found in " << ms << " ms, reading " << scan.blocksRead
+         << " of " << history.blockCount() << " history blocks (" << scan.bytesRead << " of " << history.fileBytes()
+         << " bytes)" << endl;
+    return 0;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (argc > 1 && strcmp(argv[1], "compile") == 0) {
+        return compileCommand(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "history") == 0) {
+        return historyCommand(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "clean") == 0) {
+        return cleanCommand(argc, argv);
+    }
+
+    string deckPath;
+    string replayPath;
+    string serveAddress;
+    string telemetryPath;
+    string searchQuery;
+    size_t workerCount = thread::hardware_concurrency() > 1 ? min(thread::hardware_concurrency() - 1, 8u) : 0;
+    bool hardMode = false;
+    bool plot = false;
+    bool latency = false;
+    bool streaming = false;
+    bool compress = false;
+    DeckStreamConfig streamConfig;
+    GradeConfig gradeConfig;
+    uint64_t seed = random_device()();
+    seed = (seed << 32) ^ random_device()();
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--deck") == 0 && i + 1 < argc) {
+            deckPath = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--hard") == 0) {
+            hardMode = true;
+        } else if (strcmp(argv[i], "--compress") == 0) {
+            compress = true;
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streaming = true;
+        } else if (strcmp(argv[i], "--memory") == 0 && i + 1 < argc) {
+            streamConfig.memoryBudget = static_cast<size_t>(strtoull(argv[++i], nullptr, 10)) << 20;
+        } else if (strcmp(argv[i], "--search") == 0 && i + 1 < argc) {
+            searchQuery = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workerCount = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--plot") == 0) {
+            plot = true;
+        } else if (strcmp(argv[i], "--latency") == 0) {
+            latency = true;
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetryPath = argv[++i];
+        } else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            char* end = nullptr;
+            gradeConfig.maxRatio = strtod(argv[++i], &end);
+            if (*end != '\0' || gradeConfig.maxRatio < 0.0 || gradeConfig.maxRatio > 1.0) {
+                cerr << "Error: --tolerance takes a fraction between 0 and 1" << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Usage: " << argv[0]
+                 << " [--deck <file.tsv|file.csv|file.stdeck>] [--seed <n>] [--hard] [--tolerance <0-1>] [--plot]"
+                 << " [--compress] [--latency] [--telemetry <snapshot.json>] [--replay <answers.log>]"
+                 << " [--search <query>]" << endl;
+            cerr << "       " << argv[0] << " --deck <file.tsv|file.csv> --stream [--memory <MiB>] [options above]"
+                 << endl;
+            cerr << "       " << argv[0] << " --deck <file> --serve <socket path|host:port> [--workers <n>]" << endl;
+            cerr << "       " << argv[0] << " compile <deck.tsv|deck.csv> -o <deck.stdeck>" << endl;
+            cerr << "       " << argv[0] << " clean <deck.tsv|deck.csv> -o <clean.tsv> [--threads <n>]" << endl;
+            cerr << "       " << argv[0] << " history [--mode <name>] [--days <n>] [--deck <file>] [--export <file.csv>]"
+                 << endl;
+            return 1;
+        }
+    }
+
+    if (!replayPath.empty() && deckPath.empty()) {
+        cerr << "Error: --replay needs a --deck to play" << endl;
+        return 1;
+    }
+    if (!serveAddress.empty() && deckPath.empty()) {
+        cerr << "Error: --serve needs a --deck to host" << endl;
+        return 1;
+    }
+    if (streaming && deckPath.empty()) {
+        cerr << "Error: --stream needs a --deck to read" << endl;
+        return 1;
+    }
+    if (streaming && !serveAddress.empty()) {
+        cerr << "Error: --serve shares one deck between many games, so it cannot stream" << endl;
+        return 1;
+    }
+    if (!searchQuery.empty() && (streaming || !serveAddress.empty())) {
+        cerr << "Error: --search needs the whole deck in memory and is not shared with --serve" << endl;
+        return 1;
+    }
+    if (streaming && hardMode) {
+        cerr << "Warning: hard mode needs the whole deck in memory; streamed games use random distractors" << endl;
+        hardMode = false;
+    }
+    if (streaming && compress) {
+        cerr << "Warning: --compress applies to decks held in memory; streamed cards are kept as they are" << endl;
+        compress = false;
+    }
+    bool headless = !replayPath.empty() || !serveAddress.empty();
+
     cout << "Hi, welcome to C++ Study Tool. This program will help prepare you for your exams in an exciting manner!"
          << endl;
     cout << "Created by Ian Cox" << endl;
 
-    vector<GameSession> sessions;
+    SessionJournal journal;
+    string journalError;
+    SessionStats stats;
+    if (headless) {
+        // Replays and servers play for other people or for measurement; they leave this history alone
+    } else if (!journal.open(SessionJournal::dataDirectory(), journalError)) {
+        cerr << "Warning: " << journalError << "; scores from this run will not be saved" << endl;
+    } else {
+        if (journal.importedGames() > 0) {
+            cout << "Imported " << journal.importedGames() << " games from ../game_sessions.csv" << endl;
+        }
+        // Statistics are normally current; after a crash between the journal and the state file, catch up
+        if (!stats.load(journal.dataPath() + "/stats.state", journalError)) {
+            cerr << "Warning: " << journalError << "; rebuilding statistics" << endl;
+        }
+        if (stats.lastRecorded() < journal.lastSequence()
+            && !journal.replay(stats.lastRecorded(),
+                               [&stats](uint64_t sequence, const GameSession& session) {
+                                   stats.record(sequence, session);
+                               },
+                               journalError)) {
+            cerr << "Warning: " << journalError << endl;
+        }
+    }
     int multGamesPlayed = 0;
     int matchGamesPlayed = 0;
     int timedGamesPlayed = 0;
 
-    vector<string> terms;
-    vector<string> defs;
-    bool play = true;
+    CardStore deck;
+    DeckStream deckStream;
+    bool play = deckPath.empty();
+
+    if (streaming) {
+        // Cards are read a chunk at a time as they are played, so the deck is never in memory whole
+        string error;
+        streamConfig.seed = seed;
+        if (!deckStream.open(deckPath, streamConfig, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+        cout << "Streaming " << deckPath << " in chunks of " << (deckStream.chunkSize() >> 10) << " KiB within "
+             << (deckStream.budget() >> 20) << " MiB" << endl;
+    } else if (!play) {
+        string error;
+        DeckLoadReport report;
+        auto loadStart = chrono::steady_clock::now();
+
+        if (!loadDeck(deckPath, deck, error, &report)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+
+        auto loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+        cout << "Loaded " << deck.size() << " cards from " << deckPath << " in " << loadMs << " ms" << endl;
+
+        if (report.skippedRows > 0) {
+            cout << "Skipped " << report.skippedRows << " rows without a definition (first on line "
+                 << report.firstSkippedLine << ")" << endl;
+        }
+        if (deck.size() == 0) {
+            cerr << "Error: " << deckPath << " does not contain any cards" << endl;
+            return 1;
+        }
+
+        if (compress) {
+            size_t plainBytes = deck.textBytes();
+            auto compressStart = chrono::steady_clock::now();
+            deck.compressDefinitions();
+            auto compressMs = chrono::duration<double, milli>(chrono::steady_clock::now() - compressStart).count();
+            cout << "Compressed the deck's text from " << plainBytes << " to " << deck.textBytes() << " bytes ("
+                 << static_cast<double>(plainBytes) / static_cast<double>(max<size_t>(deck.textBytes(), 1))
+                 << "x) in " << compressMs << " ms" << endl;
+        }
+    }
 
     while (play) {
         string term, def;
         cout << "Enter a term: ";
         cin >> term;
-        terms.push_back(term);
         cout << "Enter the definition for the term that you just entered: ";
         cin >> def;
-        defs.push_back(def);
+        deck.addCard(term, def);
         bool againCorrect = true;
         bool firstTime = true;
 
@@ -87,7 +606,134 @@ int main() {
         }
     }
 
-    StudyTool studyTool(terms, defs);
+    SimilarityIndex similar;
+    ReviewScheduler scheduler;
+    StudyTool studyTool(std::move(deck), seed);
+    studyTool.setGradeConfig(gradeConfig);
+    studyTool.setReportLatency(latency);
+    if (!headless) {
+        // A learner takes far longer to answer than a question takes to prepare, so the next ones are ready
+        studyTool.setPrepareAhead(MultipleChoiceRound::PREPARE_AHEAD);
+    }
+    if (streaming) {
+        studyTool.setStream(&deckStream);
+    }
+
+    // Answer and engine timings are always kept while playing; a replay keeps them when asked to
+    Telemetry telemetry;
+    if (telemetryPath.empty() && !headless && journal.isOpen()) {
+        telemetryPath = journal.dataPath() + "/telemetry.json";
+    }
+    if (!headless || (!replayPath.empty() && !telemetryPath.empty())) {
+        studyTool.setTelemetry(&telemetry);
+    }
+
+    if (!deckPath.empty() && !headless && !streaming) {
+        // Flashcard progress is kept next to the deck so it carries over between runs
+        string error;
+        if (scheduler.open(deckPath + ".sched", studyTool.getCards().size(), error)) {
+            studyTool.setScheduler(&scheduler);
+        } else {
+            cerr << "Warning: " << error << "; flashcards will not be scheduled" << endl;
+        }
+    }
+
+    // Games are filed under the deck's contents; a streamed deck is never whole in memory, so under its path
+    uint64_t deckId = streaming ? max<uint64_t>(hashText(deckPath), 1) : deckIdentity(studyTool.getCards());
+
+    if (!searchQuery.empty()) {
+        string error;
+        if (!applySearch(studyTool, searchQuery, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+    }
+
+    const CardIndex& index = studyTool.getIndex();
+    if (index.duplicateCardCount() > 0) {
+        vector<CardId> duplicated;
+        index.duplicateTerms(duplicated);
+        cout << "Note: " << duplicated.size() << " terms appear on more than one card (for example \""
+             << studyTool.getCards().term(duplicated.front()) << "\"). Any of their definitions will be accepted."
+             << endl;
+    }
+
+    if (hardMode) {
+        // Multiple choice "hard" mode: reuse the index cached next to the deck, or build and cache it
+        string cachePath = deckPath.empty() ? "" : deckPath + ".simidx";
+        string error;
+        auto indexStart = chrono::steady_clock::now();
+
+        if (!cachePath.empty() && similar.load(cachePath, studyTool.getCards(), error)) {
+            auto ms = chrono::duration<double, milli>(chrono::steady_clock::now() - indexStart).count();
+            cout << "Loaded hard-distractor index from " << cachePath << " in " << ms << " ms" << endl;
+        } else {
+            similar.build(studyTool.getCards(), index);
+            auto ms = chrono::duration<double, milli>(chrono::steady_clock::now() - indexStart).count();
+            cout << "Built hard-distractor index over " << similar.size() << " definitions in " << ms << " ms"
+                 << endl;
+            if (!cachePath.empty() && !similar.save(cachePath, error)) {
+                cerr << "Warning: " << error << endl;
+            }
+        }
+        studyTool.setHardDistractors(&similar);
+    }
+
+    if (!serveAddress.empty()) {
+        StudyServer server(studyTool, seed);
+        string error;
+        if (!server.listen(serveAddress, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+        cout << "Serving " << studyTool.getCards().size() << " cards on " << serveAddress << " with " << workerCount
+             << " worker threads. Press Ctrl-C to stop." << endl;
+
+        runningServer = &server;
+        signal(SIGINT, stopServer);
+        signal(SIGTERM, stopServer);
+        bool served = server.run(workerCount, error);
+        runningServer = nullptr;
+        if (!served) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+        cout << "Served " << server.sessionCount() << " sessions and " << server.answerCount() << " answers." << endl;
+        return 0;
+    }
+
+    if (!replayPath.empty()) {
+        ReplayReport report;
+        string error;
+        if (!replayAnswers(studyTool, replayPath, report, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+
+        int totalScore = 0;
+        for (size_t i = 0; i < report.rounds.size(); ++i) {
+            const ReplayRound& round = report.rounds[i];
+            cout << "Round " << i + 1 << ": " << round.gameMode << " score " << round.score << " of "
+                 << round.questions << ", " << round.answers << " answers" << (round.finished ? "" : " (abandoned)")
+                 << endl;
+            totalScore += round.score;
+        }
+        cout << "Replayed " << report.rounds.size() << " rounds, " << report.answers << " answers in "
+             << report.seconds * 1000.0 << " ms (" << (report.seconds > 0.0 ? report.answers / report.seconds : 0.0)
+             << " answers/s)" << endl;
+        cout << "Total score " << totalScore << ", checksum " << hex << report.checksum << dec << endl;
+        if (report.skippedLines > 0) {
+            cout << "Skipped " << report.skippedLines << " lines outside a round" << endl;
+        }
+        if (!telemetryPath.empty()) {
+            if (!telemetry.writeSnapshot(telemetryPath, studyTool.getCards(), error)) {
+                cerr << "Error: " << error << endl;
+                return 1;
+            }
+            cout << "Wrote answer and engine timings to " << telemetryPath << endl;
+        }
+        return 0;
+    }
     int firstScore = 0;
     bool playAgain = true;
 
@@ -98,10 +744,29 @@ int main() {
         cout << "2.) Multiple Choice Game [enter '2']" << endl;
         cout << "3.) Matching Game [enter '3']" << endl;
         cout << "4.) Time-Based Challenge [enter '4']" << endl;
+        if (!streaming) {
+            cout << "5.) Only Play Cards Matching a Search [enter '5']" << endl;
+        }
 
         cin.clear();
         getline(cin, input);
 
+        if (input == "5" && !streaming) {
+            string query;
+            cout << "Search for (e.g. 'heap stack', 'heap OR stack', 'mem*', 'tree -heap'), or press enter to play "
+                 << "every card: ";
+            getline(cin, query);
+            string error;
+            if (query.find_first_not_of(" \t") == string::npos) {
+                studyTool.clearFilter();
+                cout << "Playing all " << studyTool.getCards().size() << " cards." << endl;
+            } else if (!applySearch(studyTool, query, error)) {
+                cout << error << (studyTool.getFilter() != nullptr ? "; still playing the last search." : ".")
+                     << endl;
+            }
+            continue;
+        }
+
         GameMode mode;
 
         if (input.length() == 1) {
@@ -123,18 +788,18 @@ int main() {
 
             switch (mode) {
                 case FLASHCARDS_PRACTICE:
-                    studyTool.playflip(terms, defs);
+                    studyTool.playflip();
                     break;
 
                 case MULTIPLE_CHOICE_GAME: {
                     vector<int> scores;
                     int score = 0;
                     if (firstScore == 0) {
-                        firstScore = studyTool.mult(terms, defs);
+                        firstScore = studyTool.mult();
                         cout << "Your score: " << firstScore << endl;
                         score = firstScore;
                     } else {
-                        int recentScore = studyTool.mult(terms, defs);
+                        int recentScore = studyTool.mult();
                         cout << "Your score: " << recentScore << endl;
                         if (recentScore == firstScore) {
                             cout << "Your most recent score is equal to your first score." << endl;
@@ -146,45 +811,48 @@ int main() {
                         score = recentScore;
                     }
 
-                    sessions.push_back({"MultipleChoiceGame", score});
+                    recordSession(journal, stats, studyTool, deckId, "MultipleChoiceGame", score);
                     multGamesPlayed ++;
 
                     if (multGamesPlayed >= 2) {
                         string graphInput;
-                        cout << "Do you want a breakdown of your multiple choice game scores in a python plotted graph? [enter 'y' for yes or 'n' for no]" << endl;
+                        cout << "Do you want a breakdown of your multiple choice game scores? [enter 'y' for yes or 'n' for no]" << endl;
                         getline(cin, graphInput);
 
                         while (graphInput != "y" && graphInput != "n") {
-                            cout << "Invalid input. Do you want a breakdown of your multiple choice game scores in a python plotted graph? [enter 'y' for yes or 'n' for no]" << endl;
+                            cout << "Invalid input. Do you want a breakdown of your multiple choice game scores? [enter 'y' for yes or 'n' for no]" << endl;
                             getline(cin, graphInput);
                         }
 
                         if (graphInput == "y") {
-                            writeToCSV(sessions);
-                            system("python3 ../plots.py");
+                            showBreakdown(stats, studyTool, "MultipleChoiceGame", journal, plot);
                         }
                     }
 
                     break;
                 }
                 case MATCHING_GAME: {
-                    int score = studyTool.matchingGame(terms, defs);
-                    sessions.push_back({"MatchingGame", score});
+                    if (streaming) {
+                        cout << "The matching game needs the whole deck in memory, so it cannot be played with "
+                             << "--stream." << endl;
+                        break;
+                    }
+                    int score = studyTool.matchingGame();
+                    recordSession(journal, stats, studyTool, deckId, "MatchingGame", score);
                     matchGamesPlayed ++;
 
                     if (matchGamesPlayed >= 2) {
                         string graphInput;
-                        cout << "Do you want a breakdown of your matching game scores in a python plotted graph? [enter 'y' for yes or 'n' for no]" << endl;
+                        cout << "Do you want a breakdown of your matching game scores? [enter 'y' for yes or 'n' for no]" << endl;
                         getline(cin, graphInput);
 
                         while (graphInput != "y" && graphInput != "n") {
-                            cout << "Invalid input. Do you want a breakdown of your matching game scores in a python plotted graph? [enter 'y' for yes or 'n' for no]" << endl;
+                            cout << "Invalid input. Do you want a breakdown of your matching game scores? [enter 'y' for yes or 'n' for no]" << endl;
                             getline(cin, graphInput);
                         }
 
                         if (graphInput == "y") {
-                            writeToCSV(sessions);
-                            system("python3 ../plots.py");
+                            showBreakdown(stats, studyTool, "MatchingGame", journal, plot);
                         }
                     }
 
@@ -194,23 +862,23 @@ int main() {
                     int timeLimit;
                     cout << "Enter the time limit for the challenge in seconds: ";
                     cin >> timeLimit;
-                    int score = studyTool.timeChallenge(terms, defs, timeLimit);
-                    sessions.push_back({"TimeChallenge", score});
+                    cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                    int score = studyTool.timeChallenge(timeLimit);
+                    recordSession(journal, stats, studyTool, deckId, "TimeChallenge", score);
                     timedGamesPlayed ++;
 
                     if (timedGamesPlayed >= 2) {
                         string graphInput;
-                        cout << "Do you want a breakdown of your time challenge game scores in a python plotted graph? [enter 'y' for yes or 'n' for no]" << endl;
+                        cout << "Do you want a breakdown of your time challenge game scores? [enter 'y' for yes or 'n' for no]" << endl;
                         getline(cin, graphInput);
 
                         while (graphInput != "y" && graphInput != "n") {
-                            cout << "Invalid input. Do you want a breakdown of your time challenge game scores in a python plotted graph? [enter 'y' for yes or 'n' for no]" << endl;
+                            cout << "Invalid input. Do you want a breakdown of your time challenge game scores? [enter 'y' for yes or 'n' for no]" << endl;
                             getline(cin, graphInput);
                         }
 
                         if (graphInput == "y") {
-                            writeToCSV(sessions);
-                            system("python3 ../plots.py");
+                            showBreakdown(stats, studyTool, "TimeChallenge", journal, plot);
                         }
                     }
 
@@ -220,6 +888,18 @@ int main() {
                     break;
             }
 
+            if (streaming && latency) {
+                cout << "Read " << deckStream.chunkCount() << " chunks, at most "
+                     << deckStream.peakMemory() / 1048576.0 << " MiB at once; waited for the disk "
+                     << deckStream.stallCount() << " times (" << deckStream.stallTimeNanos() / 1e6 << " ms)"
+                     << endl;
+            }
+
+            string telemetryError;
+            if (!telemetryPath.empty()
+                && !telemetry.writeSnapshot(telemetryPath, studyTool.getCards(), telemetryError)) {
+                cerr << "Warning: " << telemetryError << endl;
+            }
         } else {
             cout << "The value that you entered was invalid. Click enter to try again." << endl;
             cin.ignore();
@@ -0,0 +1,169 @@
+/**
+ * mappedfile.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for MappedFile (POSIX mmap).
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "mappedfile.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+MappedFile::MappedFile() : base(nullptr), length(0) {}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept : base(other.base), length(other.length) {
+    other.base = nullptr;
+    other.length = 0;
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        base = other.base;
+        length = other.length;
+        other.base = nullptr;
+        other.length = 0;
+    }
+    return *this;
+}
+
+/**
+ * Maps a whole file into memory
+ * Inputs:
+ *   - const string& path: File to map.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - bool copyOnWrite: Map the pages private and writable.
+ * Returns:
+ *   - bool: True if the file was mapped.
+ */
+bool MappedFile::open(const string& path, string& error, bool copyOnWrite) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = "Unable to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = "Unable to stat " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    // mmap refuses zero-length mappings, so an empty file is simply an empty range
+    if (info.st_size == 0) {
+        ::close(fd);
+        static char empty = '\0';
+        base = &empty;
+        length = 0;
+        return true;
+    }
+
+    int prot = copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+    void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), prot, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        error = "Unable to map " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    // Decks are parsed front to back exactly once
+    madvise(mapping, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+    base = static_cast<char*>(mapping);
+    length = static_cast<size_t>(info.st_size);
+    return true;
+}
+
+/**
+ * Maps a file shared and writable, creating or growing it first
+ * Inputs:
+ *   - const string& path: File to map; created if missing.
+ *   - size_t minimumSize: The file is extended with zero bytes to at least this size.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: True if the file was mapped.
+ */
+bool MappedFile::openShared(const string& path, size_t minimumSize, string& error) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        error = "Unable to open " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        error = "Unable to stat " + path + ": " + strerror(errno);
+        ::close(fd);
+        return false;
+    }
+
+    size_t size = static_cast<size_t>(info.st_size);
+    if (size < minimumSize) {
+        // The new tail reads as zeros and takes no disk space until it is written
+        if (ftruncate(fd, static_cast<off_t>(minimumSize)) != 0) {
+            error = "Unable to grow " + path + ": " + strerror(errno);
+            ::close(fd);
+            return false;
+        }
+        size = minimumSize;
+    }
+    if (size == 0) {
+        error = "Unable to map " + path + ": file is empty";
+        ::close(fd);
+        return false;
+    }
+
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        error = "Unable to map " + path + ": " + strerror(errno);
+        return false;
+    }
+
+    // State files are touched a few records at a time, wherever the cards being studied live
+    madvise(mapping, size, MADV_RANDOM);
+
+    base = static_cast<char*>(mapping);
+    length = size;
+    return true;
+}
+
+/**
+ * Flushes a shared mapping's dirty pages to disk
+ */
+bool MappedFile::sync(string& error) {
+    if (base != nullptr && length > 0 && msync(base, length, MS_SYNC) != 0) {
+        error = string("Unable to sync mapping: ") + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Unmaps the file. Safe to call on an unmapped object.
+ */
+void MappedFile::close() {
+    if (base != nullptr && length > 0) {
+        munmap(base, length);
+    }
+    base = nullptr;
+    length = 0;
+}
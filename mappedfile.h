@@ -0,0 +1,73 @@
+/**
+ * mappedfile.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for MappedFile, a small owner of a read-only (or copy-on-write) memory mapping.
+ * Used by the deck loaders so large decks can be parsed in place without reading them into a buffer first,
+ * and (shared and writable) by state files that are updated in place.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_MAPPEDFILE_H
+#define M2AP_MAPPEDFILE_H
+#include <cstddef>
+#include <string>
+using namespace std;
+
+class MappedFile {
+private:
+    char* base;
+    size_t length;
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * Maps a whole file into memory
+     * Inputs:
+     *   - const string& path: File to map.
+     *   - string& error: Receives a description of the failure, if any.
+     *   - bool copyOnWrite: Map the pages private and writable so callers may edit them in place.
+     *     Edits never reach the file on disk.
+     * Returns:
+     *   - bool: True if the file was mapped (an empty file maps to an empty range).
+     */
+    bool open(const string& path, string& error, bool copyOnWrite = false);
+
+    /**
+     * Maps a file shared and writable, creating or growing it first
+     * Inputs:
+     *   - const string& path: File to map; created if missing.
+     *   - size_t minimumSize: The file is extended with zero bytes to at least this size.
+     *   - string& error: Receives a description of the failure, if any.
+     * Returns:
+     *   - bool: True if the file was mapped. Writes to the mapping reach the file.
+     */
+    bool openShared(const string& path, size_t minimumSize, string& error);
+
+    /**
+     * Flushes a shared mapping's dirty pages to disk
+     * Inputs:
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool sync(string& error);
+
+    /**
+     * Unmaps the file. Safe to call on an unmapped object.
+     */
+    void close();
+
+    const char* data() const { return base; }
+    char* mutableData() { return base; }
+    size_t size() const { return length; }
+    bool isOpen() const { return base != nullptr; }
+};
+
+#endif // M2AP_MAPPEDFILE_H
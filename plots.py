@@ -1,16 +1,40 @@
-import pandas as pd
+import json
+import os
+import sys
+
 import matplotlib.pyplot as plt
 
-frame = pd.read_csv('../game_sessions.csv')
 
-fig, ax = plt.subplots(figsize=(10, 6))
+def summary_path():
+    # Same lookup as SessionJournal::dataDirectory() in sessionlog.cpp
+    if len(sys.argv) > 1:
+        return sys.argv[1]
+    if os.environ.get('STUDYTOOL_HOME'):
+        directory = os.environ['STUDYTOOL_HOME']
+    elif os.environ.get('XDG_DATA_HOME'):
+        directory = os.path.join(os.environ['XDG_DATA_HOME'], 'cppstudytool')
+    else:
+        directory = os.path.join(os.path.expanduser('~'), '.local', 'share', 'cppstudytool')
+    return os.path.join(directory, 'summary.json')
+
+
+# summary.json is pre-aggregated by SessionStats, so nothing here grows with the history
+with open(summary_path()) as summary_file:
+    modes = json.load(summary_file)['modes']
 
-session_numbers = range(1, len(frame) + 1)
-ax.bar(session_numbers, frame['NumCorrectAnswers'], color='skyblue')
+fig, axes = plt.subplots(1, max(len(modes), 1), figsize=(10, 6), squeeze=False)
 
-ax.set_xlabel('Games Played')
-ax.set_ylabel('Score')
-ax.set_title('Scores vs. Games Played')
+for ax, (mode, summary) in zip(axes[0], modes.items()):
+    recent = summary['recent']
+    first_game = summary['count'] - len(recent) + 1
+    session_numbers = range(first_game, first_game + len(recent))
+    ax.bar(session_numbers, recent, color='skyblue')
+    ax.axhline(summary['mean'], color='gray', linestyle='--', label='mean of all %d games' % summary['count'])
+    ax.set_xlabel('Games Played')
+    ax.set_ylabel('Score')
+    ax.set_title(mode)
+    ax.legend()
 
+fig.suptitle('Scores vs. Games Played')
 plt.tight_layout()
 plt.show()
\ No newline at end of file
@@ -0,0 +1,181 @@
+/**
+ * replay.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for scripted replays. The log is mapped rather than read, and answers are handed
+ * to the rounds as views into the mapping, so a replay does no per-answer allocation of its own.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "replay.h"
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include "mappedfile.h"
+using namespace std;
+
+bool ScriptedInput::nextLine(string_view& line) {
+    if (position >= end) {
+        return false;
+    }
+    const char* newline = static_cast<const char*>(memchr(position, '\n', end - position));
+    const char* lineEnd = newline ? newline : end;
+    line = string_view(position, lineEnd - position);
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+    position = newline ? newline + 1 : end;
+    return true;
+}
+
+bool ScriptedInput::atDirective() const {
+    return position >= end || (end - position >= 2 && position[0] == '#' && position[1] == '!');
+}
+
+bool ScriptedInput::nextAnswer(string_view& answer) {
+    if (atDirective()) {
+        return false;
+    }
+    nextLine(answer);
+    ++consumed;
+    return true;
+}
+
+/**
+ * Trims spaces from both ends
+ */
+static string_view trimSpaces(string_view text) {
+    while (!text.empty() && text.front() == ' ') {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+/**
+ * Parses a "#!" line
+ * Returns:
+ *   - bool: False if the line is not a directive.
+ */
+bool parseDirective(string_view line, Directive& directive) {
+    if (line.size() < 2 || line[0] != '#' || line[1] != '!') {
+        return false;
+    }
+    string_view rest = trimSpaces(line.substr(2));
+    directive.word = rest.substr(0, rest.find(' '));
+    directive.argument = trimSpaces(rest.substr(directive.word.size()));
+    directive.startsRound = false;
+    directive.round = RoundKind::FLASHCARDS;
+    directive.reseeds = false;
+    directive.timeLimit = 0;
+    directive.seed = 0;
+
+    uint64_t value = 0;
+    auto parsed = from_chars(directive.argument.data(), directive.argument.data() + directive.argument.size(), value);
+    bool numeric = !directive.argument.empty() && parsed.ec == errc()
+                   && parsed.ptr == directive.argument.data() + directive.argument.size();
+
+    if (directive.argument.empty() && (directive.word == "flip" || directive.word == "mult"
+                                       || directive.word == "match")) {
+        directive.startsRound = true;
+        directive.round = directive.word == "flip"   ? RoundKind::FLASHCARDS
+                          : directive.word == "mult" ? RoundKind::MULTIPLE_CHOICE
+                                                     : RoundKind::MATCHING;
+    } else if (directive.word == "timed" && numeric && value <= INT32_MAX) {
+        directive.startsRound = true;
+        directive.round = RoundKind::TIMED;
+        directive.timeLimit = static_cast<int>(value);
+    } else if (directive.word == "seed" && numeric) {
+        directive.reseeds = true;
+        directive.seed = value;
+    }
+    return true;
+}
+
+/**
+ * Plays an answers log
+ * Inputs:
+ *   - StudyTool& studyTool: Deck and settings to play with.
+ *   - const string& path: The answers log.
+ *   - ReplayReport& report: Receives each round's result and the totals.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: False if the log cannot be read or has a malformed directive.
+ */
+bool replayAnswers(StudyTool& studyTool, const string& path, ReplayReport& report, string& error) {
+    report = ReplayReport{{}, 0, 0, 0.0, 1469598103934665603ULL};
+
+    MappedFile log;
+    if (!log.open(path, error)) {
+        return false;
+    }
+
+    ScriptedInput input(log.data(), log.data() + log.size());
+    NullRenderer output;
+    size_t lineNumber = 0;
+    string_view line;
+    auto start = chrono::steady_clock::now();
+
+    while (true) {
+        // Anything that is not a directive here is left over from the last round
+        while (!input.atDirective()) {
+            input.nextLine(line);
+            ++lineNumber;
+            ++report.skippedLines;
+        }
+        if (!input.nextLine(line)) {
+            break;
+        }
+        ++lineNumber;
+
+        Directive directive;
+        parseDirective(line, directive);
+        if (directive.reseeds) {
+            studyTool.setSeed(directive.seed);
+            continue;
+        }
+        if (directive.word == "search") {
+            // A search that matches nothing leaves the next rounds empty rather than stopping the replay
+            vector<CardId> found;
+            if (directive.argument.empty()) {
+                studyTool.clearFilter();
+            } else if (studyTool.findCards(directive.argument, found, error)) {
+                studyTool.setFilter(std::move(found));
+            } else {
+                error = path + ":" + to_string(lineNumber) + ": " + error;
+                return false;
+            }
+            continue;
+        }
+        if (!directive.startsRound) {
+            error = path + ":" + to_string(lineNumber) + ": unknown directive \"" + string(line) + "\"";
+            return false;
+        }
+        unique_ptr<GameRound> round = studyTool.newRound(directive.round, directive.timeLimit);
+
+        size_t before = input.answersConsumed();
+        int score = studyTool.play(*round, input, output);
+        size_t answers = input.answersConsumed() - before;
+        lineNumber += answers;
+
+        const vector<CardOutcome>& outcomes = studyTool.getLastOutcomes();
+        report.rounds.push_back({round->name(), score, outcomes.size(), answers, round->finished()});
+        report.answers += answers;
+
+        // FNV-1a over the round's results, so two replays of one log can be compared at a glance
+        auto mix = [&report](uint64_t value) {
+            report.checksum = (report.checksum ^ value) * 1099511628211ULL;
+        };
+        mix(static_cast<uint64_t>(score));
+        for (const CardOutcome& outcome : outcomes) {
+            mix((static_cast<uint64_t>(outcome.card) << 1) | (outcome.correct ? 1 : 0));
+        }
+    }
+
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return true;
+}
@@ -0,0 +1,111 @@
+/**
+ * replay.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for scripted replays: an answers log is played through the game rounds with a NullRenderer,
+ * as fast as the engine goes, to measure throughput and to check that a seed and a script always give
+ * the same scores.
+ *
+ * Log format, one entry per line:
+ *   #! flip | #! mult | #! match | #! timed <seconds>   Starts a round of that mode.
+ *   #! seed <n>                                          Reseeds the game modes (as --seed does).
+ *   #! search [query]                                    Plays only the matching cards (as --search does);
+ *                                                        without a query, every card again.
+ *   anything else                                        The next answer in the current round.
+ * A directive that arrives before the current round has finished abandons it. Answers left over after a
+ * round finishes, or before the first round, are skipped and counted.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_REPLAY_H
+#define M2AP_REPLAY_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "gameio.h"
+#include "studytool.h"
+using namespace std;
+
+struct ReplayRound {
+    string gameMode;
+    int score;
+    size_t questions;       // Questions answered
+    size_t answers;         // Lines pushed into the round, including re-asked ones
+    bool finished;
+};
+
+struct ReplayReport {
+    vector<ReplayRound> rounds;
+    size_t answers;
+    size_t skippedLines;
+    double seconds;         // Time spent in the rounds, not counting the file mapping
+    uint64_t checksum;      // Mix of every round's score and per-card results
+};
+
+struct Directive {
+    string_view word;           // First word after "#!", e.g. "timed"
+    string_view argument;       // Rest of the line, trimmed
+    bool startsRound;           // A well-formed flip, mult, match or timed directive
+    RoundKind round;
+    int timeLimit;
+    bool reseeds;               // A well-formed seed directive
+    uint64_t seed;
+};
+
+/**
+ * Parses a "#!" line
+ * Inputs:
+ *   - string_view line: One line of a log (or of a server connection).
+ *   - Directive& directive: Receives the parsed directive. Words other than the round and seed directives
+ *     are left to the caller, with neither startsRound nor reseeds set.
+ * Returns:
+ *   - bool: False if the line is not a directive at all.
+ */
+bool parseDirective(string_view line, Directive& directive);
+
+// Answers from an in-memory log; stops at the next directive line
+class ScriptedInput : public AnswerProvider {
+private:
+    const char* position;
+    const char* end;
+    size_t consumed;
+
+public:
+    ScriptedInput(const char* begin, const char* finish) : position(begin), end(finish), consumed(0) {}
+
+    bool nextAnswer(string_view& answer) override;
+
+    /**
+     * Reads the next line whatever it is
+     * Inputs:
+     *   - string_view& line: Receives the line without its newline (or carriage return).
+     * Returns:
+     *   - bool: False at the end of the log.
+     */
+    bool nextLine(string_view& line);
+
+    /**
+     * Returns:
+     *   - bool: True if the next line is a directive or the log has ended.
+     */
+    bool atDirective() const;
+
+    size_t answersConsumed() const { return consumed; }
+};
+
+/**
+ * Plays an answers log
+ * Inputs:
+ *   - StudyTool& studyTool: Deck and settings to play with; its seed is changed by "#! seed" lines.
+ *   - const string& path: The answers log.
+ *   - ReplayReport& report: Receives each round's result and the totals.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: False if the log cannot be read or has a malformed directive.
+ */
+bool replayAnswers(StudyTool& studyTool, const string& path, ReplayReport& report, string& error);
+
+#endif // M2AP_REPLAY_H
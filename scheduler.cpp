@@ -0,0 +1,334 @@
+/**
+ * scheduler.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for ReviewScheduler.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+using namespace std;
+
+namespace {
+
+const char SCHEDULE_MAGIC[8] = {'S', 'T', 'S', 'C', 'H', 'E', 'D', '\n'};
+const uint32_t SCHEDULE_VERSION = 1;
+
+const uint32_t MINUTES_PER_DAY = 24 * 60;
+const uint32_t RELEARN_MINUTES = 10;
+const uint32_t MAX_INTERVAL = 100 * 365 * MINUTES_PER_DAY;
+const uint16_t DEFAULT_EASE = 2500;
+const uint16_t MIN_EASE = 1300;
+
+} // namespace
+
+// File layout: header, then capacity heap entries, then capacity card records
+struct ReviewScheduler::FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t clean;        // 1 once close() has written everything back; 0 while open
+    uint64_t capacity;     // Card records the file has room for
+    uint64_t cardCount;
+    uint64_t heapSize;     // Cards under review (every card studied at least once)
+    uint64_t newCursor;    // Lowest card id that has never been studied
+    uint64_t reviews;      // Total reviews recorded, for statistics
+};
+
+ReviewScheduler::ReviewScheduler() : header(nullptr), heap(nullptr), schedules(nullptr) {}
+
+ReviewScheduler::~ReviewScheduler() {
+    close();
+}
+
+/**
+ * Maps the file with room for capacity cards
+ */
+bool ReviewScheduler::map(size_t capacity, string& error) {
+    size_t size = sizeof(FileHeader) + capacity * (sizeof(HeapEntry) + sizeof(CardSchedule));
+    if (!file.openShared(filePath, size, error)) {
+        return false;
+    }
+    bindPointers();
+    return true;
+}
+
+void ReviewScheduler::bindPointers() {
+    header = reinterpret_cast<FileHeader*>(file.mutableData());
+    heap = reinterpret_cast<HeapEntry*>(file.mutableData() + sizeof(FileHeader));
+    schedules = reinterpret_cast<CardSchedule*>(file.mutableData() + sizeof(FileHeader)
+                                                + header->capacity * sizeof(HeapEntry));
+}
+
+/**
+ * Opens (or creates) a schedule file
+ * Inputs:
+ *   - const string& path: Schedule file.
+ *   - size_t cardCount: Cards in the deck.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: True if the schedule is ready.
+ */
+bool ReviewScheduler::open(const string& path, size_t cardCount, string& error) {
+    close();
+    filePath = path;
+
+    if (cardCount >= UINT32_MAX) {
+        error = "Too many cards to schedule";
+        return false;
+    }
+    if (!file.openShared(filePath, sizeof(FileHeader), error)) {
+        return false;
+    }
+    header = reinterpret_cast<FileHeader*>(file.mutableData());
+
+    static const char noMagic[8] = {};
+    if (memcmp(header->magic, noMagic, sizeof(noMagic)) == 0 && header->capacity == 0) {
+        // A new file: only the header exists, and it is all zeros
+        memcpy(header->magic, SCHEDULE_MAGIC, sizeof(header->magic));
+        header->version = SCHEDULE_VERSION;
+        header->clean = 1;
+    } else if (memcmp(header->magic, SCHEDULE_MAGIC, sizeof(header->magic)) != 0) {
+        error = path + " is not a schedule file";
+        file.close();
+        header = nullptr;
+        return false;
+    } else if (header->version != SCHEDULE_VERSION) {
+        error = path + " was written by an incompatible version";
+        file.close();
+        header = nullptr;
+        return false;
+    }
+
+    size_t expected = sizeof(FileHeader) + header->capacity * (sizeof(HeapEntry) + sizeof(CardSchedule));
+    if (file.size() < expected || header->heapSize > header->capacity || header->cardCount > header->capacity) {
+        error = path + " is truncated";
+        file.close();
+        header = nullptr;
+        return false;
+    }
+    bindPointers();
+
+    if (cardCount > header->capacity && !grow(cardCount, error)) {
+        close();
+        return false;
+    }
+
+    bool rebuild = header->clean == 0;
+    if (cardCount < header->cardCount) {
+        // Cards past the end of the shortened deck are gone; forget them
+        memset(static_cast<void*>(schedules + cardCount), 0,
+               (header->cardCount - cardCount) * sizeof(CardSchedule));
+        rebuild = true;
+    }
+    header->cardCount = cardCount;
+    if (rebuild) {
+        rebuildHeap();
+    }
+
+    header->clean = 0;
+    return true;
+}
+
+/**
+ * Makes room for more cards by moving the card records up past a larger heap
+ */
+bool ReviewScheduler::grow(size_t cardCount, string& error) {
+    size_t oldCapacity = static_cast<size_t>(header->capacity);
+    size_t newCapacity = max(cardCount, oldCapacity + oldCapacity / 2);
+
+    // Remap at the new size, then slide the records; the freshly added tail of the file is already zero
+    header->clean = 0;
+    if (!map(newCapacity, error)) {
+        return false;
+    }
+    char* base = file.mutableData() + sizeof(FileHeader);
+    memmove(base + newCapacity * sizeof(HeapEntry), base + oldCapacity * sizeof(HeapEntry),
+            oldCapacity * sizeof(CardSchedule));
+    header->capacity = newCapacity;
+    bindPointers();
+    return true;
+}
+
+/**
+ * Rebuilds the heap and the new-card cursor from the card records (after a crash or a shortened deck)
+ */
+void ReviewScheduler::rebuildHeap() {
+    uint32_t size = 0;
+    header->newCursor = header->cardCount;
+    for (CardId card = 0; card < header->cardCount; ++card) {
+        CardSchedule& schedule = schedules[card];
+        if (schedule.due == 0) {
+            schedule.heapSlot = 0;
+            header->newCursor = min<uint64_t>(header->newCursor, card);
+        } else {
+            heap[size] = HeapEntry{schedule.due, card};
+            schedule.heapSlot = ++size;
+        }
+    }
+    header->heapSize = size;
+    for (uint32_t slot = size / 2; slot-- > 0;) {
+        siftDown(slot);
+    }
+}
+
+/**
+ * Marks the file clean and writes it back
+ */
+void ReviewScheduler::close() {
+    if (header != nullptr) {
+        header->clean = 1;
+        string error;
+        file.sync(error);
+    }
+    file.close();
+    header = nullptr;
+    heap = nullptr;
+    schedules = nullptr;
+}
+
+bool ReviewScheduler::heapLess(uint32_t a, uint32_t b) const {
+    return heap[a].due < heap[b].due || (heap[a].due == heap[b].due && heap[a].card < heap[b].card);
+}
+
+void ReviewScheduler::place(uint32_t slot, const HeapEntry& entry) {
+    heap[slot] = entry;
+    schedules[entry.card].heapSlot = slot + 1;
+}
+
+void ReviewScheduler::siftUp(uint32_t slot) {
+    while (slot > 0) {
+        uint32_t parent = (slot - 1) / 2;
+        if (!heapLess(slot, parent)) {
+            break;
+        }
+        HeapEntry moved = heap[parent];
+        place(parent, heap[slot]);
+        place(slot, moved);
+        slot = parent;
+    }
+}
+
+void ReviewScheduler::siftDown(uint32_t slot) {
+    uint32_t size = static_cast<uint32_t>(header->heapSize);
+    while (true) {
+        uint32_t smallest = slot;
+        uint32_t left = 2 * slot + 1;
+        uint32_t right = left + 1;
+        if (left < size && heapLess(left, smallest)) {
+            smallest = left;
+        }
+        if (right < size && heapLess(right, smallest)) {
+            smallest = right;
+        }
+        if (smallest == slot) {
+            break;
+        }
+        HeapEntry moved = heap[smallest];
+        place(smallest, heap[slot]);
+        place(slot, moved);
+        slot = smallest;
+    }
+}
+
+/**
+ * Picks the card to study next
+ * Inputs:
+ *   - uint32_t now: Current time in minutes since the epoch.
+ *   - bool allowNew: Whether a never-studied card may be returned when nothing is due.
+ * Returns:
+ *   - CardId: The most overdue card, else the next new card, else NO_CARD.
+ */
+CardId ReviewScheduler::nextCard(uint32_t now, bool allowNew) const {
+    if (header->heapSize > 0 && heap[0].due <= now) {
+        return heap[0].card;
+    }
+    if (allowNew && header->newCursor < header->cardCount) {
+        return static_cast<CardId>(header->newCursor);
+    }
+    return NO_CARD;
+}
+
+/**
+ * Records a review and reschedules the card (SM-2)
+ * Inputs:
+ *   - CardId card: Card that was studied.
+ *   - Rating rating: How well it was recalled.
+ *   - uint32_t now: Current time in minutes since the epoch.
+ */
+void ReviewScheduler::review(CardId card, Rating rating, uint32_t now) {
+    CardSchedule& schedule = schedules[card];
+    if (schedule.ease == 0) {
+        schedule.ease = DEFAULT_EASE;
+    }
+
+    // SM-2 ease update, with the four ratings standing for response qualities 1, 3, 4 and 5
+    int quality = rating == AGAIN ? 1 : rating + 1;
+    int miss = 5 - quality;
+    int ease = schedule.ease + 100 - miss * (80 + miss * 20);
+    schedule.ease = static_cast<uint16_t>(min(max(ease, static_cast<int>(MIN_EASE)), 65535));
+
+    double interval;
+    if (rating == AGAIN) {
+        schedule.repetitions = 0;
+        interval = RELEARN_MINUTES;
+    } else {
+        if (schedule.repetitions < UINT16_MAX) {
+            ++schedule.repetitions;
+        }
+        if (schedule.repetitions == 1) {
+            interval = rating == EASY ? 4.0 * MINUTES_PER_DAY : MINUTES_PER_DAY;
+        } else if (schedule.repetitions == 2) {
+            interval = rating == EASY ? 8.0 * MINUTES_PER_DAY : 6.0 * MINUTES_PER_DAY;
+        } else if (rating == HARD) {
+            interval = schedule.interval * 1.2;
+        } else {
+            interval = schedule.interval * (schedule.ease / 1000.0) * (rating == EASY ? 1.3 : 1.0);
+        }
+    }
+    schedule.interval = static_cast<uint32_t>(min(interval, static_cast<double>(MAX_INTERVAL)));
+    schedule.due = now + min(schedule.interval, UINT32_MAX - now);
+    ++header->reviews;
+
+    if (schedule.heapSlot == 0) {
+        uint32_t slot = static_cast<uint32_t>(header->heapSize++);
+        place(slot, HeapEntry{schedule.due, card});
+        siftUp(slot);
+        while (header->newCursor < header->cardCount && schedules[header->newCursor].heapSlot != 0) {
+            ++header->newCursor;
+        }
+    } else {
+        uint32_t slot = schedule.heapSlot - 1;
+        heap[slot].due = schedule.due;
+        siftUp(slot);
+        siftDown(schedule.heapSlot - 1);
+    }
+}
+
+/**
+ * Returns:
+ *   - uint32_t: Due time of the earliest card under review, or UINT32_MAX if none are.
+ */
+uint32_t ReviewScheduler::nextDueTime() const {
+    return header->heapSize > 0 ? heap[0].due : UINT32_MAX;
+}
+
+size_t ReviewScheduler::cardCount() const {
+    return static_cast<size_t>(header->cardCount);
+}
+
+size_t ReviewScheduler::studiedCount() const {
+    return static_cast<size_t>(header->heapSize);
+}
+
+/**
+ * Returns:
+ *   - uint32_t: The current time in minutes since the epoch.
+ */
+uint32_t ReviewScheduler::currentMinute() {
+    auto minutes = chrono::duration_cast<chrono::minutes>(chrono::system_clock::now().time_since_epoch());
+    return static_cast<uint32_t>(minutes.count());
+}
@@ -0,0 +1,132 @@
+/**
+ * scheduler.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for ReviewScheduler, the spaced-repetition engine behind flashcard practice.
+ * Each card keeps SM-2 state (ease, interval, due time) in a fixed 16-byte record, and cards waiting for
+ * review sit in a binary min-heap ordered by due time, so the next card comes off the top and a review
+ * re-queues its card in O(log n). Records and heap live in a memory-mapped file next to the deck
+ * (<deck>.sched): opening it touches only the header, and only the pages of cards actually reviewed are
+ * ever read. Cards never studied cost nothing; they are introduced in deck order from a cursor.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SCHEDULER_H
+#define M2AP_SCHEDULER_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "cardindex.h"
+#include "mappedfile.h"
+using namespace std;
+
+struct CardSchedule {
+    uint32_t due;          // Minutes since the Unix epoch
+    uint32_t interval;     // Minutes until the next review after the last one
+    uint32_t heapSlot;     // Position in the review heap plus one; 0 if the card has never been studied
+    uint16_t ease;         // SM-2 ease factor in thousandths (2500 = 2.5)
+    uint16_t repetitions;  // Successful reviews in a row
+};
+
+class ReviewScheduler {
+public:
+    enum Rating { AGAIN = 1, HARD = 2, GOOD = 3, EASY = 4 };
+
+private:
+    struct FileHeader;
+    struct HeapEntry {
+        uint32_t due;
+        CardId card;
+    };
+
+    MappedFile file;
+    string filePath;
+    FileHeader* header;
+    HeapEntry* heap;
+    CardSchedule* schedules;
+
+    bool map(size_t capacity, string& error);
+    void bindPointers();
+    bool grow(size_t cardCount, string& error);
+    void rebuildHeap();
+
+    bool heapLess(uint32_t a, uint32_t b) const;
+    void place(uint32_t slot, const HeapEntry& entry);
+    void siftUp(uint32_t slot);
+    void siftDown(uint32_t slot);
+
+public:
+    ReviewScheduler();
+    ~ReviewScheduler();
+
+    ReviewScheduler(const ReviewScheduler&) = delete;
+    ReviewScheduler& operator=(const ReviewScheduler&) = delete;
+
+    /**
+     * Opens (or creates) a schedule file
+     * Inputs:
+     *   - const string& path: Schedule file, normally the deck's path plus ".sched".
+     *   - size_t cardCount: Cards in the deck. Schedules follow card positions; cards added to the end of
+     *     the deck start out new, and schedules past the end of a shortened deck are dropped.
+     *   - string& error: Receives a description of the failure, if any.
+     * Returns:
+     *   - bool: True if the schedule is ready.
+     * Description:
+     *   - Reads only the header, unless the file was not closed cleanly last time; then the heap is rebuilt
+     *     from the card records so an interrupted write cannot leave it inconsistent.
+     */
+    bool open(const string& path, size_t cardCount, string& error);
+
+    /**
+     * Marks the file clean and writes it back. Also done by the destructor.
+     */
+    void close();
+
+    /**
+     * Picks the card to study next
+     * Inputs:
+     *   - uint32_t now: Current time in minutes since the epoch.
+     *   - bool allowNew: Whether a never-studied card may be returned when nothing is due.
+     * Returns:
+     *   - CardId: The most overdue card, else the next new card, else NO_CARD.
+     */
+    CardId nextCard(uint32_t now, bool allowNew) const;
+
+    /**
+     * Records a review and reschedules the card (SM-2)
+     * Inputs:
+     *   - CardId card: Card that was studied.
+     *   - Rating rating: How well it was recalled.
+     *   - uint32_t now: Current time in minutes since the epoch.
+     * Description:
+     *   - AGAIN restarts the card ten minutes out and lowers its ease; HARD, GOOD and EASY grow the
+     *     interval (1 day, 6 days, then interval * ease) with HARD shrinking and EASY stretching it.
+     */
+    void review(CardId card, Rating rating, uint32_t now);
+
+    /**
+     * Returns:
+     *   - const CardSchedule&: Scheduling state of a card.
+     */
+    const CardSchedule& schedule(CardId card) const { return schedules[card]; }
+
+    /**
+     * Returns:
+     *   - uint32_t: Due time of the earliest card under review, or UINT32_MAX if none are.
+     */
+    uint32_t nextDueTime() const;
+
+    size_t cardCount() const;
+    size_t studiedCount() const;
+    size_t newCount() const { return cardCount() - studiedCount(); }
+    bool isOpen() const { return header != nullptr; }
+
+    /**
+     * Returns:
+     *   - uint32_t: The current time in minutes since the epoch.
+     */
+    static uint32_t currentMinute();
+};
+
+#endif // M2AP_SCHEDULER_H
@@ -0,0 +1,652 @@
+/**
+ * searchindex.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for SearchIndex.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "searchindex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+#include "textnorm.h"
+using namespace std;
+
+namespace {
+
+const uint32_t SKIP_INTERVAL = 128;     // Postings between skip table entries
+const uint32_t LINK_BYTES = 4;          // A full slice ends in the pool offset of the next one
+const uint32_t SLICE_SIZES[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+const uint8_t TOP_LEVEL = sizeof(SLICE_SIZES) / sizeof(SLICE_SIZES[0]) - 1;
+
+bool isWordByte(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || c >= 0x80;
+}
+
+// Calls emit with each word of normalized text: runs of letters, digits and non-ASCII characters
+template <typename Emit>
+void forEachWord(string_view text, Emit emit) {
+    size_t i = 0;
+    while (i < text.size()) {
+        while (i < text.size() && !isWordByte(static_cast<unsigned char>(text[i]))) {
+            ++i;
+        }
+        size_t start = i;
+        while (i < text.size() && isWordByte(static_cast<unsigned char>(text[i]))) {
+            ++i;
+        }
+        if (i > start) {
+            emit(text.substr(start, i - start));
+        }
+    }
+}
+
+// Sorts card ids and drops repeats; once they cover a good part of the deck, a bitmap beats sorting
+void sortUnique(vector<CardId>& ids, size_t cardCount) {
+    if (ids.size() < cardCount / 16) {
+        sort(ids.begin(), ids.end());
+        ids.erase(unique(ids.begin(), ids.end()), ids.end());
+        return;
+    }
+    vector<uint64_t> bits((cardCount + 63) / 64, 0);
+    for (CardId id : ids) {
+        bits[id >> 6] |= uint64_t{1} << (id & 63);
+    }
+    ids.clear();
+    for (size_t i = 0; i < bits.size(); ++i) {
+        for (uint64_t word = bits[i]; word != 0; word &= word - 1) {
+            ids.push_back(static_cast<CardId>(i * 64 + static_cast<size_t>(__builtin_ctzll(word))));
+        }
+    }
+}
+
+// Replaces sorted card ids with every other card of the deck
+void complement(vector<CardId>& ids, size_t cardCount) {
+    vector<CardId> rest;
+    rest.reserve(cardCount - ids.size());
+    size_t next = 0;
+    for (size_t card = 0; card < cardCount; ++card) {
+        if (next < ids.size() && ids[next] == card) {
+            ++next;
+        } else {
+            rest.push_back(static_cast<CardId>(card));
+        }
+    }
+    ids.swap(rest);
+}
+
+} // namespace
+
+// Part of a query: one posting list not decoded yet, or the cards it matched
+struct SearchIndex::Operand {
+    uint32_t word = NO_WORD;
+    vector<CardId> cards;       // Sorted; only used when word is NO_WORD
+    bool negated = false;       // Matches the cards the above does not
+
+    size_t estimate(const SearchIndex& index) const {
+        return word != NO_WORD ? index.lists[word].count : cards.size();
+    }
+};
+
+// Walks one posting list in card order
+class SearchIndex::Cursor {
+private:
+    const SearchIndex& index;
+    const Postings& list;
+    const vector<Skip>* skips;
+    uint32_t offset;
+    uint32_t sliceEnd;
+    uint8_t level;
+    uint32_t read;              // Postings decoded so far
+    CardId card;                // The last one decoded
+
+    uint8_t readByte() {
+        if (offset == sliceEnd) {
+            memcpy(&offset, index.pool.data() + sliceEnd, LINK_BYTES);
+            level = min<uint8_t>(level + 1, TOP_LEVEL);
+            sliceEnd = offset + SLICE_SIZES[level] - LINK_BYTES;
+        }
+        return index.pool[offset++];
+    }
+
+public:
+    Cursor(const SearchIndex& searchIndex, uint32_t word)
+            : index(searchIndex), list(searchIndex.lists[word]),
+              skips(list.skips != NO_SKIPS ? &searchIndex.skipTables[list.skips] : nullptr), offset(list.head),
+              sliceEnd(list.head + SLICE_SIZES[0] - LINK_BYTES), level(0), read(0), card(0) {}
+
+    /**
+     * Decodes the next posting
+     * Returns:
+     *   - bool: False at the end of the list.
+     */
+    bool next(CardId& out) {
+        if (read == list.count) {
+            return false;
+        }
+        uint32_t gap = 0;
+        for (uint32_t shift = 0;; shift += 7) {
+            uint8_t byte = readByte();
+            gap |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (byte < 0x80) {
+                break;
+            }
+        }
+        card += gap;
+        ++read;
+        out = card;
+        return true;
+    }
+
+    /**
+     * Moves to the first posting at or after a card, jumping through the skip table where it can
+     * Returns:
+     *   - bool: False if every posting left is before the card.
+     */
+    bool seek(CardId target, CardId& out) {
+        if (read > 0 && card >= target) {
+            out = card;
+            return true;
+        }
+        // Entry j leads to posting (j + 1) * SKIP_INTERVAL; only search the table if the next one helps
+        size_t ahead = read / SKIP_INTERVAL;
+        if (skips != nullptr && ahead < skips->size() && (*skips)[ahead].before < target) {
+            auto after = partition_point(skips->begin() + static_cast<ptrdiff_t>(ahead), skips->end(),
+                                         [target](const Skip& skip) { return skip.before < target; });
+            size_t entry = static_cast<size_t>(after - skips->begin());
+            const Skip& skip = (*skips)[entry - 1];
+            offset = skip.offset;
+            sliceEnd = skip.sliceEnd;
+            level = skip.level;
+            card = skip.before;
+            read = static_cast<uint32_t>(entry * SKIP_INTERVAL);
+        }
+        while (next(out)) {
+            if (out >= target) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Recursive descent over a query's words and parentheses
+class SearchIndex::Parser {
+private:
+    const SearchIndex& index;
+    vector<string_view> tokens;
+    size_t at;
+    string& error;
+
+    bool peekIs(string_view token) const { return at < tokens.size() && tokens[at] == token; }
+
+public:
+    Parser(const SearchIndex& searchIndex, string_view query, string& parseError)
+            : index(searchIndex), at(0), error(parseError) {
+        size_t i = 0;
+        while (i < query.size()) {
+            if (isspace(static_cast<unsigned char>(query[i]))) {
+                ++i;
+            } else if (query[i] == '(' || query[i] == ')') {
+                tokens.push_back(query.substr(i++, 1));
+            } else {
+                size_t start = i;
+                while (i < query.size() && !isspace(static_cast<unsigned char>(query[i])) && query[i] != '('
+                       && query[i] != ')') {
+                    ++i;
+                }
+                tokens.push_back(query.substr(start, i - start));
+            }
+        }
+    }
+
+    bool empty() const { return tokens.empty(); }
+    bool atEnd() const { return at == tokens.size(); }
+
+    // Alternatives: a OR b OR ...
+    bool parseAny(Operand& out) {
+        vector<Operand> operands(1);
+        if (!parseAll(operands[0])) {
+            return false;
+        }
+        while (peekIs("OR")) {
+            ++at;
+            operands.emplace_back();
+            if (!parseAll(operands.back())) {
+                return false;
+            }
+        }
+        index.unite(operands, out);
+        return true;
+    }
+
+    // Everything up to the next OR or ")" must match; AND between them is optional
+    bool parseAll(Operand& out) {
+        vector<Operand> operands;
+        while (at < tokens.size() && !peekIs(")") && !peekIs("OR")) {
+            if (peekIs("AND")) {
+                ++at;
+                continue;
+            }
+            operands.emplace_back();
+            if (!parseOne(operands.back())) {
+                return false;
+            }
+        }
+        if (operands.empty()) {
+            error = at < tokens.size() ? "Expected a word to search for before \"" + string(tokens[at]) + "\""
+                                       : "Expected a word to search for at the end";
+            return false;
+        }
+        index.intersect(operands, out);
+        return true;
+    }
+
+    // NOT a, -a, (a ...), a word or a prefix
+    bool parseOne(Operand& out) {
+        if (peekIs("NOT") || peekIs("-")) {
+            ++at;
+            if (at == tokens.size() || peekIs(")") || peekIs("OR")) {
+                error = "Expected something to leave out after \"" + string(tokens[at - 1]) + "\"";
+                return false;
+            }
+            if (!parseOne(out)) {
+                return false;
+            }
+            out.negated = !out.negated;
+            return true;
+        }
+        if (peekIs("(")) {
+            ++at;
+            if (!parseAny(out)) {
+                return false;
+            }
+            if (!peekIs(")")) {
+                error = "A \"(\" in the search is not closed";
+                return false;
+            }
+            ++at;
+            return true;
+        }
+
+        string_view text = tokens[at++];
+        bool negated = text.size() > 1 && text.front() == '-';
+        if (negated) {
+            text.remove_prefix(1);
+        }
+        bool prefix = text.size() > 1 && text.back() == '*';
+        if (prefix) {
+            text.remove_suffix(1);
+        }
+
+        // Punctuation splits a word as it does the cards' text, so "e-mail" must match "e" and "mail"
+        string normalized;
+        normalizeText(text, normalized);
+        vector<string_view> pieces;
+        forEachWord(normalized, [&pieces](string_view piece) { pieces.push_back(piece); });
+        if (pieces.empty()) {
+            error = "\"" + string(tokens[at - 1]) + "\" has no letters or digits to search for";
+            return false;
+        }
+        vector<Operand> parts(pieces.size());
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            index.matchWord(pieces[i], prefix && i + 1 == pieces.size(), parts[i]);
+        }
+        index.intersect(parts, out);
+        out.negated = negated;
+        return true;
+    }
+};
+
+SearchIndex::SearchIndex() : wordStarts(1, 0), cardCount(0), postings(0) {}
+
+// Linear probing; returns the slot holding this word, or the empty slot where it belongs
+size_t SearchIndex::findSlot(string_view text, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = static_cast<size_t>(hash) & mask;
+    uint32_t tag = static_cast<uint32_t>(hash >> 32);
+    while (slots[slot].word != NO_WORD) {
+        if (slots[slot].tag == tag && word(slots[slot].word) == text) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+uint32_t SearchIndex::findWord(string_view text) const {
+    if (slots.empty()) {
+        return NO_WORD;
+    }
+    return slots[findSlot(text, hashText(text))].word;
+}
+
+/**
+ * Returns:
+ *   - uint32_t: The word's id, adding it with an empty posting list if it is new.
+ */
+uint32_t SearchIndex::addWord(string_view text) {
+    if ((lists.size() + 1) * 2 > slots.size()) {
+        growSlots();
+    }
+    uint64_t hash = hashText(text);
+    size_t slot = findSlot(text, hash);
+    if (slots[slot].word != NO_WORD) {
+        return slots[slot].word;
+    }
+    if (wordText.size() + text.size() > UINT32_MAX) {
+        throw length_error("search index is limited to 4 GiB of words");
+    }
+
+    uint32_t id = static_cast<uint32_t>(lists.size());
+    slots[slot] = Slot{id, static_cast<uint32_t>(hash >> 32)};
+    wordText.append(text);
+    wordStarts.push_back(static_cast<uint32_t>(wordText.size()));
+    recentWords.push_back(id);
+
+    uint32_t start = newSlice(0);
+    lists.push_back(Postings{start, start + SLICE_SIZES[0] - LINK_BYTES, start, 0, 0, NO_SKIPS, 0});
+    return id;
+}
+
+// Doubles the word table, keeping it at most half full
+void SearchIndex::growSlots() {
+    slots.assign(max<size_t>(16, slots.size() * 2), Slot{NO_WORD, 0});
+    size_t mask = slots.size() - 1;
+    for (uint32_t id = 0; id < lists.size(); ++id) {
+        uint64_t hash = hashText(word(id));
+        size_t slot = static_cast<size_t>(hash) & mask;
+        while (slots[slot].word != NO_WORD) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = Slot{id, static_cast<uint32_t>(hash >> 32)};
+    }
+}
+
+uint32_t SearchIndex::newSlice(uint8_t level) {
+    size_t start = pool.size();
+    if (start + SLICE_SIZES[level] > UINT32_MAX) {
+        throw length_error("search index is limited to 4 GiB of postings");
+    }
+    pool.resize(start + SLICE_SIZES[level]);
+    return static_cast<uint32_t>(start);
+}
+
+// Appends a byte to a posting list, chaining a slice twice the size on when the current one is full
+void SearchIndex::writeByte(Postings& list, uint8_t byte) {
+    if (list.tail == list.sliceEnd) {
+        uint8_t level = min<uint8_t>(list.level + 1, TOP_LEVEL);
+        uint32_t start = newSlice(level);
+        memcpy(pool.data() + list.sliceEnd, &start, LINK_BYTES);
+        list.tail = start;
+        list.sliceEnd = start + SLICE_SIZES[level] - LINK_BYTES;
+        list.level = level;
+    }
+    pool[list.tail++] = byte;
+}
+
+/**
+ * Appends a card to a word's posting list as the gap from the card before it
+ * Description:
+ *   - A word that appears more than once on a card is listed once.
+ */
+void SearchIndex::addPosting(uint32_t id, CardId card) {
+    Postings& list = lists[id];
+    if (list.count > 0 && list.last == card) {
+        return;
+    }
+    if (list.count > 0 && list.count % SKIP_INTERVAL == 0) {
+        if (list.skips == NO_SKIPS) {
+            list.skips = static_cast<uint32_t>(skipTables.size());
+            skipTables.emplace_back();
+        }
+        skipTables[list.skips].push_back(Skip{list.last, list.tail, list.sliceEnd, list.level});
+    }
+
+    uint32_t gap = card - list.last;
+    while (gap >= 0x80) {
+        writeByte(list, static_cast<uint8_t>(gap | 0x80));
+        gap >>= 7;
+    }
+    writeByte(list, static_cast<uint8_t>(gap));
+    list.last = card;
+    ++list.count;
+    ++postings;
+}
+
+void SearchIndex::indexText(CardId card, string_view text) {
+    normalizeText(text, normalized);
+    forEachWord(normalized, [this, card](string_view piece) { addPosting(addWord(piece), card); });
+}
+
+void SearchIndex::indexCard(CardId card, string_view term, string_view def) {
+    if (card < cardCount) {
+        throw invalid_argument("cards must be added to the search index in order");
+    }
+    cardCount = static_cast<size_t>(card) + 1;
+    indexText(card, term);
+    indexText(card, def);
+}
+
+/**
+ * Puts words added to recentWords since first in order
+ * Description:
+ *   - New words are merged into the short recent list, and the recent list into sortedWords once it has
+ *     grown to about the square root of its size (or when asked to), so adding a word costs a merge of the
+ *     recent list rather than of every word.
+ */
+void SearchIndex::sortWordsFrom(size_t first, bool merge) {
+    auto byText = [this](uint32_t a, uint32_t b) { return word(a) < word(b); };
+    sort(recentWords.begin() + static_cast<ptrdiff_t>(first), recentWords.end(), byText);
+    inplace_merge(recentWords.begin(), recentWords.begin() + static_cast<ptrdiff_t>(first), recentWords.end(),
+                  byText);
+    if (merge || recentWords.size() * recentWords.size() > sortedWords.size() + 4096) {
+        size_t middle = sortedWords.size();
+        sortedWords.insert(sortedWords.end(), recentWords.begin(), recentWords.end());
+        inplace_merge(sortedWords.begin(), sortedWords.begin() + static_cast<ptrdiff_t>(middle), sortedWords.end(),
+                      byText);
+        recentWords.clear();
+    }
+}
+
+/**
+ * Indexes every card from scratch
+ * Inputs:
+ *   - const CardStore& cards: Cards to index.
+ */
+void SearchIndex::build(const CardStore& cards) {
+    pool.clear();
+    lists.clear();
+    skipTables.clear();
+    wordText.clear();
+    wordStarts.assign(1, 0);
+    sortedWords.clear();
+    recentWords.clear();
+    slots.clear();
+    cardCount = 0;
+    postings = 0;
+
+    pool.reserve(cards.textBytes() / 4);
+    for (CardId card = 0; card < cards.size(); ++card) {
+        indexCard(card, cards.term(card), cards.def(card));
+    }
+    cardCount = cards.size();
+    sortWordsFrom(0, true);
+}
+
+/**
+ * Indexes one more card
+ * Description:
+ *   - Only the card's new words have to be put in order (see sortWordsFrom).
+ */
+void SearchIndex::addCard(CardId card, string_view term, string_view def) {
+    size_t firstNew = recentWords.size();
+    indexCard(card, term, def);
+    sortWordsFrom(firstNew, false);
+}
+
+void SearchIndex::decode(uint32_t id, vector<CardId>& out) const {
+    out.clear();
+    out.reserve(lists[id].count);
+    Cursor cursor(*this, id);
+    CardId card = 0;
+    while (cursor.next(card)) {
+        out.push_back(card);
+    }
+}
+
+// Appends the words of a sorted list that start with a prefix
+void SearchIndex::matchPrefix(const vector<uint32_t>& words, string_view prefix, vector<uint32_t>& out) const {
+    auto it = lower_bound(words.begin(), words.end(), prefix,
+                          [this](uint32_t id, string_view value) { return word(id) < value; });
+    for (; it != words.end() && word(*it).substr(0, prefix.size()) == prefix; ++it) {
+        out.push_back(*it);
+    }
+}
+
+/**
+ * Looks up one normalized word of a query
+ * Description:
+ *   - A word, or a prefix only one word has, stays an undecoded posting list; a prefix of several words
+ *     is decoded into the union of their lists.
+ */
+void SearchIndex::matchWord(string_view text, bool prefix, Operand& out) const {
+    out = Operand();
+    if (!prefix) {
+        out.word = findWord(text);
+        return;
+    }
+
+    vector<uint32_t> matched;
+    matchPrefix(sortedWords, text, matched);
+    matchPrefix(recentWords, text, matched);
+    if (matched.size() == 1) {
+        out.word = matched[0];
+        return;
+    }
+    vector<CardId> cards;
+    for (uint32_t id : matched) {
+        decode(id, cards);
+        out.cards.insert(out.cards.end(), cards.begin(), cards.end());
+    }
+    sortUnique(out.cards, cardCount);
+}
+
+// Decodes an operand's cards and applies its negation
+void SearchIndex::materialize(Operand& operand) const {
+    if (operand.word != NO_WORD) {
+        decode(operand.word, operand.cards);
+        operand.word = NO_WORD;
+    }
+    if (operand.negated) {
+        complement(operand.cards, cardCount);
+        operand.negated = false;
+    }
+}
+
+/**
+ * Combines operands that must all match
+ * Description:
+ *   - Starts from the smallest one that must match and narrows it by the others in order of size. Undecoded
+ *     lists are never decoded in full: each remaining card is looked up with a cursor, skipping ahead.
+ *   - With only exclusions, the result is left negated so the deck is only listed if it has to be.
+ */
+void SearchIndex::intersect(vector<Operand>& operands, Operand& out) const {
+    if (operands.size() == 1) {
+        out = std::move(operands[0]);
+        return;
+    }
+    stable_sort(operands.begin(), operands.end(), [this](const Operand& a, const Operand& b) {
+        return a.negated != b.negated ? !a.negated : a.estimate(*this) < b.estimate(*this);
+    });
+    out = Operand();
+    if (operands[0].negated) {
+        for (Operand& operand : operands) {
+            operand.negated = false;
+        }
+        unite(operands, out);
+        out.negated = true;
+        return;
+    }
+
+    materialize(operands[0]);
+    out.cards = std::move(operands[0].cards);
+    vector<CardId> kept;
+    for (size_t i = 1; i < operands.size() && !out.cards.empty(); ++i) {
+        Operand& operand = operands[i];
+        kept.clear();
+        if (operand.word != NO_WORD) {
+            Cursor cursor(*this, operand.word);
+            CardId found = 0;
+            bool more = true;
+            for (CardId card : out.cards) {
+                if (more) {
+                    more = cursor.seek(card, found);
+                }
+                if ((more && found == card) != operand.negated) {
+                    kept.push_back(card);
+                }
+            }
+        } else if (operand.negated) {
+            set_difference(out.cards.begin(), out.cards.end(), operand.cards.begin(), operand.cards.end(),
+                           back_inserter(kept));
+        } else {
+            set_intersection(out.cards.begin(), out.cards.end(), operand.cards.begin(), operand.cards.end(),
+                             back_inserter(kept));
+        }
+        out.cards.swap(kept);
+    }
+}
+
+// Combines operands any of which may match
+void SearchIndex::unite(vector<Operand>& operands, Operand& out) const {
+    if (operands.size() == 1) {
+        out = std::move(operands[0]);
+        return;
+    }
+    out = Operand();
+    for (Operand& operand : operands) {
+        materialize(operand);
+        out.cards.insert(out.cards.end(), operand.cards.begin(), operand.cards.end());
+    }
+    sortUnique(out.cards, cardCount);
+}
+
+/**
+ * Finds the cards matching a query
+ * Returns:
+ *   - bool: False if the query is malformed.
+ */
+bool SearchIndex::search(string_view query, vector<CardId>& results, string& error) const {
+    results.clear();
+    Parser parser(*this, query, error);
+    if (parser.empty()) {
+        error = "Nothing to search for";
+        return false;
+    }
+    Operand match;
+    if (!parser.parseAny(match)) {
+        return false;
+    }
+    if (!parser.atEnd()) {
+        error = "A \")\" in the search has no \"(\" before it";
+        return false;
+    }
+    materialize(match);
+    results = std::move(match.cards);
+    return true;
+}
+
+size_t SearchIndex::heapBytes() const {
+    size_t bytes = pool.capacity() + lists.capacity() * sizeof(Postings) +
+                   skipTables.capacity() * sizeof(vector<Skip>) + wordText.capacity() +
+                   (wordStarts.capacity() + sortedWords.capacity() + recentWords.capacity()) * sizeof(uint32_t) +
+                   slots.capacity() * sizeof(Slot);
+    for (const vector<Skip>& table : skipTables) {
+        bytes += table.capacity() * sizeof(Skip);
+    }
+    return bytes;
+}
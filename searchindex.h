@@ -0,0 +1,138 @@
+/**
+ * searchindex.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for SearchIndex, an inverted index from the words of every term and definition to the cards
+ * they appear on, so a learner can drill only the cards about a topic. Text is normalized the way answers
+ * are graded and split into words at spaces and punctuation. Each word's posting list holds its card ids
+ * in increasing order as varint-coded gaps, written into a chain of growing slices in one shared byte
+ * pool: a word seen once costs a few bytes, and adding a card only appends to the lists of its words.
+ * Every 128th posting of a list is also kept in a skip table, so intersecting a rare word with a common
+ * one jumps over most of the common word's list instead of decoding it.
+ *
+ * A query is a list of words that must all match. OR between words or groups matches either, a leading
+ * "-" or NOT leaves cards out, a trailing "*" matches every word with that prefix, and parentheses group:
+ *   heap stack        heap OR stack        (heap OR stack) -tree        mem*
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SEARCHINDEX_H
+#define M2AP_SEARCHINDEX_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "cardstore.h"
+using namespace std;
+
+class SearchIndex {
+private:
+    static const uint32_t NO_WORD = 0xFFFFFFFFu;
+    static const uint32_t NO_SKIPS = 0xFFFFFFFFu;
+
+    struct Skip {
+        CardId before;          // The posting ahead of the one skipped to
+        uint32_t offset;        // Pool offset of the posting skipped to
+        uint32_t sliceEnd;      // End of the data in its slice
+        uint8_t level;          // Size class of its slice
+    };
+
+    struct Postings {
+        uint32_t tail;          // Pool offset of the next byte to write
+        uint32_t sliceEnd;      // End of the data in the slice being written
+        uint32_t head;          // Pool offset of the first slice
+        CardId last;            // Last card added
+        uint32_t count;
+        uint32_t skips;         // Index into skipTables, or NO_SKIPS while the list is short
+        uint8_t level;          // Size class of the slice being written
+    };
+
+    struct Slot {
+        uint32_t word;          // Word id, or NO_WORD
+        uint32_t tag;           // High bits of the word's hash, checked before comparing text
+    };
+
+    struct Operand;
+    class Cursor;
+    class Parser;
+
+    vector<uint8_t> pool;               // Every posting list's slices
+    vector<Postings> lists;             // By word id
+    vector<vector<Skip>> skipTables;
+    string wordText;                    // Every distinct word, back to back
+    vector<uint32_t> wordStarts;        // Word w is [wordStarts[w], wordStarts[w + 1])
+    vector<uint32_t> sortedWords;       // Word ids in byte order of their text, for prefixes
+    vector<uint32_t> recentWords;       // Words added since sortedWords was last merged, also in order
+    vector<Slot> slots;                 // Open addressing, linear probing
+    size_t cardCount;
+    size_t postings;
+    string normalized;                  // Scratch for indexing
+
+    string_view word(uint32_t id) const {
+        return string_view(wordText.data() + wordStarts[id], wordStarts[id + 1] - wordStarts[id]);
+    }
+
+    size_t findSlot(string_view text, uint64_t hash) const;
+    uint32_t findWord(string_view text) const;
+    uint32_t addWord(string_view text);
+    void growSlots();
+    void indexCard(CardId card, string_view term, string_view def);
+    void indexText(CardId card, string_view text);
+    void addPosting(uint32_t id, CardId card);
+    void writeByte(Postings& list, uint8_t byte);
+    uint32_t newSlice(uint8_t level);
+    void sortWordsFrom(size_t first, bool merge);
+    void matchPrefix(const vector<uint32_t>& words, string_view prefix, vector<uint32_t>& out) const;
+
+    void decode(uint32_t id, vector<CardId>& out) const;
+    void matchWord(string_view text, bool prefix, Operand& out) const;
+    void materialize(Operand& operand) const;
+    void intersect(vector<Operand>& operands, Operand& out) const;
+    void unite(vector<Operand>& operands, Operand& out) const;
+
+public:
+    SearchIndex();
+
+    /**
+     * Indexes every card from scratch
+     * Inputs:
+     *   - const CardStore& cards: Cards to index; card ids in the index are the store's.
+     */
+    void build(const CardStore& cards);
+
+    /**
+     * Indexes one more card
+     * Inputs:
+     *   - CardId card: The card's id, which must come after every card indexed so far.
+     *   - string_view term, string_view def: The card's text.
+     * Description:
+     *   - Appends to the posting lists of the card's words; nothing already indexed is rebuilt.
+     *   - Throws length_error if the pool would pass 4 GiB, and invalid_argument for a card out of order.
+     */
+    void addCard(CardId card, string_view term, string_view def);
+
+    /**
+     * Finds the cards matching a query
+     * Inputs:
+     *   - string_view query: Words, OR, NOT or "-", "*" prefixes and parentheses, as described above.
+     *   - vector<CardId>& results: Receives the matching cards in deck order.
+     *   - string& error: Receives a description of a malformed query.
+     * Returns:
+     *   - bool: False if the query is malformed; no matches is not an error.
+     */
+    bool search(string_view query, vector<CardId>& results, string& error) const;
+
+    size_t size() const { return cardCount; }
+    size_t wordCount() const { return lists.size(); }
+    size_t postingCount() const { return postings; }
+
+    /**
+     * Returns:
+     *   - size_t: Heap bytes held by the index.
+     */
+    size_t heapBytes() const;
+};
+
+#endif // M2AP_SEARCHINDEX_H
@@ -0,0 +1,670 @@
+/**
+ * sessionlog.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for SessionJournal.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "sessionlog.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+const char CSV_HEADER[] = "Sequence,Timestamp,GameMode,NumCorrectAnswers,Total,DeckId\n";
+const char LEGACY_CSV_PATH[] = "../game_sessions.csv";     // Where the first version wrote its scores
+const size_t RECORD_HEADER_BYTES = 8;      // uint32 payload length, uint32 CRC32 of the payload
+const size_t MAX_PAYLOAD_BYTES = 1 << 26;
+const size_t MAX_MODE_BYTES = 1 << 15;
+const size_t OUTCOME_BYTES = 9;            // uint32 card, uint32 answer microseconds, uint8 correct
+const size_t MAX_OUTCOMES = (MAX_PAYLOAD_BYTES - MAX_MODE_BYTES) / OUTCOME_BYTES - 8;
+
+// Records written before deck ids and per-card results were kept end after the mode name
+struct JournalRecord {
+    uint64_t sequence;
+    int64_t timestamp;
+    int32_t score;
+    string gameMode;
+    uint64_t deckId;
+    int32_t total;
+    vector<CardOutcome> outcomes;
+};
+
+template <class T>
+void appendRaw(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void encodeRecord(const JournalRecord& record, string& out) {
+    string payload;
+    appendRaw(payload, record.sequence);
+    appendRaw(payload, record.timestamp);
+    appendRaw(payload, record.score);
+    appendRaw(payload, static_cast<uint16_t>(record.gameMode.size()));
+    payload += record.gameMode;
+    appendRaw(payload, record.deckId);
+    appendRaw(payload, record.total);
+    appendRaw(payload, static_cast<uint32_t>(record.outcomes.size()));
+    for (const CardOutcome& outcome : record.outcomes) {
+        appendRaw(payload, outcome.card);
+        appendRaw(payload, outcome.answerMicros);
+        appendRaw(payload, static_cast<uint8_t>(outcome.correct ? 1 : 0));
+    }
+
+    appendRaw(out, static_cast<uint32_t>(payload.size()));
+    appendRaw(out, crc32(payload.data(), payload.size()));
+    out += payload;
+}
+
+/**
+ * Walks the records of a journal image
+ * Returns:
+ *   - size_t: Length of the valid prefix; anything after it is a torn or corrupt tail.
+ */
+template <class Visit>
+size_t scanRecords(const string& data, Visit visit) {
+    const size_t fixedBytes = sizeof(uint64_t) + sizeof(int64_t) + sizeof(int32_t) + sizeof(uint16_t);
+    size_t offset = 0;
+
+    while (data.size() - offset >= RECORD_HEADER_BYTES) {
+        uint32_t length;
+        uint32_t crc;
+        memcpy(&length, data.data() + offset, sizeof(length));
+        memcpy(&crc, data.data() + offset + 4, sizeof(crc));
+        if (length < fixedBytes || length > MAX_PAYLOAD_BYTES || data.size() - offset - RECORD_HEADER_BYTES < length) {
+            break;
+        }
+        const char* payload = data.data() + offset + RECORD_HEADER_BYTES;
+        if (crc32(payload, length) != crc) {
+            break;
+        }
+
+        JournalRecord record;
+        uint16_t modeLength;
+        memcpy(&record.sequence, payload, sizeof(record.sequence));
+        memcpy(&record.timestamp, payload + 8, sizeof(record.timestamp));
+        memcpy(&record.score, payload + 16, sizeof(record.score));
+        memcpy(&modeLength, payload + 20, sizeof(modeLength));
+        size_t extension = length - fixedBytes;
+        if (extension < modeLength) {
+            break;
+        }
+        record.gameMode.assign(payload + fixedBytes, modeLength);
+        extension -= modeLength;
+        record.deckId = 0;
+        record.total = 0;
+        record.outcomes.clear();
+        if (extension > 0) {
+            const char* at = payload + fixedBytes + modeLength;
+            uint32_t outcomeCount;
+            if (extension < 16) {
+                break;
+            }
+            memcpy(&record.deckId, at, sizeof(record.deckId));
+            memcpy(&record.total, at + 8, sizeof(record.total));
+            memcpy(&outcomeCount, at + 12, sizeof(outcomeCount));
+            if ((extension - 16) / OUTCOME_BYTES != outcomeCount || (extension - 16) % OUTCOME_BYTES != 0) {
+                break;
+            }
+            at += 16;
+            record.outcomes.resize(outcomeCount);
+            for (CardOutcome& outcome : record.outcomes) {
+                uint8_t correct;
+                memcpy(&outcome.card, at, sizeof(outcome.card));
+                memcpy(&outcome.answerMicros, at + 4, sizeof(outcome.answerMicros));
+                memcpy(&correct, at + 8, sizeof(correct));
+                outcome.correct = correct != 0;
+                at += OUTCOME_BYTES;
+            }
+        }
+        visit(record);
+        offset += RECORD_HEADER_BYTES + length;
+    }
+    return offset;
+}
+
+bool readWholeFile(int fd, string& out) {
+    out.clear();
+    char buffer[65536];
+    if (lseek(fd, 0, SEEK_SET) < 0) {
+        return false;
+    }
+    while (true) {
+        ssize_t got = read(fd, buffer, sizeof(buffer));
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (got == 0) {
+            return true;
+        }
+        out.append(buffer, static_cast<size_t>(got));
+    }
+}
+
+bool writeAll(int fd, const string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t wrote = write(fd, data.data() + done, data.size() - done);
+        if (wrote < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        done += static_cast<size_t>(wrote);
+    }
+    return true;
+}
+
+GameSession toSession(const JournalRecord& record) {
+    return GameSession{record.gameMode, record.score, record.timestamp, record.deckId, record.total, record.outcomes};
+}
+
+bool makeDirectories(const string& path, string& error) {
+    for (size_t slash = 1; slash <= path.size(); ++slash) {
+        if (slash == path.size() || path[slash] == '/') {
+            string prefix = path.substr(0, slash);
+            if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+                error = "Unable to create " + prefix + ": " + strerror(errno);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+SessionJournal::SessionJournal()
+        : journalFd(-1), nextSequence(1), imported(0), writing(false), flushRequested(false), stopping(false),
+          writeFailed(false) {}
+
+SessionJournal::~SessionJournal() {
+    close();
+}
+
+/**
+ * Finds the directory that holds the history
+ */
+string SessionJournal::dataDirectory() {
+    const char* home = getenv("STUDYTOOL_HOME");
+    if (home != nullptr && *home != '\0') {
+        return home;
+    }
+    const char* xdg = getenv("XDG_DATA_HOME");
+    if (xdg != nullptr && *xdg != '\0') {
+        return string(xdg) + "/cppstudytool";
+    }
+    const char* user = getenv("HOME");
+    return string(user != nullptr ? user : ".") + "/.local/share/cppstudytool";
+}
+
+/**
+ * Opens the journal, recovering from a crash if needed
+ * Inputs:
+ *   - const string& dataDir: Directory for the journal and history; created if missing.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - bool: True if sessions can be appended.
+ */
+bool SessionJournal::open(const string& dataDir, string& error) {
+    close();
+    directory = dataDir;
+    if (!makeDirectories(directory, error) || !history.open(historyPath(), error)) {
+        return false;
+    }
+
+    journalFd = ::open(journalPath().c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (journalFd < 0) {
+        error = "Unable to open " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+    if (!recover(error) || !importCsv(error) || !importLegacyCsv(LEGACY_CSV_PATH, error)) {
+        ::close(journalFd);
+        journalFd = -1;
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(journalFd, &info) == 0 && static_cast<size_t>(info.st_size) >= COMPACT_BYTES && !compact(error)) {
+        ::close(journalFd);
+        journalFd = -1;
+        return false;
+    }
+
+    stopping = false;
+    writeFailed = false;
+    writer = thread(&SessionJournal::writerLoop, this);
+    return true;
+}
+
+/**
+ * Cuts a torn tail off the journal and picks up the sequence numbering where it stopped
+ */
+bool SessionJournal::recover(string& error) {
+    string data;
+    if (!readWholeFile(journalFd, data)) {
+        error = "Unable to read " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+
+    uint64_t lastSequence = 0;
+    size_t valid = scanRecords(data, [&lastSequence](const JournalRecord& record) {
+        lastSequence = max(lastSequence, record.sequence);
+    });
+    if (valid < data.size()) {
+        if (ftruncate(journalFd, static_cast<off_t>(valid)) != 0 || fdatasync(journalFd) != 0) {
+            error = "Unable to repair " + journalPath() + ": " + strerror(errno);
+            return false;
+        }
+    }
+
+    size_t csvLength;
+    nextSequence = max({lastSequence, history.lastSequence(), lastCsvSequence(csvPath(), csvLength)}) + 1;
+    return true;
+}
+
+/**
+ * Moves the games of a game_sessions.csv kept by an earlier version into the history, once
+ */
+bool SessionJournal::importCsv(string& error) {
+    size_t csvLength;
+    if (lastCsvSequence(csvPath(), csvLength) <= history.lastSequence()) {
+        return true;
+    }
+
+    vector<HistoryRecord> games;
+    ifstream csv(csvPath());
+    string line;
+    while (getline(csv, line)) {
+        // Sequence,Timestamp,GameMode,NumCorrectAnswers; the header and any torn row fail to parse
+        size_t first = line.find(',');
+        size_t second = line.find(',', first + 1);
+        size_t third = line.find(',', second + 1);
+        if (first == string::npos || second == string::npos || third == string::npos) {
+            continue;
+        }
+        char* end = nullptr;
+        uint64_t sequence = strtoull(line.c_str(), &end, 10);
+        if (end != line.c_str() + first || sequence <= history.lastSequence()) {
+            continue;
+        }
+        games.push_back(HistoryRecord{sequence, GameSession{line.substr(second + 1, third - second - 1),
+                                                            atoi(line.c_str() + third + 1),
+                                                            strtoll(line.c_str() + first + 1, nullptr, 10), 0, 0,
+                                                            {}}});
+    }
+    return history.append(games, error);
+}
+
+/**
+ * Moves the games of the two-column game_sessions.csv the first version wrote into the journal, once
+ * Inputs:
+ *   - const string& path: Where that version wrote it, relative to the directory it was started from.
+ *   - string& error: Receives a description of the failure, if any.
+ * Description:
+ *   - Its rows are GameMode,NumCorrectAnswers with no time, so each game is given the next sequence number
+ *     and a timestamp of 0. They go through the journal rather than straight into the history so that they
+ *     follow any games still waiting in the journal.
+ *   - The file is left in place; its full path is listed in legacy.imported in the data directory so it is
+ *     not imported again. A crash between the journal write and that list imports it twice.
+ */
+bool SessionJournal::importLegacyCsv(const string& path, string& error) {
+    imported = 0;
+    ifstream csv(path);
+    if (!csv) {
+        return true;
+    }
+    char* resolved = realpath(path.c_str(), nullptr);
+    string fullPath = resolved != nullptr ? resolved : path;
+    free(resolved);
+
+    string listPath = directory + "/legacy.imported";
+    ifstream list(listPath);
+    string line;
+    while (getline(list, line)) {
+        if (line == fullPath) {
+            return true;
+        }
+    }
+
+    string batch;
+    size_t games = 0;
+    while (getline(csv, line)) {
+        // GameMode,NumCorrectAnswers; the header and malformed rows are skipped
+        size_t comma = line.find(',');
+        if (comma == string::npos || comma == 0 || line.find(',', comma + 1) != string::npos) {
+            continue;
+        }
+        char* end = nullptr;
+        long score = strtol(line.c_str() + comma + 1, &end, 10);
+        if (end == line.c_str() + comma + 1 || (*end != '\0' && *end != '\r')) {
+            continue;
+        }
+        encodeRecord(JournalRecord{nextSequence++, 0, static_cast<int32_t>(score), line.substr(0, comma), 0, 0, {}},
+                     batch);
+        ++games;
+    }
+    if (!batch.empty() && (!writeAll(journalFd, batch) || fdatasync(journalFd) != 0)) {
+        error = "Unable to write " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+
+    ofstream listOut(listPath, ios::app);
+    listOut << fullPath << '\n';
+    listOut.flush();
+    if (!listOut) {
+        error = "Unable to write " + listPath;
+        return false;
+    }
+    imported = games;
+    return true;
+}
+
+/**
+ * Sequence number on the last complete row of the CSV
+ * Inputs:
+ *   - const string& path: The CSV.
+ *   - size_t& validLength: Receives the length up to and including the last complete line.
+ */
+uint64_t SessionJournal::lastCsvSequence(const string& path, size_t& validLength) {
+    validLength = 0;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+
+    // Only the tail is read, however long the history has grown
+    struct stat info;
+    string tail;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        size_t size = static_cast<size_t>(info.st_size);
+        size_t start = size > 4096 ? size - 4096 : 0;
+        tail.resize(size - start);
+        ssize_t got = pread(fd, &tail[0], tail.size(), static_cast<off_t>(start));
+        tail.resize(got > 0 ? static_cast<size_t>(got) : 0);
+        size_t lastNewline = tail.rfind('\n');
+        validLength = lastNewline == string::npos ? start : start + lastNewline + 1;
+        tail.resize(lastNewline == string::npos ? 0 : lastNewline);
+    }
+    ::close(fd);
+
+    size_t lineStart = tail.rfind('\n');
+    lineStart = lineStart == string::npos ? 0 : lineStart + 1;
+    return strtoull(tail.c_str() + lineStart, nullptr, 10);
+}
+
+/**
+ * Background writer: sends each batch to the journal in one write
+ */
+void SessionJournal::writerLoop() {
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        wake.wait_for(guard, chrono::milliseconds(FLUSH_INTERVAL_MS),
+                      [this] { return stopping || flushRequested || pending.size() >= FLUSH_BYTES; });
+        flushRequested = false;
+        if (pending.empty()) {
+            flushed.notify_all();
+            if (stopping) {
+                break;
+            }
+            continue;
+        }
+
+        string batch;
+        batch.swap(pending);
+        writing = true;
+        guard.unlock();
+        bool ok = writeAll(journalFd, batch);
+        guard.lock();
+        writing = false;
+        if (!ok) {
+            writeFailed = true;
+        }
+        flushed.notify_all();
+    }
+}
+
+/**
+ * Queues a finished game
+ * Inputs:
+ *   - const GameSession& session: The game. A zero timestamp is replaced by the current time.
+ */
+uint64_t SessionJournal::append(const GameSession& session) {
+    JournalRecord record;
+    record.timestamp = session.timestamp;
+    if (record.timestamp == 0) {
+        record.timestamp = chrono::duration_cast<chrono::milliseconds>(
+                chrono::system_clock::now().time_since_epoch()).count();
+    }
+    record.score = session.numCorrectAnswers;
+    record.gameMode = session.gameMode.substr(0, MAX_MODE_BYTES);
+    record.deckId = session.deckId;
+    record.total = session.total;
+    record.outcomes.assign(session.outcomes.begin(),
+                           session.outcomes.begin() + min(session.outcomes.size(), MAX_OUTCOMES));
+
+    lock_guard<mutex> guard(lock);
+    record.sequence = nextSequence++;
+    encodeRecord(record, pending);
+    if (pending.size() >= FLUSH_BYTES) {
+        wake.notify_one();
+    }
+    return record.sequence;
+}
+
+/**
+ * Reads back every game after a sequence number, oldest first
+ * Inputs:
+ *   - uint64_t afterSequence: Games up to and including this one are skipped.
+ *   - const function<void(uint64_t, const GameSession&)>& visit: Called with each game and its sequence.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool SessionJournal::replay(uint64_t afterSequence, const function<void(uint64_t, const GameSession&)>& visit,
+                            string& error) {
+    HistoryQuery everything;
+    everything.afterSequence = afterSequence;
+    return query(everything, visit, error);
+}
+
+/**
+ * Visits the games matching a query, oldest first, from the history and then the journal
+ * Inputs:
+ *   - const HistoryQuery& query: Mode, deck, time and sequence bounds.
+ *   - const function<void(uint64_t, const GameSession&)>& visit: Called with each game and its sequence.
+ *   - string& error: Receives a description of the failure, if any.
+ *   - HistoryScan* scan: If not nullptr, receives how many of the history's blocks were read and skipped.
+ */
+bool SessionJournal::query(const HistoryQuery& query, const function<void(uint64_t, const GameSession&)>& visit,
+                           string& error, HistoryScan* scan) {
+    if (writer.joinable() && !commit(error)) {
+        return false;
+    }
+    if (!history.query(query, visit, error, scan)) {
+        return false;
+    }
+
+    // Games not yet compacted; the journal is kept small, so it is read whole
+    lock_guard<mutex> guard(lock);
+    string data;
+    if (!readWholeFile(journalFd, data)) {
+        error = "Unable to read " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+    uint64_t seen = max(query.afterSequence, history.lastSequence());
+    scanRecords(data, [&](const JournalRecord& record) {
+        if (record.sequence <= seen || record.timestamp < query.fromTimestamp || record.timestamp > query.untilTimestamp
+            || (!query.gameMode.empty() && record.gameMode != query.gameMode)
+            || (query.deckId != 0 && record.deckId != query.deckId)) {
+            return;
+        }
+        GameSession session = toSession(record);
+        if (!query.outcomes) {
+            session.outcomes.clear();
+        }
+        visit(record.sequence, session);
+        seen = record.sequence;
+    });
+    return true;
+}
+
+/**
+ * Writes every game to a CSV with the columns of game_sessions.csv, then Total and DeckId
+ * Inputs:
+ *   - const string& path: File to write (written to a temporary file and renamed).
+ *   - string& error: Receives a description of the failure, if any.
+ *   - size_t* games: If not nullptr, receives the number of games written.
+ */
+bool SessionJournal::exportCsv(const string& path, string& error, size_t* games) {
+    string tempPath = path + ".tmp";
+    size_t written = 0;
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile << CSV_HEADER;
+        bool ok = query(HistoryQuery(), [&](uint64_t sequence, const GameSession& session) {
+            outFile << sequence << ',' << session.timestamp << ',' << session.gameMode << ','
+                    << session.numCorrectAnswers << ',' << session.total << ',' << session.deckId << '\n';
+            ++written;
+        }, error);
+        if (ok && !outFile) {
+            error = "Unable to write " + tempPath;
+            ok = false;
+        }
+        if (!ok) {
+            outFile.close();
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    if (games != nullptr) {
+        *games = written;
+    }
+    return true;
+}
+
+/**
+ * Commit point: writes every queued game and waits until it is on disk
+ */
+bool SessionJournal::commit(string& error) {
+    if (journalFd < 0) {
+        error = "Session journal is not open";
+        return false;
+    }
+
+    unique_lock<mutex> guard(lock);
+    bool written = drain(guard, error);
+    guard.unlock();
+
+    if (!written) {
+        return false;
+    }
+    if (fdatasync(journalFd) != 0) {
+        error = "Unable to sync " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// Writes every queued game to the journal; the caller holds the lock through guard
+bool SessionJournal::drain(unique_lock<mutex>& guard, string& error) {
+    if (writer.joinable()) {
+        flushRequested = true;
+        wake.notify_one();
+        flushed.wait(guard, [this] { return pending.empty() && !writing; });
+    } else if (!pending.empty()) {
+        writeFailed = !writeAll(journalFd, pending) || writeFailed;
+        pending.clear();
+    }
+    bool failed = writeFailed;
+    writeFailed = false;
+    if (failed) {
+        error = "Unable to write " + journalPath();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Moves the journal into the history and empties the journal
+ */
+bool SessionJournal::compact(string& error) {
+    if (journalFd < 0) {
+        error = "Session journal is not open";
+        return false;
+    }
+
+    // The lock is held from the last flush until the journal is emptied, so the writer cannot add a batch in
+    // between that the truncation would throw away; appends queue up meanwhile
+    unique_lock<mutex> guard(lock);
+    if (!drain(guard, error)) {
+        return false;
+    }
+    if (fdatasync(journalFd) != 0) {
+        error = "Unable to sync " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+
+    string data;
+    if (!readWholeFile(journalFd, data)) {
+        error = "Unable to read " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+
+    vector<HistoryRecord> games;
+    scanRecords(data, [&games](const JournalRecord& record) {
+        games.push_back(HistoryRecord{record.sequence, toSession(record)});
+    });
+    if (!history.append(games, error)) {
+        return false;
+    }
+
+    // Every record is now in the history; an interruption before this point is repaired by the sequence check
+    if (ftruncate(journalFd, 0) != 0 || fdatasync(journalFd) != 0) {
+        error = "Unable to empty " + journalPath() + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Commits and stops the background thread
+ */
+void SessionJournal::close() {
+    if (writer.joinable()) {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        fdatasync(journalFd);
+    }
+    if (journalFd >= 0) {
+        ::close(journalFd);
+        journalFd = -1;
+    }
+    history.close();
+}
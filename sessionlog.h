@@ -0,0 +1,176 @@
+/**
+ * sessionlog.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for SessionJournal, the append-only history of finished games.
+ * Games are appended to a journal as length- and CRC32-framed records. A background thread writes them
+ * out in batches, and commit() is a durability point that waits for the batch and fsyncs it. On open, a
+ * torn record at the end of the journal (a crash mid-write) is cut off. Compaction moves the journal's
+ * records into the columnar HistoryStore (sessions.history) and then empties the journal; queries read
+ * both. game_sessions.csv, which earlier versions appended to, is imported into the store once and is
+ * otherwise only written on request by exportCsv(); so is the two-column ../game_sessions.csv the first
+ * version wrote next to the directory it was started from.
+ * The files live in one data directory: $STUDYTOOL_HOME, else $XDG_DATA_HOME/cppstudytool, else
+ * ~/.local/share/cppstudytool, so the history no longer depends on the directory the program runs from.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SESSIONLOG_H
+#define M2AP_SESSIONLOG_H
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "historystore.h"
+#include "studytool.h"
+using namespace std;
+
+class SessionJournal {
+private:
+    string directory;
+    int journalFd;
+    uint64_t nextSequence;
+    size_t imported;
+
+    // Records appended but not yet written, guarded by lock
+    mutex lock;
+    condition_variable wake;
+    condition_variable flushed;
+    string pending;
+    bool writing;
+    bool flushRequested;
+    bool stopping;
+    bool writeFailed;
+    thread writer;
+
+    HistoryStore history;
+
+    void writerLoop();
+    bool recover(string& error);
+    bool importCsv(string& error);
+    bool importLegacyCsv(const string& path, string& error);
+    bool drain(unique_lock<mutex>& guard, string& error);
+    static uint64_t lastCsvSequence(const string& csvPath, size_t& validLength);
+
+public:
+    static const size_t FLUSH_BYTES = 4096;       // Batch size that wakes the writer early
+    static const int FLUSH_INTERVAL_MS = 1000;    // Longest a record waits in memory
+    static const size_t COMPACT_BYTES = 1 << 20;  // Journal size at which open() compacts
+
+    SessionJournal();
+    ~SessionJournal();
+
+    SessionJournal(const SessionJournal&) = delete;
+    SessionJournal& operator=(const SessionJournal&) = delete;
+
+    /**
+     * Finds the directory that holds the history
+     * Returns:
+     *   - string: $STUDYTOOL_HOME, else $XDG_DATA_HOME/cppstudytool, else $HOME/.local/share/cppstudytool.
+     */
+    static string dataDirectory();
+
+    /**
+     * Opens the journal, recovering from a crash if needed
+     * Inputs:
+     *   - const string& dataDir: Directory for the journal and history; created if missing.
+     *   - string& error: Receives a description of the failure, if any.
+     * Returns:
+     *   - bool: True if sessions can be appended.
+     * Description:
+     *   - Cuts off a torn record at the end of the journal, imports game_sessions.csv into the history
+     *     if it has games the history lacks, imports the first version's ../game_sessions.csv if it has not
+     *     been imported before (see importedGames()), then compacts if the journal has grown large.
+     */
+    bool open(const string& dataDir, string& error);
+
+    /**
+     * Queues a finished game; it is written by the background thread within FLUSH_INTERVAL_MS
+     * Inputs:
+     *   - const GameSession& session: The game. A zero timestamp is replaced by the current time. Its
+     *     per-card results are kept with it.
+     * Returns:
+     *   - uint64_t: Sequence number given to the game.
+     */
+    uint64_t append(const GameSession& session);
+
+    /**
+     * Reads back every game after a sequence number, oldest first
+     * Inputs:
+     *   - uint64_t afterSequence: Games up to and including this one are skipped.
+     *   - const function<void(uint64_t, const GameSession&)>& visit: Called with each game and its sequence.
+     *   - string& error: Receives a description of the failure, if any.
+     * Description:
+     *   - Reads the history's blocks after afterSequence and then the journal; meant for rebuilding derived
+     *     data such as statistics, not for every game. Per-card results are not read.
+     */
+    bool replay(uint64_t afterSequence, const function<void(uint64_t, const GameSession&)>& visit, string& error);
+
+    /**
+     * Visits the games matching a query, oldest first, from the history and then the journal
+     * Inputs:
+     *   - const HistoryQuery& query: Mode, deck, time and sequence bounds (see historystore.h).
+     *   - const function<void(uint64_t, const GameSession&)>& visit: Called with each game and its sequence.
+     *   - string& error: Receives a description of the failure, if any.
+     *   - HistoryScan* scan: If not nullptr, receives how many of the history's blocks were read and skipped.
+     */
+    bool query(const HistoryQuery& query, const function<void(uint64_t, const GameSession&)>& visit, string& error,
+               HistoryScan* scan = nullptr);
+
+    /**
+     * Writes every game to a CSV with the columns of game_sessions.csv, then Total and DeckId
+     * Inputs:
+     *   - const string& path: File to write (written to a temporary file and renamed).
+     *   - string& error: Receives a description of the failure, if any.
+     *   - size_t* games: If not nullptr, receives the number of games written.
+     */
+    bool exportCsv(const string& path, string& error, size_t* games = nullptr);
+
+    /**
+     * Commit point: writes every queued game and waits until it is on disk
+     * Inputs:
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool commit(string& error);
+
+    /**
+     * Moves the journal into the history and empties the journal
+     * Inputs:
+     *   - string& error: Receives a description of the failure, if any.
+     * Description:
+     *   - Records already in the history (by sequence number) are skipped, so a compaction interrupted after
+     *     appending but before emptying the journal never duplicates games.
+     *   - Holds the lock from flushing queued games until the journal is emptied, so games appended
+     *     meanwhile wait in memory and are written afterwards.
+     */
+    bool compact(string& error);
+
+    /**
+     * Commits and stops the background thread. Also done by the destructor.
+     */
+    void close();
+
+    /**
+     * Returns:
+     *   - string: The CSV earlier versions kept the history in.
+     */
+    string csvPath() const { return directory + "/game_sessions.csv"; }
+    string journalPath() const { return directory + "/sessions.journal"; }
+    string historyPath() const { return directory + "/sessions.history"; }
+    const HistoryStore& getHistory() const { return history; }
+    string dataPath() const { return directory; }
+    uint64_t lastSequence() const { return nextSequence - 1; }
+
+    /**
+     * Returns:
+     *   - size_t: Games open() moved from the first version's ../game_sessions.csv; 0 if there were none.
+     */
+    size_t importedGames() const { return imported; }
+    bool isOpen() const { return journalFd >= 0; }
+};
+
+#endif // M2AP_SESSIONLOG_H
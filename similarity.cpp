@@ -0,0 +1,327 @@
+/**
+ * similarity.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for SimilarityIndex.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "similarity.h"
+#include "deckfile.h"
+#include "textnorm.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <thread>
+using namespace std;
+
+namespace {
+
+const char SIMILARITY_MAGIC[8] = {'S', 'T', 'S', 'I', 'M', 'I', 'X', '\n'};
+const uint32_t SIMILARITY_VERSION = 1;
+const size_t MAX_BUCKET_SCAN = 128;   // Bounds the work for very common band values
+
+struct SimilarityHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t signatureSize;
+    uint64_t groupCount;
+    uint64_t fingerprint;
+};
+
+inline uint64_t mixGram(uint64_t gram) {
+    uint64_t h = gram * 0x9E3779B97F4A7C15ULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    return h;
+}
+
+// One-permutation MinHash: each 3-gram is hashed once; the low bits pick the signature slot and the
+// high bits compete for its minimum. Empty slots (short texts) borrow from the next filled slot.
+void computeSignature(string_view text, uint16_t* signature) {
+    const size_t n = SimilarityIndex::SIGNATURE_SIZE;
+    uint32_t slots[SimilarityIndex::SIGNATURE_SIZE];
+    for (size_t i = 0; i < n; ++i) {
+        slots[i] = 0x10000u;
+    }
+
+    // Pad with a space on each side so short words still produce grams and word edges count
+    auto byteAt = [&text](size_t i) -> uint64_t {
+        if (i == 0 || i > text.size()) {
+            return ' ';
+        }
+        return static_cast<unsigned char>(text[i - 1]);
+    };
+
+    size_t paddedLength = text.size() + 2;
+    for (size_t i = 0; i + 3 <= paddedLength; ++i) {
+        uint64_t gram = byteAt(i) | (byteAt(i + 1) << 8) | (byteAt(i + 2) << 16);
+        uint64_t h = mixGram(gram);
+        size_t slot = h & (n - 1);
+        uint32_t value = static_cast<uint32_t>(h >> 48);
+        if (value < slots[slot]) {
+            slots[slot] = value;
+        }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t value = slots[i];
+        size_t distance = 0;
+        while (value == 0x10000u && distance < n) {
+            ++distance;
+            value = slots[(i + distance) % n];
+        }
+        if (value == 0x10000u) {
+            value = 0xFFFFu;   // No grams at all
+        } else if (distance > 0) {
+            value = (value * 0x9E37u + static_cast<uint32_t>(distance) * 0x7F4Bu) & 0xFFFFu;
+        }
+        signature[i] = static_cast<uint16_t>(value);
+    }
+}
+
+} // namespace
+
+SimilarityIndex::SimilarityIndex() : groupCount(0), fingerprint(0) {}
+
+uint32_t SimilarityIndex::bandKey(const uint16_t* signature, size_t band) {
+    uint64_t packed = 0;
+    for (size_t r = 0; r < ROWS; ++r) {
+        packed = (packed << 16) | signature[band * ROWS + r];
+    }
+    return static_cast<uint32_t>(mixGram(packed ^ (static_cast<uint64_t>(band) << 59)) >> 32);
+}
+
+/**
+ * Fingerprint of a deck's contents, used to tie a cache file to its deck
+ */
+uint64_t SimilarityIndex::deckFingerprint(const CardStore& cards) {
+    uint64_t offsetsHash = deckChecksum(cards.offsetTable(), (2 * cards.size() + 1) * sizeof(uint32_t));
+    uint64_t fingerprint = offsetsHash ^ (deckChecksum(cards.textData(), cards.textBytes()) * 0x9E3779B97F4A7C15ULL);
+    // Compressed definitions are codes, which mean nothing without the symbols they stand for
+    if (cards.symbolTable() != nullptr) {
+        fingerprint ^= cards.symbolTable()->checksum() * 0xC2B2AE3D27D4EB4FULL;
+    }
+    return fingerprint;
+}
+
+/**
+ * Builds the index
+ * Inputs:
+ *   - const CardStore& cards: Deck text.
+ *   - const CardIndex& index: Distinct-definition numbering for the deck.
+ *   - unsigned threads: Worker threads; 0 uses every core.
+ */
+void SimilarityIndex::build(const CardStore& cards, const CardIndex& index, unsigned threads) {
+    groupCount = index.distinctDefinitionCount();
+    fingerprint = deckFingerprint(cards);
+    signatures.assign(groupCount * SIGNATURE_SIZE, 0);
+
+    if (threads == 0) {
+        threads = max(1u, thread::hardware_concurrency());
+    }
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(1, groupCount / 1024)));
+
+    // Signatures: each worker takes a contiguous range of groups
+    auto signRange = [&](size_t begin, size_t end) {
+        string normalized;
+        for (size_t group = begin; group < end; ++group) {
+            normalizeText(cards.def(index.definitionGroupCard(static_cast<uint32_t>(group))), normalized);
+            computeSignature(normalized, &signatures[group * SIGNATURE_SIZE]);
+        }
+    };
+
+    vector<thread> workers;
+    size_t chunk = (groupCount + threads - 1) / threads;
+    for (unsigned t = 1; t < threads; ++t) {
+        size_t begin = min(groupCount, t * chunk);
+        workers.emplace_back(signRange, begin, min(groupCount, begin + chunk));
+    }
+    signRange(0, min(groupCount, chunk));
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+
+    // Buckets: each band is filled and sorted independently
+    auto buildBand = [this](size_t band) {
+        vector<BucketEntry>& entries = buckets[band];
+        entries.resize(groupCount);
+        for (size_t group = 0; group < groupCount; ++group) {
+            entries[group] = BucketEntry{bandKey(&signatures[group * SIGNATURE_SIZE], band),
+                                         static_cast<uint32_t>(group)};
+        }
+        sort(entries.begin(), entries.end(), [](const BucketEntry& a, const BucketEntry& b) {
+            return a.key < b.key || (a.key == b.key && a.group < b.group);
+        });
+    };
+
+    for (size_t next = 0; next < BANDS; next += threads) {
+        for (size_t band = next + 1; band < min(BANDS, next + threads); ++band) {
+            workers.emplace_back(buildBand, band);
+        }
+        buildBand(next);
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+    }
+}
+
+/**
+ * Finds the definitions most similar to one definition
+ * Inputs:
+ *   - uint32_t group: Distinct-definition id to match.
+ *   - size_t k: Number of neighbours wanted.
+ *   - const vector<uint32_t>& excluded: Sorted group ids that must not be returned.
+ *   - vector<uint32_t>& out: Receives up to k group ids, most similar first.
+ */
+void SimilarityIndex::nearest(uint32_t group, size_t k, const vector<uint32_t>& excluded, vector<uint32_t>& out) const {
+    out.clear();
+    if (group >= groupCount) {
+        return;
+    }
+
+    const uint16_t* signature = &signatures[group * SIGNATURE_SIZE];
+    vector<uint32_t> candidates;
+
+    for (size_t band = 0; band < BANDS; ++band) {
+        BucketEntry probe{bandKey(signature, band), 0};
+        auto range = lower_bound(buckets[band].begin(), buckets[band].end(), probe,
+                                 [](const BucketEntry& a, const BucketEntry& b) { return a.key < b.key; });
+        size_t scanned = 0;
+        for (auto it = range; it != buckets[band].end() && it->key == probe.key && scanned < MAX_BUCKET_SCAN; ++it) {
+            if (it->group != group && !binary_search(excluded.begin(), excluded.end(), it->group)) {
+                candidates.push_back(it->group);
+            }
+            ++scanned;
+        }
+    }
+
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()), candidates.end());
+
+    // Rank by estimated Jaccard similarity: the number of agreeing signature values
+    vector<pair<uint32_t, uint32_t>> scored;
+    scored.reserve(candidates.size());
+    for (uint32_t candidate : candidates) {
+        const uint16_t* other = &signatures[candidate * SIGNATURE_SIZE];
+        uint32_t agree = 0;
+        for (size_t i = 0; i < SIGNATURE_SIZE; ++i) {
+            agree += signature[i] == other[i];
+        }
+        scored.emplace_back(agree, candidate);
+    }
+
+    size_t count = min(k, scored.size());
+    partial_sort(scored.begin(), scored.begin() + count, scored.end(),
+                 [](const pair<uint32_t, uint32_t>& a, const pair<uint32_t, uint32_t>& b) {
+                     return a.first > b.first || (a.first == b.first && a.second < b.second);
+                 });
+    for (size_t i = 0; i < count; ++i) {
+        out.push_back(scored[i].second);
+    }
+}
+
+/**
+ * Saves the index next to its deck
+ * Inputs:
+ *   - const string& path: Cache file to write.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool SimilarityIndex::save(const string& path, string& error) const {
+    SimilarityHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SIMILARITY_MAGIC, sizeof(header.magic));
+    header.version = SIMILARITY_VERSION;
+    header.signatureSize = SIGNATURE_SIZE;
+    header.groupCount = groupCount;
+    header.fingerprint = fingerprint;
+
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        outFile.write(reinterpret_cast<const char*>(signatures.data()),
+                      static_cast<streamsize>(signatures.size() * sizeof(uint16_t)));
+        for (size_t band = 0; band < BANDS; ++band) {
+            outFile.write(reinterpret_cast<const char*>(buckets[band].data()),
+                          static_cast<streamsize>(buckets[band].size() * sizeof(BucketEntry)));
+        }
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Loads a cached index
+ * Inputs:
+ *   - const string& path: Cache file.
+ *   - const CardStore& cards: The deck; the cache is ignored if it was built for other contents.
+ *   - string& error: Receives the reason the cache could not be used.
+ * Returns:
+ *   - bool: True if the cache matches the deck and was loaded.
+ */
+bool SimilarityIndex::load(const string& path, const CardStore& cards, string& error) {
+    ifstream inFile(path, ios::binary);
+    if (!inFile.is_open()) {
+        error = "no cached index at " + path;
+        return false;
+    }
+
+    SimilarityHeader header;
+    if (!inFile.read(reinterpret_cast<char*>(&header), sizeof(header))
+        || memcmp(header.magic, SIMILARITY_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SIMILARITY_VERSION || header.signatureSize != SIGNATURE_SIZE) {
+        error = path + " is not a compatible similarity index";
+        return false;
+    }
+    if (header.fingerprint != deckFingerprint(cards) || header.groupCount > cards.size()) {
+        error = path + " was built for a different deck";
+        return false;
+    }
+
+    groupCount = static_cast<size_t>(header.groupCount);
+    fingerprint = header.fingerprint;
+    signatures.resize(groupCount * SIGNATURE_SIZE);
+    inFile.read(reinterpret_cast<char*>(signatures.data()),
+                static_cast<streamsize>(signatures.size() * sizeof(uint16_t)));
+    for (size_t band = 0; band < BANDS; ++band) {
+        buckets[band].resize(groupCount);
+        inFile.read(reinterpret_cast<char*>(buckets[band].data()),
+                    static_cast<streamsize>(groupCount * sizeof(BucketEntry)));
+    }
+
+    if (!inFile) {
+        error = path + " is truncated";
+        *this = SimilarityIndex();
+        return false;
+    }
+    return true;
+}
+
+size_t SimilarityIndex::memoryBytes() const {
+    size_t bytes = signatures.capacity() * sizeof(uint16_t);
+    for (size_t band = 0; band < BANDS; ++band) {
+        bytes += buckets[band].capacity() * sizeof(BucketEntry);
+    }
+    return bytes;
+}
@@ -0,0 +1,95 @@
+/**
+ * similarity.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for SimilarityIndex, the MinHash/LSH index behind the multiple-choice "hard" mode.
+ * Each distinct definition gets a 32-value MinHash signature over its character 3-grams (one-permutation
+ * hashing, so one hash per 3-gram). Signatures are split into 8 bands of 4; definitions sharing a band
+ * land in the same bucket, and a question ranks only the definitions in its own buckets.
+ * The index is built once per deck across all cores and can be cached in a file next to the deck.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SIMILARITY_H
+#define M2AP_SIMILARITY_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cardindex.h"
+#include "cardstore.h"
+using namespace std;
+
+class SimilarityIndex {
+public:
+    static constexpr size_t SIGNATURE_SIZE = 32;
+    static constexpr size_t BANDS = 8;
+    static constexpr size_t ROWS = SIGNATURE_SIZE / BANDS;
+
+private:
+    struct BucketEntry {
+        uint32_t key;     // Hash of one band of a signature
+        uint32_t group;   // Distinct-definition id
+    };
+
+    size_t groupCount;
+    uint64_t fingerprint;                 // Identifies the deck the index was built for
+    vector<uint16_t> signatures;          // groupCount * SIGNATURE_SIZE values
+    vector<BucketEntry> buckets[BANDS];   // Sorted by key
+
+    static uint32_t bandKey(const uint16_t* signature, size_t band);
+
+public:
+    SimilarityIndex();
+
+    /**
+     * Builds the index
+     * Inputs:
+     *   - const CardStore& cards: Deck text.
+     *   - const CardIndex& index: Distinct-definition numbering for the deck.
+     *   - unsigned threads: Worker threads; 0 uses every core.
+     */
+    void build(const CardStore& cards, const CardIndex& index, unsigned threads = 0);
+
+    /**
+     * Finds the definitions most similar to one definition
+     * Inputs:
+     *   - uint32_t group: Distinct-definition id to match.
+     *   - size_t k: Number of neighbours wanted.
+     *   - const vector<uint32_t>& excluded: Sorted group ids that must not be returned.
+     *   - vector<uint32_t>& out: Receives up to k group ids, most similar first.
+     * Description:
+     *   - Only groups that share at least one LSH band are considered, so this may return fewer than k.
+     */
+    void nearest(uint32_t group, size_t k, const vector<uint32_t>& excluded, vector<uint32_t>& out) const;
+
+    /**
+     * Saves the index next to its deck
+     * Inputs:
+     *   - const string& path: Cache file to write (written to a temporary file and renamed).
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool save(const string& path, string& error) const;
+
+    /**
+     * Loads a cached index
+     * Inputs:
+     *   - const string& path: Cache file.
+     *   - const CardStore& cards: The deck; the cache is ignored if it was built for other contents.
+     *   - string& error: Receives the reason the cache could not be used.
+     * Returns:
+     *   - bool: True if the cache matches the deck and was loaded.
+     */
+    bool load(const string& path, const CardStore& cards, string& error);
+
+    /**
+     * Fingerprint of a deck's contents, used to tie a cache file to its deck
+     */
+    static uint64_t deckFingerprint(const CardStore& cards);
+
+    size_t size() const { return groupCount; }
+    size_t memoryBytes() const;
+};
+
+#endif // M2AP_SIMILARITY_H
@@ -0,0 +1,143 @@
+/**
+ * spscring.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for SpscRing, a bounded queue between exactly one producer thread and one consumer thread.
+ * Pushing and popping are lock-free: each side owns one index and publishes it with a release store, so
+ * a slot is handed over with no lock and no allocation. Only a side that finds the ring full (producer)
+ * or empty (consumer) parks on a condition variable, and the other side takes the lock to wake it only
+ * when it has announced that it is parked.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SPSCRING_H
+#define M2AP_SPSCRING_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+template <class T>
+class SpscRing {
+private:
+    vector<T> slots;
+    size_t mask;
+    alignas(64) atomic<size_t> head;        // Next slot to pop; written by the consumer
+    alignas(64) atomic<size_t> tail;        // Next slot to push; written by the producer
+    alignas(64) atomic<bool> producerParked;
+    atomic<bool> consumerParked;
+    atomic<bool> closed;
+    mutex parking;
+    condition_variable wake;
+
+    void wakeIf(atomic<bool>& parked) {
+        // Sequentially consistent with the index store before it, so a side about to park either sees the
+        // new index or is seen as parked here
+        if (parked.load()) {
+            lock_guard<mutex> guard(parking);
+            wake.notify_all();
+        }
+    }
+
+public:
+    /**
+     * Constructor
+     * @param capacity Items the ring holds; rounded up to a power of two, at least 2.
+     */
+    explicit SpscRing(size_t capacity)
+            : mask(0), head(0), tail(0), producerParked(false), consumerParked(false), closed(false) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return slots.size(); }
+
+    /**
+     * Producer: adds an item without waiting
+     * Returns:
+     *   - bool: False if the ring is full.
+     */
+    bool tryPush(const T& item) {
+        size_t at = tail.load(memory_order_relaxed);
+        if (at - head.load(memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[at & mask] = item;
+        tail.store(at + 1);
+        wakeIf(consumerParked);
+        return true;
+    }
+
+    /**
+     * Consumer: takes the oldest item without waiting
+     * Returns:
+     *   - bool: False if the ring is empty.
+     */
+    bool tryPop(T& item) {
+        size_t at = head.load(memory_order_relaxed);
+        if (at == tail.load(memory_order_acquire)) {
+            return false;
+        }
+        item = slots[at & mask];
+        head.store(at + 1);
+        wakeIf(producerParked);
+        return true;
+    }
+
+    /**
+     * Producer: adds an item, waiting while the ring is full
+     * Returns:
+     *   - bool: False if the ring was closed instead.
+     */
+    bool push(const T& item) {
+        while (!tryPush(item)) {
+            unique_lock<mutex> guard(parking);
+            producerParked.store(true);
+            wake.wait(guard, [this] { return closed.load() || tail.load() - head.load() < slots.size(); });
+            producerParked.store(false);
+            if (closed.load()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Consumer: takes the oldest item, waiting while the ring is empty
+     * Returns:
+     *   - bool: False if the ring was closed and is empty.
+     */
+    bool pop(T& item) {
+        while (!tryPop(item)) {
+            unique_lock<mutex> guard(parking);
+            consumerParked.store(true);
+            wake.wait(guard, [this] { return closed.load() || head.load() != tail.load(); });
+            consumerParked.store(false);
+            if (closed.load() && head.load() == tail.load()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Wakes both sides for good: push() then fails, and pop() fails once the ring is empty
+     */
+    void close() {
+        lock_guard<mutex> guard(parking);
+        closed.store(true);
+        wake.notify_all();
+    }
+};
+
+#endif // M2AP_SPSCRING_H
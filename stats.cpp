@@ -0,0 +1,399 @@
+/**
+ * stats.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for SessionStats.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+using namespace std;
+
+namespace {
+
+const char STATS_MAGIC[8] = {'S', 'T', 'S', 'T', 'A', 'T', 'S', '\n'};
+const uint32_t STATS_VERSION = 1;
+const size_t SUMMARY_WEAKEST = 10;
+
+template <class T>
+void writeValue(ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <class T>
+bool readValue(istream& in, T& value) {
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void writeJsonString(ostream& out, string_view text) {
+    out << '"';
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c == '\n') {
+            out << "\\n";
+        } else if (c == '\t') {
+            out << "\\t";
+        } else if (byte < 0x20) {
+            out << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(byte) << dec << setfill(' ');
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+bool replaceFile(const string& tempPath, const string& path, string& error) {
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+SessionStats::SessionStats() : lastSequence(0) {}
+
+SessionStats::ModeAggregate& SessionStats::aggregateFor(const string& gameMode) {
+    for (ModeAggregate& aggregate : modes) {
+        if (aggregate.gameMode == gameMode) {
+            return aggregate;
+        }
+    }
+    modes.push_back(ModeAggregate{gameMode, 0, 0, 0, 0, {}, 0, 0, {}});
+    return modes.back();
+}
+
+/**
+ * Adds a finished game
+ * Inputs:
+ *   - uint64_t sequence: The game's journal sequence number.
+ *   - const GameSession& session: The game.
+ */
+void SessionStats::record(uint64_t sequence, const GameSession& session) {
+    if (sequence != 0 && sequence <= lastSequence) {
+        return;
+    }
+    lastSequence = max(lastSequence, sequence);
+
+    ModeAggregate& aggregate = aggregateFor(session.gameMode);
+    int score = max(session.numCorrectAnswers, 0);
+
+    aggregate.best = aggregate.count == 0 ? score : max(aggregate.best, score);
+    aggregate.worst = aggregate.count == 0 ? score : min(aggregate.worst, score);
+    ++aggregate.count;
+    aggregate.sum += score;
+
+    aggregate.recent[aggregate.recentNext] = score;
+    aggregate.recentNext = (aggregate.recentNext + 1) % WINDOW;
+    aggregate.recentCount = min<uint32_t>(aggregate.recentCount + 1, WINDOW);
+
+    if (static_cast<size_t>(score) >= aggregate.histogram.size()) {
+        aggregate.histogram.resize(static_cast<size_t>(score) + 1, 0);
+    }
+    ++aggregate.histogram[score];
+}
+
+/**
+ * Adds per-card results
+ */
+void SessionStats::recordOutcomes(const vector<CardOutcome>& outcomes) {
+    for (const CardOutcome& outcome : outcomes) {
+        if (outcome.card >= cardAttempts.size()) {
+            cardAttempts.resize(outcome.card + 1, 0);
+            cardCorrect.resize(outcome.card + 1, 0);
+        }
+        ++cardAttempts[outcome.card];
+        cardCorrect[outcome.card] += outcome.correct;
+    }
+}
+
+/**
+ * Nearest-rank percentile from the histogram
+ */
+int SessionStats::percentile(const ModeAggregate& aggregate, double fraction) {
+    uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(fraction * aggregate.count)));
+    uint64_t seen = 0;
+    for (size_t score = 0; score < aggregate.histogram.size(); ++score) {
+        seen += aggregate.histogram[score];
+        if (seen >= rank) {
+            return static_cast<int>(score);
+        }
+    }
+    return aggregate.best;
+}
+
+/**
+ * Summary of one game mode
+ * Inputs:
+ *   - const string& gameMode: Mode name as recorded.
+ *   - ModeSummary& out: Receives the summary.
+ * Returns:
+ *   - bool: False if no game of this mode has been recorded.
+ */
+bool SessionStats::summarize(const string& gameMode, ModeSummary& out) const {
+    for (const ModeAggregate& aggregate : modes) {
+        if (aggregate.gameMode != gameMode || aggregate.count == 0) {
+            continue;
+        }
+        out.gameMode = gameMode;
+        out.count = aggregate.count;
+        out.mean = static_cast<double>(aggregate.sum) / static_cast<double>(aggregate.count);
+        out.best = aggregate.best;
+        out.worst = aggregate.worst;
+        out.median = percentile(aggregate, 0.5);
+        out.p90 = percentile(aggregate, 0.9);
+
+        out.recent.clear();
+        size_t start = (aggregate.recentNext + WINDOW - aggregate.recentCount) % WINDOW;
+        int64_t recentSum = 0;
+        for (size_t i = 0; i < aggregate.recentCount; ++i) {
+            out.recent.push_back(aggregate.recent[(start + i) % WINDOW]);
+            recentSum += out.recent.back();
+        }
+        out.recentMean = static_cast<double>(recentSum) / static_cast<double>(aggregate.recentCount);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Cards answered wrong most often this run
+ */
+void SessionStats::weakestCards(size_t k, vector<CardId>& out) const {
+    out.clear();
+    for (CardId card = 0; card < cardAttempts.size(); ++card) {
+        if (cardCorrect[card] < cardAttempts[card]) {
+            out.push_back(card);
+        }
+    }
+
+    // Lowest accuracy first (compared without division), then most attempts
+    auto weaker = [this](CardId a, CardId b) {
+        uint64_t left = static_cast<uint64_t>(cardCorrect[a]) * cardAttempts[b];
+        uint64_t right = static_cast<uint64_t>(cardCorrect[b]) * cardAttempts[a];
+        if (left != right) {
+            return left < right;
+        }
+        return cardAttempts[a] > cardAttempts[b] || (cardAttempts[a] == cardAttempts[b] && a < b);
+    };
+    size_t count = min(k, out.size());
+    partial_sort(out.begin(), out.begin() + count, out.end(), weaker);
+    out.resize(count);
+}
+
+/**
+ * Prints a mode's breakdown, and the weakest cards of this run, to the terminal
+ */
+void SessionStats::print(const string& gameMode, const CardStore& cards, ostream& out) const {
+    ModeSummary summary;
+    if (!summarize(gameMode, summary)) {
+        out << "No " << gameMode << " games recorded yet." << endl;
+        return;
+    }
+
+    out << fixed << setprecision(1);
+    out << gameMode << ": " << summary.count << " games, mean " << summary.mean << ", best " << summary.best
+        << ", worst " << summary.worst << ", median " << summary.median << ", 90th percentile " << summary.p90
+        << endl;
+    out << "Last " << summary.recent.size() << " games (mean " << summary.recentMean << "):";
+    for (int score : summary.recent) {
+        out << " " << score;
+    }
+    out << endl;
+    out.unsetf(ios::floatfield);
+    out << setprecision(6);
+
+    vector<CardId> weakest;
+    weakestCards(5, weakest);
+    if (!weakest.empty()) {
+        out << "Cards to work on this run:" << endl;
+        for (CardId card : weakest) {
+            if (card < cards.size()) {
+                out << "  " << cards.term(card) << " - " << cardCorrect[card] << " of " << cardAttempts[card]
+                    << " correct" << endl;
+            }
+        }
+    }
+}
+
+/**
+ * Saves the aggregates
+ * Inputs:
+ *   - const string& path: State file.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool SessionStats::save(const string& path, string& error) const {
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile.write(STATS_MAGIC, sizeof(STATS_MAGIC));
+        writeValue(outFile, STATS_VERSION);
+        writeValue(outFile, lastSequence);
+        writeValue(outFile, static_cast<uint32_t>(modes.size()));
+        for (const ModeAggregate& aggregate : modes) {
+            writeValue(outFile, static_cast<uint32_t>(aggregate.gameMode.size()));
+            outFile.write(aggregate.gameMode.data(), static_cast<streamsize>(aggregate.gameMode.size()));
+            writeValue(outFile, aggregate.count);
+            writeValue(outFile, aggregate.sum);
+            writeValue(outFile, static_cast<int32_t>(aggregate.best));
+            writeValue(outFile, static_cast<int32_t>(aggregate.worst));
+            writeValue(outFile, aggregate.recentCount);
+            writeValue(outFile, aggregate.recentNext);
+            for (size_t i = 0; i < WINDOW; ++i) {
+                writeValue(outFile, static_cast<int32_t>(aggregate.recent[i]));
+            }
+            writeValue(outFile, static_cast<uint32_t>(aggregate.histogram.size()));
+            outFile.write(reinterpret_cast<const char*>(aggregate.histogram.data()),
+                          static_cast<streamsize>(aggregate.histogram.size() * sizeof(uint64_t)));
+        }
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return replaceFile(tempPath, path, error);
+}
+
+/**
+ * Loads saved aggregates
+ * Inputs:
+ *   - const string& path: State file. A missing file leaves the statistics empty.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool SessionStats::load(const string& path, string& error) {
+    *this = SessionStats();
+    ifstream inFile(path, ios::binary);
+    if (!inFile.is_open()) {
+        return true;
+    }
+
+    char magic[sizeof(STATS_MAGIC)];
+    uint32_t version = 0;
+    uint32_t modeCount = 0;
+    if (!inFile.read(magic, sizeof(magic)) || memcmp(magic, STATS_MAGIC, sizeof(magic)) != 0
+        || !readValue(inFile, version) || version != STATS_VERSION || !readValue(inFile, lastSequence)
+        || !readValue(inFile, modeCount)) {
+        error = path + " is not a compatible statistics file";
+        *this = SessionStats();
+        return false;
+    }
+
+    for (uint32_t m = 0; m < modeCount && inFile; ++m) {
+        ModeAggregate aggregate{};
+        uint32_t nameLength = 0;
+        int32_t best = 0;
+        int32_t worst = 0;
+        uint32_t histogramSize = 0;
+        if (!readValue(inFile, nameLength) || nameLength > 1024) {
+            break;
+        }
+        aggregate.gameMode.resize(nameLength);
+        inFile.read(&aggregate.gameMode[0], nameLength);
+        readValue(inFile, aggregate.count);
+        readValue(inFile, aggregate.sum);
+        readValue(inFile, best);
+        readValue(inFile, worst);
+        readValue(inFile, aggregate.recentCount);
+        readValue(inFile, aggregate.recentNext);
+        for (size_t i = 0; i < WINDOW; ++i) {
+            int32_t score = 0;
+            readValue(inFile, score);
+            aggregate.recent[i] = score;
+        }
+        if (!readValue(inFile, histogramSize) || histogramSize > (1u << 24) || aggregate.recentCount > WINDOW
+            || aggregate.recentNext >= WINDOW) {
+            inFile.setstate(ios::failbit);
+            break;
+        }
+        aggregate.best = best;
+        aggregate.worst = worst;
+        aggregate.histogram.resize(histogramSize);
+        inFile.read(reinterpret_cast<char*>(aggregate.histogram.data()),
+                    static_cast<streamsize>(histogramSize * sizeof(uint64_t)));
+        modes.push_back(std::move(aggregate));
+    }
+
+    if (!inFile) {
+        error = path + " is truncated";
+        *this = SessionStats();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes summary.json: every mode's summary and the weakest cards of this run
+ */
+bool SessionStats::writeSummary(const string& path, const CardStore& cards, string& error) const {
+    ostringstream json;
+    json << setprecision(4);
+    auto now = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch());
+    json << "{\n  \"generated\": " << now.count() << ",\n  \"lastSequence\": " << lastSequence
+         << ",\n  \"modes\": {";
+
+    for (size_t m = 0; m < modes.size(); ++m) {
+        ModeSummary summary;
+        if (!summarize(modes[m].gameMode, summary)) {
+            continue;
+        }
+        json << (m > 0 ? ",\n    " : "\n    ");
+        writeJsonString(json, summary.gameMode);
+        json << ": {\"count\": " << summary.count << ", \"mean\": " << summary.mean << ", \"best\": " << summary.best
+             << ", \"worst\": " << summary.worst << ", \"median\": " << summary.median << ", \"p90\": "
+             << summary.p90 << ", \"recentMean\": " << summary.recentMean << ", \"recent\": [";
+        for (size_t i = 0; i < summary.recent.size(); ++i) {
+            json << (i > 0 ? ", " : "") << summary.recent[i];
+        }
+        json << "]}";
+    }
+    json << "\n  },\n  \"weakestCards\": [";
+
+    vector<CardId> weakest;
+    weakestCards(SUMMARY_WEAKEST, weakest);
+    bool first = true;
+    for (CardId card : weakest) {
+        if (card >= cards.size()) {
+            continue;
+        }
+        json << (first ? "\n    " : ",\n    ") << "{\"term\": ";
+        writeJsonString(json, cards.term(card));
+        json << ", \"attempts\": " << cardAttempts[card] << ", \"correct\": " << cardCorrect[card] << "}";
+        first = false;
+    }
+    json << (first ? "]\n}\n" : "\n  ]\n}\n");
+
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile << json.str();
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    return replaceFile(tempPath, path, error);
+}
@@ -0,0 +1,137 @@
+/**
+ * stats.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for SessionStats, the score statistics shown after games.
+ * Aggregates are updated in O(1) as each game is recorded: per game mode a count, sum, best and worst,
+ * a ring buffer of the last WINDOW scores, and a histogram of scores (scores are small whole numbers,
+ * so percentiles are exact and cost one pass over the distinct scores, never over the history).
+ * Aggregates persist in a small binary state file; summary.json is written next to it for plots.py and
+ * other readers. Per-card accuracy covers the games played in this run, since card ids belong to a deck.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_STATS_H
+#define M2AP_STATS_H
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "cardstore.h"
+#include "studytool.h"
+using namespace std;
+
+struct ModeSummary {
+    string gameMode;
+    uint64_t count;
+    double mean;
+    int best;
+    int worst;
+    int median;
+    int p90;
+    double recentMean;
+    vector<int> recent;     // Last WINDOW scores, oldest first
+};
+
+class SessionStats {
+public:
+    static const size_t WINDOW = 10;
+
+private:
+    struct ModeAggregate {
+        string gameMode;
+        uint64_t count;
+        int64_t sum;
+        int best;
+        int worst;
+        int recent[WINDOW];
+        uint32_t recentCount;
+        uint32_t recentNext;
+        vector<uint64_t> histogram;   // Games per score
+    };
+
+    vector<ModeAggregate> modes;      // A handful of modes, so a linear search beats a map
+    uint64_t lastSequence;
+    vector<uint32_t> cardAttempts;
+    vector<uint32_t> cardCorrect;
+
+    ModeAggregate& aggregateFor(const string& gameMode);
+    static int percentile(const ModeAggregate& aggregate, double fraction);
+
+public:
+    SessionStats();
+
+    /**
+     * Adds a finished game
+     * Inputs:
+     *   - uint64_t sequence: The game's journal sequence number; games at or before the last one recorded
+     *     are ignored, so replaying the journal twice is harmless.
+     *   - const GameSession& session: The game.
+     */
+    void record(uint64_t sequence, const GameSession& session);
+
+    /**
+     * Adds per-card results
+     * Inputs:
+     *   - const vector<CardOutcome>& outcomes: Cards asked in a game and whether each was answered correctly.
+     */
+    void recordOutcomes(const vector<CardOutcome>& outcomes);
+
+    /**
+     * Summary of one game mode
+     * Inputs:
+     *   - const string& gameMode: Mode name as recorded.
+     *   - ModeSummary& out: Receives the summary.
+     * Returns:
+     *   - bool: False if no game of this mode has been recorded.
+     */
+    bool summarize(const string& gameMode, ModeSummary& out) const;
+
+    /**
+     * Cards answered wrong most often this run
+     * Inputs:
+     *   - size_t k: Number of cards wanted.
+     *   - vector<CardId>& out: Receives up to k cards with at least one miss, lowest accuracy first.
+     */
+    void weakestCards(size_t k, vector<CardId>& out) const;
+
+    /**
+     * Prints a mode's breakdown, and the weakest cards of this run, to the terminal
+     * Inputs:
+     *   - const string& gameMode: Mode to show.
+     *   - const CardStore& cards: Deck, for the terms of the weakest cards.
+     *   - ostream& out: Where to print.
+     */
+    void print(const string& gameMode, const CardStore& cards, ostream& out) const;
+
+    /**
+     * Saves the aggregates
+     * Inputs:
+     *   - const string& path: State file (written to a temporary file and renamed).
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool save(const string& path, string& error) const;
+
+    /**
+     * Loads saved aggregates
+     * Inputs:
+     *   - const string& path: State file. A missing file leaves the statistics empty and is not an error.
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool load(const string& path, string& error);
+
+    /**
+     * Writes summary.json: every mode's summary and the weakest cards of this run
+     * Inputs:
+     *   - const string& path: File to write (written to a temporary file and renamed).
+     *   - const CardStore& cards: Deck, for the terms of the weakest cards.
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool writeSummary(const string& path, const CardStore& cards, string& error) const;
+
+    uint64_t lastRecorded() const { return lastSequence; }
+};
+
+#endif // M2AP_STATS_H
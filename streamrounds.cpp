@@ -0,0 +1,337 @@
+/**
+ * streamrounds.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the game rounds over a DeckStream.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "streamrounds.h"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+using namespace std;
+
+namespace {
+
+const size_t DISTRACTORS = 3;
+const size_t DISTRACTOR_DRAWS = 16;     // Reservoir draws per question before settling for fewer options
+
+// Matching shuffles the whole deck, which a stream never holds
+class MatchingUnavailable : public GameRound {
+public:
+    explicit MatchingUnavailable(const CardStore& deckCards) : GameRound(deckCards) {}
+
+    void start(GameRenderer& out) override {
+        out.message("The matching game needs the whole deck in memory, so it cannot be played from a stream.");
+        done = true;
+    }
+    void submit(string_view, GameRenderer&) override {}
+    const char* name() const override { return "MatchingGame"; }
+};
+
+} // namespace
+
+StreamFlashcardRound::StreamFlashcardRound(DeckStream& deckStream)
+        : GameRound(deckStream.cards()), stream(deckStream), step(Step::FLIP), card(0), position(0) {}
+
+/**
+ * Shows the next card of the pass, from the next chunk if this one is done, or asks about the starred
+ * cards at the end of the deck
+ */
+void StreamFlashcardRound::showNext(GameRenderer& out) {
+    if (++card >= cards.size()) {
+        string error;
+        if (!stream.next(error)) {
+            if (!error.empty()) {
+                out.message(error);
+            }
+            step = Step::STUDY_STARRED;
+            out.askStudyStarred();
+            return;
+        }
+        card = 0;
+    }
+    step = Step::FLIP;
+    out.showTerm(cards.term(card), false);
+    out.askFlip();
+}
+
+void StreamFlashcardRound::start(GameRenderer& out) {
+    stream.rewind();
+    string error;
+    if (!stream.next(error)) {
+        if (!error.empty()) {
+            out.message(error);
+        }
+        step = Step::STUDY_STARRED;
+        out.askStudyStarred();
+        return;
+    }
+    out.showTerm(cards.term(0), false);
+    out.askFlip();
+}
+
+/**
+ * Advances the flashcard round, as FlashcardRound does without a scheduler
+ */
+void StreamFlashcardRound::submit(string_view answer, GameRenderer& out) {
+    switch (step) {
+        case Step::FLIP:
+            out.clear();
+            out.showDefinition(cards.def(card));
+            step = Step::STAR;
+            out.askStar();
+            break;
+
+        case Step::STAR:
+            if (answer == "star") {
+                starred.addCard(cards.term(card), cards.def(card));
+            } else if (!answer.empty()) {
+                out.askStar();
+                break;
+            }
+            showNext(out);
+            break;
+
+        case Step::STUDY_STARRED:
+            if (answer == "y" && !starred.empty()) {
+                step = Step::STARRED_FLIP;
+                position = 0;
+                out.showTerm(starred.term(0), false);
+                out.askFlip();
+            } else if (answer == "y" || answer == "n") {
+                done = true;
+            } else {
+                out.message("That was an invalid response, try again.");
+                out.askStudyStarred();
+            }
+            break;
+
+        case Step::STARRED_FLIP:
+            out.clear();
+            out.showDefinition(starred.def(static_cast<CardId>(position)));
+            if (++position < starred.size()) {
+                out.showTerm(starred.term(static_cast<CardId>(position)), false);
+                out.askFlip();
+            } else {
+                done = true;
+            }
+            break;
+    }
+}
+
+StreamMultipleChoiceRound::StreamMultipleChoiceRound(DeckStream& deckStream, FastRng& random)
+        : GameRound(deckStream.cards()), stream(deckStream), rng(random), question(0), correctChoice(0) {}
+
+/**
+ * Shows the current question with the right answer slotted in among the distractors
+ * Description:
+ *   - Distractors are reservoir cards with a different term and definition from the question and from
+ *     each other. The options are copied into a small store of their own, since they come from all over
+ *     the deck.
+ */
+void StreamMultipleChoiceRound::ask(GameRenderer& out) {
+    string_view term = cards.term(question);
+    string_view def = cards.def(question);
+    out.showTerm(term, false);
+    uint64_t questionStart = phaseStart();
+
+    const CardStore& pool = stream.pool();
+    picked.clear();
+    for (size_t draw = 0; draw < DISTRACTOR_DRAWS && picked.size() < DISTRACTORS && !pool.empty(); ++draw) {
+        uint32_t slot = rng.below(static_cast<uint32_t>(pool.size()));
+        if (pool.term(slot) == term || pool.def(slot) == def) {
+            continue;
+        }
+        bool repeated = false;
+        for (uint32_t other : picked) {
+            repeated = repeated || pool.def(other) == pool.def(slot);
+        }
+        if (!repeated) {
+            picked.push_back(slot);
+        }
+    }
+
+    size_t randomIndex = rng.below(static_cast<uint32_t>(picked.size() + 1));
+    correctChoice = randomIndex + 1;
+    optionCards = CardStore();
+    options.clear();
+    for (size_t i = 0; i <= picked.size(); ++i) {
+        if (i == randomIndex) {
+            optionCards.addCard(term, def);
+        } else {
+            uint32_t slot = picked[i < randomIndex ? i : i - 1];
+            optionCards.addCard(pool.term(slot), pool.def(slot));
+        }
+        options.push_back(static_cast<CardId>(i));
+    }
+    phaseEnd(Phase::QUESTION, questionStart);
+
+    out.showChoices(optionCards, options);
+    out.askChoice(options.size(), false);
+}
+
+void StreamMultipleChoiceRound::start(GameRenderer& out) {
+    stream.rewind();
+    string error;
+    if (!stream.next(error)) {
+        if (!error.empty()) {
+            out.message(error);
+        }
+        done = true;
+        return;
+    }
+    ask(out);
+}
+
+/**
+ * Takes a guess at the current question; anything but a number between 1 and the number of options is
+ * asked again
+ */
+void StreamMultipleChoiceRound::submit(string_view answer, GameRenderer& out) {
+    uint64_t gradeStart = phaseStart();
+    size_t guess = 0;
+    if (!parseChoice(answer, options.size(), guess)) {
+        out.askChoice(options.size(), true);
+        return;
+    }
+
+    bool correct = guess == correctChoice;
+    phaseEnd(Phase::GRADE, gradeStart);
+    outcomes.push_back({static_cast<CardId>(stream.firstCard() + question), correct, 0});
+    out.showChoiceResult(correct, correctChoice);
+    if (correct) {
+        ++score;
+    }
+
+    if (++question < cards.size()) {
+        ask(out);
+        return;
+    }
+    string error;
+    if (stream.next(error)) {
+        question = 0;
+        ask(out);
+        return;
+    }
+    if (!error.empty()) {
+        out.message(error);
+    }
+    done = true;
+}
+
+StreamTimedRound::StreamTimedRound(DeckStream& deckStream, AnswerGrader& answerGrader, int timeLimitSeconds)
+        : GameRound(deckStream.cards()), stream(deckStream), grader(answerGrader), timeLimit(timeLimitSeconds),
+          started(false), exhausted(false), card(0) {}
+
+/**
+ * Shows the current term with the seconds left, or ends the challenge if time is up or the deck is done
+ */
+void StreamTimedRound::ask(GameRenderer& out) {
+    if (!exhausted && card >= cards.size()) {
+        string error;
+        exhausted = !stream.next(error);
+        card = 0;
+        if (!error.empty()) {
+            out.message(error);
+        }
+    }
+    auto now = chrono::steady_clock::now();
+    if (exhausted || now >= endTime) {
+        finish(out, !exhausted);
+        return;
+    }
+    auto left = chrono::duration_cast<chrono::milliseconds>(endTime - now).count();
+    out.showCountdown(static_cast<int>((left + 999) / 1000));
+    out.showTerm(cards.term(card), true);
+    askedAt = now;
+}
+
+/**
+ * Shows the answer times and the score and ends the challenge. The score is out of the cards answered,
+ * as the size of a streamed deck is not known until it has been read to the end.
+ */
+void StreamTimedRound::finish(GameRenderer& out, bool timedOut) {
+    if (timedOut) {
+        out.message("Time's up! Challenge completed.");
+    }
+    if (!outcomes.empty()) {
+        out.message(describeAnswerTimes(outcomes));
+    }
+    out.showScore("Time-Based Challenge", score, outcomes.size());
+    done = true;
+}
+
+// The first chunk is read while the learner reads the instructions
+void StreamTimedRound::start(GameRenderer& out) {
+    out.message("Time-Based Challenge: Answer as many questions as possible within " + to_string(timeLimit) +
+                " seconds.");
+    out.message("Press enter to start the challenge...");
+    stream.rewind();
+    string error;
+    exhausted = !stream.next(error);
+    if (!error.empty()) {
+        out.message(error);
+    }
+}
+
+/**
+ * Pushes an answer. The limit is strict: an answer that arrives after the deadline is not graded.
+ */
+void StreamTimedRound::submit(string_view answer, GameRenderer& out) {
+    auto now = chrono::steady_clock::now();
+    if (!started) {
+        started = true;
+        endTime = now + chrono::seconds(timeLimit);
+        ask(out);
+        return;
+    }
+    if (now >= endTime) {
+        expire(out);
+        return;
+    }
+
+    int64_t answerMicros = chrono::duration_cast<chrono::microseconds>(now - askedAt).count();
+    uint64_t gradeStart = phaseStart();
+    GradeResult result = gradeAgainstTerm(cards, stream.index(), grader, card, answer);
+    phaseEnd(Phase::GRADE, gradeStart);
+    out.showGrade(cards.def(card), result);
+    outcomes.push_back({static_cast<CardId>(stream.firstCard() + card), result.accepted,
+                        static_cast<uint32_t>(min<int64_t>(answerMicros, UINT32_MAX))});
+    if (result.accepted) {
+        ++score;
+    }
+    ++card;
+    ask(out);
+}
+
+bool StreamTimedRound::deadline(chrono::steady_clock::time_point& when) const {
+    if (!started || done) {
+        return false;
+    }
+    when = endTime;
+    return true;
+}
+
+void StreamTimedRound::expire(GameRenderer& out) {
+    if (!done) {
+        finish(out, true);
+    }
+}
+
+unique_ptr<GameRound> makeStreamRound(RoundKind kind, DeckStream& stream, FastRng& rng, AnswerGrader& grader,
+                                      int timeLimit) {
+    switch (kind) {
+        case RoundKind::FLASHCARDS:
+            return make_unique<StreamFlashcardRound>(stream);
+        case RoundKind::MULTIPLE_CHOICE:
+            return make_unique<StreamMultipleChoiceRound>(stream, rng);
+        case RoundKind::MATCHING:
+            return make_unique<MatchingUnavailable>(stream.cards());
+        case RoundKind::TIMED:
+            break;
+    }
+    return make_unique<StreamTimedRound>(stream, grader, timeLimit);
+}
@@ -0,0 +1,118 @@
+/**
+ * streamrounds.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the game rounds that play a DeckStream instead of a whole deck in memory: flashcards,
+ * multiple choice and the timed challenge, each walking the deck in file order a chunk at a time. They
+ * show the same prompts as their in-memory counterparts in gamerounds.h. Card ids in their outcomes are
+ * positions in the deck file, the ids the cards would have had if the deck had been loaded whole.
+ * Matching needs the whole deck to shuffle, so it has no streaming round.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_STREAMROUNDS_H
+#define M2AP_STREAMROUNDS_H
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include "cardstore.h"
+#include "deckstream.h"
+#include "fastrng.h"
+#include "gameio.h"
+#include "gamerounds.h"
+#include "grader.h"
+using namespace std;
+
+// Flashcards: one pass through the deck with starring, then the starred cards
+class StreamFlashcardRound : public GameRound {
+private:
+    enum class Step { FLIP, STAR, STUDY_STARRED, STARRED_FLIP };
+
+    DeckStream& stream;
+    Step step;
+    CardId card;            // In the chunk in play
+    CardStore starred;      // Copies, as their chunks are long gone by the end of the pass
+    size_t position;
+
+    void showNext(GameRenderer& out);
+
+public:
+    explicit StreamFlashcardRound(DeckStream& deckStream);
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "Flashcards"; }
+};
+
+// Multiple choice over every card in file order, with distractors from the stream's reservoir
+class StreamMultipleChoiceRound : public GameRound {
+private:
+    DeckStream& stream;
+    FastRng& rng;
+    CardId question;            // In the chunk in play
+    CardStore optionCards;      // The options of the current question
+    vector<CardId> options;     // 0 .. options - 1, for showChoices()
+    vector<uint32_t> picked;    // Reservoir slots chosen for the current question
+    size_t correctChoice;
+
+    void ask(GameRenderer& out);
+
+public:
+    /**
+     * Constructor
+     * @param deckStream Deck to play.
+     * @param random Random source for distractors and answer order.
+     */
+    StreamMultipleChoiceRound(DeckStream& deckStream, FastRng& random);
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "MultipleChoiceGame"; }
+};
+
+// Timed challenge: terms in file order until the time limit passes
+class StreamTimedRound : public GameRound {
+private:
+    DeckStream& stream;
+    AnswerGrader& grader;
+    int timeLimit;
+    bool started;
+    bool exhausted;             // The deck ran out before the time did
+    CardId card;                // In the chunk in play
+    chrono::steady_clock::time_point endTime;
+    chrono::steady_clock::time_point askedAt;
+
+    void ask(GameRenderer& out);
+    void finish(GameRenderer& out, bool timedOut);
+
+public:
+    /**
+     * Constructor
+     * @param timeLimitSeconds Seconds from the first answer (the "press enter" line) to the end.
+     */
+    StreamTimedRound(DeckStream& deckStream, AnswerGrader& answerGrader, int timeLimitSeconds);
+
+    void start(GameRenderer& out) override;
+    void submit(string_view answer, GameRenderer& out) override;
+    const char* name() const override { return "TimeChallenge"; }
+    bool deadline(chrono::steady_clock::time_point& when) const override;
+    void expire(GameRenderer& out) override;
+};
+
+/**
+ * Creates a round of a game mode over a stream
+ * Inputs:
+ *   - RoundKind kind: Game mode. A MATCHING round only says that it cannot be played.
+ *   - DeckStream& stream: Deck to play, rewound when the round starts.
+ *   - FastRng& rng, AnswerGrader& grader: Belong to the player; a round uses them until it is destroyed.
+ *   - int timeLimit: Seconds for a timed round; ignored by the other modes.
+ * Returns:
+ *   - unique_ptr<GameRound>: The round, not yet started.
+ */
+unique_ptr<GameRound> makeStreamRound(RoundKind kind, DeckStream& stream, FastRng& rng, AnswerGrader& grader,
+                                      int timeLimit);
+
+#endif // M2AP_STREAMROUNDS_H
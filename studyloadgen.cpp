@@ -0,0 +1,294 @@
+/**
+ * studyloadgen.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Load generator for the study server, built as the studytool_loadgen target.
+ * Keeps --sessions learners connected at once, each playing a round of --answers answers and then
+ * reconnecting as a new learner, one answer in flight per connection. Reports the latency of each
+ * answer (send to complete reply), throughput, and sessions per core: completed sessions per second of
+ * server CPU time, read from the server's "#! stats" before and after the run.
+ *   ./studytool_loadgen --connect /tmp/study.sock --sessions 200 --duration 10 --mode timed --deck deck.tsv
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+#include "cardstore.h"
+#include "deckloader.h"
+#include "fastrng.h"
+#include "studyserver.h"
+using namespace std;
+using Clock = chrono::steady_clock;
+
+struct Connection {
+    int fd = -1;
+    vector<string> script;      // Lines of this session; each gets one reply
+    size_t next = 0;            // Next line to send
+    bool waiting = false;       // A line (or the greeting) has no reply yet
+    Clock::time_point sentAt;
+};
+
+/**
+ * Sends a whole buffer on a blocking or non-blocking socket
+ */
+static bool sendAll(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t count = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (count > 0) {
+            sent += static_cast<size_t>(count);
+        } else if (count < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Asks the server for its CPU time on a connection of its own
+ * Returns:
+ *   - double: Server CPU seconds so far, or -1 if it could not be read.
+ */
+static double serverCpuSeconds(const string& address) {
+    string error;
+    int fd = connectToServer(address, error);
+    if (fd < 0) {
+        return -1.0;
+    }
+    string reply;
+    int repliesWanted = 2;      // The greeting, then the stats
+    bool asked = false;
+    char buffer[4096];
+    while (repliesWanted > 0) {
+        ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+        if (count <= 0) {
+            close(fd);
+            return -1.0;
+        }
+        for (ssize_t i = 0; i < count; ++i) {
+            if (buffer[i] == '\0') {
+                --repliesWanted;
+                if (repliesWanted == 1) {
+                    reply.clear();
+                }
+            } else {
+                reply += buffer[i];
+            }
+        }
+        if (repliesWanted == 1 && !asked) {
+            sendAll(fd, "#! stats\n");
+            asked = true;
+        }
+    }
+    sendAll(fd, "#! quit\n");
+    close(fd);
+    return reply.compare(0, 4, "cpu ") == 0 ? strtod(reply.c_str() + 4, nullptr) : -1.0;
+}
+
+/**
+ * Latency at a percentile of a sorted sample, in microseconds
+ */
+static double percentile(const vector<double>& sorted, double fraction) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5);
+    return sorted[min(rank, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[]) {
+    string address;
+    string deckPath;
+    string mode = "mult";
+    size_t sessionCount = 100;
+    size_t answersPerSession = 20;
+    double duration = 10.0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--connect") == 0 && i + 1 < argc) {
+            address = argv[++i];
+        } else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            sessionCount = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--answers") == 0 && i + 1 < argc) {
+            answersPerSession = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--duration") == 0 && i + 1 < argc) {
+            duration = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            mode = argv[++i];
+        } else if (strcmp(argv[i], "--deck") == 0 && i + 1 < argc) {
+            deckPath = argv[++i];
+        } else {
+            address.clear();
+            break;
+        }
+    }
+    if (address.empty() || sessionCount == 0 || answersPerSession == 0 || !(duration > 0.0)
+        || (mode != "mult" && mode != "match" && mode != "timed")) {
+        cerr << "Usage: " << argv[0] << " --connect <socket path|host:port> [--sessions <n>] [--answers <n>]"
+             << " [--duration <seconds>] [--mode mult|match|timed] [--deck <file>]" << endl;
+        return 1;
+    }
+
+    // With the server's deck, typed answers are real definitions (with a typo) rather than guesses
+    CardStore deck;
+    if (!deckPath.empty()) {
+        string error;
+        if (!loadDeck(deckPath, deck, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+    }
+
+    FastRng rng(42);
+    auto makeScript = [&](uint64_t sessionNumber, vector<string>& script) {
+        script.clear();
+        script.push_back("#! seed " + to_string(sessionNumber));
+        script.push_back(mode == "timed" ? "#! timed 3600" : "#! " + mode);
+        for (size_t answer = 0; answer < answersPerSession; ++answer) {
+            if (mode == "mult") {
+                script.push_back(to_string(1 + rng.below(4)));
+            } else if (mode == "timed" && answer == 0) {
+                script.push_back("");   // "Press enter to start the challenge"
+            } else if (!deck.empty()) {
+                CardId card = mode == "timed" ? static_cast<CardId>((answer - 1) % deck.size())
+                                              : rng.below(static_cast<uint32_t>(deck.size()));
+                string definition(deck.def(card));
+                if (!definition.empty()) {
+                    definition[rng.below(static_cast<uint32_t>(definition.size()))] = 'x';
+                }
+                script.push_back(definition);
+            } else {
+                script.push_back("no idea");
+            }
+        }
+    };
+
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    vector<Connection> connections(sessionCount);
+    uint64_t sessionsStarted = 0;
+    uint64_t sessionsCompleted = 0;
+    uint64_t failures = 0;
+    vector<double> latencies;
+    latencies.reserve(1 << 20);
+
+    auto open = [&](size_t slot) -> bool {
+        Connection& connection = connections[slot];
+        string error;
+        connection.fd = connectToServer(address, error);
+        if (connection.fd < 0) {
+            cerr << "Error: " << error << endl;
+            return false;
+        }
+        fcntl(connection.fd, F_SETFL, fcntl(connection.fd, F_GETFL) | O_NONBLOCK);
+        makeScript(sessionsStarted++, connection.script);
+        connection.next = 0;
+        connection.waiting = true;      // For the greeting
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u64 = slot;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, connection.fd, &event);
+        return true;
+    };
+
+    double cpuBefore = serverCpuSeconds(address);
+    auto start = Clock::now();
+    auto deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(duration));
+
+    for (size_t slot = 0; slot < sessionCount; ++slot) {
+        if (!open(slot)) {
+            return 1;
+        }
+    }
+
+    size_t active = sessionCount;
+    vector<epoll_event> events(256);
+    char buffer[64 * 1024];
+    while (active > 0) {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 100);
+        if (ready < 0 && errno != EINTR) {
+            cerr << "Error: epoll_wait failed: " << strerror(errno) << endl;
+            return 1;
+        }
+        Clock::time_point now = Clock::now();
+
+        for (int i = 0; i < ready; ++i) {
+            size_t slot = events[i].data.u64;
+            Connection& connection = connections[slot];
+            ssize_t count = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (count < 0 && (errno == EAGAIN || errno == EINTR)) {
+                continue;
+            }
+            if (count <= 0) {
+                ++failures;
+                close(connection.fd);
+                --active;
+                continue;
+            }
+            if (!memchr(buffer, '\0', static_cast<size_t>(count))) {
+                continue;   // Only part of the reply so far
+            }
+
+            // One line in flight, so a NUL completes it
+            if (connection.next >= 3) {
+                latencies.push_back(chrono::duration<double, micro>(now - connection.sentAt).count());
+            }
+            if (connection.next < connection.script.size()) {
+                connection.sentAt = Clock::now();
+                if (!sendAll(connection.fd, connection.script[connection.next] + "\n")) {
+                    ++failures;
+                    close(connection.fd);
+                    --active;
+                    continue;
+                }
+                ++connection.next;
+                continue;
+            }
+
+            // Session over: leave, and come back as a new learner while there is time
+            sendAll(connection.fd, "#! quit\n");
+            close(connection.fd);
+            ++sessionsCompleted;
+            if (now >= deadline || !open(slot)) {
+                --active;
+            }
+        }
+    }
+
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    double cpuAfter = serverCpuSeconds(address);
+    close(epollFd);
+
+    sort(latencies.begin(), latencies.end());
+    cout << "Sessions: " << sessionsCompleted << " completed with " << sessionCount << " connected at once ("
+         << answersPerSession << " " << mode << " answers each)";
+    if (failures > 0) {
+        cout << ", " << failures << " dropped";
+    }
+    cout << endl;
+    cout << "Answers: " << latencies.size() << " in " << seconds << " s (" << latencies.size() / seconds
+         << " answers/s, " << sessionsCompleted / seconds << " sessions/s)" << endl;
+    cout << "Latency per answer (us): p50 " << percentile(latencies, 0.50) << ", p90 " << percentile(latencies, 0.90)
+         << ", p99 " << percentile(latencies, 0.99) << ", p99.9 " << percentile(latencies, 0.999) << ", max "
+         << (latencies.empty() ? 0.0 : latencies.back()) << endl;
+    if (cpuBefore >= 0.0 && cpuAfter > cpuBefore) {
+        double cpu = cpuAfter - cpuBefore;
+        cout << "Server CPU: " << cpu << " s over " << seconds << " s (" << cpu / seconds << " cores busy); "
+             << sessionsCompleted / cpu << " sessions and " << latencies.size() / cpu << " answers per core-second"
+             << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,559 @@
+/**
+ * studyserver.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for StudyServer.
+ * The epoll thread owns the sockets: it reads, splits complete lines into a connection's inbox, and
+ * writes its outbox. Workers own a connection's game state while they play its inbox; a connection is
+ * never on two workers at once because it is only queued when it is not already busy. Replies are built
+ * in the connection's own buffer and handed back to the epoll thread through an eventfd.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "studyserver.h"
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "fastrng.h"
+#include "gameio.h"
+#include "gamerounds.h"
+#include "replay.h"
+using namespace std;
+
+static const size_t MAX_LINE = 64 * 1024;           // Longer lines close the connection
+static const size_t MAX_OUTBOX = 4 * 1024 * 1024;   // So does a client that stops reading its replies
+static const int MAX_EVENTS = 256;
+static const char* const ROUND_HELP = "Start a round with #! flip, #! mult, #! match or #! timed <seconds>.";
+
+struct StudyServer::Session {
+    int fd;
+    FastRng rng;
+    AnswerGrader grader;
+    unique_ptr<GameRound> round;
+    ostringstream text;         // Replies being built by whoever is playing the inbox
+    TextRenderer renderer;
+    string received;            // Epoll thread: bytes after the last complete line
+    bool writing;               // Epoll thread: EPOLLOUT is armed
+
+    mutex lock;                 // Guards the members below
+    string inbox;               // Complete lines not yet played
+    string outbox;              // Replies not yet sent
+    bool busy;                  // Queued for, or being played by, a worker
+    bool quitting;              // "#! quit" played: close once the outbox is sent
+
+    Session(int socket, uint64_t seed, const GradeConfig& config)
+            : fd(socket), rng(seed), renderer(text), writing(false), busy(false), quitting(false) {
+        grader.setConfig(config);
+    }
+};
+
+/**
+ * Resolves a listen or connect address
+ * Inputs:
+ *   - const string& address: A path containing '/' for a Unix socket, else "host:port", ":port" or "port".
+ *   - bool passive: True to listen on all IPv4 interfaces when no host is given, false for 127.0.0.1.
+ *   - sockaddr_storage& storage, socklen_t& length: Receive the address.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+static bool resolveAddress(const string& address, bool passive, sockaddr_storage& storage, socklen_t& length,
+                           string& error) {
+    memset(&storage, 0, sizeof(storage));
+
+    if (address.find('/') != string::npos) {
+        sockaddr_un* unixAddress = reinterpret_cast<sockaddr_un*>(&storage);
+        if (address.size() >= sizeof(unixAddress->sun_path)) {
+            error = "Socket path is too long: " + address;
+            return false;
+        }
+        unixAddress->sun_family = AF_UNIX;
+        memcpy(unixAddress->sun_path, address.c_str(), address.size() + 1);
+        length = sizeof(sockaddr_un);
+        return true;
+    }
+
+    size_t colon = address.rfind(':');
+    string host = colon == string::npos ? "" : address.substr(0, colon);
+    string port = colon == string::npos ? address : address.substr(colon + 1);
+    if (port.empty()) {
+        error = "No port in address: " + address;
+        return false;
+    }
+
+    addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = host.empty() ? AF_INET : AF_UNSPEC;     // So ":port" listens and connects on the same family
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* results = nullptr;
+    int status = getaddrinfo(host.empty() ? nullptr : host.c_str(), port.c_str(), &hints, &results);
+    if (status != 0) {
+        error = "Unable to resolve " + address + ": " + gai_strerror(status);
+        return false;
+    }
+    memcpy(&storage, results->ai_addr, results->ai_addrlen);
+    length = results->ai_addrlen;
+    freeaddrinfo(results);
+    return true;
+}
+
+StudyServer::StudyServer(const StudyTool& studyTool, uint64_t serverSeed)
+        : cards(studyTool.getCards()), index(studyTool.getIndex()), similar(studyTool.getHardDistractors()),
+          gradeConfig(studyTool.getGradeConfig()), seed(serverSeed), listenFd(-1),
+          epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)), stopping(false),
+          sessionsOpened(0), answersPlayed(0) {}
+
+StudyServer::~StudyServer() {
+    if (listenFd >= 0) {
+        close(listenFd);
+    }
+    if (!socketPath.empty()) {
+        unlink(socketPath.c_str());
+    }
+    if (epollFd >= 0) {
+        close(epollFd);
+    }
+    if (wakeFd >= 0) {
+        close(wakeFd);
+    }
+}
+
+/**
+ * Opens the listening socket
+ * Inputs:
+ *   - const string& address: Unix socket path, or TCP "host:port".
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool StudyServer::listen(const string& address, string& error) {
+    if (epollFd < 0 || wakeFd < 0) {
+        error = string("Unable to set up epoll: ") + strerror(errno);
+        return false;
+    }
+
+    sockaddr_storage storage;
+    socklen_t length = 0;
+    if (!resolveAddress(address, true, storage, length, error)) {
+        return false;
+    }
+
+    listenFd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        error = string("Unable to create socket: ") + strerror(errno);
+        return false;
+    }
+
+    if (storage.ss_family == AF_UNIX) {
+        // A socket left behind by a server that did not shut down cleanly; never remove anything else
+        struct stat info;
+        if (stat(address.c_str(), &info) == 0 && S_ISSOCK(info.st_mode)) {
+            unlink(address.c_str());
+        }
+    } else {
+        int on = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&storage), length) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+        error = "Unable to listen on " + address + ": " + strerror(errno);
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    if (storage.ss_family == AF_UNIX) {
+        socketPath = address;
+    }
+    return true;
+}
+
+/**
+ * Accepts every pending connection and greets it
+ */
+void StudyServer::accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));   // Fails harmlessly on Unix sockets
+
+        uint64_t number = sessionsOpened.fetch_add(1);
+        auto session = make_shared<Session>(fd, seed + number * 0x9E3779B97F4A7C15ULL, gradeConfig);
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        sessions[fd] = session;
+
+        session->outbox = "Welcome to C++ Study Tool: " + to_string(cards.size()) + " cards. " + ROUND_HELP + "\n";
+        session->outbox += '\0';
+        flush(session);
+    }
+}
+
+/**
+ * Reads what a connection has sent and queues its complete lines to be played
+ */
+void StudyServer::receive(const shared_ptr<Session>& session) {
+    char buffer[64 * 1024];
+    while (true) {
+        ssize_t count = recv(session->fd, buffer, sizeof(buffer), 0);
+        if (count > 0) {
+            session->received.append(buffer, static_cast<size_t>(count));
+            if (static_cast<size_t>(count) < sizeof(buffer)) {
+                break;
+            }
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            closeSession(session);
+            return;
+        }
+    }
+
+    size_t lastNewline = session->received.rfind('\n');
+    if (lastNewline == string::npos) {
+        if (session->received.size() > MAX_LINE) {
+            closeSession(session);
+        }
+        return;
+    }
+
+    bool schedule = false;
+    {
+        lock_guard<mutex> guard(session->lock);
+        session->inbox.append(session->received, 0, lastNewline + 1);
+        if (!session->busy && !session->quitting) {
+            session->busy = true;
+            schedule = true;
+        }
+    }
+    session->received.erase(0, lastNewline + 1);
+
+    if (!schedule) {
+        return;
+    }
+    if (workers.empty()) {
+        drain(*session);
+        flush(session);
+    } else {
+        lock_guard<mutex> guard(queueLock);
+        workQueue.push_back(session);
+        queueReady.notify_one();
+    }
+}
+
+/**
+ * Plays a connection's inbox, including lines that arrive meanwhile, and moves the replies to its outbox
+ * Description:
+ *   - Called with the session marked busy; clears busy once the inbox is empty.
+ */
+void StudyServer::drain(Session& session) {
+    string lines;
+    while (true) {
+        {
+            lock_guard<mutex> guard(session.lock);
+            if (session.inbox.empty() || session.quitting) {
+                session.busy = false;
+                return;
+            }
+            lines.swap(session.inbox);
+            session.inbox.clear();
+        }
+
+        bool quit = false;
+        size_t start = 0;
+        while (start < lines.size() && !quit) {
+            size_t newline = lines.find('\n', start);
+            string_view line(lines.data() + start, newline - start);
+            start = newline + 1;
+            if (!handleLine(session, line)) {
+                quit = true;
+                break;
+            }
+            session.text << '\0';
+        }
+
+        string replies = session.text.str();
+        session.text.str(string());
+        lock_guard<mutex> guard(session.lock);
+        session.outbox += replies;
+        session.quitting = quit;
+    }
+}
+
+/**
+ * Plays one line: a directive or an answer to the current round
+ * Returns:
+ *   - bool: False for "#! quit", which gets no reply.
+ */
+bool StudyServer::handleLine(Session& session, string_view line) {
+    if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+    }
+
+    Directive directive;
+    if (parseDirective(line, directive)) {
+        if (directive.startsRound) {
+            session.round = makeRound(directive.round, cards, index, similar, session.rng, session.grader, nullptr,
+                                      directive.timeLimit);
+            session.round->start(session.renderer);
+        } else if (directive.reseeds) {
+            session.rng.seed(directive.seed);
+            session.text << "Seed set to " << directive.seed << ".\n";
+            return true;
+        } else if (directive.word == "stats") {
+            rusage usage;
+            getrusage(RUSAGE_SELF, &usage);
+            double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                                + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+            session.text << "cpu " << cpuSeconds << " sessions " << sessionsOpened.load() << " answers "
+                         << answersPlayed.load() << "\n";
+            return true;
+        } else if (directive.word == "quit") {
+            return false;
+        } else {
+            session.text << "Unknown directive. " << ROUND_HELP << "\n";
+            return true;
+        }
+    } else if (!session.round) {
+        session.text << "No round in progress. " << ROUND_HELP << "\n";
+        return true;
+    } else {
+        session.round->submit(line, session.renderer);
+        answersPlayed.fetch_add(1, memory_order_relaxed);
+    }
+
+    if (session.round->finished()) {
+        session.text << session.round->name() << " round over: score " << session.round->getScore() << " of "
+                     << session.round->getOutcomes().size() << "\n";
+        session.round.reset();
+    }
+    return true;
+}
+
+/**
+ * Sends as much of a connection's outbox as the socket takes, and watches for room for the rest
+ */
+void StudyServer::flush(const shared_ptr<Session>& session) {
+    bool pending;
+    bool done;
+    {
+        lock_guard<mutex> guard(session->lock);
+        size_t sent = 0;
+        while (sent < session->outbox.size()) {
+            ssize_t count = send(session->fd, session->outbox.data() + sent, session->outbox.size() - sent,
+                                 MSG_NOSIGNAL);
+            if (count > 0) {
+                sent += static_cast<size_t>(count);
+            } else if (count < 0 && errno == EINTR) {
+                continue;
+            } else if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                sent = SIZE_MAX;
+                break;
+            }
+        }
+        if (sent == SIZE_MAX || session->outbox.size() - sent > MAX_OUTBOX) {
+            done = true;
+            pending = false;
+        } else {
+            session->outbox.erase(0, sent);
+            pending = !session->outbox.empty();
+            done = session->quitting && !session->busy && !pending;
+        }
+    }
+
+    if (done) {
+        closeSession(session);
+        return;
+    }
+    if (pending != session->writing) {
+        epoll_event event;
+        event.events = pending ? EPOLLIN | EPOLLOUT : EPOLLIN;
+        event.data.fd = session->fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, session->fd, &event);
+        session->writing = pending;
+    }
+}
+
+/**
+ * Closes a connection. A worker still playing it finishes on its own copy of the session.
+ */
+void StudyServer::closeSession(const shared_ptr<Session>& session) {
+    shared_ptr<Session> keep = session;
+    if (keep->fd < 0) {
+        return;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, keep->fd, nullptr);
+    close(keep->fd);
+    sessions.erase(keep->fd);
+    keep->fd = -1;
+}
+
+void StudyServer::workerLoop() {
+    while (true) {
+        shared_ptr<Session> session;
+        {
+            unique_lock<mutex> guard(queueLock);
+            queueReady.wait(guard, [this] { return stopping.load() || !workQueue.empty(); });
+            if (stopping.load()) {
+                return;
+            }
+            session = std::move(workQueue.front());
+            workQueue.pop_front();
+        }
+
+        drain(*session);
+
+        {
+            lock_guard<mutex> guard(queueLock);
+            finished.push_back(std::move(session));
+        }
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+}
+
+/**
+ * Serves connections until stop() is called
+ * Inputs:
+ *   - size_t workerCount: Threads that play answers; 0 plays them on this thread.
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool StudyServer::run(size_t workerCount, string& error) {
+    if (listenFd < 0) {
+        error = "The server is not listening";
+        return false;
+    }
+
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    for (size_t i = 0; i < workerCount; ++i) {
+        workers.emplace_back(&StudyServer::workerLoop, this);
+    }
+
+    epoll_event events[MAX_EVENTS];
+    vector<shared_ptr<Session>> completed;
+    while (!stopping.load()) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            error = string("epoll_wait failed: ") + strerror(errno);
+            break;
+        }
+
+        for (int i = 0; i < ready && !stopping.load(); ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                accept();
+            } else if (fd == wakeFd) {
+                uint64_t count;
+                ssize_t bytes = read(wakeFd, &count, sizeof(count));
+                (void)bytes;
+                {
+                    lock_guard<mutex> guard(queueLock);
+                    completed.swap(finished);
+                }
+                for (const shared_ptr<Session>& session : completed) {
+                    if (session->fd >= 0) {
+                        flush(session);
+                    }
+                }
+                completed.clear();
+            } else {
+                auto found = sessions.find(fd);
+                if (found == sessions.end()) {
+                    continue;
+                }
+                shared_ptr<Session> session = found->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    receive(session);
+                }
+                if (session->fd >= 0 && (events[i].events & EPOLLOUT)) {
+                    flush(session);
+                }
+            }
+        }
+    }
+
+    stopping.store(true);
+    {
+        lock_guard<mutex> guard(queueLock);
+        queueReady.notify_all();
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    while (!sessions.empty()) {
+        closeSession(sessions.begin()->second);
+    }
+    return error.empty();
+}
+
+/**
+ * Asks run() to return. Only touches an atomic and an eventfd, so it is safe in a signal handler.
+ */
+void StudyServer::stop() {
+    stopping.store(true);
+    uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written;
+}
+
+/**
+ * Connects to a server
+ * Inputs:
+ *   - const string& address: Unix socket path, or TCP "host:port" (localhost if the host is empty).
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - int: The connected socket, or -1.
+ */
+int connectToServer(const string& address, string& error) {
+    sockaddr_storage storage;
+    socklen_t length = 0;
+    if (!resolveAddress(address, false, storage, length, error)) {
+        return -1;
+    }
+
+    int fd = socket(storage.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        error = string("Unable to create socket: ") + strerror(errno);
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr*>(&storage), length) != 0) {
+        error = "Unable to connect to " + address + ": " + strerror(errno);
+        close(fd);
+        return -1;
+    }
+    if (storage.ss_family != AF_UNIX) {
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+    return fd;
+}
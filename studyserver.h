@@ -0,0 +1,127 @@
+/**
+ * studyserver.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for StudyServer, which hosts one deck for many learners at once over a Unix or TCP socket.
+ * One thread waits on every connection with epoll; each connection has its own game round, random
+ * generator and grader, while the cards, term index and hard-mode index are shared read-only. Answers
+ * are played on a small worker pool (or on the epoll thread when it has no workers), one batch per
+ * connection at a time, so a connection's answers are always handled in order.
+ *
+ * Protocol: the client sends lines; every line gets exactly one reply, and so does the connection itself
+ * on arrival. A reply is the text the terminal game would have shown, followed by a NUL byte. Lines are
+ * answers to the current round, or directives as in replay logs:
+ *   #! flip | #! mult | #! match | #! timed <seconds>   Start a round (abandoning the current one).
+ *   #! seed <n>                                          Reseed this connection's game choices.
+ *   #! stats                                             Server CPU time, sessions and answers so far.
+ *   #! quit                                              Close the connection.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_STUDYSERVER_H
+#define M2AP_STUDYSERVER_H
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "cardindex.h"
+#include "cardstore.h"
+#include "grader.h"
+#include "similarity.h"
+#include "studytool.h"
+using namespace std;
+
+class StudyServer {
+private:
+    struct Session;
+
+    const CardStore& cards;
+    const CardIndex& index;
+    const SimilarityIndex* similar;
+    GradeConfig gradeConfig;
+    uint64_t seed;
+
+    int listenFd;
+    int epollFd;
+    int wakeFd;             // eventfd: a worker finished a batch, or stop() was called
+    string socketPath;      // Unix socket to unlink on shutdown
+    atomic<bool> stopping;
+
+    unordered_map<int, shared_ptr<Session>> sessions;   // epoll thread only
+
+    vector<thread> workers;
+    mutex queueLock;
+    condition_variable queueReady;
+    deque<shared_ptr<Session>> workQueue;
+    vector<shared_ptr<Session>> finished;               // Guarded by queueLock
+
+    atomic<uint64_t> sessionsOpened;
+    atomic<uint64_t> answersPlayed;
+
+    void accept();
+    void receive(const shared_ptr<Session>& session);
+    void drain(Session& session);
+    bool handleLine(Session& session, string_view line);
+    void flush(const shared_ptr<Session>& session);
+    void closeSession(const shared_ptr<Session>& session);
+    void workerLoop();
+
+public:
+    /**
+     * Constructor
+     * @param studyTool Deck to host, with its grading tolerance and hard-mode setting. Only read, and it
+     *                  must outlive the server.
+     * @param serverSeed Connection i's games are seeded from serverSeed and i until it sends "#! seed".
+     */
+    StudyServer(const StudyTool& studyTool, uint64_t serverSeed);
+    ~StudyServer();
+
+    StudyServer(const StudyServer&) = delete;
+    StudyServer& operator=(const StudyServer&) = delete;
+
+    /**
+     * Opens the listening socket
+     * Inputs:
+     *   - const string& address: A path (anything containing '/') for a Unix socket, otherwise "host:port",
+     *     ":port" or "port" for TCP on all interfaces.
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool listen(const string& address, string& error);
+
+    /**
+     * Serves connections until stop() is called
+     * Inputs:
+     *   - size_t workerCount: Threads that play answers; 0 plays them on the epoll thread.
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool run(size_t workerCount, string& error);
+
+    /**
+     * Asks run() to return. Safe to call from a signal handler.
+     */
+    void stop();
+
+    uint64_t sessionCount() const { return sessionsOpened.load(); }
+    uint64_t answerCount() const { return answersPlayed.load(); }
+};
+
+/**
+ * Connects to a server
+ * Inputs:
+ *   - const string& address: As for StudyServer::listen(); an empty host means localhost.
+ *   - string& error: Receives a description of the failure, if any.
+ * Returns:
+ *   - int: The connected socket, or -1.
+ */
+int connectToServer(const string& address, string& error);
+
+#endif // M2AP_STUDYSERVER_H
@@ -11,224 +11,206 @@
  */
 
 #include "studytool.h"
+#include <chrono>
 #include <iostream>
-#include <cstdlib>
-#include <ctime>
-#include <algorithm>
-#include <sstream>
+#include <memory>
 #include <string>
-#include <random>
-#include <vector>
-#include <iomanip>
+#include <string_view>
+#include <unistd.h>
+#include "streamrounds.h"
+#include "telemetry.h"
+#include "terminal.h"
 using namespace std;
 
 /**
  * Constructor implementation
- * @param inputTerms
- * @param inputDefs
+ * @param inputCards Cards to study. The store is moved in, so the text is never copied.
+ * @param seed Seed for every random choice the game modes make.
  */
-StudyTool::StudyTool(const std::vector<std::string>& inputTerms, const std::vector<std::string>& inputDefs)
-        : terms(inputTerms), defs(inputDefs), score(0) {}
+StudyTool::StudyTool(CardStore inputCards, uint64_t seed)
+        : cards(std::move(inputCards)), rng(seed), hardDistractors(nullptr), scheduler(nullptr), telemetry(nullptr),
+          stream(nullptr), searchBuilt(false), filtering(false), prepareAhead(0), score(0), reportLatency(false) {
+    index.build(cards);
+}
 
 /**
- * Flashcard practice game mode
- * Inputs:
- *   - const vector<string>& inputTerms: Vector containing study terms.
- *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
+ * Adds a card after construction
  * Description:
- *   Allows the user to go through each term, revealing its definition, and optionally starring terms to review later.
- *   After reviewing all terms, the user can choose to study the starred terms.
+ *   - The card goes in before anything changes here, so a store that refuses it leaves the StudyTool as it was.
  */
-void StudyTool::playflip(const vector<string>& inputTerms, const vector<string>& inputDefs) {
-    vector<string> starred;
-    vector<string> starredDefs;
-    size_t counter = 0;
-
-    auto termIt = inputTerms.begin();
-    auto defIt = inputDefs.begin();
-
-    while (termIt != inputTerms.end() && defIt != inputDefs.end()) {
-        cout << *termIt << endl;
-        cout << "Click enter to flip card";
-
-        if (cin.get() == '\n') {
-            system("clear");
-            cout << *defIt << endl;
-
-            bool starTerm = true;
-            while (starTerm) {
-                cout << "Do you want to star this term or move on? [type 'star' to star or click enter to advance]";
-                string star;
-                getline(cin, star);
-
-                if (star == "star") {
-                    starred.push_back(*termIt);
-                    starredDefs.push_back(*defIt);
-                    starTerm = false;
-                } else if (star.empty()) {
-                    starTerm = false;
-                }
-            }
-
-            ++termIt;
-            ++defIt;
-        }
+CardId StudyTool::addCard(string_view term, string_view def) {
+    CardId card = cards.addCard(term, def);
+    index.build(cards);
+    if (searchBuilt) {
+        search.addCard(card, term, def);
     }
+    hardDistractors = nullptr;
+    return card;
+}
 
-    counter = 0;
-    string response;
-    bool studyMore = true;
-
-    while (studyMore) {
-        cout << "Would you now like to study your starred terms? ['y' for yes, 'n' for no]: ";
-        string study;
-        getline(cin, study);
-        
-        if (study == "y") {
-            for (const auto& s : starred) {
-                cout << s << endl;
-                cin.ignore();
-                cout << "Click enter to flip card";
-                if (cin.get() == '\n') {
-                    system("clear");
-                    cout << starredDefs[counter] << endl;
-                }
-                counter++;
-            }
-            studyMore = false;
-        } else if (study == "n") {
-            studyMore = false;
-        } else {
-            cout << "That was an invalid response, try again." << endl;
-        }
+/**
+ * Finds the cards matching a search
+ * Returns:
+ *   - bool: False if the query is malformed.
+ */
+bool StudyTool::findCards(string_view query, vector<CardId>& results, string& error) {
+    if (!searchBuilt) {
+        search.build(cards);
+        searchBuilt = true;
     }
+    return search.search(query, results, error);
 }
 
 /**
- * Multiple-choice game mode
+ * Creates a round of a game mode over this StudyTool's cards
  * Inputs:
- *   - const vector<string>& inputTerms: Vector containing study terms.
- *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
+ *   - RoundKind kind: Game mode.
+ *   - int timeLimit: Seconds for a timed round.
  * Returns:
- *   - int: User's score in the multiple-choice game.
- * Description:
- *   Presents study terms as multiple-choice questions, with the user selecting the correct definition.
- *   Scores are calculated based on the number of correct answers.
+ *   - unique_ptr<GameRound>: The round, not yet started.
  */
-int StudyTool::mult(const vector<string>& inputTerms, const vector<string>& inputDefs) {
-    int score = 0;
+unique_ptr<GameRound> StudyTool::newRound(RoundKind kind, int timeLimit) {
+    if (stream != nullptr) {
+        return makeStreamRound(kind, *stream, rng, grader, timeLimit);
+    }
+    unique_ptr<GameRound> round = makeRound(kind, cards, index, hardDistractors, rng, grader, scheduler, timeLimit);
+    if (filtering) {
+        round->setSelection(CardSelection::of(filter));
+    }
+    round->setPrepareAhead(prepareAhead);
+    return round;
+}
 
-    for (const auto &term : inputTerms) {
-        cout << term << endl;
-        size_t index = distance(inputTerms.begin(), find(inputTerms.begin(), inputTerms.end(), term));
-        size_t cycle = 1;
-        int correct = 0;
-        vector<string> used;
-        size_t rangeCycle = (inputTerms.size() >= 4) ? 5 : inputTerms.size() + 1;
-        size_t randomIndex = (inputTerms.size() >= 4) ? rand() % 4 + 1 : rand() % inputTerms.size() + 1;
+/**
+ * Plays a round to the end or until the answers run out
+ * Returns:
+ *   - int: The round's score.
+ * Description:
+ *   - While the round has a deadline the input is asked to give up at it, and the round expires if it does.
+ */
+int StudyTool::play(GameRound& round, AnswerProvider& input, GameRenderer& output) {
+    ModeLatency* latency = telemetry != nullptr ? &telemetry->forMode(round.name()) : nullptr;
+    round.setLatency(latency);
+    round.start(output);
+
+    // With telemetry, one clock reading ends each wait and starts the step it sets off, and one ends the
+    // step and starts the next wait; the step less its question and grade phases is its RENDER time
+    string_view answer;
+    chrono::steady_clock::time_point deadline;
+    uint64_t askedAt = latency != nullptr ? Telemetry::now() : 0;
+    while (!round.finished()) {
+        AnswerWait wait = AnswerWait::ANSWERED;
+        if (round.deadline(deadline)) {
+            wait = input.nextAnswerBy(answer, deadline);
+        } else if (!input.nextAnswer(answer)) {
+            wait = AnswerWait::ENDED;
+        }
 
-        while (cycle < rangeCycle) {
-            if (cycle == randomIndex) {
-                cout << cycle << ": " << inputDefs[index] << endl;
-                correct = randomIndex;
-                used.push_back(inputDefs[index]);
+        if (wait == AnswerWait::ENDED) {
+            break;
+        }
+        if (latency == nullptr) {
+            if (wait == AnswerWait::EXPIRED) {
+                round.expire(output);
             } else {
-                string randdef = inputDefs[rand() % inputDefs.size()];
-
-                while (cycle != randomIndex && randdef == inputDefs[index]) {
-                    randdef = inputDefs[rand() % inputDefs.size()];
-                }
-                bool doneUsed = true;
-
-                while (doneUsed) {
-                    if (find(used.begin(), used.end(), randdef) != used.end()) {
-                        randdef = inputDefs[rand() % inputDefs.size()];
-                    } else {
-                        doneUsed = false;
-                    }
-                }
-                cout << cycle << ": " << randdef << endl;
-                used.push_back(randdef);
+                round.submit(answer, output);
             }
-            cycle++;
+            continue;
         }
 
-        int guess;
-        cout << "What is your guess? [enter a number 1-4]: ";
-
-        while (!(cin >> guess) || guess < 1 || guess > 4) {
-            cout << "Invalid input. Please enter a number between 1 and 4: ";
-            cin.clear();
-            cin.ignore();
-        }
-
-        if (correct == guess) {
-            cout << "You were correct!" << endl;
-            score++;
+        uint64_t answeredAt = Telemetry::now();
+        size_t graded = round.getOutcomes().size();
+        if (wait == AnswerWait::EXPIRED) {
+            round.expire(output);
         } else {
-            cout << "That's not correct. The correct answer was: " << correct << endl;
+            latency->record(Phase::ANSWER, answeredAt - askedAt);
+            round.submit(answer, output);
+            if (round.getOutcomes().size() > graded) {
+                telemetry->recordAnswer(round.getOutcomes().back().card, answeredAt - askedAt);
+            }
         }
-        cin.ignore();
+        askedAt = Telemetry::now();
+        uint64_t step = askedAt - answeredAt;
+        uint64_t phases = round.takePhaseNanos();
+        latency->record(Phase::RENDER, step > phases ? step - phases : 0);
     }
-    return score;
+    round.setLatency(nullptr);
+    outcomes = round.getOutcomes();
+    return round.getScore();
 }
 
 /**
- * Matching game mode
+ * Plays a round on the terminal
  * Inputs:
- *   - const vector<string>& inputTerms: Vector containing study terms.
- *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
+ *   - RoundKind kind: Game mode.
+ *   - int timeLimit: Seconds for a timed round.
+ * Returns:
+ *   - int: The round's score.
  * Description:
- *   - Presents terms and definitions shuffled, asking the user to match them.
- *   - Scores are calculated based on the number of correct matches.
+ *   - On a terminal, keys are read as they are pressed and each screen is drawn with one write.
+ *   - When input or output is redirected, the game reads lines from cin and prints to cout as before.
  */
-int StudyTool::matchingGame(const vector<string>& inputTerms, const vector<string>& inputDefs) {
-    // Check if there are enough terms and definitions
-    if (inputTerms.size() < 2 || inputDefs.size() < 2 || inputTerms.size() != inputDefs.size()) {
-        cout << "Insufficient terms and definitions for the matching game." << endl;
-        return 0;
-    }
-
-    // Combine terms and definitions into a single vector of pairs
-    vector<pair<string, string>> shuffledPairs;
-    for (size_t i = 0; i < inputTerms.size(); ++i) {
-        shuffledPairs.push_back(make_pair(inputTerms[i], inputDefs[i]));
+int StudyTool::playOnConsole(RoundKind kind, int timeLimit) {
+    cout.flush();
+    RawTerminal terminal(STDIN_FILENO, STDOUT_FILENO);
+    if (!terminal.isRaw()) {
+        ConsoleInput input;
+        ConsoleRenderer output;
+        return play(*newRound(kind, timeLimit), input, output);
     }
 
-    // Seed for random number generation
-    unsigned seed = static_cast<unsigned>(chrono::system_clock::now().time_since_epoch().count());
-
-    // Shuffle the pairs using <algorithm> and <random>
-    shuffle(shuffledPairs.begin(), shuffledPairs.end(), std::default_random_engine(seed));
-
-    // Display shuffled terms and ask the user to match them
-    int score = 0;
-    cout << "Matching Game: Match the terms with their correct definitions" << endl;
-
-    for (const auto& pair : shuffledPairs) {
-        cout << pair.first << " -> ";
-        string userAnswer;
-        getline(cin, userAnswer);
-
-        if (userAnswer == pair.second) {
-            cout << "Correct!" << endl;
-            ++score;
-        } else {
-            cout << "Incorrect. The correct definition was: " << pair.second << endl;
+    int result;
+    {
+        TerminalRenderer output(terminal);
+        TerminalInput input(terminal, output);
+        result = play(*newRound(kind, timeLimit), input, output);
+        if (reportLatency) {
+            // Send the last screen first, so a deadline that ended the game is timed to it
+            output.present();
+            output.printLatency(terminal.out());
         }
     }
+    return result;
+}
+
+/**
+ * Flashcard practice game mode
+ * Description:
+ *   With a scheduler attached, runs a spaced-repetition session instead.
+ *   Allows the user to go through each term, revealing its definition, and optionally starring terms to review later.
+ *   After reviewing all terms, the user can choose to study the starred terms.
+ */
+void StudyTool::playflip() {
+    playOnConsole(RoundKind::FLASHCARDS);
+}
 
-    // Display final score
-    cout << "Matching Game Score: " << score << " out of " << shuffledPairs.size() << endl;
+/**
+ * Multiple-choice game mode
+ * Returns:
+ *   - int: User's score in the multiple-choice game.
+ * Description:
+ *   Presents study terms as multiple-choice questions, with the user selecting the correct definition.
+ *   Up to three distractors are drawn from the deck's other distinct definitions; in hard mode the
+ *   most similar wrong definitions are used.
+ *   Scores are calculated based on the number of correct answers.
+ */
+int StudyTool::mult() {
+    return playOnConsole(RoundKind::MULTIPLE_CHOICE);
+}
 
-    return score;
+/**
+ * Matching game mode
+ * Description:
+ *   - Presents terms and definitions shuffled, asking the user to match them.
+ *   - Scores are calculated based on the number of correct matches.
+ */
+int StudyTool::matchingGame() {
+    return playOnConsole(RoundKind::MATCHING);
 }
 
 /**
  * Time-based challenge game mode
  * Inputs:
- *   - const vector<string>& inputTerms: Vector containing study terms.
- *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
  *   - int timeLimit: Time limit for the challenge in seconds.
  * Returns:
  *   - int: User's score in the time-based challenge.
@@ -236,39 +218,8 @@ int StudyTool::matchingGame(const vector<string>& inputTerms, const vector<strin
  *   - Presents study terms with a time limit for the user to answer as many as possible.
  *   - Scores are calculated based on the number of correct answers.
  */
-int StudyTool::timeChallenge(const vector<string>& inputTerms, const vector<string>& inputDefs, int timeLimit) {
-    int score = 0;
-
-    cout << "Time-Based Challenge: Answer as many questions as possible within " << timeLimit << " seconds." << endl;
-    cout << "Press enter to start the challenge..." << endl;
-    cin.ignore();
-
-    auto startTime = chrono::steady_clock::now();
-    auto endTime = startTime + chrono::seconds(timeLimit);
-
-    for (const auto& term : inputTerms) {
-        if (chrono::steady_clock::now() > endTime) {
-            cout << "Time's up! Challenge completed." << endl;
-            break;
-        }
-
-        cout << term << " -> ";
-        string userAnswer;
-        getline(cin, userAnswer);
-
-        size_t index = distance(inputTerms.begin(), find(inputTerms.begin(), inputTerms.end(), term));
-        if (userAnswer == inputDefs[index]) {
-            cout << "Correct!" << endl;
-            ++score;
-        } else {
-            cout << "Incorrect. The correct definition was: " << inputDefs[index] << endl;
-        }
-    }
-
-    // Display final score
-    cout << "Time-Based Challenge Score: " << score << " out of " << inputTerms.size() << endl;
-
-    return score;
+int StudyTool::timeChallenge(int timeLimit) {
+    return playOnConsole(RoundKind::TIMED, timeLimit);
 }
 
 /**
@@ -11,78 +11,291 @@
 
 #ifndef M2AP_STUDYTOOL_H
 #define M2AP_STUDYTOOL_H
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
-#include "GLFW/glfw3.h"
+#include <string_view>
+#include "cardstore.h"
+#include "cardindex.h"
+#include "deckstream.h"
+#include "fastrng.h"
+#include "gameio.h"
+#include "gamerounds.h"
+#include "grader.h"
+#include "scheduler.h"
+#include "searchindex.h"
+#include "similarity.h"
+#include "telemetry.h"
 using namespace std;
 
 struct GameSession {
     string gameMode;
     int numCorrectAnswers;
+    int64_t timestamp;      // Milliseconds since the epoch when the game ended; 0 means "now"
+    uint64_t deckId;        // deckIdentity() of the deck played, or 0 if not known
+    int total;              // Cards answered
+    vector<CardOutcome> outcomes;
 };
 
 class StudyTool {
 private:
-    vector<string> terms;
-    vector<string> defs;
+    CardStore cards;
+    CardIndex index;
+    FastRng rng;
+    const SimilarityIndex* hardDistractors;
+    AnswerGrader grader;
+    ReviewScheduler* scheduler;
+    Telemetry* telemetry;
+    DeckStream* stream;
+    SearchIndex search;             // Built on the first search, then kept up to date by addCard()
+    bool searchBuilt;
+    vector<CardId> filter;          // Cards every game plays while filtering
+    bool filtering;
+    vector<CardOutcome> outcomes;   // Per-card results of the last game played
+    size_t prepareAhead;
     int score;
+    bool reportLatency;
+
+    /**
+     * Plays a round on the terminal: a raw-mode terminal when stdin and stdout are one, else cin and cout
+     */
+    int playOnConsole(RoundKind kind, int timeLimit = 0);
 
 public:
+    static const size_t NEW_CARDS_PER_SESSION = FlashcardRound::NEW_CARDS_PER_SESSION;
+
     /**
      * Constructor using initializer list
-     * @param inputTerms
-     * @param inputDefs
+     * @param inputCards Cards to study. The store is moved in, so the text is never copied.
+     * @param seed Seed for every random choice the game modes make; the same seed replays the same quiz.
      */
-    StudyTool(const std::vector<std::string>& inputTerms, const std::vector<std::string>& inputDefs);
+    StudyTool(CardStore inputCards, uint64_t seed);
 
     /**
-     * Flashcard practice game mode
+     * Adds a card after construction
      * Inputs:
-     *   - const vector<string>& inputTerms: Vector containing study terms.
-     *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
+     *   - string_view term: Study term.
+     *   - string_view def: Definition for the term.
+     * Returns:
+     *   - CardId: Id of the new card.
      * Description:
-     *   - Allows the user to go through each term, revealing its definition, and optionally starring terms to review later.
+     *   - Rebuilds the term index, so this is for cards typed in one at a time, not for loading decks.
+     *     The search index, once built, only has the new card added.
+     *   - A filter set earlier does not take in the new card.
+     *   - Hard mode is turned off, since its similarity index does not cover the new card.
+     *   - Rounds created earlier, and views of the cards' text, must not be used afterwards.
+     *   - Throws like CardStore::addCard, e.g. for a compiled deck.
+     */
+    CardId addCard(string_view term, string_view def);
+
+    /**
+     * Grades a typed answer the way the matching and timed games do
+     * Inputs:
+     *   - CardId card: Card being answered.
+     *   - string_view answer: Definition given.
+     * Returns:
+     *   - GradeResult: See gradeAgainstTerm.
+     */
+    GradeResult grade(CardId card, string_view answer) { return gradeAgainstTerm(cards, index, grader, card, answer); }
+
+    /**
+     * Reseeds the random choices made by the game modes
+     * @param seed Seed for the next games.
+     */
+    void setSeed(uint64_t seed) { rng.seed(seed); }
+
+    /**
+     * Turns the multiple-choice "hard" mode on or off
+     * @param similar Similarity index built over this StudyTool's cards, or nullptr for random distractors.
+     *                The index must outlive its use here.
+     */
+    void setHardDistractors(const SimilarityIndex* similar) { hardDistractors = similar; }
+
+    /**
+     * Sets how far a typed answer may be from the definition in the matching and timed games
+     * @param config Edit-distance limits; a maxRatio of 0 accepts only answers that match after normalization.
+     */
+    void setGradeConfig(const GradeConfig& config) { grader.setConfig(config); }
+
+    /**
+     * Attaches a spaced-repetition schedule to flashcard practice
+     * @param reviewScheduler Schedule opened for this StudyTool's cards, or nullptr for a plain run through
+     *                        the deck. The scheduler must outlive its use here.
+     */
+    void setScheduler(ReviewScheduler* reviewScheduler) { scheduler = reviewScheduler; }
+
+    /**
+     * Times answers and engine phases into latency histograms while games are played
+     * @param latencyTelemetry Histograms to record into, or nullptr to not time anything. They must outlive
+     *                         their use here.
+     */
+    void setTelemetry(Telemetry* latencyTelemetry) { telemetry = latencyTelemetry; }
+
+    /**
+     * Plays flashcards, multiple choice and the timed challenge from a stream instead of the cards
+     * @param deckStream Opened stream, or nullptr to play the cards again. It must outlive its use here,
+     *                   and while it is attached hard mode and the scheduler are not used.
+     */
+    void setStream(DeckStream* deckStream) { stream = deckStream; }
+
+    /**
+     * Prepares multiple-choice questions on a background thread while the learner answers
+     * @param questions Questions to keep ready, e.g. MultipleChoiceRound::PREPARE_AHEAD; 0 (the default)
+     *                  prepares each question after the answer before it. The quiz for a seed is the same.
+     */
+    void setPrepareAhead(size_t questions) { prepareAhead = questions; }
+
+    /**
+     * Finds the cards matching a search
+     * Inputs:
+     *   - string_view query: Words, OR, NOT or "-", "*" prefixes and parentheses (see searchindex.h).
+     *   - vector<CardId>& results: Receives the matching cards in deck order.
+     *   - string& error: Receives a description of a malformed query.
+     * Returns:
+     *   - bool: False if the query is malformed.
+     * Description:
+     *   - The first search indexes every card's words, which takes about a second per million cards.
+     */
+    bool findCards(string_view query, vector<CardId>& results, string& error);
+
+    /**
+     * Plays only some of the cards in every game mode, e.g. the results of findCards()
+     * @param cardIds Cards to play, in order. Rounds refer to them instead of copying the deck.
+     *                Flashcards over a filter are a plain pass rather than a scheduled session.
+     */
+    void setFilter(vector<CardId> cardIds) {
+        filter = std::move(cardIds);
+        filtering = true;
+    }
+
+    /**
+     * Goes back to playing every card
+     */
+    void clearFilter() {
+        filter.clear();
+        filtering = false;
+    }
+
+    /**
+     * Returns:
+     *   - const vector<CardId>*: The cards being played, or nullptr when every card is.
+     */
+    const vector<CardId>* getFilter() const { return filtering ? &filter : nullptr; }
+
+    /**
+     * Returns:
+     *   - const Telemetry*: The attached latency histograms, or nullptr.
+     */
+    const Telemetry* getTelemetry() const { return telemetry; }
+
+    /**
+     * Prints how long each answer took to reach the screen after every terminal game
+     * @param report True to print the timings.
+     */
+    void setReportLatency(bool report) { reportLatency = report; }
+
+    /**
+     * Returns:
+     *   - GradeConfig: How far typed answers may be from the definition.
+     */
+    GradeConfig getGradeConfig() const { return grader.getConfig(); }
+
+    /**
+     * Returns:
+     *   - const SimilarityIndex*: The hard-mode index, or nullptr in normal mode.
+     */
+    const SimilarityIndex* getHardDistractors() const { return hardDistractors; }
+
+    /**
+     * Returns:
+     *   - const CardStore&: The cards every game mode plays over.
+     */
+    const CardStore& getCards() const { return cards; }
+
+    /**
+     * Returns:
+     *   - const CardIndex&: Term index over the cards, built once by the constructor.
+     */
+    const CardIndex& getIndex() const { return index; }
+
+    /**
+     * Returns:
+     *   - const vector<CardOutcome>&: Each card asked in the last multiple-choice, matching or timed game,
+     *     in the order asked, and whether it was answered correctly.
+     */
+    const vector<CardOutcome>& getLastOutcomes() const { return outcomes; }
+
+    /**
+     * Creates a round of a game mode over this StudyTool's cards
+     * Inputs:
+     *   - RoundKind kind: Game mode.
+     *   - int timeLimit: Seconds for a timed round; ignored by the other modes.
+     * Returns:
+     *   - unique_ptr<GameRound>: The round, not yet started. It refers to this StudyTool's cards, filter,
+     *     random generator, grader and scheduler, so it must not outlive the StudyTool or a change of
+     *     filter, and two rounds from one StudyTool should not be played at the same time.
+     */
+    unique_ptr<GameRound> newRound(RoundKind kind, int timeLimit = 0);
+
+    /**
+     * Plays a round to the end or until the answers run out
+     * Inputs:
+     *   - GameRound& round: Round to play, not yet started.
+     *   - AnswerProvider& input: Source of the learner's answers.
+     *   - GameRenderer& output: Receives everything the round shows.
+     * Returns:
+     *   - int: The round's score. Its per-card results become getLastOutcomes().
+     * Description:
+     *   - While the round has a deadline (see GameRound::deadline) answers are read with
+     *     AnswerProvider::nextAnswerBy, and the round expires if the deadline passes first.
+     *   - With telemetry attached, each answer's wait and the engine phases it set off are timed into the
+     *     mode's histograms, and graded answers into their card's.
+     */
+    int play(GameRound& round, AnswerProvider& input, GameRenderer& output);
+
+    /**
+     * Flashcard practice game mode
+     * Description:
+     *   - With a scheduler attached, runs a spaced-repetition session over the cards that are due.
+     *   - Otherwise allows the user to go through each term, revealing its definition, and optionally starring terms to review later.
      *   - After reviewing all terms, the user can choose to study the starred terms.
      */
-    void playflip(const vector<string>& inputTerms, const vector<string>& inputDefs);
+    void playflip();
 
     /**
      * Multiple-choice game mode
-     * Inputs:
-     *   - const vector<string>& inputTerms: Vector containing study terms.
-     *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
      * Returns:
      *   - int: User's score in the multiple-choice game.
      * Description:
      *   Presents study terms as multiple-choice questions, with the user selecting the correct definition.
+     *   Up to three distractors are drawn from the deck's other distinct definitions; in hard mode the
+     *   most similar wrong definitions are used.
      *   Scores are calculated based on the number of correct answers.
      */
-    int mult(const vector<string>& inputTerms, const vector<string>& inputDefs);
+    int mult();
 
     /**
      * Matching game mode
-     * Inputs:
-     *   - const vector<string>& inputTerms: Vector containing study terms.
-     *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
      * Description:
      *   - Presents terms and definitions shuffled, asking the user to match them.
+     *   - Answers are graded ignoring case, accents and spacing, and small typos are accepted.
      *   - Scores are calculated based on the number of correct matches.
      */
-    int matchingGame(const vector<string>& inputTerms, const vector<string>& inputDefs);
+    int matchingGame();
 
     /**
      * Time-based challenge game mode
      * Inputs:
-     *   - const vector<string>& inputTerms: Vector containing study terms.
-     *   - const vector<string>& inputDefs: Vector containing corresponding definitions.
      *   - int timeLimit: Time limit for the challenge in seconds.
      * Returns:
      *   - int: User's score in the time-based challenge.
      * Description:
      *   - Presents study terms with a time limit for the user to answer as many as possible.
+     *   - Answers are graded like the matching game.
      *   - Scores are calculated based on the number of correct answers.
      */
-    int timeChallenge(const vector<string>& inputTerms, const vector<string>& inputDefs, int timeLimit);
+    int timeChallenge(int timeLimit);
 
     /**
      * Overloaded equality operator
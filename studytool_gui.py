@@ -1,20 +1,21 @@
+import threading
 import tkinter as tk
-#import sys
-#sys.path.append("../studytool.h")
-from tkinter import messagebox
-#from studytool import StudyTool  # Importing the StudyTool class from studytool.py
+from tkinter import filedialog, messagebox
 
+# The native engine, built by CMake as the studytool_python target (studytool.*.so / studytool.*.pyd)
 try:
     from studytool import StudyTool
 except ImportError as e:
     print("Error importing studytool module:", e)
+    raise
 
 class StudyToolGUI:
     def __init__(self, root):
         self.root = root
         self.root.title("C++ Study Tool")
 
-        self.study_tool = StudyTool()  # Assuming StudyTool class is imported from studytool.py
+        self.study_tool = StudyTool()
+        self.round = None
 
         self.label = tk.Label(root, text="Enter a term:")
         self.label.pack()
@@ -31,20 +32,88 @@ class StudyToolGUI:
         self.add_button = tk.Button(root, text="Add Term", command=self.add_term)
         self.add_button.pack()
 
+        self.load_button = tk.Button(root, text="Load Deck...", command=self.load_deck)
+        self.load_button.pack()
+
         self.play_button = tk.Button(root, text="Play", command=self.start_game)
         self.play_button.pack()
 
+        # Multiple choice round: the term, then one button per option
+        self.question_label = tk.Label(root, text="", wraplength=400)
+        self.question_label.pack()
+        self.choice_frame = tk.Frame(root)
+        self.choice_frame.pack()
+        self.status_label = tk.Label(root, text="")
+        self.status_label.pack()
+
     def add_term(self):
         term = self.term_entry.get()
         definition = self.definition_entry.get()
-        self.study_tool.add_term_definition(term, definition)
+        try:
+            self.study_tool.add_term_definition(term, definition)
+        except (BufferError, ValueError) as e:
+            messagebox.showerror("Error", str(e))
+            return
         messagebox.showinfo("Success", "Term added successfully!")
         self.term_entry.delete(0, tk.END)
         self.definition_entry.delete(0, tk.END)
 
+    def load_deck(self):
+        path = filedialog.askopenfilename(filetypes=[("Decks", "*.tsv *.csv *.stdeck"), ("All files", "*")])
+        if not path:
+            return
+        self.round = None
+        self.load_button.config(state=tk.DISABLED)
+        self.status_label.config(text="Loading " + path + "...")
+
+        # The module lets go of the GIL while it parses, so the window keeps redrawing
+        def load():
+            try:
+                tool, error = StudyTool(path), None
+            except (OSError, ValueError, MemoryError) as e:
+                tool, error = None, e
+            self.root.after(0, self.deck_loaded, path, tool, error)
+
+        threading.Thread(target=load, daemon=True).start()
+
+    def deck_loaded(self, path, tool, error):
+        self.load_button.config(state=tk.NORMAL)
+        if error is not None:
+            self.status_label.config(text="")
+            messagebox.showerror("Error", str(error))
+            return
+        self.study_tool = tool
+        self.status_label.config(text="Loaded %d cards from %s" % (len(tool), path))
+
     def start_game(self):
-        # Logic to start the game
-        messagebox.showinfo("Game", "Game started!")
+        if len(self.study_tool) == 0:
+            messagebox.showinfo("Game", "Add some terms or load a deck first.")
+            return
+        self.round = self.study_tool.new_round("mult")
+        self.show(self.round.start())
+
+    def choose(self, number):
+        self.show(self.round.submit(str(number)))
+
+    def show(self, events):
+        for widget in self.choice_frame.winfo_children():
+            widget.destroy()
+        for event in events:
+            kind = event[0]
+            if kind == "term":
+                self.question_label.config(text=event[1])
+            elif kind == "choices":
+                for number, card in enumerate(event[1], start=1):
+                    tk.Button(self.choice_frame, text="%d. %s" % (number, self.study_tool.definition(card)),
+                              wraplength=400, command=lambda n=number: self.choose(n)).pack(fill=tk.X)
+            elif kind == "choice_result":
+                self.status_label.config(text="Correct!" if event[1] else "Incorrect.")
+        if self.round.finished:
+            # The round reports its last answer but not a score; show it from the round itself
+            self.question_label.config(text="")
+            messagebox.showinfo("Game", "%s: %d / %d" % (self.round.name, self.round.score,
+                                                         len(self.round.outcomes)))
+            self.round = None
 
 if __name__ == "__main__":
     root = tk.Tk()
@@ -0,0 +1,597 @@
+/**
+ * studytoolbench.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Microbenchmarks for the study engine, built as the studytool_bench target.
+ * Each benchmark runs over synthetic decks of 1k, 100k and 1M cards (see synthdeck.h) and the results are
+ * printed as one JSON document on stdout, so runs can be saved and compared across releases:
+ *   ./studytool_bench > bench.json
+ *   ./studytool_bench --cards 1000,100000 --min-time 0.2 --filter grade
+ * It also writes the training workload for profile-guided builds (see CMakeLists.txt): a synthetic deck
+ * and a replay script that plays all four game modes on it.
+ *   ./studytool_bench --write-workload deck.tsv answers.log [--cards 20000]
+ * A benchmark is timed in batches sized to take about a fifth of --min-time each; five batches are run
+ * and the fastest and median time per operation are reported. Progress goes to stderr.
+ * Whole multiple-choice rounds are timed over 1k, 10k and 100k cards, or the --cards sizes. The quadratic
+ * term lookup they replaced only runs when named: --filter round_lookup_find (tens of seconds at 100k cards).
+ * An operation longer than a batch is timed once.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "cardstore.h"
+#include "deckloader.h"
+#include "deckstream.h"
+#include "distractors.h"
+#include "fastrng.h"
+#include "gameio.h"
+#include "gamerounds.h"
+#include "grader.h"
+#include "historystore.h"
+#include "searchindex.h"
+#include "similarity.h"
+#include "streamrounds.h"
+#include "studytool.h"
+#include "symboltable.h"
+#include "synthdeck.h"
+using namespace std;
+
+static const uint64_t DECK_SEED = 20240301;
+static const size_t BATCHES = 5;
+static const size_t WORKLOAD_CARDS = 20000;
+static const size_t WORKLOAD_ANSWERS = 5000;   // Per round; three passes of the four modes
+static const size_t STREAM_BUDGET = size_t{4} << 20;
+static const vector<size_t> ROUND_SIZES = {1000, 10000, 100000};     // Whole rounds, unless --cards is given
+
+struct BenchResult {
+    string name;
+    size_t cards;
+    uint64_t iterations;        // Operations per batch
+    double bestNs;              // Fastest batch, per operation
+    double medianNs;            // Median batch, per operation
+};
+
+// Results the compiler cannot prove unused
+static volatile uint64_t sink;
+
+/**
+ * Times an operation
+ * Inputs:
+ *   - const char* name: Benchmark name.
+ *   - size_t cards: Deck size the operation runs against.
+ *   - double minSeconds: Rough total time to spend.
+ *   - Op op: Called as op(n) to perform n operations.
+ * Returns:
+ *   - BenchResult: Time per operation.
+ */
+template <typename Op>
+static BenchResult measure(const char* name, size_t cards, double minSeconds, Op op) {
+    using Clock = chrono::steady_clock;
+    double batchSeconds = minSeconds / BATCHES;
+
+    // Grow the batch until one takes long enough to time reliably
+    uint64_t iterations = 1;
+    double elapsed;
+    while (true) {
+        auto start = Clock::now();
+        op(iterations);
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+        if (elapsed >= batchSeconds || iterations >= (1ULL << 40)) {
+            break;
+        }
+        double scale = elapsed > 0.0 ? batchSeconds / elapsed : 100.0;
+        iterations = static_cast<uint64_t>(iterations * min(max(scale * 1.2, 2.0), 100.0));
+    }
+
+    // An operation longer than a batch is timed once rather than in batches
+    if (iterations == 1 && elapsed >= batchSeconds) {
+        double ns = elapsed * 1e9;
+        cerr << "  " << name << " @ " << cards << " cards: " << ns << " ns/op (timed once)" << endl;
+        return {name, cards, 1, ns, ns};
+    }
+
+    vector<double> perOp;
+    for (size_t batch = 0; batch < BATCHES; ++batch) {
+        auto start = Clock::now();
+        op(iterations);
+        perOp.push_back(chrono::duration<double, nano>(Clock::now() - start).count() / iterations);
+    }
+    sort(perOp.begin(), perOp.end());
+
+    cerr << "  " << name << " @ " << cards << " cards: " << perOp[BATCHES / 2] << " ns/op" << endl;
+    return {name, cards, iterations, perOp.front(), perOp[BATCHES / 2]};
+}
+
+/**
+ * Copies a card with a typo in it, for grading
+ */
+static string withTypo(string_view definition, FastRng& rng) {
+    string answer(definition);
+    if (!answer.empty()) {
+        answer[rng.below(static_cast<uint32_t>(answer.size()))] = 'x';
+    }
+    return answer;
+}
+
+/**
+ * Writes a string as a JSON string literal
+ */
+static void writeJsonString(ostream& out, string_view text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+static bool parseSizes(const char* text, vector<size_t>& sizes) {
+    sizes.clear();
+    while (*text != '\0') {
+        char* end = nullptr;
+        unsigned long long value = strtoull(text, &end, 10);
+        if (end == text || value == 0 || (*end != ',' && *end != '\0')) {
+            return false;
+        }
+        sizes.push_back(static_cast<size_t>(value));
+        text = *end == ',' ? end + 1 : end;
+    }
+    return !sizes.empty();
+}
+
+int main(int argc, char* argv[]) {
+    vector<size_t> sizes = {1000, 100000, 1000000};
+    double minSeconds = 1.0;
+    string filter;
+    string workloadDeck;
+    string workloadScript;
+    bool sizesGiven = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--cards") == 0 && i + 1 < argc && parseSizes(argv[i + 1], sizes)) {
+            sizesGiven = true;
+            ++i;
+        } else if (strcmp(argv[i], "--write-workload") == 0 && i + 2 < argc) {
+            workloadDeck = argv[++i];
+            workloadScript = argv[++i];
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            minSeconds = strtod(argv[++i], nullptr);
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--cards <n,n,...>] [--min-time <seconds>] [--filter <substring>]"
+                 << endl;
+            cerr << "       " << argv[0] << " --write-workload <deck.tsv> <answers.log> [--cards <n>]" << endl;
+            return 1;
+        }
+    }
+
+    if (!workloadDeck.empty()) {
+        size_t cardCount = sizesGiven ? sizes.front() : WORKLOAD_CARDS;
+        CardStore deck;
+        generateDeck(cardCount, DECK_SEED, deck);
+        string error;
+        if (!writeSyntheticDeck(workloadDeck, cardCount, DECK_SEED, error) ||
+            !writeSyntheticScript(workloadScript, deck, WORKLOAD_ANSWERS, DECK_SEED, error)) {
+            cerr << "Error: " << error << endl;
+            return 1;
+        }
+        cerr << "Wrote " << cardCount << " cards to " << workloadDeck << " and their replay script to "
+             << workloadScript << endl;
+        return 0;
+    }
+    if (!(minSeconds > 0.0)) {
+        cerr << "Error: --min-time must be positive" << endl;
+        return 1;
+    }
+
+    auto wanted = [&filter](const char* name) {
+        return filter.empty() || strstr(name, filter.c_str()) != nullptr;
+    };
+
+    vector<BenchResult> results;
+    string deckPath = (filesystem::temp_directory_path() / ("studytool_bench_" + to_string(time(nullptr)) + ".tsv"))
+                              .string();
+
+    for (size_t cardCount : sizes) {
+        cerr << "Deck of " << cardCount << " cards" << endl;
+        CardStore source;
+        generateDeck(cardCount, DECK_SEED, source);
+
+        if (wanted("deck_build")) {
+            // Cards into a fresh store, then the StudyTool and its term index
+            results.push_back(measure("deck_build", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    CardStore copy;
+                    copy.reserve(source.size(), source.textBytes());
+                    for (CardId card = 0; card < source.size(); ++card) {
+                        copy.addCard(source.term(card), source.def(card));
+                    }
+                    StudyTool studyTool(std::move(copy), DECK_SEED);
+                    sink = sink + studyTool.getIndex().distinctTermCount();
+                }
+            }));
+        }
+
+        bool loadTsv = wanted("deck_load_tsv");
+        bool streamMult = wanted("stream_mult_question");
+        if (loadTsv || streamMult) {
+            string error;
+            if (!writeSyntheticDeck(deckPath, cardCount, DECK_SEED, error)) {
+                cerr << "Error: " << error << endl;
+                return 1;
+            }
+        }
+
+        if (loadTsv) {
+            results.push_back(measure("deck_load_tsv", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    CardStore loaded;
+                    string loadError;
+                    if (!loadDeck(deckPath, loaded, loadError)) {
+                        cerr << "Error: " << loadError << endl;
+                        exit(1);
+                    }
+                    sink = sink + loaded.size();
+                }
+            }));
+        }
+
+        if (streamMult) {
+            // mult_question played from the deck file within a 4 MiB budget, chunk changes included
+            DeckStream stream;
+            DeckStreamConfig config;
+            config.memoryBudget = STREAM_BUDGET;
+            config.seed = DECK_SEED;
+            string error;
+            if (!stream.open(deckPath, config, error)) {
+                cerr << "Error: " << error << endl;
+                return 1;
+            }
+            FastRng rng(DECK_SEED);
+            AnswerGrader grader;
+            NullRenderer output;
+            unique_ptr<GameRound> round = makeStreamRound(RoundKind::MULTIPLE_CHOICE, stream, rng, grader, 0);
+            round->start(output);
+            results.push_back(measure("stream_mult_question", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    if (round->finished()) {
+                        round = makeStreamRound(RoundKind::MULTIPLE_CHOICE, stream, rng, grader, 0);
+                        round->start(output);
+                    }
+                    round->submit("1", output);
+                }
+                sink = sink + round->getScore();
+            }));
+            cerr << "    peak " << (stream.peakMemory() >> 10) << " KiB of " << (STREAM_BUDGET >> 10) << " KiB, "
+                 << stream.stallCount() << " stalls totalling " << stream.stallTimeNanos() / 1000000 << " ms"
+                 << endl;
+        }
+        remove(deckPath.c_str());
+
+        StudyTool studyTool(std::move(source), DECK_SEED);
+        const CardStore& cards = studyTool.getCards();
+        const CardIndex& index = studyTool.getIndex();
+        NullRenderer output;
+
+        if (wanted("mult_question")) {
+            // One multiple-choice question: sample distractors, place the answer, take a guess
+            unique_ptr<GameRound> round = studyTool.newRound(RoundKind::MULTIPLE_CHOICE);
+            round->start(output);
+            results.push_back(measure("mult_question", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    if (round->finished()) {
+                        round = studyTool.newRound(RoundKind::MULTIPLE_CHOICE);
+                        round->start(output);
+                    }
+                    round->submit("1", output);
+                }
+                sink = sink + round->getScore();
+            }));
+        }
+
+        if (wanted("mult_answer_latency")) {
+            // A learner who takes a millisecond over each hard multiple-choice question: the time from an answer
+            // to the next question, with each question prepared after the answer ("inline") and with the next
+            // ones prepared on a background thread while the learner thinks ("ahead")
+            SimilarityIndex similar;
+            similar.build(cards, index);
+            studyTool.setHardDistractors(&similar);
+            const size_t answers = min<size_t>(cards.size() - 1, 2000);
+            for (size_t ahead : {size_t(0), MultipleChoiceRound::PREPARE_AHEAD}) {
+                studyTool.setSeed(DECK_SEED);
+                studyTool.setPrepareAhead(ahead);
+                unique_ptr<GameRound> round = studyTool.newRound(RoundKind::MULTIPLE_CHOICE);
+                round->start(output);
+                vector<double> latencies;
+                for (size_t i = 0; i < answers; ++i) {
+                    this_thread::sleep_for(chrono::milliseconds(1));
+                    auto answered = chrono::steady_clock::now();
+                    round->submit("1", output);
+                    latencies.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - answered).count());
+                }
+                sink = sink + round->getScore();
+                sort(latencies.begin(), latencies.end());
+
+                const char* name = ahead == 0 ? "mult_answer_latency_inline" : "mult_answer_latency_ahead";
+                double median = latencies[latencies.size() / 2];
+                cerr << "  " << name << " @ " << cardCount << " cards: median " << median << " ns, p99 "
+                     << latencies[latencies.size() * 99 / 100] << " ns, max " << latencies.back() << " ns" << endl;
+                results.push_back({name, cardCount, answers, latencies.front(), median});
+            }
+            studyTool.setPrepareAhead(0);
+            studyTool.setHardDistractors(nullptr);
+        }
+
+        if (wanted("distractor_sample")) {
+            DistractorSampler sampler(index);
+            FastRng rng(DECK_SEED);
+            vector<CardId> options;
+            results.push_back(measure("distractor_sample", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    CardId card = rng.below(static_cast<uint32_t>(cards.size()));
+                    sink = sink + sampler.sample(card, 3, rng, options);
+                }
+            }));
+        }
+
+        if (wanted("matching_shuffle")) {
+            // Starting a matching round: lay out every card id and shuffle them
+            results.push_back(measure("matching_shuffle", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    unique_ptr<GameRound> round = studyTool.newRound(RoundKind::MATCHING);
+                    round->start(output);
+                    sink = sink + round->finished();
+                }
+            }));
+        }
+
+        if (wanted("search_build")) {
+            results.push_back(measure("search_build", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    SearchIndex search;
+                    search.build(cards);
+                    sink = sink + search.postingCount();
+                }
+            }));
+        }
+
+        if (wanted("search_query")) {
+            // A common word, two of them, a boolean mix, a prefix and a rare word against a common one
+            const char* const queries[] = {"heap", "heap stack", "(heap OR stack) -tree", "term12*", "term123 heap"};
+            const size_t queryCount = sizeof(queries) / sizeof(queries[0]);
+            SearchIndex search;
+            search.build(cards);
+            vector<CardId> found;
+            string error;
+            results.push_back(measure("search_query", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    search.search(queries[i % queryCount], found, error);
+                    sink = sink + found.size();
+                }
+            }));
+            cerr << "    " << search.wordCount() << " words, " << search.postingCount() << " postings in "
+                 << (search.heapBytes() >> 10) << " KiB" << endl;
+        }
+
+        if (wanted("history_query")) {
+            // As many games as the deck has cards, one every ten minutes up to now, each with ten cards asked;
+            // then the scores of one mode over the last 30 days
+            const char* const modes[] = {"MultipleChoiceGame", "MatchingGame", "TimeChallenge"};
+            const int64_t minute = 60000;
+            int64_t now = chrono::duration_cast<chrono::milliseconds>(
+                    chrono::system_clock::now().time_since_epoch()).count();
+            FastRng rng(DECK_SEED);
+            vector<HistoryRecord> games(cardCount);
+            for (size_t i = 0; i < cardCount; ++i) {
+                GameSession& session = games[i].session;
+                games[i].sequence = i + 1;
+                session.gameMode = modes[rng.below(3)];
+                session.timestamp = now - static_cast<int64_t>(cardCount - i) * 10 * minute;
+                session.deckId = 1;
+                session.total = 10;
+                session.numCorrectAnswers = 0;
+                for (int k = 0; k < 10; ++k) {
+                    bool correct = rng.below(4) != 0;
+                    session.outcomes.push_back(CardOutcome{rng.below(static_cast<uint32_t>(cards.size())), correct,
+                                                           1000000 + rng.below(4000000)});
+                    session.numCorrectAnswers += correct ? 1 : 0;
+                }
+            }
+
+            string historyPath = deckPath + ".history";
+            string error;
+            HistoryStore history;
+            remove(historyPath.c_str());
+            if (!history.open(historyPath, error) || !history.append(games, error)) {
+                cerr << "Error: " << error << endl;
+                return 1;
+            }
+            HistoryQuery query;
+            query.gameMode = "MatchingGame";
+            query.fromTimestamp = now - 30 * 24 * 60 * minute;
+            HistoryScan scan;
+            results.push_back(measure("history_query", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    history.query(query, [](uint64_t, const GameSession& session) {
+                        sink = sink + static_cast<uint64_t>(session.numCorrectAnswers);
+                    }, error, &scan);
+                }
+            }));
+            cerr << "    " << cardCount << " games in " << (history.fileBytes() >> 10) << " KiB, "
+                 << history.blockCount() << " blocks; read " << scan.blocksRead << " blocks (" << scan.bytesRead
+                 << " bytes) per query" << endl;
+            history.close();
+            remove(historyPath.c_str());
+        }
+
+        bool defDecode = wanted("def_decode");
+        bool defLookup = wanted("def_lookup");
+        if (defDecode || defLookup) {
+            // A compressed copy of the deck: every definition decoded in order straight from its codes, then
+            // random definitions read through def() and its cache, as the game modes read them
+            CardStore packed;
+            packed.reserve(cards.size(), cards.textBytes());
+            for (CardId card = 0; card < cards.size(); ++card) {
+                packed.addCard(cards.term(card), cards.def(card));
+            }
+            auto trainStart = chrono::steady_clock::now();
+            packed.compressDefinitions();
+            double trainMs = chrono::duration<double, milli>(chrono::steady_clock::now() - trainStart).count();
+
+            size_t plainBytes = 0;
+            size_t codeBytes = 0;
+            size_t longestCodes = 0;
+            for (CardId card = 0; card < cards.size(); ++card) {
+                size_t codes = packed.offsetTable()[2 * card + 2] - packed.offsetTable()[2 * card + 1];
+                plainBytes += cards.def(card).size();
+                codeBytes += codes;
+                longestCodes = max(longestCodes, codes);
+                if (packed.def(card) != cards.def(card)) {
+                    cerr << "Error: card " << card << " does not decode to its definition" << endl;
+                    return 1;
+                }
+            }
+            cerr << "    definitions " << plainBytes << " -> " << codeBytes << " bytes ("
+                 << static_cast<double>(plainBytes) / static_cast<double>(max<size_t>(codeBytes, 1)) << "x) with "
+                 << packed.symbolTable()->size() << " symbols, compressed in " << trainMs << " ms" << endl;
+
+            if (defDecode) {
+                const SymbolTable& table = *packed.symbolTable();
+                const uint32_t* offsets = packed.offsetTable();
+                vector<char> scratch(SymbolTable::decodedBound(longestCodes));
+                BenchResult result = measure("def_decode", cardCount, minSeconds, [&](uint64_t n) {
+                    for (uint64_t i = 0; i < n; ++i) {
+                        size_t card = i % packed.size();
+                        sink = sink + table.decode(packed.textData() + offsets[2 * card + 1],
+                                                   offsets[2 * card + 2] - offsets[2 * card + 1], scratch.data());
+                    }
+                });
+                double bytesPerCard = static_cast<double>(plainBytes) / static_cast<double>(cards.size());
+                cerr << "    " << bytesPerCard / result.medianNs << " GB/s decoded" << endl;
+                results.push_back(result);
+            }
+
+            if (defLookup) {
+                FastRng rng(DECK_SEED);
+                vector<CardId> picks(4096);
+                for (CardId& pick : picks) {
+                    pick = rng.below(static_cast<uint32_t>(packed.size()));
+                }
+                results.push_back(measure("def_lookup", cardCount, minSeconds, [&](uint64_t n) {
+                    for (uint64_t i = 0; i < n; ++i) {
+                        sink = sink + packed.def(picks[i % picks.size()]).size();
+                    }
+                }));
+            }
+        }
+
+        if (wanted("grade")) {
+            // Typed answers one character off their definition, against a cached and a changing pattern
+            FastRng rng(DECK_SEED);
+            AnswerGrader grader;
+            const size_t answerCount = min<size_t>(cards.size(), 1024);
+            vector<CardId> asked(answerCount);
+            vector<string> answers(answerCount);
+            for (size_t i = 0; i < answerCount; ++i) {
+                asked[i] = rng.below(static_cast<uint32_t>(cards.size()));
+                answers[i] = withTypo(cards.def(asked[i]), rng);
+            }
+            results.push_back(measure("grade", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    size_t pick = i % answerCount;
+                    sink = sink + gradeAgainstTerm(cards, index, grader, asked[pick], answers[pick]).accepted;
+                }
+            }));
+        }
+    }
+
+    // Whole multiple-choice rounds, against the lookup the games used before cards had ids: a range-for over
+    // the terms with distance(find()) to recover each term's definition. That lookup is quadratic (tens of
+    // seconds a round at 100k cards), so it only runs when --filter asks for it
+    bool roundMult = wanted("round_mult");
+    bool roundFind = !filter.empty() && wanted("round_lookup_find");
+    for (size_t cardCount : sizesGiven ? sizes : ROUND_SIZES) {
+        if (!roundMult && !roundFind) {
+            break;
+        }
+        cerr << "Round of " << cardCount << " cards" << endl;
+        CardStore deck;
+        generateDeck(cardCount, DECK_SEED, deck);
+
+        if (roundFind) {
+            vector<string> inputTerms;
+            vector<string> inputDefs;
+            for (CardId card = 0; card < deck.size(); ++card) {
+                inputTerms.emplace_back(deck.term(card));
+                inputDefs.emplace_back(deck.def(card));
+            }
+            auto findRound = [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    for (const string& term : inputTerms) {
+                        size_t at = distance(inputTerms.begin(), find(inputTerms.begin(), inputTerms.end(), term));
+                        sink = sink + inputDefs[at].size();
+                    }
+                }
+            };
+            results.push_back(measure("round_lookup_find", cardCount, minSeconds, findRound));
+        }
+
+        if (roundMult) {
+            StudyTool studyTool(std::move(deck), DECK_SEED);
+            NullRenderer output;
+            results.push_back(measure("round_mult", cardCount, minSeconds, [&](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    unique_ptr<GameRound> round = studyTool.newRound(RoundKind::MULTIPLE_CHOICE);
+                    round->start(output);
+                    while (!round->finished()) {
+                        round->submit("1", output);
+                    }
+                    sink = sink + round->getScore();
+                }
+            }));
+        }
+    }
+
+    cout << "{\n  \"suite\": \"studytool_bench\",\n  \"version\": 1,\n";
+    cout << "  \"deck_seed\": " << DECK_SEED << ",\n  \"timestamp\": " << time(nullptr) << ",\n";
+#ifdef __VERSION__
+    cout << "  \"compiler\": ";
+    writeJsonString(cout, __VERSION__);
+    cout << ",\n";
+#endif
+    cout << "  \"results\": [" << fixed << setprecision(1);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& result = results[i];
+        cout << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        writeJsonString(cout, result.name);
+        cout << ", \"cards\": " << result.cards << ", \"iterations\": " << result.iterations
+             << ", \"best_ns\": " << result.bestNs << ", \"median_ns\": " << result.medianNs
+             << ", \"ops_per_second\": " << setprecision(3) << (result.medianNs > 0.0 ? 1e9 / result.medianNs : 0.0)
+             << setprecision(1) << "}";
+    }
+    cout << "\n  ]\n}" << endl;
+    return 0;
+}
@@ -0,0 +1,391 @@
+/**
+ * studytoolframebench.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Frame-time benchmark for the graphical front end, built as the studytool_framebench target.
+ * It needs no window and no GPU: an OpenGL 3.3 core context is made through EGL without a surface (on
+ * a machine with no GPU, Mesa's llvmpipe software rasterizer) and every frame is drawn into an offscreen
+ * framebuffer. The games are played on a synthetic deck (see synthdeck.h), one answer per frame so
+ * every frame has new text, and each frame is timed from the first layout to glFinish(). Results are
+ * printed as one JSON document on stdout, like studytool_bench:
+ *   ./studytool_framebench > frames.json
+ *   ./studytool_framebench --width 1920 --height 1080 --frames 300 --ppm /tmp/frame
+ * --ppm writes the last frame of each scenario as <prefix>-<scenario>.ppm to look at.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "cardstore.h"
+#include "cardview.h"
+#include "fastrng.h"
+#include "gamerounds.h"
+#include "glyphatlas.h"
+#include "studytool.h"
+#include "synthdeck.h"
+#include "textbatch.h"
+using namespace std;
+
+static const uint64_t DECK_SEED = 20240301;
+
+struct FrameResult {
+    string name;
+    size_t frames;
+    double meanUs;
+    double p50Us;
+    double p90Us;
+    double p99Us;
+    double maxUs;
+    size_t drawCalls;       // Most in one frame
+    double quads;           // Rectangles per frame, on average
+};
+
+// An OpenGL context with nothing to show it on, and a framebuffer to draw into instead
+struct OffscreenContext {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+
+    ~OffscreenContext() {
+        if (framebuffer != 0) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+        }
+        if (display != EGL_NO_DISPLAY) {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (context != EGL_NO_CONTEXT) {
+                eglDestroyContext(display, context);
+            }
+            eglTerminate(display);
+        }
+    }
+};
+
+/**
+ * Makes a surfaceless OpenGL 3.3 core context current, with a framebuffer of the given size bound
+ * Description:
+ *   - Mesa's surfaceless platform is tried first, as it needs neither a display server nor a GPU; other
+ *     EGL implementations get their default display.
+ */
+static bool makeContext(OffscreenContext& offscreen, int width, int height, string& error) {
+    auto getPlatformDisplay =
+            reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (getPlatformDisplay != nullptr) {
+        offscreen.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (offscreen.display == EGL_NO_DISPLAY) {
+        offscreen.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+    EGLint major = 0;
+    EGLint minor = 0;
+    if (offscreen.display == EGL_NO_DISPLAY || eglInitialize(offscreen.display, &major, &minor) != EGL_TRUE) {
+        offscreen.display = EGL_NO_DISPLAY;
+        error = "Unable to open an EGL display";
+        return false;
+    }
+    if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
+        error = "EGL has no desktop OpenGL";
+        return false;
+    }
+
+    const EGLint configAttributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                       EGL_NONE};
+    EGLConfig config;
+    EGLint configs = 0;
+    if (eglChooseConfig(offscreen.display, configAttributes, &config, 1, &configs) != EGL_TRUE || configs == 0) {
+        error = "No EGL configuration supports OpenGL";
+        return false;
+    }
+    const EGLint contextAttributes[] = {EGL_CONTEXT_MAJOR_VERSION, 3, EGL_CONTEXT_MINOR_VERSION, 3,
+                                        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                        EGL_NONE};
+    offscreen.context = eglCreateContext(offscreen.display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (offscreen.context == EGL_NO_CONTEXT) {
+        error = "Unable to create an OpenGL 3.3 core context";
+        return false;
+    }
+    if (eglMakeCurrent(offscreen.display, EGL_NO_SURFACE, EGL_NO_SURFACE, offscreen.context) != EGL_TRUE) {
+        error = "Unable to make a context current without a surface";
+        return false;
+    }
+    if (gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress)) == 0) {
+        error = "Unable to load the OpenGL functions";
+        return false;
+    }
+
+    glGenRenderbuffers(1, &offscreen.colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, offscreen.colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenFramebuffers(1, &offscreen.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, offscreen.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreen.colorBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        error = "The offscreen framebuffer is incomplete";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the framebuffer as a binary PPM
+ */
+static bool writeFrame(const string& path, int width, int height, string& error) {
+    vector<uint8_t> pixels(static_cast<size_t>(width) * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        error = "Unable to open " + path;
+        return false;
+    }
+    out << "P6\n" << width << ' ' << height << "\n255\n";
+    // OpenGL's rows run bottom to top
+    for (int y = height - 1; y >= 0; --y) {
+        const uint8_t* row = pixels.data() + static_cast<size_t>(y) * width * 4;
+        for (int x = 0; x < width; ++x) {
+            out.write(reinterpret_cast<const char*>(row + x * 4), 3);
+        }
+    }
+    if (!out) {
+        error = "Unable to write " + path;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Draws frames and times them
+ * Inputs:
+ *   - const char* name: Scenario name.
+ *   - size_t frames: Frames to draw.
+ *   - CardView& view, TextBatch& batch, int width, int height: What to draw and where.
+ *   - Step step: Called before each frame with the frame number, to move the game on.
+ * Returns:
+ *   - FrameResult: Frame times.
+ */
+template <typename Step>
+static FrameResult measureFrames(const char* name, size_t frames, CardView& view, TextBatch& batch, int width,
+                                 int height, Step step) {
+    using Clock = chrono::steady_clock;
+    vector<double> micros;
+    micros.reserve(frames);
+    size_t drawCalls = 0;
+    size_t quads = 0;
+    for (size_t frame = 0; frame < frames; ++frame) {
+        step(frame);
+        auto start = Clock::now();
+        batch.begin(width, height, view.background());
+        view.draw(batch, width, height);
+        quads += batch.flush();
+        glFinish();
+        micros.push_back(chrono::duration<double, micro>(Clock::now() - start).count());
+        drawCalls = max(drawCalls, batch.draws());
+    }
+
+    double total = 0.0;
+    for (double us : micros) {
+        total += us;
+    }
+    vector<double> sorted = micros;
+    sort(sorted.begin(), sorted.end());
+    auto at = [&sorted](double fraction) {
+        return sorted[min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())))];
+    };
+    FrameResult result = {name, frames, total / static_cast<double>(frames), at(0.50), at(0.90), at(0.99),
+                          sorted.back(), drawCalls, static_cast<double>(quads) / static_cast<double>(frames)};
+    cerr << "  " << name << ": " << result.p50Us << " us/frame median, " << result.p99Us << " us p99" << endl;
+    return result;
+}
+
+/**
+ * Writes a string as a JSON string literal
+ */
+static void writeJsonString(ostream& out, string_view text) {
+    out << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+int main(int argc, char* argv[]) {
+    int width = 1280;
+    int height = 720;
+    size_t frames = 600;
+    size_t cardCount = 1000;
+    int fontSize = 22;
+    string fontPath;
+    string ppmPrefix;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--width") == 0 && i + 1 < argc) {
+            width = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--height") == 0 && i + 1 < argc) {
+            height = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--cards") == 0 && i + 1 < argc) {
+            cardCount = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--font") == 0 && i + 1 < argc) {
+            fontPath = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            fontSize = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+            ppmPrefix = argv[++i];
+        } else {
+            cerr << "Usage: " << argv[0] << " [--width <px>] [--height <px>] [--frames <n>] [--cards <n>]"
+                 << " [--font <file>] [--size <px>] [--ppm <prefix>]" << endl;
+            return 1;
+        }
+    }
+    if (width < 64 || height < 64 || frames == 0 || cardCount < 4 || fontSize < 6) {
+        cerr << "Error: the frame must be at least 64x64, with at least 1 frame, 4 cards and a 6 px font" << endl;
+        return 1;
+    }
+    if (fontPath.empty()) {
+        fontPath = GlyphAtlas::findDefaultFont();
+        if (fontPath.empty()) {
+            cerr << "Error: no system font found; pass one with --font" << endl;
+            return 1;
+        }
+    }
+
+    string error;
+    OffscreenContext offscreen;
+    if (!makeContext(offscreen, width, height, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    string rendererName = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+    cerr << "Drawing " << width << "x" << height << " frames with " << rendererName << endl;
+
+    GlyphAtlas atlas;
+    if (!atlas.open(fontPath, fontSize, error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+    TextBatch batch(atlas);
+    if (!batch.init(error)) {
+        cerr << "Error: " << error << endl;
+        return 1;
+    }
+
+    CardStore deck;
+    generateDeck(cardCount, DECK_SEED, deck);
+    StudyTool studyTool(std::move(deck), DECK_SEED);
+    const CardStore& cards = studyTool.getCards();
+    FastRng rng(DECK_SEED);
+    vector<FrameResult> results;
+    auto saveFrame = [&](const char* scenario) {
+        if (!ppmPrefix.empty() && !writeFrame(ppmPrefix + "-" + scenario + ".ppm", width, height, error)) {
+            cerr << "Warning: " << error << endl;
+        }
+    };
+
+    // The same screen again and again: what a frame costs when nothing has changed
+    {
+        CardView view(atlas);
+        unique_ptr<GameRound> round = studyTool.newRound(RoundKind::FLASHCARDS);
+        round->start(view);
+        round->submit("", view);
+        results.push_back(measureFrames("redraw", frames, view, batch, width, height, [](size_t) {}));
+        saveFrame("redraw");
+    }
+
+    // One answer a frame: flip, then move on (starring one card in eight)
+    {
+        CardView view(atlas);
+        unique_ptr<GameRound> round = studyTool.newRound(RoundKind::FLASHCARDS);
+        round->start(view);
+        results.push_back(measureFrames("flashcards", frames, view, batch, width, height, [&](size_t) {
+            if (round->finished()) {
+                round = studyTool.newRound(RoundKind::FLASHCARDS);
+                round->start(view);
+            } else if (view.prompt() == CardPrompt::STUDY_STARRED) {
+                round->submit("n", view);
+            } else {
+                round->submit(view.prompt() == CardPrompt::STAR && rng.below(8) == 0 ? "star" : "", view);
+            }
+        }));
+        saveFrame("flashcards");
+    }
+
+    // One guess a frame
+    {
+        CardView view(atlas);
+        unique_ptr<GameRound> round = studyTool.newRound(RoundKind::MULTIPLE_CHOICE);
+        round->start(view);
+        string guess;
+        results.push_back(measureFrames("multiple_choice", frames, view, batch, width, height, [&](size_t) {
+            if (round->finished()) {
+                round = studyTool.newRound(RoundKind::MULTIPLE_CHOICE);
+                round->start(view);
+                return;
+            }
+            guess = to_string(1 + rng.below(static_cast<uint32_t>(max<size_t>(view.choicesShown(), 1))));
+            round->submit(guess, view);
+        }));
+        saveFrame("multiple_choice");
+    }
+
+    // A definition of some 10k words, shown at once and scrolled through three lines a frame: it is laid
+    // out as far as it is scrolled, a few dozen lines per frame, never all in one frame
+    {
+        string longDefinition;
+        for (CardId card = 0; card < min<size_t>(cards.size(), 1000); ++card) {
+            longDefinition += cards.def(card);
+            longDefinition += card % 10 == 9 ? ".\n" : ". ";
+        }
+        CardView view(atlas);
+        view.showTerm("A very long definition", false);
+        view.showDefinition(longDefinition);
+        view.askStar();
+        results.push_back(measureFrames("long_definition", frames, view, batch, width, height, [&](size_t frame) {
+            if (frame > 0) {
+                view.scroll(3);
+            }
+        }));
+        saveFrame("long_definition");
+    }
+
+    cout << "{\n  \"suite\": \"studytool_framebench\",\n  \"version\": 1,\n  \"renderer\": ";
+    writeJsonString(cout, rendererName);
+    cout << ",\n  \"width\": " << width << ",\n  \"height\": " << height << ",\n  \"font_size\": " << fontSize
+         << ",\n  \"glyphs_rasterized\": " << atlas.glyphsRasterized() << ",\n  \"atlas_rows\": " << atlas.rows()
+         << ",\n  \"results\": [" << fixed << setprecision(1);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const FrameResult& result = results[i];
+        cout << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+        writeJsonString(cout, result.name);
+        cout << ", \"frames\": " << result.frames << ", \"mean_us\": " << result.meanUs << ", \"p50_us\": "
+             << result.p50Us << ", \"p90_us\": " << result.p90Us << ", \"p99_us\": " << result.p99Us
+             << ", \"max_us\": " << result.maxUs << ", \"fps\": " << (result.meanUs > 0.0 ? 1e6 / result.meanUs : 0.0)
+             << ", \"draw_calls\": " << result.drawCalls << ", \"quads\": " << result.quads << "}";
+    }
+    cout << "\n  ]\n}" << endl;
+    return 0;
+}
@@ -0,0 +1,729 @@
+/**
+ * studytoolmodule.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the "studytool" Python extension module, which runs the study engine inside
+ * the Python process for studytool_gui.py and scripts. studytool.StudyTool wraps a StudyTool: decks
+ * are loaded by the C++ loader, rounds are played with the same game logic as the terminal, and typed
+ * answers are graded by the same grader. The deck's text and offset table are exported through the
+ * buffer protocol, so memoryview(tool.text) and memoryview(tool.offsets) read the CardStore's memory
+ * (or a compiled deck's mapping) directly; nothing is copied per card, whatever the deck's size.
+ * A round reports what it shows as a list of event tuples rather than text, for the GUI to draw.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "deckloader.h"
+#include "gameio.h"
+#include "gamerounds.h"
+#include "stats.h"
+#include "studytool.h"
+using namespace std;
+
+namespace {
+
+struct StudyToolObject {
+    PyObject_HEAD
+    StudyTool* tool;
+    SessionStats* stats;
+    uint64_t gamesRecorded;
+    Py_ssize_t pins;        // Buffer exports and rounds still alive; cards cannot be added until they go
+};
+
+enum class DeckPart {
+    TEXT,
+    OFFSETS
+};
+
+struct DeckBufferObject {
+    PyObject_HEAD
+    StudyToolObject* owner;
+    DeckPart part;
+    Py_ssize_t shape;       // Items, and bytes per item, for the views handed out
+    Py_ssize_t stride;
+};
+
+struct RoundObject {
+    PyObject_HEAD
+    StudyToolObject* owner;
+    GameRound* round;
+    bool recorded;          // Score and outcomes have gone into the owner's statistics
+};
+
+// Created by PyInit_studytool
+PyTypeObject* studyToolType = nullptr;
+PyTypeObject* deckBufferType = nullptr;
+PyTypeObject* roundType = nullptr;
+
+// An empty deck has no offset table; an empty buffer still needs somewhere to point
+const uint32_t NO_OFFSETS[1] = {0};
+
+PyObject* toPython(string_view text) {
+    return PyUnicode_DecodeUTF8(text.data(), static_cast<Py_ssize_t>(text.size()), "replace");
+}
+
+// Turns an exception from the engine into a Python one; returns nullptr for the caller to return
+PyObject* raiseFrom(const exception& failure) {
+    if (dynamic_cast<const bad_alloc*>(&failure) != nullptr) {
+        return PyErr_NoMemory();
+    }
+    if (dynamic_cast<const length_error*>(&failure) != nullptr) {
+        PyErr_SetString(PyExc_OverflowError, failure.what());
+    } else if (dynamic_cast<const logic_error*>(&failure) != nullptr) {
+        PyErr_SetString(PyExc_ValueError, failure.what());
+    } else {
+        PyErr_SetString(PyExc_RuntimeError, failure.what());
+    }
+    return nullptr;
+}
+
+bool checkCard(const StudyToolObject* self, unsigned long long card) {
+    if (card >= self->tool->getCards().size()) {
+        PyErr_Format(PyExc_IndexError, "card %llu is out of range for a deck of %zu cards", card,
+                     self->tool->getCards().size());
+        return false;
+    }
+    return true;
+}
+
+// Collects a round's events as tuples in a list
+class EventRenderer : public GameRenderer {
+private:
+    PyObject* events;
+    bool failed;
+
+    void add(PyObject* event) {
+        if (event == nullptr || PyList_Append(events, event) < 0) {
+            failed = true;
+        }
+        Py_XDECREF(event);
+    }
+
+public:
+    EventRenderer() : events(PyList_New(0)), failed(events == nullptr) {}
+    ~EventRenderer() override { Py_XDECREF(events); }
+
+    /**
+     * Returns:
+     *   - PyObject*: The events as a new reference, or nullptr with a Python error set.
+     */
+    PyObject* take() {
+        if (failed) {
+            if (!PyErr_Occurred()) {
+                PyErr_NoMemory();
+            }
+            return nullptr;
+        }
+        PyObject* taken = events;
+        events = nullptr;
+        return taken;
+    }
+
+    void clear() override { add(Py_BuildValue("(s)", "clear")); }
+    void message(string_view text) override { add(Py_BuildValue("(sN)", "message", toPython(text))); }
+    void showTerm(string_view term, bool typedAnswer) override {
+        add(Py_BuildValue("(sNO)", "term", toPython(term), typedAnswer ? Py_True : Py_False));
+    }
+    void showDefinition(string_view definition) override {
+        add(Py_BuildValue("(sN)", "definition", toPython(definition)));
+    }
+    void showChoices(const CardStore&, const vector<CardId>& options) override {
+        PyObject* ids = PyTuple_New(static_cast<Py_ssize_t>(options.size()));
+        for (size_t i = 0; ids != nullptr && i < options.size(); ++i) {
+            PyTuple_SET_ITEM(ids, static_cast<Py_ssize_t>(i), PyLong_FromUnsignedLong(options[i]));
+        }
+        add(ids == nullptr ? nullptr : Py_BuildValue("(sN)", "choices", ids));
+    }
+    void askFlip() override { add(Py_BuildValue("(ss)", "ask", "flip")); }
+    void askStar() override { add(Py_BuildValue("(ss)", "ask", "star")); }
+    void askStudyStarred() override { add(Py_BuildValue("(ss)", "ask", "study_starred")); }
+    void askRating() override { add(Py_BuildValue("(ss)", "ask", "rating")); }
+    void askChoice(size_t choices, bool retry) override {
+        add(Py_BuildValue("(ssnO)", "ask", "choice", static_cast<Py_ssize_t>(choices), retry ? Py_True : Py_False));
+    }
+    void showChoiceResult(bool correct, size_t correctChoice) override {
+        add(Py_BuildValue("(sOn)", "choice_result", correct ? Py_True : Py_False,
+                          static_cast<Py_ssize_t>(correctChoice)));
+    }
+    void showGrade(string_view definition, const GradeResult& result) override {
+        add(Py_BuildValue("(sNOk)", "grade", toPython(definition), result.accepted ? Py_True : Py_False,
+                          static_cast<unsigned long>(result.distance)));
+    }
+    void showScore(string_view gameName, int score, size_t total) override {
+        add(Py_BuildValue("(sNin)", "score", toPython(gameName), score, static_cast<Py_ssize_t>(total)));
+    }
+    void showCountdown(int secondsLeft) override { add(Py_BuildValue("(si)", "countdown", secondsLeft)); }
+};
+
+// ---- DeckBuffer: a read-only view of the deck's text or offsets ----
+
+int deckBufferGet(PyObject* object, Py_buffer* view, int flags) {
+    DeckBufferObject* self = reinterpret_cast<DeckBufferObject*>(object);
+    if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE) {
+        PyErr_SetString(PyExc_BufferError, "the deck is read-only");
+        view->obj = nullptr;
+        return -1;
+    }
+
+    const CardStore& cards = self->owner->tool->getCards();
+    view->obj = object;
+    Py_INCREF(object);
+    view->readonly = 1;
+    view->ndim = 1;
+    view->suboffsets = nullptr;
+    view->internal = nullptr;
+    if (self->part == DeckPart::TEXT) {
+        view->buf = const_cast<char*>(cards.empty() ? "" : cards.textData());
+        view->len = static_cast<Py_ssize_t>(cards.textBytes());
+        view->itemsize = 1;
+        view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? const_cast<char*>("B") : nullptr;
+    } else {
+        size_t offsets = cards.empty() ? 0 : 2 * cards.size() + 1;
+        view->buf = const_cast<uint32_t*>(cards.empty() ? NO_OFFSETS : cards.offsetTable());
+        view->len = static_cast<Py_ssize_t>(offsets * sizeof(uint32_t));
+        view->itemsize = sizeof(uint32_t);
+        view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? const_cast<char*>("I") : nullptr;
+    }
+    // One dimension, contiguous; the deck cannot change while a view is out, so every view shares these
+    self->shape = view->len / view->itemsize;
+    self->stride = view->itemsize;
+    view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &self->shape : nullptr;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &self->stride : nullptr;
+    ++self->owner->pins;
+    return 0;
+}
+
+void deckBufferRelease(PyObject* object, Py_buffer*) {
+    --reinterpret_cast<DeckBufferObject*>(object)->owner->pins;
+}
+
+void deckBufferDealloc(PyObject* object) {
+    Py_XDECREF(reinterpret_cast<DeckBufferObject*>(object)->owner);
+    PyTypeObject* type = Py_TYPE(object);
+    type->tp_free(object);
+    Py_DECREF(type);
+}
+
+
+PyObject* newDeckBuffer(StudyToolObject* owner, DeckPart part) {
+    DeckBufferObject* buffer = PyObject_New(DeckBufferObject, deckBufferType);
+    if (buffer == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(owner);
+    buffer->owner = owner;
+    buffer->part = part;
+    return reinterpret_cast<PyObject*>(buffer);
+}
+
+// ---- Round: one game mode, pushed an answer at a time ----
+
+// Folds a finished round into its owner's statistics, once
+void recordRound(RoundObject* self) {
+    if (self->recorded || !self->round->finished()) {
+        return;
+    }
+    self->recorded = true;
+    const vector<CardOutcome>& outcomes = self->round->getOutcomes();
+    if (outcomes.empty()) {
+        return;     // Flashcards: nothing scored, as in the terminal game
+    }
+    GameSession session{self->round->name(), self->round->getScore(), 0, 0, static_cast<int>(outcomes.size()),
+                        outcomes};
+    self->owner->stats->record(++self->owner->gamesRecorded, session);
+    self->owner->stats->recordOutcomes(outcomes);
+}
+
+PyObject* roundStart(PyObject* object, PyObject*) {
+    RoundObject* self = reinterpret_cast<RoundObject*>(object);
+    EventRenderer events;
+    try {
+        self->round->start(events);
+    } catch (const exception& failure) {
+        return raiseFrom(failure);
+    }
+    recordRound(self);
+    return events.take();
+}
+
+PyObject* roundSubmit(PyObject* object, PyObject* args) {
+    RoundObject* self = reinterpret_cast<RoundObject*>(object);
+    const char* answer;
+    Py_ssize_t length;
+    if (!PyArg_ParseTuple(args, "s#:submit", &answer, &length)) {
+        return nullptr;
+    }
+    if (self->round->finished()) {
+        PyErr_SetString(PyExc_RuntimeError, "the round is over");
+        return nullptr;
+    }
+    EventRenderer events;
+    try {
+        self->round->submit(string_view(answer, static_cast<size_t>(length)), events);
+    } catch (const exception& failure) {
+        return raiseFrom(failure);
+    }
+    recordRound(self);
+    return events.take();
+}
+
+PyObject* roundExpire(PyObject* object, PyObject*) {
+    RoundObject* self = reinterpret_cast<RoundObject*>(object);
+    EventRenderer events;
+    self->round->expire(events);
+    recordRound(self);
+    return events.take();
+}
+
+PyObject* roundFinished(PyObject* object, void*) {
+    return PyBool_FromLong(reinterpret_cast<RoundObject*>(object)->round->finished());
+}
+
+PyObject* roundScore(PyObject* object, void*) {
+    return PyLong_FromLong(reinterpret_cast<RoundObject*>(object)->round->getScore());
+}
+
+PyObject* roundName(PyObject* object, void*) {
+    return PyUnicode_FromString(reinterpret_cast<RoundObject*>(object)->round->name());
+}
+
+PyObject* roundDeadline(PyObject* object, void*) {
+    chrono::steady_clock::time_point when;
+    if (!reinterpret_cast<RoundObject*>(object)->round->deadline(when)) {
+        Py_RETURN_NONE;
+    }
+    double left = chrono::duration<double>(when - chrono::steady_clock::now()).count();
+    return PyFloat_FromDouble(left > 0.0 ? left : 0.0);
+}
+
+PyObject* roundOutcomes(PyObject* object, void*) {
+    const vector<CardOutcome>& outcomes = reinterpret_cast<RoundObject*>(object)->round->getOutcomes();
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(outcomes.size()));
+    for (size_t i = 0; list != nullptr && i < outcomes.size(); ++i) {
+        PyObject* outcome = Py_BuildValue("(kO)", static_cast<unsigned long>(outcomes[i].card),
+                                          outcomes[i].correct ? Py_True : Py_False);
+        if (outcome == nullptr) {
+            Py_CLEAR(list);
+            break;
+        }
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), outcome);
+    }
+    return list;
+}
+
+void roundDealloc(PyObject* object) {
+    RoundObject* self = reinterpret_cast<RoundObject*>(object);
+    delete self->round;
+    if (self->owner != nullptr) {
+        --self->owner->pins;
+        Py_DECREF(self->owner);
+    }
+    PyTypeObject* type = Py_TYPE(object);
+    type->tp_free(object);
+    Py_DECREF(type);
+}
+
+PyMethodDef roundMethods[] = {
+        {"start", roundStart, METH_NOARGS,
+         "start() -> list of events\n\nShows the first prompt. Call once, before submit()."},
+        {"submit", roundSubmit, METH_VARARGS,
+         "submit(answer) -> list of events\n\nPushes one line of input: a typed definition, a choice number,\n"
+         "'star', a rating, 'y' or 'n', as the terminal game would take it."},
+        {"expire", roundExpire, METH_NOARGS,
+         "expire() -> list of events\n\nEnds a timed round whose deadline passed before an answer came."},
+        {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef roundGetters[] = {
+        {"finished", roundFinished, nullptr, "True once the round is over.", nullptr},
+        {"score", roundScore, nullptr, "Correct answers so far.", nullptr},
+        {"name", roundName, nullptr, "Mode name used for statistics, e.g. 'MatchingGame'.", nullptr},
+        {"deadline", roundDeadline, nullptr, "Seconds left in a timed round, or None.", nullptr},
+        {"outcomes", roundOutcomes, nullptr, "(card, correct) for each card answered, in order.", nullptr},
+        {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+// ---- StudyTool ----
+
+PyObject* studyToolNew(PyTypeObject* type, PyObject*, PyObject*) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(type->tp_alloc(type, 0));
+    if (self != nullptr) {
+        self->tool = nullptr;
+        self->stats = nullptr;
+        self->gamesRecorded = 0;
+        self->pins = 0;
+    }
+    return reinterpret_cast<PyObject*>(self);
+}
+
+/**
+ * StudyTool(deck=None, seed=None)
+ * Description:
+ *   - Loads the deck (TSV, CSV or compiled) with the GIL released, so other Python threads (the Tk event
+ *     loop) keep running while a large deck loads.
+ */
+int studyToolInit(PyObject* object, PyObject* args, PyObject* kwargs) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    static const char* keywords[] = {"deck", "seed", nullptr};
+    PyObject* deckArg = Py_None;
+    PyObject* seedArg = Py_None;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OO:StudyTool", const_cast<char**>(keywords), &deckArg,
+                                     &seedArg)) {
+        return -1;
+    }
+    if (self->tool != nullptr) {
+        PyErr_SetString(PyExc_RuntimeError, "StudyTool is already initialized");
+        return -1;
+    }
+
+    uint64_t seed;
+    if (seedArg == Py_None) {
+        seed = random_device()();
+        seed = (seed << 32) ^ random_device()();
+    } else {
+        seed = PyLong_AsUnsignedLongLongMask(seedArg);
+        if (PyErr_Occurred()) {
+            return -1;
+        }
+    }
+
+    CardStore cards;
+    if (deckArg != Py_None) {
+        PyObject* pathBytes = nullptr;
+        if (!PyUnicode_FSConverter(deckArg, &pathBytes)) {
+            return -1;
+        }
+        string path(PyBytes_AS_STRING(pathBytes), static_cast<size_t>(PyBytes_GET_SIZE(pathBytes)));
+        Py_DECREF(pathBytes);
+
+        string error;
+        bool loaded;
+        Py_BEGIN_ALLOW_THREADS
+        try {
+            loaded = loadDeck(path, cards, error);
+        } catch (const exception& failure) {
+            loaded = false;
+            error = failure.what();
+        }
+        Py_END_ALLOW_THREADS
+        if (!loaded) {
+            PyErr_SetString(PyExc_OSError, error.c_str());
+            return -1;
+        }
+    }
+
+    try {
+        self->tool = new StudyTool(std::move(cards), seed);
+        self->stats = new SessionStats();
+    } catch (const exception& failure) {
+        raiseFrom(failure);
+        return -1;
+    }
+    return 0;
+}
+
+void studyToolDealloc(PyObject* object) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    delete self->stats;
+    delete self->tool;
+    PyTypeObject* type = Py_TYPE(object);
+    type->tp_free(object);
+    Py_DECREF(type);
+}
+
+bool checkReady(StudyToolObject* self) {
+    if (self->tool == nullptr) {
+        PyErr_SetString(PyExc_RuntimeError, "StudyTool.__init__ was not called");
+        return false;
+    }
+    return true;
+}
+
+Py_ssize_t studyToolLength(PyObject* object) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    return checkReady(self) ? static_cast<Py_ssize_t>(self->tool->getCards().size()) : -1;
+}
+
+PyObject* studyToolAdd(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    const char* term;
+    Py_ssize_t termLength;
+    const char* definition;
+    Py_ssize_t definitionLength;
+    if (!checkReady(self)
+        || !PyArg_ParseTuple(args, "s#s#:add_term_definition", &term, &termLength, &definition, &definitionLength)) {
+        return nullptr;
+    }
+    if (self->pins > 0) {
+        // Adding may move the text, and rounds hold on to the index
+        PyErr_SetString(PyExc_BufferError, "cards cannot be added while views of the deck or rounds exist");
+        return nullptr;
+    }
+    try {
+        CardId card = self->tool->addCard(string_view(term, static_cast<size_t>(termLength)),
+                                          string_view(definition, static_cast<size_t>(definitionLength)));
+        return PyLong_FromUnsignedLong(card);
+    } catch (const exception& failure) {
+        return raiseFrom(failure);
+    }
+}
+
+PyObject* studyToolTerm(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    unsigned long long card;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "K:term", &card) || !checkCard(self, card)) {
+        return nullptr;
+    }
+    return toPython(self->tool->getCards().term(static_cast<CardId>(card)));
+}
+
+PyObject* studyToolDefinition(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    unsigned long long card;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "K:definition", &card) || !checkCard(self, card)) {
+        return nullptr;
+    }
+    return toPython(self->tool->getCards().def(static_cast<CardId>(card)));
+}
+
+PyObject* studyToolFind(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    const char* term;
+    Py_ssize_t length;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "s#:find", &term, &length)) {
+        return nullptr;
+    }
+    const StudyTool& tool = *self->tool;
+    CardId card = tool.getIndex().findTerm(tool.getCards(), string_view(term, static_cast<size_t>(length)));
+    if (card == NO_CARD) {
+        Py_RETURN_NONE;
+    }
+    return PyLong_FromUnsignedLong(card);
+}
+
+PyObject* studyToolGrade(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    unsigned long long card;
+    const char* answer;
+    Py_ssize_t length;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "Ks#:grade", &card, &answer, &length)
+        || !checkCard(self, card)) {
+        return nullptr;
+    }
+    GradeResult result =
+            self->tool->grade(static_cast<CardId>(card), string_view(answer, static_cast<size_t>(length)));
+    return Py_BuildValue("(Ok)", result.accepted ? Py_True : Py_False, static_cast<unsigned long>(result.distance));
+}
+
+PyObject* studyToolSeed(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    unsigned long long seed;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "K:seed", &seed)) {
+        return nullptr;
+    }
+    self->tool->setSeed(seed);
+    Py_RETURN_NONE;
+}
+
+PyObject* studyToolNewRound(PyObject* object, PyObject* args, PyObject* kwargs) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    static const char* keywords[] = {"mode", "time_limit", nullptr};
+    const char* mode;
+    int timeLimit = 0;
+    if (!checkReady(self)
+        || !PyArg_ParseTupleAndKeywords(args, kwargs, "s|i:new_round", const_cast<char**>(keywords), &mode,
+                                        &timeLimit)) {
+        return nullptr;
+    }
+
+    // The same names as the replay directives
+    string_view name(mode);
+    RoundKind kind;
+    if (name == "flip") {
+        kind = RoundKind::FLASHCARDS;
+    } else if (name == "mult") {
+        kind = RoundKind::MULTIPLE_CHOICE;
+    } else if (name == "match") {
+        kind = RoundKind::MATCHING;
+    } else if (name == "timed" && timeLimit > 0) {
+        kind = RoundKind::TIMED;
+    } else {
+        PyErr_Format(PyExc_ValueError, "unknown mode '%s' (expected 'flip', 'mult', 'match' or 'timed' with a "
+                                       "positive time_limit)", mode);
+        return nullptr;
+    }
+
+    RoundObject* round = PyObject_New(RoundObject, roundType);
+    if (round == nullptr) {
+        return nullptr;
+    }
+    round->owner = nullptr;
+    round->recorded = false;
+    try {
+        round->round = self->tool->newRound(kind, timeLimit).release();
+    } catch (const exception& failure) {
+        round->round = nullptr;
+        Py_DECREF(round);
+        return raiseFrom(failure);
+    }
+    Py_INCREF(self);
+    round->owner = self;
+    ++self->pins;
+    return reinterpret_cast<PyObject*>(round);
+}
+
+PyObject* summaryToDict(const ModeSummary& summary) {
+    PyObject* recent = PyList_New(static_cast<Py_ssize_t>(summary.recent.size()));
+    for (size_t i = 0; recent != nullptr && i < summary.recent.size(); ++i) {
+        PyList_SET_ITEM(recent, static_cast<Py_ssize_t>(i), PyLong_FromLong(summary.recent[i]));
+    }
+    if (recent == nullptr) {
+        return nullptr;
+    }
+    return Py_BuildValue("{s:N,s:K,s:d,s:i,s:i,s:i,s:i,s:d,s:N}", "gameMode", toPython(summary.gameMode), "count",
+                         static_cast<unsigned long long>(summary.count), "mean", summary.mean, "best", summary.best,
+                         "worst", summary.worst, "median", summary.median, "p90", summary.p90, "recentMean",
+                         summary.recentMean, "recent", recent);
+}
+
+PyObject* studyToolSummary(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    const char* mode;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "s:summary", &mode)) {
+        return nullptr;
+    }
+    ModeSummary summary;
+    if (!self->stats->summarize(mode, summary)) {
+        Py_RETURN_NONE;
+    }
+    return summaryToDict(summary);
+}
+
+PyObject* studyToolWeakest(PyObject* object, PyObject* args) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    Py_ssize_t count = 10;
+    if (!checkReady(self) || !PyArg_ParseTuple(args, "|n:weakest_cards", &count)) {
+        return nullptr;
+    }
+    vector<CardId> weakest;
+    self->stats->weakestCards(count > 0 ? static_cast<size_t>(count) : 0, weakest);
+    PyObject* list = PyList_New(static_cast<Py_ssize_t>(weakest.size()));
+    for (size_t i = 0; list != nullptr && i < weakest.size(); ++i) {
+        PyList_SET_ITEM(list, static_cast<Py_ssize_t>(i), PyLong_FromUnsignedLong(weakest[i]));
+    }
+    return list;
+}
+
+PyObject* studyToolText(PyObject* object, void*) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    return checkReady(self) ? newDeckBuffer(self, DeckPart::TEXT) : nullptr;
+}
+
+PyObject* studyToolOffsets(PyObject* object, void*) {
+    StudyToolObject* self = reinterpret_cast<StudyToolObject*>(object);
+    return checkReady(self) ? newDeckBuffer(self, DeckPart::OFFSETS) : nullptr;
+}
+
+PyMethodDef studyToolMethods[] = {
+        {"add_term_definition", studyToolAdd, METH_VARARGS,
+         "add_term_definition(term, definition) -> card id\n\nAdds a card. Not possible for a compiled deck, or "
+         "while\nmemoryviews of the deck or rounds are alive."},
+        {"term", studyToolTerm, METH_VARARGS, "term(card) -> str"},
+        {"definition", studyToolDefinition, METH_VARARGS, "definition(card) -> str"},
+        {"find", studyToolFind, METH_VARARGS, "find(term) -> card id or None\n\nExact match on the term's bytes."},
+        {"grade", studyToolGrade, METH_VARARGS,
+         "grade(card, answer) -> (accepted, distance)\n\nGrades a typed definition like the matching and timed "
+         "games:\nignoring case, accents and spacing, with small typos accepted."},
+        {"seed", studyToolSeed, METH_VARARGS, "seed(n)\n\nReseeds the random choices of the next rounds."},
+        {"new_round", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(studyToolNewRound)),
+         METH_VARARGS | METH_KEYWORDS,
+         "new_round(mode, time_limit=0) -> Round\n\nmode is 'flip', 'mult', 'match' or 'timed'. Finished rounds "
+         "count\ntowards summary() and weakest_cards()."},
+        {"summary", studyToolSummary, METH_VARARGS,
+         "summary(mode) -> dict or None\n\nScore statistics of the finished rounds of a mode, e.g. "
+         "'MatchingGame'."},
+        {"weakest_cards", studyToolWeakest, METH_VARARGS,
+         "weakest_cards(k=10) -> list of card ids\n\nCards answered wrong most often, lowest accuracy first."},
+        {nullptr, nullptr, 0, nullptr}};
+
+PyGetSetDef studyToolGetters[] = {
+        {"text", studyToolText, nullptr,
+         "Buffer of every term and definition, back to back, as UTF-8 bytes (read-only, not copied).", nullptr},
+        {"offsets", studyToolOffsets, nullptr,
+         "Buffer of 2 * len(self) + 1 uint32 offsets into text: term i is text[offsets[2i]:offsets[2i+1]],\n"
+         "its definition text[offsets[2i+1]:offsets[2i+2]] (read-only, not copied).",
+         nullptr},
+        {nullptr, nullptr, nullptr, nullptr, nullptr}};
+
+PyType_Slot studyToolSlots[] = {
+        {Py_tp_doc, const_cast<char*>("StudyTool(deck=None, seed=None)\n\nA deck (loaded from a TSV, CSV or compiled "
+                                      ".stdeck file, or empty)\nand the game engine over it.")},
+        {Py_tp_new, reinterpret_cast<void*>(studyToolNew)},
+        {Py_tp_init, reinterpret_cast<void*>(studyToolInit)},
+        {Py_tp_dealloc, reinterpret_cast<void*>(studyToolDealloc)},
+        {Py_tp_methods, studyToolMethods},
+        {Py_tp_getset, studyToolGetters},
+        {Py_sq_length, reinterpret_cast<void*>(studyToolLength)},
+        {0, nullptr}};
+
+PyType_Slot deckBufferSlots[] = {
+        {Py_tp_doc, const_cast<char*>("Read-only view of a StudyTool's cards; use memoryview() on it.")},
+        {Py_tp_dealloc, reinterpret_cast<void*>(deckBufferDealloc)},
+        {Py_bf_getbuffer, reinterpret_cast<void*>(deckBufferGet)},
+        {Py_bf_releasebuffer, reinterpret_cast<void*>(deckBufferRelease)},
+        {0, nullptr}};
+
+PyType_Slot roundSlots[] = {
+        {Py_tp_doc, const_cast<char*>("One game round. start() and submit() return what it shows as event tuples,\n"
+                                      "e.g. ('term', 'photosynthesis', False), ('choices', (3, 0, 7, 1)),\n"
+                                      "('ask', 'choice', 4, False).")},
+        {Py_tp_dealloc, reinterpret_cast<void*>(roundDealloc)},
+        {Py_tp_methods, roundMethods},
+        {Py_tp_getset, roundGetters},
+        {0, nullptr}};
+
+PyType_Spec studyToolSpec = {"studytool.StudyTool", sizeof(StudyToolObject), 0, Py_TPFLAGS_DEFAULT, studyToolSlots};
+PyType_Spec deckBufferSpec = {"studytool.DeckBuffer", sizeof(DeckBufferObject), 0, Py_TPFLAGS_DEFAULT,
+                              deckBufferSlots};
+PyType_Spec roundSpec = {"studytool.Round", sizeof(RoundObject), 0, Py_TPFLAGS_DEFAULT, roundSlots};
+
+PyModuleDef studyToolModule = {PyModuleDef_HEAD_INIT,
+                               "studytool",
+                               "The CppPy-StudyTool engine: decks, game rounds, grading and score statistics.",
+                               -1,
+                               nullptr,
+                               nullptr,
+                               nullptr,
+                               nullptr,
+                               nullptr};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_studytool() {
+    studyToolType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&studyToolSpec));
+    deckBufferType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&deckBufferSpec));
+    roundType = reinterpret_cast<PyTypeObject*>(PyType_FromSpec(&roundSpec));
+    if (studyToolType == nullptr || deckBufferType == nullptr || roundType == nullptr) {
+        return nullptr;
+    }
+    PyObject* module = PyModule_Create(&studyToolModule);
+    if (module == nullptr) {
+        return nullptr;
+    }
+    Py_INCREF(studyToolType);
+    if (PyModule_AddObject(module, "StudyTool", reinterpret_cast<PyObject*>(studyToolType)) < 0) {
+        Py_DECREF(studyToolType);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,238 @@
+/**
+ * symboltable.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for SymbolTable.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "symboltable.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "textnorm.h"
+using namespace std;
+
+namespace {
+const size_t TRAINING_PASSES = 5;
+const size_t MAX_SYMBOLS = 255;     // Code 255 is the escape
+
+struct Candidate {
+    uint64_t value;
+    size_t length;
+
+    bool operator==(const Candidate& other) const { return value == other.value && length == other.length; }
+};
+
+struct CandidateHash {
+    size_t operator()(const Candidate& candidate) const {
+        return static_cast<size_t>((candidate.value ^ candidate.length) * 0x9E3779B97F4A7C15ULL >> 16);
+    }
+};
+
+Candidate loadCandidate(const char* text, size_t length) {
+    Candidate candidate{0, length};
+    memcpy(&candidate.value, text, length);
+    return candidate;
+}
+
+inline void copySymbol(char* out, const uint64_t& symbol) { memcpy(out, &symbol, sizeof(symbol)); }
+}
+
+SymbolTable::SymbolTable() : symbols(), lengths(), symbolCount(0), byPrefix(), prefixStart(), byFirstByte() {
+    rebuildLookup();
+}
+
+// Symbols of two bytes or more are looked up by their first two bytes, longest first; single bytes directly
+void SymbolTable::rebuildLookup() {
+    byPrefix.clear();
+    prefixStart.assign(65536 + 1, 0);
+    fill(begin(byFirstByte), end(byFirstByte), ESCAPE);
+
+    vector<uint8_t> order;
+    for (size_t code = 0; code < symbolCount; ++code) {
+        if (lengths[code] == 1) {
+            byFirstByte[static_cast<uint8_t>(reinterpret_cast<const char*>(&symbols[code])[0])] =
+                    static_cast<uint8_t>(code);
+        } else {
+            order.push_back(static_cast<uint8_t>(code));
+        }
+    }
+    auto prefixOf = [this](uint8_t code) {
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&symbols[code]);
+        return static_cast<size_t>(bytes[0]) | static_cast<size_t>(bytes[1]) << 8;
+    };
+    sort(order.begin(), order.end(), [&](uint8_t a, uint8_t b) {
+        size_t prefixA = prefixOf(a), prefixB = prefixOf(b);
+        if (prefixA != prefixB) {
+            return prefixA < prefixB;
+        }
+        return lengths[a] != lengths[b] ? lengths[a] > lengths[b] : a < b;
+    });
+    for (uint8_t code : order) {
+        ++prefixStart[prefixOf(code) + 1];
+    }
+    for (size_t prefix = 0; prefix < 65536; ++prefix) {
+        prefixStart[prefix + 1] += prefixStart[prefix];
+    }
+    byPrefix = std::move(order);
+}
+
+// Length of the longest symbol the text starts with, or 0 if only an escape covers its first byte
+size_t SymbolTable::longestMatch(const char* text, size_t remaining, uint8_t& code) const {
+    if (remaining >= 2) {
+        size_t prefix = static_cast<size_t>(static_cast<unsigned char>(text[0]))
+                        | static_cast<size_t>(static_cast<unsigned char>(text[1])) << 8;
+        for (size_t at = prefixStart[prefix]; at < prefixStart[prefix + 1]; ++at) {
+            uint8_t candidate = byPrefix[at];
+            if (lengths[candidate] <= remaining && memcmp(text, &symbols[candidate], lengths[candidate]) == 0) {
+                code = candidate;
+                return lengths[candidate];
+            }
+        }
+    }
+    code = byFirstByte[static_cast<unsigned char>(text[0])];
+    return code == ESCAPE ? 0 : 1;
+}
+
+/**
+ * Trains the table
+ * Inputs:
+ *   - const vector<string_view>& sample: Strings representative of those to be encoded.
+ */
+void SymbolTable::train(const vector<string_view>& sample) {
+    symbolCount = 0;
+    fill(begin(lengths), end(lengths), 0);
+    fill(begin(symbols), end(symbols), 0);
+    rebuildLookup();
+
+    for (size_t pass = 0; pass < TRAINING_PASSES; ++pass) {
+        // Bytes each candidate would have covered: the symbols used, single bytes, and adjacent pairs
+        unordered_map<Candidate, uint64_t, CandidateHash> gains;
+        for (string_view text : sample) {
+            size_t previous = 0;
+            for (size_t at = 0; at < text.size();) {
+                uint8_t code;
+                size_t length = max<size_t>(longestMatch(text.data() + at, text.size() - at, code), 1);
+                gains[loadCandidate(text.data() + at, length)] += length;
+                if (length > 1) {
+                    gains[loadCandidate(text.data() + at, 1)] += 1;
+                }
+                if (previous > 0 && previous + length <= MAX_SYMBOL) {
+                    gains[loadCandidate(text.data() + at - previous, previous + length)] += previous + length;
+                }
+                previous = length;
+                at += length;
+            }
+        }
+
+        vector<pair<uint64_t, Candidate>> ranked;
+        ranked.reserve(gains.size());
+        for (const auto& entry : gains) {
+            ranked.emplace_back(entry.second, entry.first);
+        }
+        // Ties are broken on the symbol itself so the same sample always trains the same table
+        size_t keep = min(MAX_SYMBOLS, ranked.size());
+        partial_sort(ranked.begin(), ranked.begin() + static_cast<ptrdiff_t>(keep), ranked.end(),
+                     [](const pair<uint64_t, Candidate>& a, const pair<uint64_t, Candidate>& b) {
+                         if (a.first != b.first) {
+                             return a.first > b.first;
+                         }
+                         if (a.second.length != b.second.length) {
+                             return a.second.length > b.second.length;
+                         }
+                         return a.second.value < b.second.value;
+                     });
+
+        fill(begin(lengths), end(lengths), 0);
+        fill(begin(symbols), end(symbols), 0);
+        for (size_t code = 0; code < keep; ++code) {
+            symbols[code] = ranked[code].second.value;
+            lengths[code] = static_cast<uint8_t>(ranked[code].second.length);
+        }
+        symbolCount = keep;
+        rebuildLookup();
+    }
+}
+
+/**
+ * Encodes a string
+ * Inputs:
+ *   - string_view text: Text to encode.
+ *   - string& out: Receives the codes, appended.
+ */
+void SymbolTable::encode(string_view text, string& out) const {
+    for (size_t at = 0; at < text.size();) {
+        uint8_t code;
+        size_t length = longestMatch(text.data() + at, text.size() - at, code);
+        if (length == 0) {
+            out += static_cast<char>(ESCAPE);
+            out += text[at];
+            ++at;
+        } else {
+            out += static_cast<char>(code);
+            at += length;
+        }
+    }
+}
+
+/**
+ * Decodes a string encoded by this table
+ * Inputs:
+ *   - const char* codes: Codes from encode().
+ *   - size_t length: Number of code bytes.
+ *   - char* out: Destination; must hold decodedBound(length) bytes.
+ * Returns:
+ *   - size_t: Length of the decoded text.
+ * Description:
+ *   - Every symbol is copied as a whole 8-byte word and the output advanced by its length, so there is no
+ *     per-byte loop. While the next eight codes hold no escape they are decoded without a branch between them.
+ */
+size_t SymbolTable::decode(const char* codes, size_t length, char* out) const {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(codes);
+    const unsigned char* end = in + length;
+    char* start = out;
+
+    while (in < end) {
+        if (end - in >= 8) {
+            uint64_t word;
+            memcpy(&word, in, sizeof(word));
+            uint64_t inverted = ~word;
+            // A byte of 0xFF (ESCAPE) is a zero byte of the inverted word
+            if (((inverted - 0x0101010101010101ULL) & ~inverted & 0x8080808080808080ULL) == 0) {
+                for (size_t k = 0; k < 8; ++k) {
+                    copySymbol(out, symbols[in[k]]);
+                    out += lengths[in[k]];
+                }
+                in += 8;
+                continue;
+            }
+        }
+        unsigned char code = *in++;
+        if (code != ESCAPE) {
+            copySymbol(out, symbols[code]);
+            out += lengths[code];
+        } else if (in < end) {
+            *out++ = static_cast<char>(*in++);
+        }
+    }
+    return static_cast<size_t>(out - start);
+}
+
+/**
+ * Returns:
+ *   - size_t: Heap bytes held by the lookup tables.
+ */
+size_t SymbolTable::heapBytes() const {
+    return byPrefix.capacity() + prefixStart.capacity() * sizeof(uint16_t);
+}
+
+/**
+ * Returns:
+ *   - uint64_t: Hash of the symbols.
+ */
+uint64_t SymbolTable::checksum() const {
+    uint64_t bytes = hashText(string_view(reinterpret_cast<const char*>(symbols), sizeof(symbols)));
+    return bytes ^ hashText(string_view(reinterpret_cast<const char*>(lengths), sizeof(lengths))) * 0x100000001B3ull;
+}
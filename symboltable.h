@@ -0,0 +1,92 @@
+/**
+ * symboltable.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for SymbolTable, a static dictionary that compresses short strings such as definitions.
+ * In the manner of FSST, up to 255 symbols of 1 to 8 bytes are trained on a sample of a deck, and text is
+ * encoded as one byte per symbol, the longest symbol matching at each position. A byte no symbol covers is
+ * written as an escape code followed by the byte itself. Each string is encoded on its own, so any one of
+ * them can be decoded without the others; decoding is a table lookup and an 8-byte copy per code.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SYMBOLTABLE_H
+#define M2AP_SYMBOLTABLE_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+using namespace std;
+
+class SymbolTable {
+private:
+    uint64_t symbols[256];          // Symbol bytes in memory order, zero past the symbol's length
+    uint8_t lengths[256];           // 0 for codes not in use
+    size_t symbolCount;
+    vector<uint8_t> byPrefix;       // Codes of the longer symbols, grouped by their first two bytes, longest first
+    vector<uint16_t> prefixStart;   // Where each two-byte prefix's group starts in byPrefix
+    uint8_t byFirstByte[256];       // Code of the one-byte symbol for each byte, or ESCAPE
+
+    void rebuildLookup();
+    size_t longestMatch(const char* text, size_t remaining, uint8_t& code) const;
+
+public:
+    static const uint8_t ESCAPE = 255;
+    static const size_t MAX_SYMBOL = 8;
+    static const size_t DECODE_SLACK = 7;     // Extra bytes decode() may write past the decoded text
+
+    SymbolTable();
+
+    /**
+     * Trains the table
+     * Inputs:
+     *   - const vector<string_view>& sample: Strings representative of those to be encoded.
+     * Description:
+     *   - Starts from an empty table and, over a few passes, encodes the sample with the current table and
+     *     keeps the 255 symbols and pairs of adjacent symbols that would have saved the most bytes.
+     */
+    void train(const vector<string_view>& sample);
+
+    /**
+     * Encodes a string
+     * Inputs:
+     *   - string_view text: Text to encode.
+     *   - string& out: Receives the codes, appended.
+     */
+    void encode(string_view text, string& out) const;
+
+    /**
+     * Decodes a string encoded by this table
+     * Inputs:
+     *   - const char* codes: Codes from encode().
+     *   - size_t length: Number of code bytes.
+     *   - char* out: Destination; must hold decodedBound(length) bytes.
+     * Returns:
+     *   - size_t: Length of the decoded text.
+     */
+    size_t decode(const char* codes, size_t length, char* out) const;
+
+    /**
+     * Returns:
+     *   - size_t: Bytes decode() may write for the given number of codes, slack included.
+     */
+    static size_t decodedBound(size_t length) { return length * MAX_SYMBOL + DECODE_SLACK; }
+
+    size_t size() const { return symbolCount; }
+
+    /**
+     * Returns:
+     *   - size_t: Heap bytes held by the lookup tables.
+     */
+    size_t heapBytes() const;
+
+    /**
+     * Returns:
+     *   - uint64_t: Hash of the symbols, which together with the codes identifies the text they stand for.
+     */
+    uint64_t checksum() const;
+};
+
+#endif // M2AP_SYMBOLTABLE_H
@@ -0,0 +1,226 @@
+/**
+ * synthdeck.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the synthetic deck generator.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "synthdeck.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "fastrng.h"
+using namespace std;
+
+static const char* const VOCABULARY[] = {
+    "array", "bucket", "cache", "data", "edge", "field", "graph", "hash", "heap", "index", "key", "list",
+    "map", "memory", "node", "offset", "page", "pointer", "queue", "record", "register", "set", "stack",
+    "string", "table", "thread", "tree", "value", "vector", "word", "block", "branch", "buffer", "byte",
+    "channel", "clock", "counter", "cursor", "entry", "frame", "lock", "loop", "mask", "packet", "path",
+    "segment", "signal", "socket", "slot", "token", "trie", "window", "bit", "cell", "chunk", "digit",
+    "file", "flag", "handle", "layer", "level", "line", "object", "port"
+};
+static const uint32_t VOCABULARY_SIZE = sizeof(VOCABULARY) / sizeof(VOCABULARY[0]);
+
+/**
+ * Builds one card's text
+ * Inputs:
+ *   - size_t id: Card number, which makes the term unique.
+ *   - FastRng& rng: Generator shared by the whole deck, so cards depend on the seed and their position.
+ *   - string& term, string& def: Receive the card.
+ */
+static void makeCard(size_t id, FastRng& rng, string& term, string& def) {
+    term = "term";
+    term += to_string(id);
+    term += ' ';
+    term += VOCABULARY[rng.below(VOCABULARY_SIZE)];
+
+    def.clear();
+    uint32_t words = 6 + rng.below(9);
+    for (uint32_t w = 0; w < words; ++w) {
+        if (w > 0) {
+            def += ' ';
+        }
+        def += VOCABULARY[rng.below(VOCABULARY_SIZE)];
+    }
+}
+
+/**
+ * Writes a text file by way of a temporary file
+ */
+static bool writeAtomically(const string& path, const string& text, string& error) {
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile.write(text.data(), static_cast<streamsize>(text.size()));
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes a typed answer for a card: its definition, one character off, or another card's
+ * Inputs:
+ *   - const CardStore& deck: Deck the card is in.
+ *   - CardId card: The card asked.
+ *   - FastRng& rng: Generator of the script.
+ *   - ostream& out: Receives the answer and its newline.
+ */
+static void writeTypedAnswer(const CardStore& deck, CardId card, FastRng& rng, ostream& out) {
+    uint32_t roll = rng.below(8);
+    string answer(deck.def(roll == 7 ? rng.below(static_cast<uint32_t>(deck.size())) : card));
+    if (roll >= 4 && roll < 7 && !answer.empty()) {
+        size_t at = rng.below(static_cast<uint32_t>(answer.size()));
+        if (roll == 4) {
+            answer[at] = static_cast<char>('a' + rng.below(26));
+        } else if (roll == 5) {
+            answer.erase(at, 1);
+        } else {
+            answer.insert(at, 1, static_cast<char>('a' + rng.below(26)));
+        }
+    }
+    out << answer << '\n';
+}
+
+/**
+ * Generates a synthetic deck
+ * Inputs:
+ *   - size_t cardCount: Number of cards.
+ *   - uint64_t seed: The same seed always gives the same deck.
+ *   - CardStore& store: Receives the cards.
+ */
+void generateDeck(size_t cardCount, uint64_t seed, CardStore& store) {
+    store = CardStore();
+    store.reserve(cardCount, cardCount * 72);
+
+    FastRng rng(seed);
+    string term;
+    string def;
+    for (size_t id = 0; id < cardCount; ++id) {
+        makeCard(id, rng, term, def);
+        store.addCard(term, def);
+    }
+}
+
+/**
+ * Writes a synthetic deck as a TSV file
+ * Inputs:
+ *   - const string& path: File to write.
+ *   - size_t cardCount: Number of cards.
+ *   - uint64_t seed: Seed, as for generateDeck().
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool writeSyntheticDeck(const string& path, size_t cardCount, uint64_t seed, string& error) {
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::binary | ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+
+        FastRng rng(seed);
+        string term;
+        string def;
+        string chunk;
+        for (size_t id = 0; id < cardCount; ++id) {
+            makeCard(id, rng, term, def);
+            chunk += term;
+            chunk += '\t';
+            chunk += def;
+            chunk += '\n';
+            if (chunk.size() >= 1 << 16) {
+                outFile.write(chunk.data(), static_cast<streamsize>(chunk.size()));
+                chunk.clear();
+            }
+        }
+        outFile.write(chunk.data(), static_cast<streamsize>(chunk.size()));
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes a replay script that plays every game mode on a deck
+ * Inputs:
+ *   - const string& path: File to write.
+ *   - const CardStore& deck: Deck the script is for.
+ *   - size_t answersPerRound: Answers in each round.
+ *   - uint64_t seed: Seed of the script.
+ *   - string& error: Receives a description of the failure, if any.
+ * Description:
+ *   - The timed challenge asks in deck order, so its answers are aimed at the card asked; the matching
+ *     game's order is shuffled by the game's own generator, so its answers are for random cards and are
+ *     graded as mostly wrong, which still exercises the grader as a struggling learner would.
+ */
+bool writeSyntheticScript(const string& path, const CardStore& deck, size_t answersPerRound, uint64_t seed,
+                          string& error) {
+    if (deck.size() < 4) {
+        error = "A replay script needs a deck of at least 4 cards";
+        return false;
+    }
+
+    FastRng rng(seed);
+    ostringstream script;
+    size_t perRound = min(answersPerRound, deck.size());
+    for (uint64_t pass = 1; pass <= 3; ++pass) {
+        script << "#! seed " << seed + pass << '\n';
+
+        // Flip every card, starring one in eight, then decline to go through the starred cards
+        script << "#! flip\n";
+        for (size_t i = 0; i < perRound; ++i) {
+            script << '\n' << (rng.below(8) == 0 ? "star" : "") << '\n';
+        }
+        script << "n\n";
+
+        // Guesses, with the odd one out of range (asked again)
+        script << "#! mult\n";
+        for (size_t i = 0; i < perRound; ++i) {
+            if (rng.below(16) == 0) {
+                script << "9\n";
+            }
+            script << 1 + rng.below(4) << '\n';
+        }
+
+        script << "#! match\n";
+        for (size_t i = 0; i < perRound; ++i) {
+            writeTypedAnswer(deck, rng.below(static_cast<uint32_t>(deck.size())), rng, script);
+        }
+
+        // Long enough never to run out while the script is replayed
+        script << "#! timed 3600\n\n";
+        for (size_t i = 0; i < perRound; ++i) {
+            writeTypedAnswer(deck, static_cast<CardId>(i), rng, script);
+        }
+    }
+    return writeAtomically(path, script.str(), error);
+}
@@ -0,0 +1,56 @@
+/**
+ * synthdeck.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the synthetic deck generator used by the benchmarks and load tests.
+ * Decks are a pure function of (card count, seed), so numbers measured on one machine can be reproduced
+ * on another without shipping multi-megabyte deck files. Terms are unique ("term<i> <word>"); definitions
+ * are 6-14 words drawn from a small technical vocabulary, so they share words the way a real deck does.
+ * Answer scripts for --replay are generated the same way, to drive every game mode without a learner.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_SYNTHDECK_H
+#define M2AP_SYNTHDECK_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "cardstore.h"
+using namespace std;
+
+/**
+ * Generates a synthetic deck
+ * Inputs:
+ *   - size_t cardCount: Number of cards.
+ *   - uint64_t seed: The same seed always gives the same deck.
+ *   - CardStore& store: Receives the cards. Any previous contents are replaced.
+ */
+void generateDeck(size_t cardCount, uint64_t seed, CardStore& store);
+
+/**
+ * Writes a synthetic deck as a TSV file loadDeck() can read
+ * Inputs:
+ *   - const string& path: File to write (written to a temporary file and renamed).
+ *   - size_t cardCount: Number of cards.
+ *   - uint64_t seed: The same seed always gives the same deck as generateDeck().
+ *   - string& error: Receives a description of the failure, if any.
+ */
+bool writeSyntheticDeck(const string& path, size_t cardCount, uint64_t seed, string& error);
+
+/**
+ * Writes a replay script (see replay.h) that plays every game mode on a deck
+ * Inputs:
+ *   - const string& path: File to write (written to a temporary file and renamed).
+ *   - const CardStore& deck: Deck the script will be replayed against, for the typed answers.
+ *   - size_t answersPerRound: Answers in each round; rounds longer than the deck stop at its end.
+ *   - uint64_t seed: The same seed always gives the same script.
+ *   - string& error: Receives a description of the failure, if any.
+ * Description:
+ *   - Three passes, each reseeding the game, of a flashcard, multiple choice, matching and timed round.
+ *     Answers are a learner's mix: mostly right, some with a typo, some wrong or out of range.
+ */
+bool writeSyntheticScript(const string& path, const CardStore& deck, size_t answersPerRound, uint64_t seed,
+                          string& error);
+
+#endif // M2AP_SYNTHDECK_H
@@ -0,0 +1,224 @@
+/**
+ * telemetry.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the latency histograms and their snapshot.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "telemetry.h"
+#include <cerrno>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+using namespace std;
+
+namespace {
+
+const char* const PHASE_NAMES[PHASE_COUNT] = {"answer", "question", "grade", "render"};
+
+void writeJsonString(ostream& out, string_view text) {
+    out << '"';
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c == '\n') {
+            out << "\\n";
+        } else if (c == '\t') {
+            out << "\\t";
+        } else if (byte < 0x20) {
+            out << "\\u" << hex << setw(4) << setfill('0') << static_cast<int>(byte) << dec << setfill(' ');
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+// The top of the bucket holding a rank, in nanoseconds, over any kind of counter; times were counted in
+// units of 2^shift ns
+template <class Count>
+uint64_t bucketAtRank(const Count* counts, size_t buckets, uint32_t precision, uint32_t shift, uint64_t rank) {
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+        seen += counts[bucket];
+        if (seen >= rank) {
+            return ((LatencyHistogram::bucketHigh(bucket, precision) + 1) << shift) - 1;
+        }
+    }
+    return 0;
+}
+
+uint64_t rankOf(double fraction, uint64_t total) {
+    uint64_t rank = static_cast<uint64_t>(ceil(fraction * static_cast<double>(total)));
+    return rank < 1 ? 1 : (rank > total ? total : rank);
+}
+
+// "buckets": [[lowest time, count], ...] for the non-empty buckets
+template <class Count>
+void writeBuckets(ostream& out, const Count* counts, size_t buckets, uint32_t precision, uint32_t shift) {
+    out << "\"buckets\": [";
+    bool first = true;
+    for (size_t bucket = 0; bucket < buckets; ++bucket) {
+        if (counts[bucket] == 0) {
+            continue;
+        }
+        out << (first ? "" : ", ") << '[' << (LatencyHistogram::bucketLow(bucket, precision) << shift) << ", "
+            << counts[bucket] << ']';
+        first = false;
+    }
+    out << ']';
+}
+
+void writeHistogram(ostream& out, const LatencyHistogram& histogram) {
+    out << "{\"count\": " << histogram.count() << ", \"mean\": " << llround(histogram.mean())
+        << ", \"min\": " << histogram.minimum() << ", \"p50\": " << histogram.percentile(0.50)
+        << ", \"p90\": " << histogram.percentile(0.90) << ", \"p99\": " << histogram.percentile(0.99)
+        << ", \"p999\": " << histogram.percentile(0.999) << ", \"max\": " << histogram.maximum() << ", ";
+    writeBuckets(out, histogram.buckets().data(), histogram.buckets().size(), histogram.precision(), 0);
+    out << '}';
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram(uint32_t precision)
+        : precisionBits(precision), counts(bucketCount(precision), 0), total(0), sum(0), lowest(UINT64_MAX),
+          highest(0) {}
+
+uint64_t LatencyHistogram::bucketLow(size_t bucket, uint32_t precision) {
+    if (bucket < (size_t{2} << precision)) {
+        return bucket;
+    }
+    size_t shift = (bucket >> precision) - 1;
+    return static_cast<uint64_t>(bucket - (shift << precision)) << shift;
+}
+
+uint64_t LatencyHistogram::bucketHigh(size_t bucket, uint32_t precision) {
+    if (bucket < (size_t{2} << precision)) {
+        return bucket;
+    }
+    size_t shift = (bucket >> precision) - 1;
+    return bucketLow(bucket, precision) + (uint64_t{1} << shift) - 1;
+}
+
+/**
+ * Time below which a fraction of the recorded times fall
+ * Description:
+ *   - One pass over the buckets; the answer is exact while times are below 2^(precision+1) ns.
+ */
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t high = bucketAtRank(counts.data(), counts.size(), precisionBits, 0, rankOf(fraction, total));
+    return high < highest ? high : highest;
+}
+
+ModeLatency::ModeLatency(string_view mode, uint32_t precision)
+        : gameMode(mode), phases(PHASE_COUNT, LatencyHistogram(precision)) {}
+
+ModeLatency& Telemetry::forMode(string_view gameMode) {
+    for (unique_ptr<ModeLatency>& mode : modes) {
+        if (mode->gameMode == gameMode) {
+            return *mode;
+        }
+    }
+    modes.push_back(make_unique<ModeLatency>(gameMode, MODE_PRECISION));
+    return *modes.back();
+}
+
+/**
+ * Counts how long the learner took to answer a card
+ * Description:
+ *   - A card gets its row of counts the first time it is answered, so memory follows the cards played,
+ *     not the size of the deck (beyond 4 bytes per card for the lookup). Rows share one array.
+ */
+void Telemetry::recordAnswer(CardId card, uint64_t nanos) {
+    if (card >= cardRows.size()) {
+        cardRows.resize(static_cast<size_t>(card) + 1, 0);
+    }
+    if (cardRows[card] == 0) {
+        rowCards.push_back(card);
+        cardCounts.resize(rowCards.size() * CARD_BUCKETS, 0);
+        cardRows[card] = static_cast<uint32_t>(rowCards.size());
+    }
+    // Times past the top of the range share the last bucket
+    uint64_t units = min<uint64_t>(nanos >> CARD_SHIFT, (uint64_t{1} << (LatencyHistogram::MAX_BITS - CARD_SHIFT)) - 1);
+    size_t row = cardRows[card] - 1;
+    uint16_t& count = cardCounts[row * CARD_BUCKETS + LatencyHistogram::bucketOf(units, CARD_PRECISION)];
+    if (count < UINT16_MAX) {
+        ++count;
+    }
+}
+
+/**
+ * Writes a snapshot as JSON
+ * Description:
+ *   - Cards are listed in the order they were first answered; ids outside the deck are left out.
+ */
+bool Telemetry::writeSnapshot(const string& path, const CardStore& deck, string& error) const {
+    ostringstream json;
+    auto generated = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch());
+    json << "{\n  \"generated\": " << generated.count() << ",\n  \"unit\": \"ns\",\n  \"modes\": {";
+
+    for (size_t m = 0; m < modes.size(); ++m) {
+        json << (m > 0 ? ",\n    " : "\n    ");
+        writeJsonString(json, modes[m]->gameMode);
+        json << ": {";
+        for (size_t phase = 0; phase < PHASE_COUNT; ++phase) {
+            json << (phase > 0 ? ",\n      " : "\n      ") << '"' << PHASE_NAMES[phase] << "\": ";
+            writeHistogram(json, modes[m]->phases[phase]);
+        }
+        json << "\n    }";
+    }
+    json << (modes.empty() ? "},\n  \"cards\": [" : "\n  },\n  \"cards\": [");
+
+    bool first = true;
+    for (size_t row = 0; row < rowCards.size(); ++row) {
+        if (rowCards[row] >= deck.size()) {
+            continue;
+        }
+        const uint16_t* counts = cardCounts.data() + row * CARD_BUCKETS;
+        uint64_t total = 0;
+        for (size_t bucket = 0; bucket < CARD_BUCKETS; ++bucket) {
+            total += counts[bucket];
+        }
+        json << (first ? "\n    " : ",\n    ") << "{\"card\": " << rowCards[row] << ", \"term\": ";
+        writeJsonString(json, deck.term(rowCards[row]));
+        json << ", \"answer\": {\"count\": " << total << ", \"p50\": "
+             << bucketAtRank(counts, CARD_BUCKETS, CARD_PRECISION, CARD_SHIFT, rankOf(0.50, total)) << ", \"p90\": "
+             << bucketAtRank(counts, CARD_BUCKETS, CARD_PRECISION, CARD_SHIFT, rankOf(0.90, total)) << ", ";
+        writeBuckets(json, counts, CARD_BUCKETS, CARD_PRECISION, CARD_SHIFT);
+        json << "}}";
+        first = false;
+    }
+    json << (first ? "]\n}\n" : "\n  ]\n}\n");
+
+    string tempPath = path + ".tmp";
+    {
+        ofstream outFile(tempPath, ios::trunc);
+        if (!outFile.is_open()) {
+            error = "Unable to open " + tempPath + ": " + strerror(errno);
+            return false;
+        }
+        outFile << json.str();
+        if (!outFile) {
+            error = "Unable to write " + tempPath;
+            remove(tempPath.c_str());
+            return false;
+        }
+    }
+    if (rename(tempPath.c_str(), path.c_str()) != 0) {
+        error = "Unable to rename " + tempPath + " to " + path + ": " + strerror(errno);
+        remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,187 @@
+/**
+ * telemetry.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the latency telemetry kept while games are played: how long the learner takes to
+ * answer, and how long the engine spends making questions, grading answers and drawing screens.
+ * Times go into HDR-style histograms (exact below 2^(precision+1) ns, then a fixed number of steps per
+ * doubling, up to about 18 minutes), so recording is a few instructions, memory never grows with the
+ * number of samples, and percentiles are accurate to the histogram's precision. There is one set per
+ * game mode and one answer-time histogram per card answered, and the lot can be written as a JSON
+ * snapshot. Like per-card accuracy in SessionStats, this covers the games played in this run.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_TELEMETRY_H
+#define M2AP_TELEMETRY_H
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "cardstore.h"
+using namespace std;
+
+// What a measured time was spent on
+enum class Phase {
+    ANSWER,         // The learner: from a prompt being ready to the answer arriving
+    QUESTION,       // Choosing the next question (distractors, shuffling, the next due card)
+    GRADE,          // Checking an answer
+    RENDER          // The rest of the reply to an answer: moving the round on and handing over its screen
+};
+
+const size_t PHASE_COUNT = 4;
+
+class LatencyHistogram {
+public:
+    static constexpr uint32_t MAX_BITS = 40;    // Up to about 18 minutes; longer times share the last bucket
+
+private:
+    uint32_t precisionBits;     // Steps per doubling, as a power of two
+    vector<uint32_t> counts;
+    uint64_t total;
+    uint64_t sum;
+    uint64_t lowest;
+    uint64_t highest;
+
+public:
+    /**
+     * Constructor
+     * @param precision Bits of precision: 2^precision steps per doubling, so a recorded time is off by at
+     *                  most 1/2^precision. The histogram takes 4 * 2^precision * (41 - precision) bytes.
+     */
+    explicit LatencyHistogram(uint32_t precision);
+
+    /**
+     * Returns:
+     *   - size_t: Buckets in a histogram of the given precision.
+     */
+    static size_t bucketCount(uint32_t precision) { return (size_t{1} << precision) * (MAX_BITS + 1 - precision); }
+
+    /**
+     * Returns:
+     *   - size_t: The bucket a time falls in: the time itself while it is small, then the top
+     *     precision + 1 bits of it plus its magnitude. Times of 2^MAX_BITS ns or more go in the last bucket.
+     */
+    static size_t bucketOf(uint64_t nanos, uint32_t precision) {
+        nanos = nanos < (uint64_t{1} << MAX_BITS) ? nanos : (uint64_t{1} << MAX_BITS) - 1;
+        if (nanos < (uint64_t{2} << precision)) {
+            return static_cast<size_t>(nanos);
+        }
+        uint32_t shift = 63 - static_cast<uint32_t>(__builtin_clzll(nanos)) - precision;
+        return (static_cast<size_t>(shift) << precision) + static_cast<size_t>(nanos >> shift);
+    }
+
+    /**
+     * Returns:
+     *   - uint64_t: The smallest time counted in a bucket.
+     */
+    static uint64_t bucketLow(size_t bucket, uint32_t precision);
+
+    /**
+     * Returns:
+     *   - uint64_t: The largest time counted in a bucket.
+     */
+    static uint64_t bucketHigh(size_t bucket, uint32_t precision);
+
+    /**
+     * Counts one time
+     * Inputs:
+     *   - uint64_t nanos: The time in nanoseconds.
+     */
+    void record(uint64_t nanos) {
+        ++counts[bucketOf(nanos, precisionBits)];
+        ++total;
+        sum += nanos;
+        lowest = nanos < lowest ? nanos : lowest;
+        highest = nanos > highest ? nanos : highest;
+    }
+
+    /**
+     * Time below which a fraction of the recorded times fall
+     * Inputs:
+     *   - double fraction: Between 0 and 1, e.g. 0.99.
+     * Returns:
+     *   - uint64_t: The top of the bucket holding that rank (never above the largest time recorded), or 0
+     *     if nothing has been recorded.
+     */
+    uint64_t percentile(double fraction) const;
+
+    uint32_t precision() const { return precisionBits; }
+    uint64_t count() const { return total; }
+    uint64_t minimum() const { return total > 0 ? lowest : 0; }
+    uint64_t maximum() const { return highest; }
+    double mean() const { return total > 0 ? static_cast<double>(sum) / total : 0.0; }
+    const vector<uint32_t>& buckets() const { return counts; }
+};
+
+// One game mode's histograms, one per phase
+struct ModeLatency {
+    string gameMode;
+    vector<LatencyHistogram> phases;
+
+    ModeLatency(string_view mode, uint32_t precision);
+
+    void record(Phase phase, uint64_t nanos) { phases[static_cast<size_t>(phase)].record(nanos); }
+};
+
+class Telemetry {
+public:
+    static constexpr uint32_t MODE_PRECISION = 5;   // Within about 3%, 4.5 KiB per phase
+    static constexpr uint32_t CARD_PRECISION = 2;   // Within 25%
+    static constexpr uint32_t CARD_SHIFT = 20;      // Cards count answer times in units of 2^20 ns (about 1 ms)
+
+    static constexpr size_t CARD_BUCKETS =          // Two bytes each per card answered, 152 bytes in all
+            (size_t{1} << CARD_PRECISION) * (LatencyHistogram::MAX_BITS - CARD_SHIFT + 1 - CARD_PRECISION);
+
+    /**
+     * Returns:
+     *   - uint64_t: Nanoseconds on the steady clock, for timing phases.
+     */
+    static uint64_t now() {
+        return static_cast<uint64_t>(
+                chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+private:
+    vector<unique_ptr<ModeLatency>> modes;  // A handful, searched linearly; their addresses stay put
+    vector<uint32_t> cardRows;              // Per card id: 1 + its row in cardCounts, or 0 if never answered
+    vector<CardId> rowCards;                // Card of each row, in the order first answered
+    vector<uint16_t> cardCounts;            // A row of bucket counts per card, stopping at 65535 each
+
+public:
+    /**
+     * Histograms of a game mode, created on first use
+     * Inputs:
+     *   - string_view gameMode: Mode name as recorded, e.g. "MatchingGame".
+     * Returns:
+     *   - ModeLatency&: The mode's histograms; the reference stays valid for the Telemetry's lifetime.
+     */
+    ModeLatency& forMode(string_view gameMode);
+
+    /**
+     * Counts how long the learner took to answer a card
+     * Inputs:
+     *   - CardId card: The card answered.
+     *   - uint64_t nanos: From the question being shown to the answer arriving.
+     */
+    void recordAnswer(CardId card, uint64_t nanos);
+
+    size_t cardsAnswered() const { return rowCards.size(); }
+
+    /**
+     * Writes a snapshot as JSON: per mode and phase, and per card, the count, percentiles and the non-empty
+     * buckets (as [lowest time, count] pairs, so snapshots can be merged), all in nanoseconds
+     * Inputs:
+     *   - const string& path: File to write (written to a temporary file and renamed).
+     *   - const CardStore& deck: Deck the card ids belong to, for their terms.
+     *   - string& error: Receives a description of the failure, if any.
+     */
+    bool writeSnapshot(const string& path, const CardStore& deck, string& error) const;
+};
+
+#endif // M2AP_TELEMETRY_H
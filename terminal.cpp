@@ -0,0 +1,494 @@
+/**
+ * terminal.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for RawTerminal, TerminalRenderer and TerminalInput.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "terminal.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <iomanip>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+// Clears the screen and its scrollback and homes the cursor, as clear(1) does
+const char CLEAR_SCREEN[] = "\x1b[H\x1b[2J\x1b[3J";
+
+const int CTRL_D = 0x04;
+const int ESCAPE = 0x1B;
+const int BACKSPACE = 0x7F;
+const int CTRL_H = 0x08;
+
+// Saves the cursor, returns to the start of the prompt line, and restores the cursor after the label
+const char COUNTDOWN_START[] = "\x1b" "7\r";
+const char COUNTDOWN_END[] = "\x1b" "8";
+
+// The mode to put back if a signal ends the program mid-game; only one terminal is raw at a time
+termios restoreMode;
+int restoreFd = -1;
+struct sigaction previousActions[3];
+const int RESTORE_SIGNALS[3] = {SIGINT, SIGTERM, SIGHUP};
+
+void restoreAndRaise(int signalNumber) {
+    if (restoreFd >= 0) {
+        tcsetattr(restoreFd, TCSANOW, &restoreMode);
+    }
+    signal(signalNumber, SIG_DFL);
+    raise(signalNumber);
+}
+
+double percentile(vector<double> samples, double fraction) {
+    sort(samples.begin(), samples.end());
+    size_t rank = static_cast<size_t>(fraction * (samples.size() - 1) + 0.5);
+    return samples[min(rank, samples.size() - 1)];
+}
+
+void printSamples(ostream& report, const char* label, const vector<double>& samples) {
+    if (samples.empty()) {
+        return;
+    }
+    ios::fmtflags flags = report.flags();
+    streamsize precision = report.precision();
+    report << fixed << setprecision(1) << label << ": p50 " << percentile(samples, 0.50) << " us, p99 "
+           << percentile(samples, 0.99) << " us, max " << *max_element(samples.begin(), samples.end()) << " us over "
+           << samples.size() << '\n';
+    report.flags(flags);
+    report.precision(precision);
+}
+
+// The same width every second, so a redraw covers the last one exactly
+string countdownLabel(int secondsLeft) {
+    ostringstream label;
+    label << '[' << setw(3) << secondsLeft << "s] ";
+    return label.str();
+}
+
+} // namespace
+
+/**
+ * Constructor
+ * @param inputFd Terminal to read keys from.
+ * @param outputFd Terminal to draw on.
+ */
+RawTerminal::RawTerminal(int inputFd, int outputFd)
+        : inFd(inputFd), outFd(outputFd), raw(false), saved(), pendingAt(0), timerFd(-1), answered(false) {
+    if (!isatty(inFd) || !isatty(outFd) || tcgetattr(inFd, &saved) != 0) {
+        return;
+    }
+
+    // Keys arrive one at a time and are not echoed; output processing stays on, so '\n' still starts a
+    // new line, and so do signals, so Ctrl-C still interrupts
+    termios mode = saved;
+    mode.c_lflag &= ~static_cast<tcflag_t>(ICANON | ECHO | IEXTEN);
+    mode.c_cc[VMIN] = 1;
+    mode.c_cc[VTIME] = 0;
+    if (tcsetattr(inFd, TCSANOW, &mode) != 0) {
+        return;
+    }
+    raw = true;
+
+    restoreMode = saved;
+    restoreFd = inFd;
+    struct sigaction action = {};
+    action.sa_handler = restoreAndRaise;
+    sigemptyset(&action.sa_mask);
+    for (int i = 0; i < 3; ++i) {
+        sigaction(RESTORE_SIGNALS[i], &action, &previousActions[i]);
+    }
+}
+
+RawTerminal::~RawTerminal() {
+    paint();
+    if (timerFd >= 0) {
+        close(timerFd);
+    }
+    if (raw) {
+        tcsetattr(inFd, TCSANOW, &saved);
+        restoreFd = -1;
+        for (int i = 0; i < 3; ++i) {
+            sigaction(RESTORE_SIGNALS[i], &previousActions[i], nullptr);
+        }
+    }
+}
+
+/**
+ * Sends the frame built so far with one write() and starts a new one
+ */
+bool RawTerminal::paint() {
+    string text = frame.str();
+    if (text.empty()) {
+        return true;
+    }
+    frame.str(string());
+    return write(text);
+}
+
+/**
+ * Writes straight to the terminal, ahead of the frame
+ */
+bool RawTerminal::write(string_view text) {
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t count = ::write(outFd, text.data() + written, text.size() - written);
+        if (count > 0) {
+            written += static_cast<size_t>(count);
+        } else if (count < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads one byte of input
+ * Inputs:
+ *   - int timeoutMs: How long to wait; -1 waits for as long as it takes.
+ * Returns:
+ *   - int: The byte, -1 at end of input or on an error, or -2 if the time ran out.
+ */
+int RawTerminal::readByte(int timeoutMs) {
+    if (pendingAt < pending.size()) {
+        return static_cast<unsigned char>(pending[pendingAt++]);
+    }
+
+    pollfd ready = {inFd, POLLIN, 0};
+    int count;
+    do {
+        count = poll(&ready, 1, timeoutMs);
+    } while (count < 0 && errno == EINTR);
+    if (count == 0) {
+        return -2;
+    }
+    return count < 0 ? -1 : receive();
+}
+
+/**
+ * Reads one byte of input, giving up at a point in time
+ * Inputs:
+ *   - Clock::time_point until: When to give up.
+ * Returns:
+ *   - int: The byte, -1 at end of input or on an error, or -2 if the time came first.
+ */
+int RawTerminal::readByteUntil(Clock::time_point until) {
+    if (pendingAt < pending.size()) {
+        return static_cast<unsigned char>(pending[pendingAt++]);
+    }
+    if (until == Clock::time_point::max()) {
+        return readByte(-1);
+    }
+
+    if (timerFd < 0) {
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    }
+    // steady_clock is CLOCK_MONOTONIC, so the deadline is armed as an absolute time on the same clock
+    auto sinceEpoch = chrono::duration_cast<chrono::nanoseconds>(until.time_since_epoch()).count();
+    itimerspec alarm = {};
+    alarm.it_value.tv_sec = static_cast<time_t>(max<int64_t>(sinceEpoch, 1) / 1000000000);
+    alarm.it_value.tv_nsec = static_cast<long>(max<int64_t>(sinceEpoch, 1) % 1000000000);
+    if (timerFd < 0 || timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &alarm, nullptr) != 0) {
+        // No timer: poll with the wait rounded up to whole milliseconds instead
+        auto wait = chrono::duration_cast<chrono::milliseconds>(until - Clock::now() + chrono::microseconds(999));
+        return readByte(static_cast<int>(max<int64_t>(wait.count(), 0)));
+    }
+
+    pollfd ready[2] = {{inFd, POLLIN, 0}, {timerFd, POLLIN, 0}};
+    int count;
+    do {
+        count = poll(ready, 2, -1);
+    } while (count < 0 && errno == EINTR);
+    if (count < 0) {
+        return -1;
+    }
+    if (ready[0].revents != 0) {
+        return receive();
+    }
+    uint64_t expirations;
+    ssize_t drained = read(timerFd, &expirations, sizeof(expirations));
+    (void)drained;
+    return -2;
+}
+
+// Takes whatever has arrived (a pasted answer, an escape sequence) in one read
+int RawTerminal::receive() {
+    char buffer[256];
+    ssize_t received;
+    do {
+        received = read(inFd, buffer, sizeof(buffer));
+    } while (received < 0 && errno == EINTR);
+    if (received <= 0) {
+        return -1;
+    }
+    pending.assign(buffer, static_cast<size_t>(received));
+    pendingAt = 1;
+    return static_cast<unsigned char>(pending[0]);
+}
+
+void RawTerminal::markAnswered() {
+    answered = true;
+    answeredAt = Clock::now();
+}
+
+bool RawTerminal::takeAnswered(Clock::time_point& when) {
+    if (!answered) {
+        return false;
+    }
+    answered = false;
+    when = answeredAt;
+    return true;
+}
+
+TerminalRenderer::TerminalRenderer(RawTerminal& rawTerminal)
+        : TextRenderer(rawTerminal.out()), terminal(rawTerminal), current(KeyPrompt::LINE), waiting(KeyPrompt::LINE),
+          choiceCount(0), expired(false) {}
+
+TerminalRenderer::~TerminalRenderer() {
+    terminal.paint();
+}
+
+void TerminalRenderer::clear() {
+    out << CLEAR_SCREEN;
+}
+
+void TerminalRenderer::showTerm(string_view term, bool typedAnswer) {
+    TextRenderer::showTerm(term, typedAnswer);
+    if (typedAnswer) {
+        current = KeyPrompt::LINE;
+    }
+}
+
+void TerminalRenderer::askFlip() {
+    out << "Press any key to flip the card";
+    current = KeyPrompt::FLIP;
+}
+
+void TerminalRenderer::askStar() {
+    out << "Press 's' to star this term, or any other key to move on";
+    current = KeyPrompt::STAR;
+}
+
+void TerminalRenderer::askStudyStarred() {
+    out << "Would you now like to study your starred terms? [press 'y' or 'n']: ";
+    current = KeyPrompt::STUDY_STARRED;
+}
+
+void TerminalRenderer::askRating() {
+    TextRenderer::askRating();
+    current = KeyPrompt::RATING;
+}
+
+void TerminalRenderer::askChoice(size_t choices, bool retry) {
+    if (choices > 9) {
+        // More options than digit keys: fall back to typing the number
+        TextRenderer::askChoice(choices, retry);
+        current = KeyPrompt::LINE;
+        return;
+    }
+    out << "What is your guess? [press 1-" << choices << "]: ";
+    current = KeyPrompt::CHOICE;
+    choiceCount = choices;
+}
+
+void TerminalRenderer::showCountdown(int secondsLeft) {
+    out << countdownLabel(secondsLeft);
+}
+
+void TerminalRenderer::updateCountdown(int secondsLeft) {
+    terminal.write(COUNTDOWN_START + countdownLabel(secondsLeft) + COUNTDOWN_END);
+}
+
+void TerminalRenderer::deadlinePassed(RawTerminal::Clock::time_point deadline) {
+    expired = true;
+    expiredAt = deadline;
+}
+
+/**
+ * Sends the frame, timing it against the answer (or the deadline) that led to it
+ */
+bool TerminalRenderer::present() {
+    RawTerminal::Clock::time_point answeredAt;
+    bool timed = terminal.takeAnswered(answeredAt);
+    bool painted = terminal.paint();
+    RawTerminal::Clock::time_point now = RawTerminal::Clock::now();
+    if (timed) {
+        double micros = chrono::duration<double, micro>(now - answeredAt).count();
+        (waiting == KeyPrompt::FLIP ? flipMicros : answerMicros).push_back(micros);
+    }
+    if (expired) {
+        overshootMicros.push_back(chrono::duration<double, micro>(now - expiredAt).count());
+        expired = false;
+    }
+    waiting = current;
+    return painted;
+}
+
+/**
+ * Prints how long answers took to reach the screen
+ * Inputs:
+ *   - ostream& report: Where to print.
+ */
+void TerminalRenderer::printLatency(ostream& report) const {
+    printSamples(report, "Flip to paint", flipMicros);
+    printSamples(report, "Answer to paint", answerMicros);
+    printSamples(report, "Deadline overshoot", overshootMicros);
+}
+
+/**
+ * Reads the learner's next answer
+ * Inputs:
+ *   - string_view& answer: Receives the answer; valid until the next call.
+ * Returns:
+ *   - bool: False once input has run out.
+ * Description:
+ *   - One-key prompts take the first key that answers them and ignore the rest; 's' stars a card.
+ *   - Anything else is typed, with backspace, and ends at enter.
+ */
+bool TerminalInput::nextAnswer(string_view& answer) {
+    if (!output.present()) {
+        return false;
+    }
+
+    KeyPrompt prompt = output.prompt();
+    if (prompt == KeyPrompt::LINE) {
+        line.clear();
+        if (editLine(RawTerminal::Clock::time_point::max()) <= 0) {
+            return false;
+        }
+        terminal.markAnswered();
+        output.echo("\n");
+        answer = line;
+        return true;
+    }
+
+    while (true) {
+        int key = terminal.readByte(-1);
+        if (key < 0 || key == CTRL_D) {
+            return false;
+        }
+        line.clear();
+        if (prompt == KeyPrompt::FLIP) {
+            // Any key flips
+        } else if (prompt == KeyPrompt::STAR) {
+            if (key == 's' || key == 'S') {
+                line = "star";
+            }
+        } else if (prompt == KeyPrompt::STUDY_STARRED) {
+            if (key != 'y' && key != 'n') {
+                continue;
+            }
+            line = static_cast<char>(key);
+        } else if (prompt == KeyPrompt::RATING) {
+            if (key != 'q' && (key < '1' || key > '4')) {
+                continue;
+            }
+            line = static_cast<char>(key);
+        } else if (key < '1' || key > static_cast<int>('0' + output.choices())) {
+            continue;
+        } else {
+            line = static_cast<char>(key);
+        }
+        terminal.markAnswered();
+        output.echo(line);
+        output.echo("\n");
+        answer = line;
+        return true;
+    }
+}
+
+/**
+ * Reads a typed answer with a deadline
+ * Inputs:
+ *   - string_view& answer: Receives the answer; valid until the next call.
+ *   - chrono::steady_clock::time_point deadline: When the answer is due.
+ * Returns:
+ *   - AnswerWait: ANSWERED with the answer, EXPIRED at the deadline, or ENDED once input has run out.
+ * Description:
+ *   - The wait wakes on a key or on the next whole second left, when the countdown is redrawn in place,
+ *     and at the deadline itself; the time is never polled for in between.
+ */
+AnswerWait TerminalInput::nextAnswerBy(string_view& answer, chrono::steady_clock::time_point deadline) {
+    if (output.prompt() != KeyPrompt::LINE) {
+        return AnswerProvider::nextAnswerBy(answer, deadline);
+    }
+    if (!output.present()) {
+        return AnswerWait::ENDED;
+    }
+
+    line.clear();
+    while (true) {
+        RawTerminal::Clock::time_point now = RawTerminal::Clock::now();
+        if (now >= deadline) {
+            output.deadlinePassed(deadline);
+            output.echo("\n");
+            return AnswerWait::EXPIRED;
+        }
+        // Wake when the seconds left drop by one, e.g. from 4.3 s left at 3.0 s left
+        auto wholeSeconds = chrono::duration_cast<chrono::seconds>(deadline - now - chrono::nanoseconds(1));
+        int status = editLine(deadline - wholeSeconds);
+        if (status < 0) {
+            return AnswerWait::ENDED;
+        }
+        if (status > 0) {
+            terminal.markAnswered();
+            output.echo("\n");
+            answer = line;
+            return AnswerWait::ANSWERED;
+        }
+        if (RawTerminal::Clock::now() < deadline) {
+            output.updateCountdown(static_cast<int>(wholeSeconds.count()));
+        }
+    }
+}
+
+/**
+ * Edits the typed line, echoing it as it is typed
+ * Inputs:
+ *   - RawTerminal::Clock::time_point until: When to stop waiting, with the line kept for the next call.
+ * Returns:
+ *   - int: 1 at enter, 0 if the time came first, and -1 at the end of input (or Ctrl-D on an empty line).
+ */
+int TerminalInput::editLine(RawTerminal::Clock::time_point until) {
+    while (true) {
+        int key = terminal.readByteUntil(until);
+        if (key == -2) {
+            return 0;
+        }
+        if (key < 0 || (key == CTRL_D && line.empty())) {
+            return -1;
+        }
+        if (key == '\n' || key == '\r') {
+            return 1;
+        }
+        if (key == BACKSPACE || key == CTRL_H) {
+            if (!line.empty()) {
+                // Drop the last whole UTF-8 character
+                size_t end = line.size() - 1;
+                while (end > 0 && (static_cast<unsigned char>(line[end]) & 0xC0) == 0x80) {
+                    --end;
+                }
+                line.resize(end);
+                terminal.write("\b \b");
+            }
+        } else if (key == ESCAPE) {
+            // Arrow and function keys: skip the rest of the sequence
+            int next = terminal.readByte(10);
+            if (next == '[' || next == 'O') {
+                do {
+                    next = terminal.readByte(10);
+                } while (next >= 0 && (next < 0x40 || next > 0x7E));
+            }
+        } else if (key >= 0x20 || key == '\t') {
+            line += static_cast<char>(key);
+            terminal.write(string_view(line).substr(line.size() - 1));
+        }
+    }
+}
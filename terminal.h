@@ -0,0 +1,204 @@
+/**
+ * terminal.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the interactive terminal front end. RawTerminal switches the terminal out of line mode
+ * for the length of a game, so keys arrive as they are pressed, and collects output into a frame that is
+ * sent with one write() when the game waits for the learner. TerminalRenderer draws the games into that
+ * frame, clearing the screen with ANSI escapes rather than running clear(1), and TerminalInput answers
+ * one-key prompts (flip, star, rate, choose) from a single keypress and edits typed answers itself.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_TERMINAL_H
+#define M2AP_TERMINAL_H
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <termios.h>
+#include <vector>
+#include "gameio.h"
+using namespace std;
+
+class RawTerminal {
+public:
+    using Clock = chrono::steady_clock;
+
+private:
+    int inFd;
+    int outFd;
+    bool raw;
+    termios saved;
+    ostringstream frame;
+    string pending;             // Bytes read from the terminal and not yet consumed
+    size_t pendingAt;
+    int timerFd;                // timerfd for reads with a deadline, created on first use
+    bool answered;
+    Clock::time_point answeredAt;
+
+    int receive();
+
+public:
+    /**
+     * Constructor
+     * @param inputFd Terminal to read keys from.
+     * @param outputFd Terminal to draw on.
+     * Description:
+     *   - Only switches modes when both are terminals; otherwise isRaw() is false and nothing changes.
+     *   - The old mode comes back in the destructor, and also if the program is interrupted or killed.
+     */
+    RawTerminal(int inputFd, int outputFd);
+    ~RawTerminal();
+
+    RawTerminal(const RawTerminal&) = delete;
+    RawTerminal& operator=(const RawTerminal&) = delete;
+
+    bool isRaw() const { return raw; }
+
+    /**
+     * Returns:
+     *   - ostream&: The frame being built; nothing reaches the terminal until paint().
+     */
+    ostream& out() { return frame; }
+
+    /**
+     * Sends the frame built so far with one write() and starts a new one
+     * Returns:
+     *   - bool: False if the terminal could not be written to.
+     */
+    bool paint();
+
+    /**
+     * Writes straight to the terminal, ahead of the frame (for echoing keys as they are typed)
+     */
+    bool write(string_view text);
+
+    /**
+     * Reads one byte of input
+     * Inputs:
+     *   - int timeoutMs: How long to wait; -1 waits for as long as it takes.
+     * Returns:
+     *   - int: The byte (0-255), -1 at end of input or on an error, or -2 if the time ran out.
+     */
+    int readByte(int timeoutMs);
+
+    /**
+     * Reads one byte of input, giving up at a point in time
+     * Inputs:
+     *   - Clock::time_point until: When to give up. A timerfd armed for that instant wakes the wait, so it
+     *     ends within the scheduler's wakeup latency rather than poll's millisecond rounding.
+     * Returns:
+     *   - int: As for readByte().
+     */
+    int readByteUntil(Clock::time_point until);
+
+    /**
+     * Notes that an answer was just read, so the next paint() can be timed against it
+     */
+    void markAnswered();
+
+    /**
+     * Takes the time of the answer noted by markAnswered()
+     * Inputs:
+     *   - Clock::time_point& when: Receives the time, if there is one.
+     * Returns:
+     *   - bool: False if no answer has been noted since the last call.
+     */
+    bool takeAnswered(Clock::time_point& when);
+};
+
+// What the next answer is, so it can come from one key instead of a typed line
+enum class KeyPrompt {
+    LINE,
+    FLIP,
+    STAR,
+    STUDY_STARRED,
+    RATING,
+    CHOICE
+};
+
+// The games on a terminal in raw mode, one frame per screen
+class TerminalRenderer : public TextRenderer {
+private:
+    RawTerminal& terminal;
+    KeyPrompt current;              // What the frame being built asks for
+    KeyPrompt waiting;              // The prompt on screen when the last frame was sent
+    size_t choiceCount;
+    vector<double> flipMicros;      // Flip keypress to the definition on screen
+    vector<double> answerMicros;    // Any other answer to the next screen
+    vector<double> overshootMicros; // A deadline to "time's up" on screen
+    bool expired;
+    RawTerminal::Clock::time_point expiredAt;
+
+public:
+    explicit TerminalRenderer(RawTerminal& rawTerminal);
+    ~TerminalRenderer() override;
+
+    void clear() override;
+    void showTerm(string_view term, bool typedAnswer) override;
+    void askFlip() override;
+    void askStar() override;
+    void askStudyStarred() override;
+    void askRating() override;
+    void askChoice(size_t choices, bool retry) override;
+    void showCountdown(int secondsLeft) override;
+
+    /**
+     * Redraws the countdown shown before the prompt, in place, while the learner types
+     */
+    void updateCountdown(int secondsLeft);
+
+    /**
+     * Notes that a deadline passed while waiting for an answer; the next frame sent is timed against it
+     */
+    void deadlinePassed(RawTerminal::Clock::time_point deadline);
+
+    /**
+     * Sends the frame, timing it against the answer that led to it
+     * Returns:
+     *   - bool: False if the terminal could not be written to.
+     */
+    bool present();
+
+    /**
+     * Adds text to the frame without sending it, for the input to finish a prompt's line
+     */
+    void echo(string_view text) { out << text; }
+
+    KeyPrompt prompt() const { return current; }
+    size_t choices() const { return choiceCount; }
+
+    /**
+     * Prints how long answers took to reach the screen
+     * Inputs:
+     *   - ostream& report: Where to print.
+     */
+    void printLatency(ostream& report) const;
+};
+
+// Answers from a terminal in raw mode: one key for one-key prompts, an edited line otherwise
+class TerminalInput : public AnswerProvider {
+private:
+    RawTerminal& terminal;
+    TerminalRenderer& output;
+    string line;
+
+    int editLine(RawTerminal::Clock::time_point until);
+
+public:
+    TerminalInput(RawTerminal& rawTerminal, TerminalRenderer& renderer) : terminal(rawTerminal), output(renderer) {}
+
+    bool nextAnswer(string_view& answer) override;
+
+    /**
+     * Reads a typed answer until the deadline, ticking the countdown once a second without polling in
+     * between, and gives up at the deadline itself with the line left unfinished
+     */
+    AnswerWait nextAnswerBy(string_view& answer, chrono::steady_clock::time_point deadline) override;
+};
+
+#endif // M2AP_TERMINAL_H
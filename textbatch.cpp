@@ -0,0 +1,257 @@
+/**
+ * textbatch.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for the batched text renderer.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "textbatch.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstdint>
+using namespace std;
+
+namespace {
+
+// Pixels from the top-left in, clip space out
+const char* const VERTEX_SHADER = R"(#version 330 core
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texel;
+layout(location = 2) in vec4 color;
+uniform vec2 viewport;
+out vec2 atlasTexel;
+out vec4 tint;
+void main() {
+    gl_Position = vec4(position.x * 2.0 / viewport.x - 1.0, 1.0 - position.y * 2.0 / viewport.y, 0.0, 1.0);
+    atlasTexel = texel;
+    tint = color;
+}
+)";
+
+// Glyphs are drawn at their rasterized size on whole pixels, so each fragment reads exactly one atlas
+// texel: texelFetch, no filtering
+const char* const FRAGMENT_SHADER = R"(#version 330 core
+uniform sampler2D atlas;
+in vec2 atlasTexel;
+in vec4 tint;
+out vec4 fragment;
+void main() {
+    float coverage = texelFetch(atlas, ivec2(atlasTexel), 0).r;
+    fragment = vec4(tint.rgb, tint.a * coverage);
+}
+)";
+
+/**
+ * Compiles one shader
+ * Returns:
+ *   - GLuint: The shader, or 0 with error set.
+ */
+GLuint compileShader(GLenum type, const char* source, string& error) {
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+    GLint compiled = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled != GL_TRUE) {
+        char log[1024] = "";
+        glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+        error = string(type == GL_VERTEX_SHADER ? "Vertex" : "Fragment") + " shader did not compile: " + log;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+void setClearColor(uint32_t color) {
+    glClearColor(static_cast<float>(color & 0xFF) / 255.0f, static_cast<float>(color >> 8 & 0xFF) / 255.0f,
+                 static_cast<float>(color >> 16 & 0xFF) / 255.0f, 1.0f);
+}
+
+} // namespace
+
+TextBatch::TextBatch(GlyphAtlas& glyphAtlas)
+        : atlas(glyphAtlas), program(0), vertexArray(0), vertexBuffer(0), texture(0), viewportUniform(-1),
+          textureRows(0), bufferBytes(0), frameWidth(1), frameHeight(1), drawCalls(0) {}
+
+TextBatch::~TextBatch() {
+    if (program != 0) {
+        glDeleteProgram(program);
+        glDeleteVertexArrays(1, &vertexArray);
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteTextures(1, &texture);
+    }
+}
+
+bool TextBatch::init(string& error) {
+    GLuint vertexShader = compileShader(GL_VERTEX_SHADER, VERTEX_SHADER, error);
+    if (vertexShader == 0) {
+        return false;
+    }
+    GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER, error);
+    if (fragmentShader == 0) {
+        glDeleteShader(vertexShader);
+        return false;
+    }
+    program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glLinkProgram(program);
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE) {
+        char log[1024] = "";
+        glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+        error = string("Shaders did not link: ") + log;
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+    viewportUniform = glGetUniformLocation(program, "viewport");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "atlas"), 0);
+
+    glGenVertexArrays(1, &vertexArray);
+    glGenBuffers(1, &vertexBuffer);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(BatchVertex),
+                          reinterpret_cast<const void*>(offsetof(BatchVertex, x)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(BatchVertex),
+                          reinterpret_cast<const void*>(offsetof(BatchVertex, u)));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(BatchVertex),
+                          reinterpret_cast<const void*>(offsetof(BatchVertex, color)));
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    textureRows = 0;
+    return true;
+}
+
+void TextBatch::begin(int width, int height, uint32_t background) {
+    frameWidth = max(width, 1);
+    frameHeight = max(height, 1);
+    vertices.clear();
+    fills.clear();
+    drawCalls = 0;
+
+    glViewport(0, 0, frameWidth, frameHeight);
+    setClearColor(background);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+// Two triangles
+void TextBatch::addQuad(float x0, float y0, float x1, float y1, uint16_t u0, uint16_t v0, uint16_t u1, uint16_t v1,
+                        uint32_t color) {
+    BatchVertex topLeft = {x0, y0, u0, v0, color};
+    BatchVertex topRight = {x1, y0, u1, v0, color};
+    BatchVertex bottomLeft = {x0, y1, u0, v1, color};
+    BatchVertex bottomRight = {x1, y1, u1, v1, color};
+    vertices.insert(vertices.end(), {topLeft, bottomLeft, topRight, topRight, bottomLeft, bottomRight});
+}
+
+void TextBatch::addRect(float x, float y, float width, float height, uint32_t color) {
+    fills.push_back({x, y, width, height, color});
+}
+
+void TextBatch::addText(const TextLayout& layout, float x, float y, uint32_t color, size_t firstLine, size_t endLine,
+                        float centerWidth) {
+    endLine = min(endLine, layout.lineCount());
+    if (firstLine >= endLine) {
+        return;
+    }
+    // Whole pixels, so every glyph lands texel for texel
+    float left = static_cast<float>(static_cast<int32_t>(x));
+    float top = static_cast<float>(static_cast<int32_t>(y));
+    vertices.reserve(vertices.size() + 6 * static_cast<size_t>(layout.end(endLine) - layout.begin(firstLine)));
+    for (size_t line = firstLine; line < endLine; ++line) {
+        float lineLeft = left;
+        if (centerWidth > 0.0f) {
+            lineLeft += static_cast<float>(static_cast<int32_t>((centerWidth - layout.lineWidth(line)) / 2.0f));
+        }
+        for (const PlacedGlyph* glyph = layout.begin(line); glyph != layout.end(line + 1); ++glyph) {
+            float x0 = lineLeft + static_cast<float>(glyph->x);
+            float y0 = top + static_cast<float>(glyph->y);
+            addQuad(x0, y0, x0 + glyph->width, y0 + glyph->height, glyph->atlasX, glyph->atlasY,
+                    static_cast<uint16_t>(glyph->atlasX + glyph->width),
+                    static_cast<uint16_t>(glyph->atlasY + glyph->height), color);
+        }
+    }
+}
+
+/**
+ * Brings the texture up to date with the atlas
+ * Description:
+ *   - Only the rows that gained glyphs are sent; the texture is only made again when the atlas grew.
+ */
+void TextBatch::uploadAtlas() {
+    int top = 0;
+    int bottom = 0;
+    if (!atlas.takeDirtyRows(top, bottom)) {
+        return;
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (atlas.rows() != textureRows) {
+        textureRows = atlas.rows();
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlas.width(), textureRows, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data());
+        return;
+    }
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, top, atlas.width(), bottom - top, GL_RED, GL_UNSIGNED_BYTE,
+                    atlas.data() + static_cast<size_t>(top) * atlas.width());
+}
+
+size_t TextBatch::flush() {
+    if (!fills.empty()) {
+        // Scissor boxes count from the bottom-left
+        glEnable(GL_SCISSOR_TEST);
+        for (const BatchFill& fill : fills) {
+            int left = static_cast<int>(fill.x);
+            int top = static_cast<int>(fill.y);
+            int right = static_cast<int>(fill.x + fill.width);
+            int bottom = static_cast<int>(fill.y + fill.height);
+            glScissor(left, frameHeight - bottom, max(right - left, 0), max(bottom - top, 0));
+            setClearColor(fill.color);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+        glDisable(GL_SCISSOR_TEST);
+        fills.clear();
+    }
+
+    uploadAtlas();
+    if (vertices.empty()) {
+        return 0;
+    }
+
+    glUseProgram(program);
+    glUniform2f(viewportUniform, static_cast<float>(frameWidth), static_cast<float>(frameHeight));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(vertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+
+    // A fresh store each frame (orphaning), so the driver never waits for the last frame's draw to finish
+    size_t bytes = vertices.size() * sizeof(BatchVertex);
+    bufferBytes = max(bufferBytes, bytes);
+    glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(bufferBytes), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(bytes), vertices.data());
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(vertices.size()));
+    ++drawCalls;
+
+    size_t quads = vertices.size() / 6;
+    vertices.clear();
+    return quads;
+}
@@ -0,0 +1,123 @@
+/**
+ * textbatch.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for the OpenGL side of the graphical front end. A TextBatch collects the glyphs of every
+ * piece of text on a screen into one vertex array and draws them with a single draw call from one
+ * texture: the glyph atlas, with only the rows that gained glyphs uploaded again. Plain boxes under the
+ * text are filled with scissored clears, which a software rasterizer does as a memset rather than
+ * blending every pixel. That keeps a frame to one buffer upload and one draw, which is what lets Mesa's
+ * llvmpipe keep up.
+ * Needs an OpenGL 3.3 core context, current, with its functions loaded by GLAD.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_TEXTBATCH_H
+#define M2AP_TEXTBATCH_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "glyphatlas.h"
+#include "textlayout.h"
+using namespace std;
+
+// One corner of a glyph: 16 bytes
+struct BatchVertex {
+    float x;
+    float y;
+    uint16_t u;             // Atlas pixel
+    uint16_t v;
+    uint32_t color;         // 0xAABBGGRR, i.e. R, G, B, A in memory order
+};
+
+// A box filled under the text
+struct BatchFill {
+    float x;
+    float y;
+    float width;
+    float height;
+    uint32_t color;
+};
+
+/**
+ * Returns:
+ *   - uint32_t: A color as BatchVertex keeps it.
+ */
+inline uint32_t packColor(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha = 255) {
+    return static_cast<uint32_t>(red) | static_cast<uint32_t>(green) << 8 | static_cast<uint32_t>(blue) << 16 |
+           static_cast<uint32_t>(alpha) << 24;
+}
+
+class TextBatch {
+private:
+    GlyphAtlas& atlas;
+    unsigned program;           // GL object names
+    unsigned vertexArray;
+    unsigned vertexBuffer;
+    unsigned texture;
+    int viewportUniform;
+    int textureRows;            // Rows of the atlas the texture was made with
+    size_t bufferBytes;         // Size of the vertex buffer's store
+    vector<BatchVertex> vertices;
+    vector<BatchFill> fills;
+    int frameWidth;
+    int frameHeight;
+    size_t drawCalls;
+
+    void addQuad(float x0, float y0, float x1, float y1, uint16_t u0, uint16_t v0, uint16_t u1, uint16_t v1,
+                 uint32_t color);
+    void uploadAtlas();
+
+public:
+    explicit TextBatch(GlyphAtlas& glyphAtlas);
+    ~TextBatch();
+
+    TextBatch(const TextBatch&) = delete;
+    TextBatch& operator=(const TextBatch&) = delete;
+
+    /**
+     * Compiles the shaders and makes the buffers and the atlas texture
+     * Inputs:
+     *   - string& error: Receives a description of the failure (such as a shader log), if any.
+     */
+    bool init(string& error);
+
+    /**
+     * Starts a frame: sets the viewport and clears it
+     * Inputs:
+     *   - int width, int height: Framebuffer size in pixels; coordinates run from the top-left.
+     *   - uint32_t background: Clear color, from packColor().
+     */
+    void begin(int width, int height, uint32_t background);
+
+    /**
+     * Adds an opaque rectangle, drawn under all of the batch's text; rectangles overlap in the order added
+     */
+    void addRect(float x, float y, float width, float height, uint32_t color);
+
+    /**
+     * Adds lines of laid-out text
+     * Inputs:
+     *   - const TextLayout& layout: Text to draw.
+     *   - float x, float y: Where the text's top-left goes.
+     *   - uint32_t color: Text color.
+     *   - size_t firstLine, size_t endLine: Lines to draw, as [firstLine, endLine); lines scrolled out of
+     *     view are skipped without looking at their glyphs.
+     *   - float centerWidth: If positive, each line is centered in this width from x.
+     */
+    void addText(const TextLayout& layout, float x, float y, uint32_t color, size_t firstLine = 0,
+                 size_t endLine = SIZE_MAX, float centerWidth = 0.0f);
+
+    /**
+     * Fills the rectangles, uploads new glyphs and the frame's text, and draws the text with one call
+     * Returns:
+     *   - size_t: Glyphs drawn.
+     */
+    size_t flush();
+
+    size_t draws() const { return drawCalls; }
+};
+
+#endif // M2AP_TEXTBATCH_H
@@ -0,0 +1,150 @@
+/**
+ * textlayout.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for word-wrapped text layout.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "textlayout.h"
+#include <algorithm>
+#include <cmath>
+using namespace std;
+
+namespace {
+
+const char32_t REPLACEMENT = 0xFFFD;
+
+// Decodes one UTF-8 sequence starting at text[i] and advances i past it; bad bytes become U+FFFD
+char32_t nextCodepoint(string_view text, size_t& i) {
+    unsigned char lead = static_cast<unsigned char>(text[i++]);
+    if (lead < 0x80) {
+        return lead;
+    }
+    size_t length = lead >= 0xF0 && lead <= 0xF4 ? 3 : (lead >= 0xE0 ? 2 : (lead >= 0xC2 ? 1 : 0));
+    if (length == 0 || lead > 0xF4 || i + length > text.size()) {
+        return REPLACEMENT;
+    }
+    char32_t cp = lead & (0x3F >> length);
+    for (size_t k = 0; k < length; ++k) {
+        unsigned char byte = static_cast<unsigned char>(text[i + k]);
+        if ((byte & 0xC0) != 0x80) {
+            return REPLACEMENT;
+        }
+        cp = (cp << 6) | (byte & 0x3F);
+    }
+    i += length;
+    return cp;
+}
+
+bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+} // namespace
+
+TextLayout::TextLayout() : atlas(nullptr), wrapWidth(0), next(0), widest(0) {
+    lineStarts.push_back(0);
+}
+
+void TextLayout::reset(GlyphAtlas& glyphAtlas, string_view content, int width) {
+    atlas = &glyphAtlas;
+    text.assign(content);
+    wrapWidth = max(width, 1);
+    next = 0;
+    glyphs.clear();
+    lineStarts.assign(1, 0);
+    lineWidths.clear();
+    widest = 0;
+}
+
+/**
+ * Lays out one line
+ * Description:
+ *   - Greedy: words are placed until one would cross the wrap width, and that word starts the next line.
+ *     Spaces where a line wraps are dropped. A word is placed before it is known to fit, and taken back if
+ *     it does not, so each character is decoded once in the common case.
+ */
+void TextLayout::layoutLine() {
+    float pen = 0.0f;
+    int32_t top = static_cast<int32_t>(lineWidths.size()) * atlas->lineHeight() + atlas->baseline();
+    int32_t lineRight = 0;
+    bool wrapped = !lineWidths.empty() && text[next - 1] != '\n';
+    if (wrapped) {
+        while (next < text.size() && isSpace(text[next])) {
+            ++next;
+        }
+    }
+
+    while (next < text.size()) {
+        char c = text[next];
+        if (c == '\n') {
+            ++next;
+            break;
+        }
+        if (isSpace(c)) {
+            pen += atlas->glyph(' ').advance * (c == '\t' ? 4.0f : 1.0f);
+            ++next;
+            continue;
+        }
+
+        // One word
+        size_t wordStart = next;
+        size_t firstGlyph = glyphs.size();
+        float wordPen = pen;
+        int32_t wordRight = lineRight;
+        size_t at = next;
+        bool overflow = false;
+        while (at < text.size() && !isSpace(text[at]) && text[at] != '\n') {
+            size_t charStart = at;
+            const Glyph& glyph = atlas->glyph(nextCodepoint(text, at));
+            if (wordPen + glyph.advance > static_cast<float>(wrapWidth) && wordPen > 0.0f) {
+                overflow = true;
+                if (wordStart == next && pen == 0.0f) {
+                    // A word wider than a whole line: break it here
+                    next = charStart;
+                }
+                break;
+            }
+            if (glyph.width > 0) {
+                int32_t x = static_cast<int32_t>(lround(wordPen)) + glyph.left;
+                glyphs.push_back({x, top - glyph.top, glyph.width, glyph.height, glyph.x, glyph.y});
+                wordRight = max(wordRight, x + glyph.width);
+            }
+            wordPen += glyph.advance;
+        }
+        if (overflow) {
+            if (next == wordStart) {
+                glyphs.resize(firstGlyph);
+            } else {
+                lineRight = wordRight;
+            }
+            break;
+        }
+        next = at;
+        pen = wordPen;
+        lineRight = wordRight;
+    }
+
+    lineStarts.push_back(static_cast<uint32_t>(glyphs.size()));
+    lineWidths.push_back(lineRight);
+    widest = max(widest, lineRight);
+}
+
+size_t TextLayout::layoutLines(size_t maxLines) {
+    size_t added = 0;
+    while (added < maxLines && !complete()) {
+        layoutLine();
+        ++added;
+    }
+    return added;
+}
+
+const PlacedGlyph* TextLayout::begin(size_t firstLine) const {
+    return glyphs.data() + lineStarts[min(firstLine, lineWidths.size())];
+}
+
+const PlacedGlyph* TextLayout::end(size_t endLine) const {
+    return glyphs.data() + lineStarts[min(endLine, lineWidths.size())];
+}
@@ -0,0 +1,99 @@
+/**
+ * textlayout.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for word-wrapped text layout in the graphical front end. A TextLayout turns UTF-8 text
+ * into glyph rectangles line by line, and can stop after any number of lines and carry on later, so a
+ * definition pages long is laid out a screenful at a time over several frames instead of stalling one.
+ * Positions are whole pixels relative to the top-left of the text, ready to be batched (see textbatch.h).
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_TEXTLAYOUT_H
+#define M2AP_TEXTLAYOUT_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "glyphatlas.h"
+using namespace std;
+
+// A glyph's bitmap placed on the page
+struct PlacedGlyph {
+    int32_t x;              // Top-left corner, relative to the text's top-left
+    int32_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t atlasX;
+    uint16_t atlasY;
+};
+
+class TextLayout {
+private:
+    GlyphAtlas* atlas;
+    string text;
+    int wrapWidth;
+    size_t next;                    // Byte offset of the first character not laid out yet
+    vector<PlacedGlyph> glyphs;
+    vector<uint32_t> lineStarts;    // First glyph of each line, then one past the last glyph
+    vector<int32_t> lineWidths;
+    int32_t widest;
+
+    void layoutLine();
+
+public:
+    TextLayout();
+
+    /**
+     * Starts laying out a piece of text, dropping whatever was laid out before
+     * Inputs:
+     *   - GlyphAtlas& glyphAtlas: Font to lay out in; must outlive the layout.
+     *   - string_view content: UTF-8 text; copied. A newline always breaks the line.
+     *   - int width: Pixels a line may take before words wrap onto the next; words wider than that are
+     *     broken between characters.
+     */
+    void reset(GlyphAtlas& glyphAtlas, string_view content, int width);
+
+    /**
+     * Lays out more of the text
+     * Inputs:
+     *   - size_t maxLines: Most lines to add.
+     * Returns:
+     *   - size_t: Lines added; 0 once the text is complete.
+     */
+    size_t layoutLines(size_t maxLines);
+
+    /**
+     * Lays out the whole text
+     */
+    void layoutAll() { layoutLines(SIZE_MAX); }
+
+    bool complete() const { return next >= text.size(); }
+    bool empty() const { return text.empty(); }
+    string_view content() const { return text; }
+    int wrap() const { return wrapWidth; }
+
+    size_t lineCount() const { return lineWidths.size(); }
+    int32_t lineWidth(size_t line) const { return lineWidths[line]; }
+    int32_t width() const { return widest; }
+
+    /**
+     * Returns:
+     *   - int: Height of the lines laid out so far, in pixels.
+     */
+    int height() const { return atlas == nullptr ? 0 : static_cast<int>(lineWidths.size()) * atlas->lineHeight(); }
+
+    /**
+     * Glyphs of a range of lines
+     * Inputs:
+     *   - size_t firstLine, size_t endLine: Lines [firstLine, endLine), clamped to those laid out.
+     * Returns:
+     *   - const PlacedGlyph*: The glyphs, in order, from begin to end.
+     */
+    const PlacedGlyph* begin(size_t firstLine) const;
+    const PlacedGlyph* end(size_t endLine) const;
+};
+
+#endif // M2AP_TEXTLAYOUT_H
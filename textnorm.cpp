@@ -0,0 +1,370 @@
+/**
+ * textnorm.cpp file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Implementation file for text normalization.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#include "textnorm.h"
+using namespace std;
+
+namespace {
+
+// Folding for U+00C0..U+04FF (Latin-1 Supplement, Latin Extended-A/B, IPA, Greek, Cyrillic).
+// Generated from the Unicode Character Database: simple lowercase mapping, then the NFD base letter
+// with combining marks removed, so 'É', 'é' and 'e' + U+0301 all fold to 'e'. U+023A and U+023E, whose
+// lowercase forms lie outside the BMP's 2-byte range, fold to 'a' and 't' so folding never grows the UTF-8.
+const char32_t FOLD_FIRST = 0x00C0;
+const char32_t FOLD_LAST = 0x04FF;
+const uint16_t FOLD_TABLE[FOLD_LAST - FOLD_FIRST + 1] = {
+    0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x00E6, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065,
+    0x0069, 0x0069, 0x0069, 0x0069, 0x00F0, 0x006E, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x00D7,
+    0x00F8, 0x0075, 0x0075, 0x0075, 0x0075, 0x0079, 0x00FE, 0x00DF, 0x0061, 0x0061, 0x0061, 0x0061,
+    0x0061, 0x0061, 0x00E6, 0x0063, 0x0065, 0x0065, 0x0065, 0x0065, 0x0069, 0x0069, 0x0069, 0x0069,
+    0x00F0, 0x006E, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x00F7, 0x00F8, 0x0075, 0x0075, 0x0075,
+    0x0075, 0x0079, 0x00FE, 0x0079, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0061, 0x0063, 0x0063,
+    0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0063, 0x0064, 0x0064, 0x0111, 0x0111, 0x0065, 0x0065,
+    0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0065, 0x0067, 0x0067, 0x0067, 0x0067,
+    0x0067, 0x0067, 0x0067, 0x0067, 0x0068, 0x0068, 0x0127, 0x0127, 0x0069, 0x0069, 0x0069, 0x0069,
+    0x0069, 0x0069, 0x0069, 0x0069, 0x0069, 0x0131, 0x0133, 0x0133, 0x006A, 0x006A, 0x006B, 0x006B,
+    0x0138, 0x006C, 0x006C, 0x006C, 0x006C, 0x006C, 0x006C, 0x0140, 0x0140, 0x0142, 0x0142, 0x006E,
+    0x006E, 0x006E, 0x006E, 0x006E, 0x006E, 0x0149, 0x014B, 0x014B, 0x006F, 0x006F, 0x006F, 0x006F,
+    0x006F, 0x006F, 0x0153, 0x0153, 0x0072, 0x0072, 0x0072, 0x0072, 0x0072, 0x0072, 0x0073, 0x0073,
+    0x0073, 0x0073, 0x0073, 0x0073, 0x0073, 0x0073, 0x0074, 0x0074, 0x0074, 0x0074, 0x0167, 0x0167,
+    0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075,
+    0x0077, 0x0077, 0x0079, 0x0079, 0x0079, 0x007A, 0x007A, 0x007A, 0x007A, 0x007A, 0x007A, 0x017F,
+    0x0180, 0x0253, 0x0183, 0x0183, 0x0185, 0x0185, 0x0254, 0x0188, 0x0188, 0x0256, 0x0257, 0x018C,
+    0x018C, 0x018D, 0x01DD, 0x0259, 0x025B, 0x0192, 0x0192, 0x0260, 0x0263, 0x0195, 0x0269, 0x0268,
+    0x0199, 0x0199, 0x019A, 0x019B, 0x026F, 0x0272, 0x019E, 0x0275, 0x006F, 0x006F, 0x01A3, 0x01A3,
+    0x01A5, 0x01A5, 0x0280, 0x01A8, 0x01A8, 0x0283, 0x01AA, 0x01AB, 0x01AD, 0x01AD, 0x0288, 0x0075,
+    0x0075, 0x028A, 0x028B, 0x01B4, 0x01B4, 0x01B6, 0x01B6, 0x0292, 0x01B9, 0x01B9, 0x01BA, 0x01BB,
+    0x01BD, 0x01BD, 0x01BE, 0x01BF, 0x01C0, 0x01C1, 0x01C2, 0x01C3, 0x01C6, 0x01C6, 0x01C6, 0x01C9,
+    0x01C9, 0x01C9, 0x01CC, 0x01CC, 0x01CC, 0x0061, 0x0061, 0x0069, 0x0069, 0x006F, 0x006F, 0x0075,
+    0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x0075, 0x01DD, 0x0061, 0x0061,
+    0x0061, 0x0061, 0x00E6, 0x00E6, 0x01E5, 0x01E5, 0x0067, 0x0067, 0x006B, 0x006B, 0x006F, 0x006F,
+    0x006F, 0x006F, 0x0292, 0x0292, 0x006A, 0x01F3, 0x01F3, 0x01F3, 0x0067, 0x0067, 0x0195, 0x01BF,
+    0x006E, 0x006E, 0x0061, 0x0061, 0x00E6, 0x00E6, 0x00F8, 0x00F8, 0x0061, 0x0061, 0x0061, 0x0061,
+    0x0065, 0x0065, 0x0065, 0x0065, 0x0069, 0x0069, 0x0069, 0x0069, 0x006F, 0x006F, 0x006F, 0x006F,
+    0x0072, 0x0072, 0x0072, 0x0072, 0x0075, 0x0075, 0x0075, 0x0075, 0x0073, 0x0073, 0x0074, 0x0074,
+    0x021D, 0x021D, 0x0068, 0x0068, 0x019E, 0x0221, 0x0223, 0x0223, 0x0225, 0x0225, 0x0061, 0x0061,
+    0x0065, 0x0065, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x006F, 0x0079, 0x0079,
+    0x0234, 0x0235, 0x0236, 0x0237, 0x0238, 0x0239, 0x0061, 0x023C, 0x023C, 0x019A, 0x0074, 0x023F,
+    0x0240, 0x0242, 0x0242, 0x0180, 0x0289, 0x028C, 0x0247, 0x0247, 0x0249, 0x0249, 0x024B, 0x024B,
+    0x024D, 0x024D, 0x024F, 0x024F, 0x0250, 0x0251, 0x0252, 0x0253, 0x0254, 0x0255, 0x0256, 0x0257,
+    0x0258, 0x0259, 0x025A, 0x025B, 0x025C, 0x025D, 0x025E, 0x025F, 0x0260, 0x0261, 0x0262, 0x0263,
+    0x0264, 0x0265, 0x0266, 0x0267, 0x0268, 0x0269, 0x026A, 0x026B, 0x026C, 0x026D, 0x026E, 0x026F,
+    0x0270, 0x0271, 0x0272, 0x0273, 0x0274, 0x0275, 0x0276, 0x0277, 0x0278, 0x0279, 0x027A, 0x027B,
+    0x027C, 0x027D, 0x027E, 0x027F, 0x0280, 0x0281, 0x0282, 0x0283, 0x0284, 0x0285, 0x0286, 0x0287,
+    0x0288, 0x0289, 0x028A, 0x028B, 0x028C, 0x028D, 0x028E, 0x028F, 0x0290, 0x0291, 0x0292, 0x0293,
+    0x0294, 0x0295, 0x0296, 0x0297, 0x0298, 0x0299, 0x029A, 0x029B, 0x029C, 0x029D, 0x029E, 0x029F,
+    0x02A0, 0x02A1, 0x02A2, 0x02A3, 0x02A4, 0x02A5, 0x02A6, 0x02A7, 0x02A8, 0x02A9, 0x02AA, 0x02AB,
+    0x02AC, 0x02AD, 0x02AE, 0x02AF, 0x02B0, 0x02B1, 0x02B2, 0x02B3, 0x02B4, 0x02B5, 0x02B6, 0x02B7,
+    0x02B8, 0x02B9, 0x02BA, 0x02BB, 0x02BC, 0x02BD, 0x02BE, 0x02BF, 0x02C0, 0x02C1, 0x02C2, 0x02C3,
+    0x02C4, 0x02C5, 0x02C6, 0x02C7, 0x02C8, 0x02C9, 0x02CA, 0x02CB, 0x02CC, 0x02CD, 0x02CE, 0x02CF,
+    0x02D0, 0x02D1, 0x02D2, 0x02D3, 0x02D4, 0x02D5, 0x02D6, 0x02D7, 0x02D8, 0x02D9, 0x02DA, 0x02DB,
+    0x02DC, 0x02DD, 0x02DE, 0x02DF, 0x02E0, 0x02E1, 0x02E2, 0x02E3, 0x02E4, 0x02E5, 0x02E6, 0x02E7,
+    0x02E8, 0x02E9, 0x02EA, 0x02EB, 0x02EC, 0x02ED, 0x02EE, 0x02EF, 0x02F0, 0x02F1, 0x02F2, 0x02F3,
+    0x02F4, 0x02F5, 0x02F6, 0x02F7, 0x02F8, 0x02F9, 0x02FA, 0x02FB, 0x02FC, 0x02FD, 0x02FE, 0x02FF,
+    0x0300, 0x0301, 0x0302, 0x0303, 0x0304, 0x0305, 0x0306, 0x0307, 0x0308, 0x0309, 0x030A, 0x030B,
+    0x030C, 0x030D, 0x030E, 0x030F, 0x0310, 0x0311, 0x0312, 0x0313, 0x0314, 0x0315, 0x0316, 0x0317,
+    0x0318, 0x0319, 0x031A, 0x031B, 0x031C, 0x031D, 0x031E, 0x031F, 0x0320, 0x0321, 0x0322, 0x0323,
+    0x0324, 0x0325, 0x0326, 0x0327, 0x0328, 0x0329, 0x032A, 0x032B, 0x032C, 0x032D, 0x032E, 0x032F,
+    0x0330, 0x0331, 0x0332, 0x0333, 0x0334, 0x0335, 0x0336, 0x0337, 0x0338, 0x0339, 0x033A, 0x033B,
+    0x033C, 0x033D, 0x033E, 0x033F, 0x0340, 0x0341, 0x0342, 0x0343, 0x0344, 0x0345, 0x0346, 0x0347,
+    0x0348, 0x0349, 0x034A, 0x034B, 0x034C, 0x034D, 0x034E, 0x034F, 0x0350, 0x0351, 0x0352, 0x0353,
+    0x0354, 0x0355, 0x0356, 0x0357, 0x0358, 0x0359, 0x035A, 0x035B, 0x035C, 0x035D, 0x035E, 0x035F,
+    0x0360, 0x0361, 0x0362, 0x0363, 0x0364, 0x0365, 0x0366, 0x0367, 0x0368, 0x0369, 0x036A, 0x036B,
+    0x036C, 0x036D, 0x036E, 0x036F, 0x0371, 0x0371, 0x0373, 0x0373, 0x02B9, 0x0375, 0x0377, 0x0377,
+    0x0378, 0x0379, 0x037A, 0x037B, 0x037C, 0x037D, 0x003B, 0x03F3, 0x0380, 0x0381, 0x0382, 0x0383,
+    0x0384, 0x00A8, 0x03B1, 0x00B7, 0x03B5, 0x03B7, 0x03B9, 0x038B, 0x03BF, 0x038D, 0x03C5, 0x03C9,
+    0x03B9, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB,
+    0x03BC, 0x03BD, 0x03BE, 0x03BF, 0x03C0, 0x03C1, 0x03A2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7,
+    0x03C8, 0x03C9, 0x03B9, 0x03C5, 0x03B1, 0x03B5, 0x03B7, 0x03B9, 0x03C5, 0x03B1, 0x03B2, 0x03B3,
+    0x03B4, 0x03B5, 0x03B6, 0x03B7, 0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF,
+    0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7, 0x03C8, 0x03C9, 0x03B9, 0x03C5,
+    0x03BF, 0x03C5, 0x03C9, 0x03D7, 0x03D0, 0x03D1, 0x03D2, 0x03D2, 0x03D2, 0x03D5, 0x03D6, 0x03D7,
+    0x03D9, 0x03D9, 0x03DB, 0x03DB, 0x03DD, 0x03DD, 0x03DF, 0x03DF, 0x03E1, 0x03E1, 0x03E3, 0x03E3,
+    0x03E5, 0x03E5, 0x03E7, 0x03E7, 0x03E9, 0x03E9, 0x03EB, 0x03EB, 0x03ED, 0x03ED, 0x03EF, 0x03EF,
+    0x03F0, 0x03F1, 0x03F2, 0x03F3, 0x03B8, 0x03F5, 0x03F6, 0x03F8, 0x03F8, 0x03F2, 0x03FB, 0x03FB,
+    0x03FC, 0x037B, 0x037C, 0x037D, 0x0435, 0x0435, 0x0452, 0x0433, 0x0454, 0x0455, 0x0456, 0x0456,
+    0x0458, 0x0459, 0x045A, 0x045B, 0x043A, 0x0438, 0x0443, 0x045F, 0x0430, 0x0431, 0x0432, 0x0433,
+    0x0434, 0x0435, 0x0436, 0x0437, 0x0438, 0x0438, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447, 0x0448, 0x0449, 0x044A, 0x044B,
+    0x044C, 0x044D, 0x044E, 0x044F, 0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+    0x0438, 0x0438, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F, 0x0440, 0x0441, 0x0442, 0x0443,
+    0x0444, 0x0445, 0x0446, 0x0447, 0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+    0x0435, 0x0435, 0x0452, 0x0433, 0x0454, 0x0455, 0x0456, 0x0456, 0x0458, 0x0459, 0x045A, 0x045B,
+    0x043A, 0x0438, 0x0443, 0x045F, 0x0461, 0x0461, 0x0463, 0x0463, 0x0465, 0x0465, 0x0467, 0x0467,
+    0x0469, 0x0469, 0x046B, 0x046B, 0x046D, 0x046D, 0x046F, 0x046F, 0x0471, 0x0471, 0x0473, 0x0473,
+    0x0475, 0x0475, 0x0475, 0x0475, 0x0479, 0x0479, 0x047B, 0x047B, 0x047D, 0x047D, 0x047F, 0x047F,
+    0x0481, 0x0481, 0x0482, 0x0483, 0x0484, 0x0485, 0x0486, 0x0487, 0x0488, 0x0489, 0x048B, 0x048B,
+    0x048D, 0x048D, 0x048F, 0x048F, 0x0491, 0x0491, 0x0493, 0x0493, 0x0495, 0x0495, 0x0497, 0x0497,
+    0x0499, 0x0499, 0x049B, 0x049B, 0x049D, 0x049D, 0x049F, 0x049F, 0x04A1, 0x04A1, 0x04A3, 0x04A3,
+    0x04A5, 0x04A5, 0x04A7, 0x04A7, 0x04A9, 0x04A9, 0x04AB, 0x04AB, 0x04AD, 0x04AD, 0x04AF, 0x04AF,
+    0x04B1, 0x04B1, 0x04B3, 0x04B3, 0x04B5, 0x04B5, 0x04B7, 0x04B7, 0x04B9, 0x04B9, 0x04BB, 0x04BB,
+    0x04BD, 0x04BD, 0x04BF, 0x04BF, 0x04CF, 0x0436, 0x0436, 0x04C4, 0x04C4, 0x04C6, 0x04C6, 0x04C8,
+    0x04C8, 0x04CA, 0x04CA, 0x04CC, 0x04CC, 0x04CE, 0x04CE, 0x04CF, 0x0430, 0x0430, 0x0430, 0x0430,
+    0x04D5, 0x04D5, 0x0435, 0x0435, 0x04D9, 0x04D9, 0x04D9, 0x04D9, 0x0436, 0x0436, 0x0437, 0x0437,
+    0x04E1, 0x04E1, 0x0438, 0x0438, 0x0438, 0x0438, 0x043E, 0x043E, 0x04E9, 0x04E9, 0x04E9, 0x04E9,
+    0x044D, 0x044D, 0x0443, 0x0443, 0x0443, 0x0443, 0x0443, 0x0443, 0x0447, 0x0447, 0x04F7, 0x04F7,
+    0x044B, 0x044B, 0x04FB, 0x04FB, 0x04FD, 0x04FD, 0x04FF, 0x04FF,
+};
+
+// Bytes that are not valid UTF-8 are carried through as U+DC80..U+DCFF (as Python's surrogateescape
+// does), so they still compare equal to themselves and round-trip back to the original byte.
+const char32_t ESCAPED_BYTE = 0xDC00;
+
+bool isCombiningMark(char32_t cp) {
+    return (cp >= 0x0300 && cp <= 0x036F) || (cp >= 0x1AB0 && cp <= 0x1AFF) || (cp >= 0x1DC0 && cp <= 0x1DFF)
+           || (cp >= 0x20D0 && cp <= 0x20FF) || (cp >= 0xFE20 && cp <= 0xFE2F);
+}
+
+bool isSpace(char32_t cp) {
+    return cp == ' ' || (cp >= '\t' && cp <= '\r') || cp == 0x85 || cp == 0xA0 || cp == 0x1680
+           || (cp >= 0x2000 && cp <= 0x200A) || cp == 0x2028 || cp == 0x2029 || cp == 0x202F || cp == 0x205F
+           || cp == 0x3000;
+}
+
+bool isIgnorable(char32_t cp) {
+    return (cp >= 0x200B && cp <= 0x200D) || cp == 0x2060 || cp == 0xFEFF || cp == 0xAD;
+}
+
+char32_t foldCodepoint(char32_t cp) {
+    if (cp < 0x80) {
+        return (cp >= 'A' && cp <= 'Z') ? cp + ('a' - 'A') : cp;
+    }
+    if (cp >= FOLD_FIRST && cp <= FOLD_LAST) {
+        return FOLD_TABLE[cp - FOLD_FIRST];
+    }
+    if (cp >= 0xFF01 && cp <= 0xFF5E) {
+        // Full-width ASCII
+        return foldCodepoint(cp - 0xFEE0);
+    }
+    switch (cp) {
+        case 0x2018: case 0x2019: case 0x201A: case 0x201B: case 0x2032:
+            return '\'';
+        case 0x201C: case 0x201D: case 0x201E: case 0x201F: case 0x2033:
+            return '"';
+        case 0x2010: case 0x2011: case 0x2012: case 0x2013: case 0x2014: case 0x2015: case 0x2212:
+            return '-';
+        case 0x2026:
+            return '.';
+        default:
+            return cp;
+    }
+}
+
+// Decodes one UTF-8 sequence starting at text[i] and advances i past it
+char32_t decodeUtf8(string_view text, size_t& i) {
+    unsigned char lead = static_cast<unsigned char>(text[i]);
+    size_t length;
+    char32_t cp;
+
+    if (lead < 0x80) {
+        ++i;
+        return lead;
+    } else if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        cp = lead & 0x1F;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        cp = lead & 0x0F;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        cp = lead & 0x07;
+    } else {
+        ++i;
+        return ESCAPED_BYTE + lead;
+    }
+
+    if (i + length > text.size()) {
+        ++i;
+        return ESCAPED_BYTE + lead;
+    }
+    for (size_t k = 1; k < length; ++k) {
+        unsigned char next = static_cast<unsigned char>(text[i + k]);
+        if ((next & 0xC0) != 0x80) {
+            ++i;
+            return ESCAPED_BYTE + lead;
+        }
+        cp = (cp << 6) | (next & 0x3F);
+    }
+
+    // Reject overlong forms, surrogates and values past U+10FFFF
+    if ((length == 3 && cp < 0x800) || (length == 4 && (cp < 0x10000 || cp > 0x10FFFF))
+        || (cp >= 0xD800 && cp <= 0xDFFF)) {
+        ++i;
+        return ESCAPED_BYTE + lead;
+    }
+    i += length;
+    return cp;
+}
+
+// Writes one code point as UTF-8; never longer than the sequence it was folded from
+char* writeUtf8(char32_t cp, char* out) {
+    if (cp < 0x80) {
+        *out++ = static_cast<char>(cp);
+    } else if (cp >= ESCAPED_BYTE + 0x80 && cp <= ESCAPED_BYTE + 0xFF) {
+        *out++ = static_cast<char>(cp - ESCAPED_BYTE);
+    } else if (cp < 0x800) {
+        *out++ = static_cast<char>(0xC0 | (cp >> 6));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = static_cast<char>(0xE0 | (cp >> 12));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = static_cast<char>(0xF0 | (cp >> 18));
+        *out++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+// Walks the text once, handing each normalized code point to emit. ASCII takes a short path since
+// most decks are mostly ASCII.
+template <class Emit>
+void normalizeInto(string_view text, Emit emit) {
+    bool started = false;
+    bool pendingSpace = false;
+    size_t i = 0;
+
+    while (i < text.size()) {
+        unsigned char byte = static_cast<unsigned char>(text[i]);
+        char32_t cp;
+
+        if (byte < 0x80) {
+            ++i;
+            if (byte == ' ' || (byte >= '\t' && byte <= '\r')) {
+                pendingSpace = started;
+                continue;
+            }
+            cp = (byte >= 'A' && byte <= 'Z') ? byte + ('a' - 'A') : byte;
+        } else {
+            cp = decodeUtf8(text, i);
+            if (isSpace(cp)) {
+                pendingSpace = started;
+                continue;
+            }
+            if (isCombiningMark(cp) || isIgnorable(cp)) {
+                continue;
+            }
+            cp = foldCodepoint(cp);
+        }
+
+        if (pendingSpace) {
+            emit(U' ');
+            pendingSpace = false;
+        }
+        emit(cp);
+        started = true;
+    }
+}
+
+} // namespace
+
+/**
+ * Normalizes text for comparison
+ * Inputs:
+ *   - string_view text: UTF-8 text to normalize.
+ *   - string& out: Receives the normalized UTF-8 text.
+ */
+void normalizeText(string_view text, string& out) {
+    // Normalizing never lengthens the text, so write into a buffer of the input's size and trim it
+    out.resize(text.size());
+    char* begin = &out[0];
+    char* write = begin;
+    normalizeInto(text, [&write](char32_t cp) { write = writeUtf8(cp, write); });
+    out.resize(static_cast<size_t>(write - begin));
+}
+
+/**
+ * Normalizes text into code points
+ * Inputs:
+ *   - string_view text: UTF-8 text to normalize.
+ *   - u32string& out: Receives one element per normalized character.
+ */
+void normalizeCodepoints(string_view text, u32string& out) {
+    out.resize(text.size());
+    char32_t* begin = &out[0];
+    char32_t* write = begin;
+    normalizeInto(text, [&write](char32_t cp) { *write++ = cp; });
+    out.resize(static_cast<size_t>(write - begin));
+}
+
+/**
+ * Cleans text for display
+ * Inputs:
+ *   - string_view text: UTF-8 text to clean.
+ *   - string& out: Receives the cleaned UTF-8 text.
+ */
+void tidyText(string_view text, string& out) {
+    // A stray byte becomes a three-byte U+FFFD, so the output can be up to three times the input
+    out.resize(3 * text.size());
+    char* begin = out.empty() ? nullptr : &out[0];
+    char* write = begin;
+    bool pendingSpace = false;
+    size_t i = 0;
+
+    while (i < text.size()) {
+        unsigned char byte = static_cast<unsigned char>(text[i]);
+
+        if (byte > ' ' && byte < 0x7F) {
+            // Printable ASCII needs no decoding, so the whole run is copied in one tight loop
+            if (pendingSpace) {
+                *write++ = ' ';
+                pendingSpace = false;
+            }
+            do {
+                *write++ = text[i++];
+            } while (i < text.size() && static_cast<unsigned char>(text[i]) > ' '
+                     && static_cast<unsigned char>(text[i]) < 0x7F);
+            continue;
+        }
+        if (byte < 0x80) {
+            // Whitespace or a control character
+            ++i;
+            if (byte == ' ' || (byte >= '\t' && byte <= '\r')) {
+                pendingSpace = write != begin;
+            }
+            continue;
+        }
+
+        char32_t cp = decodeUtf8(text, i);
+        if (isSpace(cp)) {
+            pendingSpace = write != begin;
+            continue;
+        }
+        if (isIgnorable(cp) || (cp >= 0x80 && cp <= 0x9F)) {
+            continue;
+        }
+        if (cp >= ESCAPED_BYTE + 0x80 && cp <= ESCAPED_BYTE + 0xFF) {
+            cp = 0xFFFD;
+        }
+        if (pendingSpace) {
+            *write++ = ' ';
+            pendingSpace = false;
+        }
+        write = writeUtf8(cp, write);
+    }
+    out.resize(static_cast<size_t>(write - begin));
+}
+
+/**
+ * 64-bit FNV-1a hash of a piece of text
+ */
+uint64_t hashText(string_view text) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 0x100000001b3ULL;
+    }
+    // FNV's low bits mix poorly and callers mask them off for table slots, so finish with an avalanche step
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
@@ -0,0 +1,56 @@
+/**
+ * textnorm.h file for CppPy-StudyTool
+ * Author: Ian Cox
+ *
+ * Header file for text normalization shared by the card index, answer grading and the deck cleaner.
+ * Normalization is Unicode-aware: it decodes UTF-8, folds case and accents for Latin, Greek and Cyrillic,
+ * maps full-width forms, typographic quotes and dashes to ASCII, drops combining marks and zero-width
+ * characters, and collapses all kinds of whitespace.
+ * Known bugs: None.
+ * TODO: N/A
+ */
+
+#ifndef M2AP_TEXTNORM_H
+#define M2AP_TEXTNORM_H
+#include <cstdint>
+#include <string>
+#include <string_view>
+using namespace std;
+
+/**
+ * Normalizes text for comparison
+ * Inputs:
+ *   - string_view text: UTF-8 text to normalize.
+ *   - string& out: Receives the normalized UTF-8 text. Reusing one buffer avoids an allocation per call.
+ * Description:
+ *   - Folds case and accents, trims the ends and collapses every run of whitespace into one space.
+ *   - Invalid UTF-8 bytes are kept as they are.
+ */
+void normalizeText(string_view text, string& out);
+
+/**
+ * Normalizes text into code points
+ * Inputs:
+ *   - string_view text: UTF-8 text to normalize.
+ *   - u32string& out: Receives one element per normalized character, for character-level edit distance.
+ */
+void normalizeCodepoints(string_view text, u32string& out);
+
+/**
+ * Cleans text for display
+ * Inputs:
+ *   - string_view text: UTF-8 text to clean, such as a card read from an imported deck.
+ *   - string& out: Receives the cleaned UTF-8 text.
+ * Description:
+ *   - Unlike normalizeText, case and accents are kept: the result is still meant to be shown.
+ *   - Trims the ends, collapses every run of whitespace into one space, drops control and zero-width
+ *     characters (including byte order marks) and replaces invalid UTF-8 with U+FFFD.
+ */
+void tidyText(string_view text, string& out);
+
+/**
+ * 64-bit FNV-1a hash of a piece of text, with a final avalanche so the low bits can index tables
+ */
+uint64_t hashText(string_view text);
+
+#endif // M2AP_TEXTNORM_H